@@ -9,6 +9,7 @@ all: libAP4.a
 
 CORE_SOURCES = 								\
     Ap4Results.cpp                          \
+    Ap4Arena.cpp                            \
     Ap4Atom.cpp                             \
     Ap4AtomFactory.cpp                      \
     Ap4AtomSampleTable.cpp                  \
@@ -29,6 +30,9 @@ CORE_SOURCES = 								\
     Ap4File.cpp                             \
     Ap4FileWriter.cpp                       \
     Ap4FileCopier.cpp                       \
+    Ap4FastStart.cpp                        \
+    Ap4Fragmenter.cpp                       \
+    Ap4InPlaceMoovWriter.cpp                \
     Ap4FrmaAtom.cpp                         \
     Ap4FtypAtom.cpp                         \
     Ap4HdlrAtom.cpp                         \
@@ -51,6 +55,7 @@ CORE_SOURCES = 								\
     Ap4OhdrAtom.cpp                         \
     Ap4OmaDcf.cpp                           \
     Ap4Processor.cpp                        \
+    Ap4Threads.cpp                          \
     Ap4Protection.cpp                       \
     Ap4RtpAtom.cpp                          \
     Ap4RtpHint.cpp                          \
@@ -121,6 +126,7 @@ CORE_SOURCES = 								\
     Ap4SgpdAtom.cpp                         \
     Ap4SbgpAtom.cpp                         \
     Ap4NalParser.cpp                        \
+    Ap4AnnexBWriter.cpp                     \
     Ap4AvcParser.cpp                        \
     Ap4HevcParser.cpp                       \
     Ap4SegmentBuilder.cpp                   \
@@ -134,7 +140,7 @@ CRYPTO_OBJECTS = $(CRYPTO_SOURCES:.cpp=.o)
 METADATA_SOURCES = Ap4MetaData.cpp
 METADATA_OBJECTS = $(METADATA_SOURCES:.cpp=.o)
 
-SYSTEM_SOURCES = $(FILE_BYTE_STREAM_IMPLEMENTATION).cpp $(RANDOM_IMPLEMENTATION).cpp
+SYSTEM_SOURCES = $(FILE_BYTE_STREAM_IMPLEMENTATION).cpp $(RANDOM_IMPLEMENTATION).cpp $(MAPPED_FILE_BYTE_STREAM_IMPLEMENTATION:=.cpp) $(THREADS_IMPLEMENTATION).cpp
 SYSTEM_OBJECTS = $(SYSTEM_SOURCES:.cpp=.o)
 
 CODECS_SOURCES = Ap4AdtsParser.cpp Ap4BitStream.cpp Ap4Mp4AudioInfo.cpp
@@ -152,6 +158,7 @@ VPATH += $(SOURCE_ROOT)/Core
 VPATH += $(SOURCE_ROOT)/Crypto
 VPATH += $(SOURCE_ROOT)/System/StdC
 VPATH += $(SOURCE_ROOT)/System/Posix
+VPATH += $(SOURCE_ROOT)/System/Win32
 VPATH += $(SOURCE_ROOT)/Codecs
 VPATH += $(SOURCE_ROOT)/MetaData
 VPATH += $(SOURCE_ROOT)/CApi
@@ -0,0 +1,36 @@
+##########################################################################
+#
+#    Mp4Package Program
+#
+#    (c) 2002-2014 Axiomatic Systems, LLC
+#
+##########################################################################
+all: mp4package
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Lib.exp
+
+##########################################################################
+# targets
+##########################################################################
+TARGET_SOURCES = Mp4Package.cpp
+
+##########################################################################
+# make path
+##########################################################################
+VPATH += $(SOURCE_ROOT)/Apps/Mp4Package
+
+##########################################################################
+# includes
+##########################################################################
+include $(BUILD_ROOT)/Makefiles/Rules.mak
+
+##########################################################################
+# rules
+##########################################################################
+mp4package: $(TARGET_OBJECTS) $(TARGET_LIBRARY_FILES)
+	$(LINK) $(TARGET_OBJECTS) -o $@ $(LINK_LIBRARIES)
+
+
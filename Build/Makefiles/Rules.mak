@@ -47,7 +47,7 @@ INVOKE_SUBMAKE = $(MAKE) --no-print-directory
 # variables
 ##########################################################################
 LINK                 = $(LINK_CPP)
-LINK_LIBRARIES      += $(foreach lib,$(TARGET_LIBRARIES),-l$(lib))
+LINK_LIBRARIES      += $(foreach lib,$(TARGET_LIBRARIES),-l$(lib)) $(LIBRARIES_CPP)
 TARGET_LIBRARY_FILES = $(foreach lib,$(TARGET_LIBRARIES),lib$(lib).a)
 TARGET_OBJECTS       = $(TARGET_SOURCES:.cpp=.o)
 
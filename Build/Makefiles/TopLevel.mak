@@ -19,6 +19,8 @@ export TARGET
 
 export FILE_BYTE_STREAM_IMPLEMENTATION
 export RANDOM_IMPLEMENTATION
+export MAPPED_FILE_BYTE_STREAM_IMPLEMENTATION
+export THREADS_IMPLEMENTATION
 
 export CC
 export AUTODEP_CPP
@@ -49,7 +51,7 @@ Setup:
 	mkdir $(OUTPUT_DIR)
     
 # ------- Apps -----------
-ALL_APPS = mp4dump mp4info mp42aac mp42ts aac2mp4 mp4decrypt mp4encrypt mp4edit mp4extract mp4rtphintinfo mp4tag mp4dcfpackager mp4fragment mp4compact mp4split mp4mux avcinfo hevcinfo mp42hevc mp42hls
+ALL_APPS = mp4dump mp4info mp42aac mp42ts aac2mp4 mp4decrypt mp4encrypt mp4edit mp4extract mp4rtphintinfo mp4tag mp4dcfpackager mp4fragment mp4compact mp4faststart mp4split mp4package mp4mux avcinfo hevcinfo mp42hevc mp42hls
 export ALL_APPS
 
 ##################################################################
@@ -129,10 +131,18 @@ mp4split: lib
 	$(TITLE)
 	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4Split.mak
 
+mp4package: lib
+	$(TITLE)
+	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4Package.mak
+
 mp4compact: lib
 	$(TITLE)
 	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4Compact.mak
 	
+mp4faststart: lib
+	$(TITLE)
+	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4FastStart.mak
+
 mp4mux: lib
 	$(TITLE)
 	@$(INVOKE_SUBMAKE) -f $(BUILD_ROOT)/Makefiles/Mp4Mux.mak
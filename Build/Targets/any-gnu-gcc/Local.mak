@@ -57,13 +57,15 @@ WARNINGS_CPP = -Wall -Wshadow -Wpointer-arith -Wcast-qual
 INCLUDES_CPP =
 
 # libraries
-LIBRARIES_CPP = 
+LIBRARIES_CPP = -lpthread
 
 #######################################################################
 #    module selection
 #######################################################################
 FILE_BYTE_STREAM_IMPLEMENTATION = Ap4StdCFileByteStream
 RANDOM_IMPLEMENTATION = Ap4PosixRandom
+MAPPED_FILE_BYTE_STREAM_IMPLEMENTATION = Ap4PosixMappedFileByteStream
+THREADS_IMPLEMENTATION = Ap4PosixThreads
 
 #######################################################################
 #    includes
@@ -64,84 +64,43 @@ WriteSample(const AP4_DataBuffer& sample_data,
             unsigned int          nalu_length_size, 
             AP4_ByteStream*       output)
 {
-    const unsigned char* data      = sample_data.GetData();
-    unsigned int         data_size = sample_data.GetDataSize();
+    const AP4_UI08* data      = sample_data.GetData();
+    AP4_Size        data_size = sample_data.GetDataSize();
+    const AP4_UI08* nalu      = NULL;
+    AP4_Size        nalu_size = 0;
 
-    // allocate a buffer for the PES packet
-    AP4_DataBuffer frame_data;
-    unsigned char* frame_buffer = NULL;
+    // allocate a buffer for the frame data
+    AP4_DataBuffer   frame_data;
+    AP4_AnnexBWriter writer(frame_data);
+    writer.Reserve(6+prefix.GetDataSize()+data_size);
 
     // add a delimiter if we don't already have one
     bool have_access_unit_delimiter = (data_size >  nalu_length_size) && ((data[nalu_length_size] & 0x1F) == AP4_AVC_NAL_UNIT_TYPE_ACCESS_UNIT_DELIMITER);
     if (!have_access_unit_delimiter) {
-        AP4_Size frame_data_size = frame_data.GetDataSize();
-        frame_data.SetDataSize(frame_data_size+6);
-        frame_buffer = frame_data.UseData()+frame_data_size;
-    
         // start of access unit
-        frame_buffer[0] = 0;
-        frame_buffer[1] = 0;
-        frame_buffer[2] = 0;
-        frame_buffer[3] = 1;
-        frame_buffer[4] = 9;    // NAL type = Access Unit Delimiter;
-        frame_buffer[5] = 0xE0; // Slice types = ANY
+        unsigned char delimiter[6];
+        delimiter[0] = 0;
+        delimiter[1] = 0;
+        delimiter[2] = 0;
+        delimiter[3] = 1;
+        delimiter[4] = 9;    // NAL type = Access Unit Delimiter;
+        delimiter[5] = 0xE0; // Slice types = ANY
+        writer.Write(delimiter, 6);
     }
     
-    // write the NAL units
-    bool prefix_added = false;
-    while (data_size) {
-        // sanity check
-        if (data_size < nalu_length_size) break;
-        
-        // get the next NAL unit
-        AP4_UI32 nalu_size;
-        if (nalu_length_size == 1) {
-            nalu_size = *data++;
-            data_size--;
-        } else if (nalu_length_size == 2) {
-            nalu_size = AP4_BytesToInt16BE(data);
-            data      += 2;
-            data_size -= 2;
-        } else if (nalu_length_size == 4) {
-            nalu_size = AP4_BytesToInt32BE(data);
-            data      += 4;
-            data_size -= 4;
-        } else {
-            break;
+    // write the first NAL unit, with the prefix right after the delimiter
+    if (AP4_AnnexBWriter::ReadNalu(data, data_size, nalu_length_size, nalu, nalu_size)) {
+        if (!have_access_unit_delimiter) {
+            writer.Write(prefix.GetData(), prefix.GetDataSize());
         }
-        if (nalu_size > data_size) break;
-        
-        // add the prefix if needed
-        if (prefix.GetDataSize() && !prefix_added && !have_access_unit_delimiter) {
-            AP4_Size frame_data_size = frame_data.GetDataSize();
-            frame_data.SetDataSize(frame_data_size+prefix.GetDataSize());
-            frame_buffer = frame_data.UseData()+frame_data_size;
-            AP4_CopyMemory(frame_buffer, prefix.GetData(), prefix.GetDataSize());
-            prefix_added = true;
+        writer.WriteNalu(nalu, nalu_size);
+        if (have_access_unit_delimiter) {
+            writer.Write(prefix.GetData(), prefix.GetDataSize());
         }
-    
-        // add a start code before the NAL unit
-        AP4_Size frame_data_size = frame_data.GetDataSize();
-        frame_data.SetDataSize(frame_data_size+3+nalu_size);
-        frame_buffer = frame_data.UseData()+frame_data_size;
-        frame_buffer[0] = 0;
-        frame_buffer[1] = 0;
-        frame_buffer[2] = 1;
-        AP4_CopyMemory(frame_buffer+3, data, nalu_size);
         
-        // add the prefix if needed
-        if (prefix.GetDataSize() && !prefix_added) {
-            AP4_Size frame_data_size = frame_data.GetDataSize();
-            frame_data.SetDataSize(frame_data_size+prefix.GetDataSize());
-            frame_buffer = frame_data.UseData()+frame_data_size;
-            AP4_CopyMemory(frame_buffer, prefix.GetData(), prefix.GetDataSize());
-            prefix_added = true;
-        }
-
-        // move to the next NAL unit
-        data      += nalu_size;
-        data_size -= nalu_size;
-    } 
+        // write the other NAL units as they are
+        writer.WriteSample(data, data_size, nalu_length_size);
+    }
     
     output->Write(frame_data.GetData(), frame_data.GetDataSize());
 }
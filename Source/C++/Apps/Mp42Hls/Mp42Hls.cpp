@@ -164,12 +164,15 @@ public:
 class TrackSampleReader : public SampleReader
 {
 public:
-    TrackSampleReader(AP4_Track& track) : m_Track(track), m_SampleIndex(0) {}
+    TrackSampleReader(AP4_Track& track) : m_Track(track), m_SampleIndex(0), m_ChunkPosition(0) {}
     AP4_Result ReadSample(AP4_Sample& sample, AP4_DataBuffer& sample_data);
     
 private:
-    AP4_Track&  m_Track;
-    AP4_Ordinal m_SampleIndex;
+    AP4_Track&            m_Track;
+    AP4_Ordinal           m_SampleIndex;   // next sample to read from the track
+    AP4_Array<AP4_Sample> m_ChunkSamples;  // samples read together
+    AP4_DataBuffer        m_ChunkData;
+    AP4_Ordinal           m_ChunkPosition; // next sample to return from the chunk
 };
 
 /*----------------------------------------------------------------------
@@ -178,8 +181,19 @@ private:
 AP4_Result 
 TrackSampleReader::ReadSample(AP4_Sample& sample, AP4_DataBuffer& sample_data)
 {
-    if (m_SampleIndex >= m_Track.GetSampleCount()) return AP4_ERROR_EOS;
-    return m_Track.ReadSample(m_SampleIndex++, sample, sample_data);
+    // read the next chunk of samples when we have returned all of them
+    if (m_ChunkPosition >= m_ChunkSamples.ItemCount()) {
+        if (m_SampleIndex >= m_Track.GetSampleCount()) return AP4_ERROR_EOS;
+        AP4_Result result = m_Track.ReadSampleChunk(m_SampleIndex, m_ChunkSamples, m_ChunkData);
+        if (AP4_FAILED(result)) return result;
+        m_SampleIndex  += m_ChunkSamples.ItemCount();
+        m_ChunkPosition = 0;
+    }
+    
+    // return the sample's slice of the chunk
+    sample = m_ChunkSamples[m_ChunkPosition++];
+    AP4_Size offset = (AP4_Size)(sample.GetOffset()-m_ChunkSamples[0].GetOffset());
+    return sample_data.SetData(m_ChunkData.GetData()+offset, sample.GetSize());
 }
 
 /*----------------------------------------------------------------------
@@ -226,37 +240,6 @@ OpenOutput(const char* filename_pattern, unsigned int segment_number)
     return output;
 }
 
-/*----------------------------------------------------------------------
-|   PreventStartCodeEmulation
-+---------------------------------------------------------------------*/
-static void
-PreventStartCodeEmulation(const AP4_UI08* payload, AP4_Size payload_size, AP4_DataBuffer& output)
-{
-    output.Reserve(payload_size*2); // more than enough
-    AP4_Size  output_size = 0;
-    AP4_UI08* buffer = output.UseData();
-    
-	unsigned int zero_counter = 0;
-	for (unsigned int i = 0; i < payload_size; i++) {
-		if (zero_counter == 2) {
-            if (payload[i] == 0 || payload[i] == 1 || payload[i] == 2 || payload[i] == 3) {
-                buffer[output_size++] = 3;
-                zero_counter = 0;
-            }
-		}
-
-        buffer[output_size++] = payload[i];
-
-		if (payload[i] == 0) {
-			++zero_counter;
-		} else {
-			zero_counter = 0;
-		}		
-	}
-
-    output.SetDataSize(output_size);
-}
-
 /*----------------------------------------------------------------------
 |   EncryptingStream
 +---------------------------------------------------------------------*/
@@ -471,7 +454,10 @@ SampleEncrypter::EncryptVideoSample(AP4_DataBuffer& sample, AP4_UI08 nalu_length
 
             // perform startcode emulation prevention
             AP4_DataBuffer escaped_nalu;
-            PreventStartCodeEmulation(nalu+nalu_length_size, nalu_length, escaped_nalu);
+            escaped_nalu.SetDataSize(AP4_AnnexBWriter::GetMaxEscapedSize(nalu_length));
+            escaped_nalu.SetDataSize(AP4_AnnexBWriter::Escape(nalu+nalu_length_size,
+                                                               nalu_length,
+                                                               escaped_nalu.UseData()));
             
             // the size may have changed
             // FIXME: this could overflow if nalu_length_size is too small
@@ -103,12 +103,15 @@ public:
 class TrackSampleReader : public SampleReader
 {
 public:
-    TrackSampleReader(AP4_Track& track) : m_Track(track), m_SampleIndex(0) {}
+    TrackSampleReader(AP4_Track& track) : m_Track(track), m_SampleIndex(0), m_ChunkPosition(0) {}
     AP4_Result ReadSample(AP4_Sample& sample, AP4_DataBuffer& sample_data);
     
 private:
-    AP4_Track&  m_Track;
-    AP4_Ordinal m_SampleIndex;
+    AP4_Track&            m_Track;
+    AP4_Ordinal           m_SampleIndex;   // next sample to read from the track
+    AP4_Array<AP4_Sample> m_ChunkSamples;  // samples read together
+    AP4_DataBuffer        m_ChunkData;
+    AP4_Ordinal           m_ChunkPosition; // next sample to return from the chunk
 };
 
 /*----------------------------------------------------------------------
@@ -117,8 +120,19 @@ private:
 AP4_Result 
 TrackSampleReader::ReadSample(AP4_Sample& sample, AP4_DataBuffer& sample_data)
 {
-    if (m_SampleIndex >= m_Track.GetSampleCount()) return AP4_ERROR_EOS;
-    return m_Track.ReadSample(m_SampleIndex++, sample, sample_data);
+    // read the next chunk of samples when we have returned all of them
+    if (m_ChunkPosition >= m_ChunkSamples.ItemCount()) {
+        if (m_SampleIndex >= m_Track.GetSampleCount()) return AP4_ERROR_EOS;
+        AP4_Result result = m_Track.ReadSampleChunk(m_SampleIndex, m_ChunkSamples, m_ChunkData);
+        if (AP4_FAILED(result)) return result;
+        m_SampleIndex  += m_ChunkSamples.ItemCount();
+        m_ChunkPosition = 0;
+    }
+    
+    // return the sample's slice of the chunk
+    sample = m_ChunkSamples[m_ChunkPosition++];
+    AP4_Size offset = (AP4_Size)(sample.GetOffset()-m_ChunkSamples[0].GetOffset());
+    return sample_data.SetData(m_ChunkData.GetData()+offset, sample.GetSize());
 }
 
 /*----------------------------------------------------------------------
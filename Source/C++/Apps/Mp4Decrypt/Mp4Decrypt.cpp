@@ -63,6 +63,10 @@ PrintUsageAndExit()
             "  --fragments-info <filename>\n"
             "      Decrypt the fragments read from <input>, with track info read\n"
             "      from <filename>.\n"
+            "  --streaming\n"
+            "      Write the output strictly forward, without seeking back, so that\n"
+            "      it can be a pipe (implied when <output> is -stdout).\n"
+            "      Any 'sidx' index is dropped in this mode.\n"
             );
     exit(1);
 }
@@ -101,6 +105,7 @@ main(int argc, char** argv)
     const char* output_filename = NULL;
     const char* fragments_info_filename = NULL;
     bool        show_progress = false;
+    bool        streaming = false;
 
     char* arg;
     while ((arg = *++argv)) {
@@ -150,6 +155,8 @@ main(int argc, char** argv)
             fragments_info_filename = arg;
         } else if (!strcmp(arg, "--show-progress")) {
             show_progress = true;
+        } else if (!strcmp(arg, "--streaming")) {
+            streaming = true;
         } else if (input_filename == NULL) {
             input_filename = arg;
         } else if (output_filename == NULL) {
@@ -173,7 +180,7 @@ main(int argc, char** argv)
     // create the input stream
     AP4_Result result;
     AP4_ByteStream* input = NULL;
-    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ_MAPPED, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file (%s) %d\n", input_filename, result);
         return 1;
@@ -223,7 +230,9 @@ main(int argc, char** argv)
                     if (sdesc && sdesc->GetType() == AP4_SampleDescription::TYPE_PROTECTED) {
                         AP4_ProtectedSampleDescription* psdesc = AP4_DYNAMIC_CAST(AP4_ProtectedSampleDescription, sdesc);
                         if (psdesc) {
-                            if (psdesc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC) {
+                            if (psdesc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC ||
+                                psdesc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENS ||
+                                psdesc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CBCS) {
                                 processor = new AP4_CencDecryptingProcessor(&key_map);
                                 break;
                             }
@@ -248,6 +257,9 @@ main(int argc, char** argv)
     }
     
     // process/decrypt the file
+    if (streaming || !strcmp(output_filename, "-stdout")) {
+        processor->SetStreamingOutput(true);
+    }
     ProgressListener listener;
     if (fragments_info) {
         result = processor->Process(*input, *output, *fragments_info, show_progress?&listener:NULL);
@@ -31,6 +31,7 @@
 +---------------------------------------------------------------------*/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Ap4.h"
 
@@ -49,11 +50,21 @@ PrintUsageAndExit()
 {
     fprintf(stderr, 
             BANNER 
-            "\n\nusage: mp4edit [commands] <input> <output>\n"
+            "\n\nusage: mp4edit [options] [commands] <input> [<output>]\n"
             "    where commands include one or more of:\n"
             "    --insert <atom_path>:<atom_source_file>[:<position>]\n"
             "    --remove <atom_path>\n"
-            "    --replace <atom_path>:<atom_source_file>\n");
+            "    --replace <atom_path>:<atom_source_file>\n"
+            "    and options include:\n"
+            "    --in-place\n"
+            "        modify <input> instead of writing an <output> file. If all the\n"
+            "        commands are within the moov atom and the new moov atom still fits\n"
+            "        in its current space (including adjacent 'free' atoms), only the\n"
+            "        moov atom is overwritten, otherwise the file is rewritten with padding\n"
+            "    --padding <n>\n"
+            "        reserve <n> bytes of 'free' space after the moov atom when the file\n"
+            "        is rewritten (default: 0, or %d with --in-place)\n",
+            AP4_IN_PLACE_MOOV_WRITER_DEFAULT_PADDING);
     exit(1);
 }
 
@@ -90,6 +101,7 @@ public:
     };
 
     // constructor and destructor
+    AP4_EditingProcessor() : m_Padding(0) {}
     virtual ~AP4_EditingProcessor();
 
     // methods
@@ -100,6 +112,8 @@ public:
                                   const char*   atom_path, 
                                   const char*   file_path,
                                   int           position = -1);
+    void               SetPadding(AP4_UI32 padding) { m_Padding = padding; }
+    bool               IsMoovOnly();
 
 private:
     // methods
@@ -113,6 +127,7 @@ private:
     // members
     AP4_List<Command> m_Commands;
     AP4_AtomParent    m_TopLevelParent;
+    AP4_UI32          m_Padding;
 };
 
 /*----------------------------------------------------------------------
@@ -167,9 +182,32 @@ AP4_EditingProcessor::Initialize(AP4_AtomParent& top_level,
         command_item = command_item->GetNext();
     }
 
+    // reserve space for future in-place edits
+    if (m_Padding) {
+        AP4_InPlaceMoovWriter::AddPadding(top_level, m_Padding);
+    }
+    
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_EditingProcessor::IsMoovOnly
++---------------------------------------------------------------------*/
+bool
+AP4_EditingProcessor::IsMoovOnly()
+{
+    for (AP4_List<Command>::Item* item = m_Commands.FirstItem();
+         item;
+         item = item->GetNext()) {
+        const AP4_String& path = item->GetData()->m_AtomPath;
+        if (item->GetData()->m_Type == Command::TYPE_INSERT && path == "moov") continue;
+        if (path.GetLength() <= 5 || strncmp(path.GetChars(), "moov/", 5) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_EditingProcessor::DoRemove
 +---------------------------------------------------------------------*/
@@ -286,6 +324,82 @@ AP4_EditingProcessor::DoReplace(Command* command, AP4_AtomParent& top_level)
     }
 }
 
+/*----------------------------------------------------------------------
+|   EditInPlace
++---------------------------------------------------------------------*/
+static AP4_Result
+EditInPlace(AP4_EditingProcessor& processor, const char* filename, int padding)
+{
+    AP4_Result result;
+    
+    // edits that stay within the moov atom don't move the media data, so
+    // try to just overwrite the moov atom first
+    if (processor.IsMoovOnly()) {
+        AP4_ByteStream* file = NULL;
+        result = AP4_FileByteStream::Create(filename, AP4_FileByteStream::STREAM_MODE_READ_WRITE, file);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open file for writing (%s)\n", filename);
+            return result;
+        }
+        AP4_DefaultAtomFactory atom_factory;
+        AP4_AtomParent*        top_level = new AP4_AtomParent();
+        result = atom_factory.CreateAtomsFromStream(*file, *top_level);
+        if (AP4_SUCCEEDED(result)) {
+            result = processor.Initialize(*top_level, *file, NULL);
+        }
+        if (AP4_SUCCEEDED(result)) {
+            AP4_Atom* moov = top_level->GetChild(AP4_ATOM_TYPE_MOOV);
+            if (moov) {
+                result = AP4_InPlaceMoovWriter::Write(*moov, *file);
+            } else {
+                result = AP4_ERROR_INVALID_FORMAT;
+            }
+        }
+        delete top_level;
+        file->Release();
+        if (result != AP4_ERROR_NOT_ENOUGH_SPACE) return result;
+    }
+    
+    // rewrite the file next to the original, with room for the next edit
+    AP4_Size   name_length = (AP4_Size)AP4_StringLength(filename);
+    AP4_String temp_filename(name_length+4);
+    AP4_CopyMemory(temp_filename.UseChars(), filename, name_length);
+    AP4_CopyMemory(temp_filename.UseChars()+name_length, ".tmp", 4);
+    AP4_ByteStream* input = NULL;
+    result = AP4_FileByteStream::Create(filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file (%s)\n", filename);
+        return result;
+    }
+    AP4_ByteStream* output = NULL;
+    result = AP4_FileByteStream::Create(temp_filename.GetChars(), AP4_FileByteStream::STREAM_MODE_WRITE, output);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open temporary file (%s)\n", temp_filename.GetChars());
+        input->Release();
+        return result;
+    }
+    processor.SetPadding(padding < 0 ? AP4_IN_PLACE_MOOV_WRITER_DEFAULT_PADDING : padding);
+    result = processor.Process(*input, *output);
+    input->Release();
+    output->Release();
+    
+    // replace the original file with the rewritten one
+    if (AP4_FAILED(result)) {
+        remove(temp_filename.GetChars());
+        return result;
+    }
+    if (rename(temp_filename.GetChars(), filename) != 0) {
+        // some platforms can't rename over an existing file
+        remove(filename);
+        if (rename(temp_filename.GetChars(), filename) != 0) {
+            fprintf(stderr, "ERROR: cannot replace the input file\n");
+            return AP4_FAILURE;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -302,9 +416,20 @@ main(int argc, char** argv)
     // parse arguments
     const char* input_filename = NULL;
     const char* output_filename = NULL;
+    bool        in_place = false;
+    int         padding = -1;
     char* arg;
     while ((arg = *++argv)) {
-        if (!AP4_CompareStrings(arg, "--insert")) {
+        if (!AP4_CompareStrings(arg, "--in-place")) {
+            in_place = true;
+        } else if (!AP4_CompareStrings(arg, "--padding")) {
+            char* param = *++argv;
+            if (param == NULL) {
+                fprintf(stderr, "ERROR: missing argument for --padding option\n");
+                return 1;
+            }
+            padding = (int)strtoul(param, NULL, 10);
+        } else if (!AP4_CompareStrings(arg, "--insert")) {
             char* param = *++argv;
             if (param == NULL) {
                 fprintf(stderr, "ERROR: missing argument for --insert command\n");
@@ -376,10 +501,18 @@ main(int argc, char** argv)
         fprintf(stderr, "ERROR: missing input filename\n");
         return 1;
     }
+    if (in_place) {
+        if (output_filename) {
+            fprintf(stderr, "ERROR: unexpected output filename with --in-place\n");
+            return 1;
+        }
+        return AP4_SUCCEEDED(EditInPlace(processor, input_filename, padding))?0:1;
+    }
     if (output_filename == NULL) {
         fprintf(stderr, "ERROR: missing output filename\n");
         return 1;
     }
+    if (padding > 0) processor.SetPadding(padding);
 
 	// create the input stream
     AP4_Result result;
@@ -52,7 +52,8 @@ PrintUsageAndExit()
         "\n\n"
         "usage: mp4encrypt --method <method> [options] <input> <output>\n"
         "  --method: <method> is OMA-PDCF-CBC, OMA-PDCF-CTR, MARLIN-IPMP-ACBC,\n"
-        "     MARLIN-IPMP-ACGK, ISMA-IAEC, PIFF-CBC, PIFF-CTR, or MPEG-CENC\n"
+        "     MARLIN-IPMP-ACGK, ISMA-IAEC, PIFF-CBC, PIFF-CTR, MPEG-CENC,\n"
+        "     MPEG-CENS or MPEG-CBCS\n"
         "  Options:\n"
         "  --show-progress: show progress details\n"
         "  --fragments-info <filename>\n"
@@ -80,13 +81,22 @@ PrintUsageAndExit()
         "      (several --pssh options can be used, with a different system ID for each)\n"
         "  --kms-uri <uri>\n"
         "      Specifies the KMS URI for the ISMA-IAEC method\n"
+        "  --threads <n>\n"
+        "      Encrypt the samples of each fragment using up to <n> threads\n"
+        "      (0 means one thread per CPU). The output is the same as with a\n"
+        "      single thread (the default). Only fragmented input encrypted with\n"
+        "      MPEG-CENC, MPEG-CENS, MPEG-CBCS or PIFF-CTR uses more than one thread.\n"
+        "  --streaming\n"
+        "      Write the output strictly forward, without seeking back, so that\n"
+        "      it can be a pipe (implied when <output> is -stdout).\n"
+        "      Any 'sidx' index is dropped in this mode.\n"
         "\n"
         "  Method Specifics:\n"
-        "    OMA-PDCF-CBC, MARLIN-IPMP-ACBC, MARLIN-IPMP-ACGK, PIFF-CBC: \n"
+        "    OMA-PDCF-CBC, MARLIN-IPMP-ACBC, MARLIN-IPMP-ACGK, PIFF-CBC, MPEG-CBCS: \n"
         "    the <iv> can be 64-bit or 128-bit\n"
         "    If the IV is specified as a 64-bit value, it will be padded with zeros.\n"
         "\n"
-        "    OMA-PDCF-CTR, ISMA-IAEC, PIFF-CTR, MPEG-CENC: the <iv> should be a 64-bit\n"
+        "    OMA-PDCF-CTR, ISMA-IAEC, PIFF-CTR, MPEG-CENC, MPEG-CENS: the <iv> should be a 64-bit\n"
         "    hex string. If a 128-bit value is supplied, it will be truncated\n"
         "    to 64-bit.\n"
         "\n"
@@ -102,7 +112,11 @@ PrintUsageAndExit()
         "    is 0. The <iv> part of the key must be present, but will be ignored;\n"
         "    It should therefore be set to 0000000000000000\n"
         "\n"
-        "    MPEG-CENC, PIFF-CTR, PIFF-CBC: The following properties are defined:\n"
+        "    MPEG-CENS, MPEG-CBCS: AVC and HEVC video is encrypted with a 1:9 pattern\n"
+        "    (one 16-byte block out of ten), other tracks are fully encrypted.\n"
+        "    With MPEG-CBCS, the <iv> is a constant IV used for all samples.\n"
+        "\n"
+        "    MPEG-CENC, MPEG-CENS, MPEG-CBCS, PIFF-CTR, PIFF-CBC: The following properties are defined:\n"
         "      KID -> the value of KID, 16 bytes, in hexadecimal (32 characters)\n"
         "      ContentId -> Content ID mapping for KID (Marlin option)\n"
         "      PsshPadding -> pad the 'pssh' container to this size\n"
@@ -124,6 +138,8 @@ enum Method {
     METHOD_PIFF_CBC,
     METHOD_PIFF_CTR,
     METHOD_MPEG_CENC,
+    METHOD_MPEG_CENS,
+    METHOD_MPEG_CBCS,
     METHOD_ISMA_AES
 }; 
 
@@ -154,7 +170,11 @@ CheckWarning(AP4_ByteStream& stream, AP4_ProtectionKeyMap& key_map, Method metho
                   true);
     AP4_Movie* movie = file.GetMovie();
     if (!movie) {
-        if (method != METHOD_MPEG_CENC && method != METHOD_PIFF_CBC && method != METHOD_PIFF_CTR) {
+        if (method != METHOD_MPEG_CENC && 
+            method != METHOD_MPEG_CENS && 
+            method != METHOD_MPEG_CBCS && 
+            method != METHOD_PIFF_CBC  && 
+            method != METHOD_PIFF_CTR) {
             fprintf(stderr, "WARNING: no movie atom found in input file\n");
             return false;
         }
@@ -163,6 +183,8 @@ CheckWarning(AP4_ByteStream& stream, AP4_ProtectionKeyMap& key_map, Method metho
     bool warning = false;
     switch (method) {
         case METHOD_MPEG_CENC:
+        case METHOD_MPEG_CENS:
+        case METHOD_MPEG_CBCS:
         case METHOD_PIFF_CBC:
         case METHOD_PIFF_CTR:
             if (movie && !movie->HasFragments()) {
@@ -209,6 +231,8 @@ main(int argc, char** argv)
     AP4_TrackPropertyMap     property_map;
     bool                     show_progress = false;
     bool                     strict = false;
+    AP4_Cardinal             thread_count = 1;
+    bool                     streaming = false;
     AP4_Array<AP4_PsshAtom*> pssh_atoms;
     AP4_Result               result;
     
@@ -235,6 +259,10 @@ main(int argc, char** argv)
                 method = METHOD_PIFF_CTR;
             } else if (!strcmp(arg, "MPEG-CENC")) {
                 method = METHOD_MPEG_CENC;
+            } else if (!strcmp(arg, "MPEG-CENS")) {
+                method = METHOD_MPEG_CENS;
+            } else if (!strcmp(arg, "MPEG-CBCS")) {
+                method = METHOD_MPEG_CBCS;
             } else if (!strcmp(arg, "ISMA-IAEC")) {
                 method = METHOD_ISMA_AES;
             } else {
@@ -297,6 +325,16 @@ main(int argc, char** argv)
                 return 1;
             }
             kms_uri = arg;
+        } else if (!strcmp(arg, "--threads")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument for --threads option\n");
+                return 1;
+            }
+            thread_count = (AP4_Cardinal)strtoul(arg, NULL, 10);
+            if (thread_count == 0) thread_count = AP4_System_GetProcessorCount();
+        } else if (!strcmp(arg, "--streaming")) {
+            streaming = true;
         } else if (!strcmp(arg, "--show-progress")) {
             show_progress = true;
         } else if (!strcmp(arg, "--show-progress")) {
@@ -363,6 +401,7 @@ main(int argc, char** argv)
                 case METHOD_ISMA_AES:
                 case METHOD_PIFF_CTR:
                 case METHOD_MPEG_CENC:
+                case METHOD_MPEG_CENS:
                     // truncate the IV
                     AP4_SetMemory(&iv[8], 0, 8);
                     break;
@@ -389,7 +428,9 @@ main(int argc, char** argv)
                 method != METHOD_MARLIN_IPMP_ACGK &&
                 method != METHOD_PIFF_CBC         &&
                 method != METHOD_PIFF_CTR         &&
-                method != METHOD_MPEG_CENC) {
+                method != METHOD_MPEG_CENC        &&
+                method != METHOD_MPEG_CENS        &&
+                method != METHOD_MPEG_CBCS) {
                 fprintf(stderr, "ERROR: this method does not use properties\n");
                 return 1;
             }
@@ -494,7 +535,9 @@ main(int argc, char** argv)
         processor = oma_processor;
     } else if (method == METHOD_PIFF_CTR ||
                method == METHOD_PIFF_CBC ||
-               method == METHOD_MPEG_CENC) {
+               method == METHOD_MPEG_CENC ||
+               method == METHOD_MPEG_CENS ||
+               method == METHOD_MPEG_CBCS) {
         AP4_CencVariant variant = AP4_CENC_VARIANT_MPEG;
         switch (method) {
             case METHOD_PIFF_CBC:
@@ -509,6 +552,14 @@ main(int argc, char** argv)
                 variant = AP4_CENC_VARIANT_MPEG;
                 break;
                 
+            case METHOD_MPEG_CENS:
+                variant = AP4_CENC_VARIANT_MPEG_CENS;
+                break;
+                
+            case METHOD_MPEG_CBCS:
+                variant = AP4_CENC_VARIANT_MPEG_CBCS;
+                break;
+                
             default:
                 break;
         }
@@ -523,7 +574,7 @@ main(int argc, char** argv)
     
     // create the input stream
     AP4_ByteStream* input = NULL;
-    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ_MAPPED, input);
     if (AP4_FAILED(result)) {
         fprintf(stderr, "ERROR: cannot open input file (%s)\n", input_filename);
         return 1;
@@ -548,6 +599,10 @@ main(int argc, char** argv)
     }
     
     // process/decrypt the file
+    processor->SetThreadCount(thread_count);
+    if (streaming || !strcmp(output_filename, "-stdout")) {
+        processor->SetStreamingOutput(true);
+    }
     ProgressListener listener;
     if (fragments_info) {
         bool check = CheckWarning(*fragments_info, key_map, method);
@@ -0,0 +1,124 @@
+/*****************************************************************
+|
+|    AP4 - MP4 Fast Start
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "MP4 Fast Start - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2016 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr, 
+        BANNER 
+        "\n\n"
+        "usage: mp4faststart [options] <input> <output>\n"
+        "Moves the moov atom before the media data, for progressive download.\n"
+        "Options:\n"
+        "  --verbose\n"
+        );
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc == 1) PrintUsageAndExit();
+
+    // parse options
+    const char* input_filename  = NULL;
+    const char* output_filename = NULL;
+    bool        verbose         = false;
+    AP4_Result  result;
+
+    // parse the command line arguments
+    char* arg;
+    while ((arg = *++argv)) {
+        if (!AP4_CompareStrings(arg, "--verbose")) {
+            verbose = true;
+        } else if (input_filename == NULL) {
+            input_filename = arg;
+        } else if (output_filename == NULL) {
+            output_filename = arg;
+        } else {
+            fprintf(stderr, "ERROR: unexpected argument (%s)\n", arg);
+            return 1;
+        }
+    }
+    if (input_filename == NULL || output_filename == NULL) {
+        PrintUsageAndExit();
+    }
+
+    // create the input stream
+    AP4_ByteStream* input = NULL;
+    result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file (%s)\n", input_filename);
+        return 1;
+    }
+
+    // create the output stream
+    AP4_ByteStream* output = NULL;
+    result = AP4_FileByteStream::Create(output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open output file (%s)\n", output_filename);
+        input->Release();
+        return 1;
+    }
+
+    // relocate the moov atom
+    bool moved = false;
+    result = AP4_FastStart::Write(*input, *output, &moved);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: failed to process the file (%d)\n", result);
+    } else if (verbose) {
+        printf(moved ? "moov atom moved before mdat\n" : "moov atom already before mdat, file copied\n");
+    }
+
+    // cleanup
+    input->Release();
+    output->Release();
+
+    return AP4_FAILED(result)?1:0;
+}
@@ -932,36 +932,205 @@ ShowSample_Text(AP4_Track&      track,
     }
 }
 
+/*----------------------------------------------------------------------
+|   FragmentTrackStats
++---------------------------------------------------------------------*/
+struct FragmentTrackStats {
+    FragmentTrackStats() : track_id(0), total_size(0), total_duration(0) {}
+    AP4_UI32 track_id;
+    AP4_UI64 total_size;
+    AP4_UI64 total_duration;
+};
+
+/*----------------------------------------------------------------------
+|   FragmentStats
++---------------------------------------------------------------------*/
+struct FragmentStats {
+    FragmentStats() : scanned(false) {}
+    bool                          scanned;
+    AP4_Array<FragmentTrackStats> tracks;
+};
+
+/*----------------------------------------------------------------------
+|   FindTrex
++---------------------------------------------------------------------*/
+static AP4_TrexAtom*
+FindTrex(AP4_Movie& movie, AP4_UI32 track_id)
+{
+    AP4_MoovAtom* moov = movie.GetMoovAtom();
+    if (moov == NULL) return NULL;
+    AP4_ContainerAtom* mvex = AP4_DYNAMIC_CAST(AP4_ContainerAtom, moov->GetChild(AP4_ATOM_TYPE_MVEX));
+    if (mvex == NULL) return NULL;
+    for (AP4_List<AP4_Atom>::Item* item = mvex->GetChildren().FirstItem();
+                                   item;
+                                   item = item->GetNext()) {
+        AP4_TrexAtom* trex = AP4_DYNAMIC_CAST(AP4_TrexAtom, item->GetData());
+        if (trex && trex->GetTrackId() == track_id) return trex;
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------
+|   AccumulateTraf
++---------------------------------------------------------------------*/
+static void
+AccumulateTraf(AP4_Movie& movie, AP4_ContainerAtom* traf, FragmentStats& fragment_stats)
+{
+    AP4_TfhdAtom* tfhd = AP4_DYNAMIC_CAST(AP4_TfhdAtom, traf->GetChild(AP4_ATOM_TYPE_TFHD));
+    if (tfhd == NULL) return;
+    AP4_UI32 track_id = tfhd->GetTrackId();
+    if (movie.GetTrack(track_id) == NULL) return;
+
+    // find or create the stats entry for this track
+    FragmentTrackStats* stats = NULL;
+    for (unsigned int i=0; i<fragment_stats.tracks.ItemCount(); i++) {
+        if (fragment_stats.tracks[i].track_id == track_id) {
+            stats = &fragment_stats.tracks[i];
+            break;
+        }
+    }
+    if (stats == NULL) {
+        FragmentTrackStats new_stats;
+        new_stats.track_id = track_id;
+        fragment_stats.tracks.Append(new_stats);
+        stats = &fragment_stats.tracks[fragment_stats.tracks.ItemCount()-1];
+    }
+    
+    // defaults, with the same precedence as AP4_FragmentSampleTable
+    AP4_TrexAtom* trex = FindTrex(movie, track_id);
+    AP4_UI32 default_sample_size = 0;
+    if (tfhd->GetFlags() & AP4_TFHD_FLAG_DEFAULT_SAMPLE_SIZE_PRESENT) {
+        default_sample_size = tfhd->GetDefaultSampleSize();
+    } else if (trex) {
+        default_sample_size = trex->GetDefaultSampleSize();
+    }
+    AP4_UI32 default_sample_duration = 0;
+    if (tfhd->GetFlags() & AP4_TFHD_FLAG_DEFAULT_SAMPLE_DURATION_PRESENT) {
+        default_sample_duration = tfhd->GetDefaultSampleDuration();
+    } else if (trex) {
+        default_sample_duration = trex->GetDefaultSampleDuration();
+    }
+    
+    for (AP4_List<AP4_Atom>::Item* item = traf->GetChildren().FirstItem();
+                                   item;
+                                   item = item->GetNext()) {
+        if (item->GetData()->GetType() != AP4_ATOM_TYPE_TRUN) continue;
+        AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, item->GetData());
+        if (trun == NULL) continue;
+        const AP4_Array<AP4_TrunAtom::Entry>& entries = trun->GetEntries();
+        AP4_UI32 trun_flags = trun->GetFlags();
+        if (trun_flags & AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT) {
+            for (unsigned int i=0; i<entries.ItemCount(); i++) {
+                stats->total_size += entries[i].sample_size;
+            }
+        } else {
+            stats->total_size += (AP4_UI64)default_sample_size*entries.ItemCount();
+        }
+        if (trun_flags & AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT) {
+            for (unsigned int i=0; i<entries.ItemCount(); i++) {
+                stats->total_duration += entries[i].sample_duration;
+            }
+        } else {
+            stats->total_duration += (AP4_UI64)default_sample_duration*entries.ItemCount();
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   ScanFragments
+|
+|   Walk the top-level atoms once, parsing only the moof atoms and
+|   seeking over everything else, so that the sizes and durations of
+|   all the tracks are obtained without reading any media data.
+|   The samples in the moov come first, as with AP4_LinearReader.
++---------------------------------------------------------------------*/
+static void
+ScanFragments(AP4_Movie& movie, AP4_ByteStream& stream, FragmentStats& fragment_stats)
+{
+    fragment_stats.scanned = true;
+    
+    // start with the samples of the 'stbl' of each track
+    for (AP4_List<AP4_Track>::Item* track_item = movie.GetTracks().FirstItem();
+                                    track_item;
+                                    track_item = track_item->GetNext()) {
+        AP4_Track*         track = track_item->GetData();
+        FragmentTrackStats stats;
+        stats.track_id = track->GetId();
+        AP4_Sample sample;
+        for (unsigned int i=0; i<track->GetSampleCount(); i++) {
+            if (AP4_SUCCEEDED(track->GetSample(i, sample))) {
+                stats.total_size     += sample.GetSize();
+                stats.total_duration += sample.GetDuration();
+            }
+        }
+        fragment_stats.tracks.Append(stats);
+    }
+    
+    AP4_UI64 position;
+    stream.Tell(position);
+    AP4_LargeSize stream_size = 0;
+    stream.GetSize(stream_size);
+    
+    AP4_Position offset = 0;
+    while (AP4_SUCCEEDED(stream.Seek(offset))) {
+        AP4_UI32 size_32 = 0;
+        AP4_UI32 type    = 0;
+        if (AP4_FAILED(stream.ReadUI32(size_32))) break;
+        if (AP4_FAILED(stream.ReadUI32(type)))    break;
+        AP4_UI64 size = size_32;
+        if (size_32 == 1) {
+            if (AP4_FAILED(stream.ReadUI64(size))) break;
+        } else if (size_32 == 0) {
+            if (stream_size <= offset) break;
+            size = stream_size-offset;
+        }
+        if (size < 8) break;
+        
+        if (type == AP4_ATOM_TYPE_MOOF) {
+            AP4_Atom* atom = NULL;
+            stream.Seek(offset);
+            if (AP4_SUCCEEDED(AP4_DefaultAtomFactory::Instance.CreateAtomFromStream(stream, atom))) {
+                AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+                if (moof) {
+                    for (AP4_List<AP4_Atom>::Item* item = moof->GetChildren().FirstItem();
+                                                   item;
+                                                   item = item->GetNext()) {
+                        if (item->GetData()->GetType() != AP4_ATOM_TYPE_TRAF) continue;
+                        AP4_ContainerAtom* traf = AP4_DYNAMIC_CAST(AP4_ContainerAtom, item->GetData());
+                        if (traf) AccumulateTraf(movie, traf, fragment_stats);
+                    }
+                }
+            }
+            delete atom;
+        }
+        offset += size;
+    }
+    
+    stream.Seek(position);
+}
+
 /*----------------------------------------------------------------------
 |   ComputeBitrate
 +---------------------------------------------------------------------*/
 static double
-ComputeBitrate(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream)
+ComputeBitrate(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, FragmentStats& fragment_stats)
 {
     double   bitrate = 0.0;
     AP4_UI64 total_size = 0;
     AP4_UI64 total_duration = 0;
     
-    AP4_UI64 position;
-    stream.Tell(position);
-    stream.Seek(0);
-    AP4_LinearReader reader(movie, &stream);
-    reader.EnableTrack(track.GetId());
-    
-    AP4_Sample sample;
     if (movie.HasFragments()) {
-        AP4_DataBuffer sample_data;
-        for(unsigned int i=0; ; i++) {
-            AP4_UI32 track_id = 0;
-            AP4_Result result = reader.ReadNextSample(sample, sample_data, track_id);
-            if (AP4_SUCCEEDED(result)) {
-                total_size += sample.GetSize();
-                total_duration += sample.GetDuration();
-            } else {
+        // all the tracks are accounted for in a single pass over the moof atoms
+        if (!fragment_stats.scanned) ScanFragments(movie, stream, fragment_stats);
+        for (unsigned int i=0; i<fragment_stats.tracks.ItemCount(); i++) {
+            if (fragment_stats.tracks[i].track_id == track.GetId()) {
+                total_size     = fragment_stats.tracks[i].total_size;
+                total_duration = fragment_stats.tracks[i].total_duration;
                 break;
             }
         }
     } else {
+        AP4_Sample sample;
         for (unsigned int i=0; i<track.GetSampleCount(); i++) {
             if (AP4_SUCCEEDED(track.GetSample(i, sample))) {
                 total_size += sample.GetSize();
@@ -982,7 +1151,7 @@ ComputeBitrate(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream)
 |   ShowTrackInfo_Text
 +---------------------------------------------------------------------*/
 static void
-ShowTrackInfo_Text(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, bool show_samples, bool show_sample_data, bool verbose, bool fast)
+ShowTrackInfo_Text(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, FragmentStats& fragment_stats, bool show_samples, bool show_sample_data, bool verbose, bool fast)
 {
     printf("  flags:        %d", track.GetFlags());
     if (track.GetFlags() & AP4_TRACK_FLAG_ENABLED) {
@@ -1022,7 +1191,7 @@ ShowTrackInfo_Text(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, b
     printf("    duration:     %lld (media timescale units)\n", track.GetMediaDuration());
     printf("    duration:     %d (ms)\n", (AP4_UI32)AP4_ConvertTime(track.GetMediaDuration(), track.GetMediaTimeScale(), 1000));
     if (!fast) {
-    printf("    bitrate (computed): %.3f Kbps\n", (float)ComputeBitrate(movie, track, stream)/1000.0);
+    printf("    bitrate (computed): %.3f Kbps\n", (float)ComputeBitrate(movie, track, stream, fragment_stats)/1000.0);
     }
     if (track.GetWidth()  || track.GetHeight()) {
         printf("  display width:  %f\n", (float)track.GetWidth()/65536.0);
@@ -1064,7 +1233,7 @@ ShowTrackInfo_Text(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, b
 |   ShowTrackInfo_Json
 +---------------------------------------------------------------------*/
 static void
-ShowTrackInfo_Json(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, bool /*show_samples*/, bool /*show_sample_data*/, bool verbose, bool fast)
+ShowTrackInfo_Json(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, FragmentStats& fragment_stats, bool /*show_samples*/, bool /*show_sample_data*/, bool verbose, bool fast)
 {
     printf("{\n");
     printf("  \"flags\":%d,\n", track.GetFlags());
@@ -1111,7 +1280,7 @@ ShowTrackInfo_Json(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, b
     printf("    \"duration_ms\":%d", (AP4_UI32)AP4_ConvertTime(track.GetMediaDuration(), track.GetMediaTimeScale(), 1000));
     if (!fast) {
         printf(",\n");
-    printf("    \"bitrate\":%.3f\n", (float)ComputeBitrate(movie, track, stream)/1000.0);
+    printf("    \"bitrate\":%.3f\n", (float)ComputeBitrate(movie, track, stream, fragment_stats)/1000.0);
     } else {
         printf("\n");
     }
@@ -1147,15 +1316,15 @@ ShowTrackInfo_Json(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, b
 |   ShowTrackInfo
 +---------------------------------------------------------------------*/
 static void
-ShowTrackInfo(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, bool show_samples, bool show_sample_data, bool verbose, bool fast)
+ShowTrackInfo(AP4_Movie& movie, AP4_Track& track, AP4_ByteStream& stream, FragmentStats& fragment_stats, bool show_samples, bool show_sample_data, bool verbose, bool fast)
 {
     switch (Options.format) {
         case TEXT_FORMAT: 
-            ShowTrackInfo_Text(movie, track, stream, show_samples, show_sample_data, verbose, fast);
+            ShowTrackInfo_Text(movie, track, stream, fragment_stats, show_samples, show_sample_data, verbose, fast);
             break;
 
         case JSON_FORMAT: 
-            ShowTrackInfo_Json(movie, track, stream, show_samples, show_sample_data, verbose, fast);
+            ShowTrackInfo_Json(movie, track, stream, fragment_stats, show_samples, show_sample_data, verbose, fast);
             break;
     }
 }
@@ -1246,6 +1415,7 @@ ShowFileInfo(AP4_File& file)
 static void
 ShowTracks(AP4_Movie& movie, AP4_List<AP4_Track>& tracks, AP4_ByteStream& stream, bool show_samples, bool show_sample_data, bool verbose, bool fast)
 {
+    FragmentStats fragment_stats;
     if (Options.format == JSON_FORMAT) printf("\"tracks\":[\n");
     int index=1;
     for (AP4_List<AP4_Track>::Item* track_item = tracks.FirstItem();
@@ -1255,7 +1425,7 @@ ShowTracks(AP4_Movie& movie, AP4_List<AP4_Track>& tracks, AP4_ByteStream& stream
             printf("Track %d:\n", index); 
         }
         if (Options.format == JSON_FORMAT && index > 1) printf(",\n"); 
-        ShowTrackInfo(movie, *track_item->GetData(), stream, show_samples, show_sample_data, verbose, fast);
+        ShowTrackInfo(movie, *track_item->GetData(), stream, fragment_stats, show_samples, show_sample_data, verbose, fast);
     }
     if (Options.format == JSON_FORMAT) printf("]\n");
 }
@@ -1275,13 +1445,14 @@ ShowMarlinTracks(AP4_File& file, AP4_ByteStream& stream, AP4_List<AP4_Track>& tr
         ShowTracks(*file.GetMovie(), tracks, stream, show_samples, show_sample_data, verbose, fast);
         return;
     }
+    FragmentStats fragment_stats;
     int index=1;
     for (AP4_List<AP4_Track>::Item* track_item = tracks.FirstItem();
          track_item;
          track_item = track_item->GetNext(), ++index) {
         printf("Track %d:\n", index); 
         AP4_Track* track = track_item->GetData();
-        ShowTrackInfo(*file.GetMovie(), *track, stream, show_samples, show_sample_data, verbose, fast);
+        ShowTrackInfo(*file.GetMovie(), *track, stream, fragment_stats, show_samples, show_sample_data, verbose, fast);
         
         for (AP4_List<AP4_MarlinIpmpParser::SinfEntry>::Item* sinf_entry_item = sinf_entries.FirstItem();
              sinf_entry_item;
@@ -1503,7 +1674,14 @@ main(int argc, char** argv)
 
     if (Options.format == JSON_FORMAT) printf("{\n");
     
-    AP4_File* file = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    // the sample tables are only parsed if they are needed, and the
+    // whole atom tree is released at once
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_Arena* arena = new AP4_Arena();
+    atom_factory.SetLazyParsing(true);
+    atom_factory.SetArena(arena);
+    arena->Release();
+    AP4_File* file = new AP4_File(*input, atom_factory, true);
     input->Release();
     ShowFileInfo(*file);
 
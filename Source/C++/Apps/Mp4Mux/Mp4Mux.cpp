@@ -49,7 +49,8 @@ const unsigned int AP4_MUX_DEFAULT_VIDEO_FRAME_RATE = 24;
 |   globals
 +---------------------------------------------------------------------*/
 static struct {
-    bool verbose;
+    bool     verbose;
+    AP4_UI32 interleave;
 } Options;
 
 /*----------------------------------------------------------------------
@@ -96,7 +97,9 @@ PrintUsageAndExit()
             "If no type is specified for an input, the type will be inferred from the file extension\n"
             "\n"
             "Options:\n"
-            "  --verbose: show more details\n");
+            "  --verbose: show more details\n"
+            "  --interleave <ms>: interleave the tracks in chunks of <ms> milliseconds\n"
+            "                     (default: tracks are written one after the other)\n");
     exit(1);
 }
 
@@ -655,7 +658,8 @@ main(int argc, char** argv)
     if (argc < 2) {
         PrintUsageAndExit();
     }
-    Options.verbose = false;
+    Options.verbose    = false;
+    Options.interleave = 0;
     
     const char* output_filename = NULL;
     AP4_Array<char*> input_names;
@@ -663,6 +667,17 @@ main(int argc, char** argv)
     while (char* arg = *++argv) {
         if (!strcmp(arg, "--verbose")) {
             Options.verbose = true;
+        } else if (!strcmp(arg, "--interleave")) {
+            arg = *++argv;
+            if (arg == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --interleave option\n");
+                return 1;
+            }
+            Options.interleave = (AP4_UI32)strtoul(arg, NULL, 10);
+            if (Options.interleave == 0) {
+                fprintf(stderr, "ERROR: invalid --interleave value\n");
+                return 1;
+            }
         } else if (!strcmp(arg, "--track")) {
             input_names.Append(*++argv);
         } else if (output_filename == NULL) {
@@ -775,7 +790,11 @@ main(int argc, char** argv)
     file.SetFileType(AP4_FILE_BRAND_MP42, 1, &brands[0], brands.ItemCount());
 
     // write the file to the output
-    AP4_FileWriter::Write(file, *output);
+    if (Options.interleave) {
+        AP4_FileWriter::Write(file, *output, AP4_FileWriter::INTERLEAVING_TIME, Options.interleave);
+    } else {
+        AP4_FileWriter::Write(file, *output);
+    }
     
     // cleanup
     delete sample_storage;
@@ -0,0 +1,899 @@
+/*****************************************************************
+|
+|    AP4 - MP4 multi-rendition packager
+|
+|    Copyright 2002-2014 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "MP4 Multi-Rendition Packager - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2014 Axiomatic Systems, LLC"
+
+#define AP4_PACKAGE_DEFAULT_OUTPUT_DIR    "output"
+#define AP4_PACKAGE_INIT_SEGMENT_NAME     "init.mp4"
+#define AP4_PACKAGE_MEDIA_SEGMENT_PATTERN "seg-%llu.m4f"
+#define AP4_PACKAGE_VIDEO_DIR             "video"
+#define AP4_PACKAGE_AUDIO_DIR             "audio"
+
+/*----------------------------------------------------------------------
+|   options
++---------------------------------------------------------------------*/
+struct Options {
+    bool          verbose;
+    const char*   output_dir;
+    AP4_Cardinal  thread_count;
+    unsigned int  fragment_duration;
+    bool          encrypt;
+    unsigned char key[16];
+    const char*   kid_hex;
+    bool          fixed_iv;
+    unsigned char iv[16];
+} Options;
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: mp4package [options] <input> [<input> ...]\n"
+            "Packages all the renditions of an ABR ladder at once. Inputs that are\n"
+            "not fragmented are fragmented first, the same way mp4fragment does;\n"
+            "fragmented inputs are used as they are. Every audio and video track\n"
+            "is written to its own directory, with an init segment (init.mp4) and\n"
+            "one media segment per fragment (seg-<n>.m4f), the same layout as the\n"
+            "one produced by mp4-dash.py:\n"
+            "  <output-dir>/video/<n>      : video tracks, numbered from 1\n"
+            "  <output-dir>/audio/<lang>   : audio tracks, one per language\n"
+            "Options:\n"
+            "  --verbose : print verbose information when running\n"
+            "  --output-dir <dir> : output directory (default: output)\n"
+            "  --threads <n>\n"
+            "      Package up to <n> inputs at the same time (0 means one thread per\n"
+            "      CPU). The default is one thread per CPU.\n"
+            "  --fragment-duration <milliseconds>\n"
+            "      Fragment duration for inputs that are not fragmented (default:\n"
+            "      automatic, as with mp4fragment).\n"
+            "  --key <kid>:<key>[:<iv>]\n"
+            "      Encrypt all the tracks with MPEG-CENC, using the 128-bit key <key>\n"
+            "      identified by <kid> (both hex-encoded). A random IV is chosen for\n"
+            "      each track, unless the 64-bit <iv> is given: it is then used for\n"
+            "      all the tracks, which is only meant for reproducible output, such\n"
+            "      as tests, since tracks that share a key and an IV are not secure.\n"
+            "      Inputs that are not fragmented are fragmented in memory before they\n"
+            "      are encrypted.\n");
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   MakeDirectory
++---------------------------------------------------------------------*/
+static AP4_Result
+MakeDirectory(const char* path)
+{
+#if defined(_WIN32)
+    int result = _mkdir(path);
+#else
+    int result = mkdir(path, 0755);
+#endif
+    if (result != 0 && errno != EEXIST) return AP4_ERROR_CANNOT_OPEN_FILE;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   Rendition
++---------------------------------------------------------------------*/
+struct Rendition {
+    Rendition(AP4_UI32 track_id, const char* directory) :
+        m_TrackId(track_id),
+        m_Directory(directory),
+        m_SegmentCount(0),
+        m_Output(NULL) {}
+    ~Rendition() { if (m_Output) m_Output->Release(); }
+
+    AP4_UI32        m_TrackId;
+    AP4_String      m_Directory;
+    AP4_UI64        m_SegmentCount;
+    AP4_ByteStream* m_Output;
+    unsigned char   m_Iv[16];
+};
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter
++---------------------------------------------------------------------*/
+/*
+ * Output stream that splits a fragmented MP4 stream, written strictly
+ * forward, into one init segment and one media segment per fragment for
+ * each rendition, the same way mp4split does with --track-id. The 'ftyp',
+ * 'moov' and 'moof' atoms are buffered so that they can be parsed, all
+ * other atoms are passed through to the current segment of each rendition.
+ */
+class SegmentSplitter : public AP4_ByteStream
+{
+public:
+    // constructor and destructor
+    SegmentSplitter(AP4_AtomFactory& atom_factory, AP4_Array<Rendition*>& renditions);
+
+    // methods
+    AP4_Result Finish();
+
+    // AP4_ByteStream methods
+    AP4_Result ReadPartial(void*     /* buffer        */,
+                           AP4_Size  /* bytes_to_read */,
+                           AP4_Size& bytes_read) {
+        bytes_read = 0;
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_Result WritePartial(const void* buffer,
+                            AP4_Size    bytes_to_write,
+                            AP4_Size&   bytes_written);
+    AP4_Result Seek(AP4_Position position) {
+        return position == m_Position ? AP4_SUCCESS : AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_Result Tell(AP4_Position& position) {
+        position = m_Position;
+        return AP4_SUCCESS;
+    }
+    AP4_Result GetSize(AP4_LargeSize& size) {
+        size = m_Position;
+        return AP4_SUCCESS;
+    }
+
+    // AP4_Referenceable methods
+    void AddReference() { ++m_ReferenceCount; }
+    void Release()      { if (--m_ReferenceCount == 0) delete this; }
+
+private:
+    // methods
+    AP4_Result StartAtom();
+    AP4_Result EndAtom();
+    AP4_Result WriteInitSegments();
+    AP4_Result StartMediaSegments();
+    AP4_Result PassThrough(const void* data, AP4_Size data_size);
+    AP4_Result ParseBufferedAtom(AP4_ContainerAtom*& container);
+
+    // members
+    AP4_AtomFactory&       m_AtomFactory;
+    AP4_Array<Rendition*>& m_Renditions;
+    AP4_Cardinal           m_ReferenceCount;
+    AP4_Position           m_Position;
+    AP4_UI08               m_Header[16];
+    AP4_Size               m_HeaderSize;
+    bool                   m_InAtom;
+    bool                   m_OpenEnded;
+    bool                   m_Buffered;
+    AP4_Atom::Type         m_AtomType;
+    AP4_UI64               m_AtomRemaining;
+    AP4_DataBuffer         m_Atom;
+    AP4_DataBuffer         m_Ftyp;
+};
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::SegmentSplitter
++---------------------------------------------------------------------*/
+SegmentSplitter::SegmentSplitter(AP4_AtomFactory&       atom_factory,
+                                 AP4_Array<Rendition*>& renditions) :
+    m_AtomFactory(atom_factory),
+    m_Renditions(renditions),
+    m_ReferenceCount(1),
+    m_Position(0),
+    m_HeaderSize(0),
+    m_InAtom(false),
+    m_OpenEnded(false),
+    m_Buffered(false),
+    m_AtomType(0),
+    m_AtomRemaining(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::WritePartial
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::WritePartial(const void* buffer,
+                              AP4_Size    bytes_to_write,
+                              AP4_Size&   bytes_written)
+{
+    const AP4_UI08* data = (const AP4_UI08*)buffer;
+    AP4_Size        left = bytes_to_write;
+    AP4_Result      result;
+    bytes_written = 0;
+    while (left) {
+        if (!m_InAtom) {
+            // collect the atom header (8 bytes, or 16 with a 64-bit size)
+            AP4_Size header_size = (m_HeaderSize >= 4 && AP4_BytesToUInt32BE(m_Header) == 1) ? 16 : 8;
+            AP4_Size chunk = header_size-m_HeaderSize;
+            if (chunk > left) chunk = left;
+            AP4_CopyMemory(&m_Header[m_HeaderSize], data, chunk);
+            m_HeaderSize += chunk;
+            data         += chunk;
+            left         -= chunk;
+            if (m_HeaderSize == 8 && AP4_BytesToUInt32BE(m_Header) == 1) continue;
+            if (m_HeaderSize < header_size) continue;
+            result = StartAtom();
+            if (AP4_FAILED(result)) return result;
+        } else {
+            AP4_Size chunk = left;
+            if (!m_OpenEnded && chunk > m_AtomRemaining) chunk = (AP4_Size)m_AtomRemaining;
+            if (m_Buffered) {
+                result = m_Atom.AppendData(data, chunk);
+            } else {
+                result = PassThrough(data, chunk);
+            }
+            if (AP4_FAILED(result)) return result;
+            data += chunk;
+            left -= chunk;
+            if (!m_OpenEnded) m_AtomRemaining -= chunk;
+        }
+        if (m_InAtom && !m_OpenEnded && m_AtomRemaining == 0) {
+            result = EndAtom();
+            if (AP4_FAILED(result)) return result;
+        }
+    }
+    bytes_written  = bytes_to_write;
+    m_Position    += bytes_to_write;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::StartAtom
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::StartAtom()
+{
+    AP4_UI64 atom_size = AP4_BytesToUInt32BE(m_Header);
+    if (atom_size == 1) atom_size = AP4_BytesToUInt64BE(&m_Header[8]);
+    m_AtomType  = AP4_BytesToUInt32BE(&m_Header[4]);
+    m_Buffered  = (m_AtomType == AP4_ATOM_TYPE_FTYP ||
+                   m_AtomType == AP4_ATOM_TYPE_MOOV ||
+                   m_AtomType == AP4_ATOM_TYPE_MOOF);
+    m_OpenEnded = (atom_size == 0);
+    if (m_OpenEnded) {
+        // the atom extends to the end of the stream
+        if (m_Buffered) return AP4_ERROR_INVALID_FORMAT;
+        m_AtomRemaining = 0;
+    } else {
+        if (atom_size < m_HeaderSize) return AP4_ERROR_INVALID_FORMAT;
+        m_AtomRemaining = atom_size-m_HeaderSize;
+    }
+    m_InAtom = true;
+
+    if (m_Buffered) {
+        m_Atom.SetDataSize(0);
+        return m_Atom.AppendData(m_Header, m_HeaderSize);
+    } else {
+        return PassThrough(m_Header, m_HeaderSize);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::EndAtom
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::EndAtom()
+{
+    AP4_Result result = AP4_SUCCESS;
+    if (m_AtomType == AP4_ATOM_TYPE_FTYP) {
+        m_Ftyp.SetData(m_Atom.GetData(), m_Atom.GetDataSize());
+    } else if (m_AtomType == AP4_ATOM_TYPE_MOOV) {
+        result = WriteInitSegments();
+    } else if (m_AtomType == AP4_ATOM_TYPE_MOOF) {
+        result = StartMediaSegments();
+        if (AP4_SUCCEEDED(result)) result = PassThrough(m_Atom.GetData(), m_Atom.GetDataSize());
+    }
+    m_InAtom     = false;
+    m_HeaderSize = 0;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::PassThrough
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::PassThrough(const void* data, AP4_Size data_size)
+{
+    if (m_AtomType == AP4_ATOM_TYPE_MFRA) return AP4_SUCCESS;
+    for (unsigned int i=0; i<m_Renditions.ItemCount(); i++) {
+        AP4_ByteStream* output = m_Renditions[i]->m_Output;
+        if (output) {
+            AP4_Result result = output->Write(data, data_size);
+            if (AP4_FAILED(result)) return result;
+        }
+    }
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::ParseBufferedAtom
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::ParseBufferedAtom(AP4_ContainerAtom*& container)
+{
+    container = NULL;
+    AP4_MemoryByteStream* stream = new AP4_MemoryByteStream(m_Atom.GetData(), m_Atom.GetDataSize());
+    AP4_Atom* atom = NULL;
+    AP4_Result result = m_AtomFactory.CreateAtomFromStream(*stream, atom);
+    stream->Release();
+    if (AP4_FAILED(result)) return result;
+    container = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+    if (container == NULL) {
+        delete atom;
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   DetachOtherTracks
++---------------------------------------------------------------------*/
+/*
+ * Detach the 'trak' or 'trex' children that are not for track_id, and
+ * remember where they were so that they can be put back.
+ */
+static void
+DetachOtherTracks(AP4_ContainerAtom*    parent,
+                  AP4_Atom::Type        type,
+                  AP4_UI32              track_id,
+                  AP4_Array<AP4_Atom*>& detached,
+                  AP4_Array<int>&       positions)
+{
+    if (parent == NULL) return;
+    int position = 0;
+    AP4_List<AP4_Atom>::Item* child = parent->GetChildren().FirstItem();
+    while (child) {
+        AP4_Atom* atom = child->GetData();
+        child = child->GetNext();
+        AP4_UI32 atom_track_id = track_id;
+        if (atom->GetType() == type && type == AP4_ATOM_TYPE_TRAK) {
+            AP4_TkhdAtom* tkhd = AP4_DYNAMIC_CAST(AP4_TkhdAtom, ((AP4_TrakAtom*)atom)->GetChild(AP4_ATOM_TYPE_TKHD));
+            if (tkhd) atom_track_id = tkhd->GetTrackId();
+        } else if (atom->GetType() == type && type == AP4_ATOM_TYPE_TREX) {
+            AP4_TrexAtom* trex = AP4_DYNAMIC_CAST(AP4_TrexAtom, atom);
+            if (trex) atom_track_id = trex->GetTrackId();
+        }
+        if (atom_track_id != track_id) {
+            atom->Detach();
+            detached.Append(atom);
+            positions.Append(position);
+        }
+        ++position;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   ReattachTracks
++---------------------------------------------------------------------*/
+static void
+ReattachTracks(AP4_ContainerAtom*    parent,
+               AP4_Array<AP4_Atom*>& detached,
+               AP4_Array<int>&       positions)
+{
+    for (unsigned int i=0; i<detached.ItemCount(); i++) {
+        parent->AddChild(detached[i], positions[i]);
+    }
+    detached.Clear();
+    positions.Clear();
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::WriteInitSegments
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::WriteInitSegments()
+{
+    AP4_ContainerAtom* moov = NULL;
+    AP4_Result result = ParseBufferedAtom(moov);
+    if (AP4_FAILED(result)) return result;
+    AP4_ContainerAtom* mvex = AP4_DYNAMIC_CAST(AP4_ContainerAtom, moov->GetChild(AP4_ATOM_TYPE_MVEX));
+
+    // each rendition gets the 'moov' atom with only its own 'trak' and 'trex'
+    AP4_Array<AP4_Atom*> detached_traks;
+    AP4_Array<int>       trak_positions;
+    AP4_Array<AP4_Atom*> detached_trexs;
+    AP4_Array<int>       trex_positions;
+    for (unsigned int i=0; i<m_Renditions.ItemCount() && AP4_SUCCEEDED(result); i++) {
+        Rendition* rendition = m_Renditions[i];
+        DetachOtherTracks(moov, AP4_ATOM_TYPE_TRAK, rendition->m_TrackId, detached_traks, trak_positions);
+        DetachOtherTracks(mvex, AP4_ATOM_TYPE_TREX, rendition->m_TrackId, detached_trexs, trex_positions);
+
+        // write the init segment
+        char name[4096];
+        AP4_FormatString(name, sizeof(name), "%s/" AP4_PACKAGE_INIT_SEGMENT_NAME, rendition->m_Directory.GetChars());
+        if (rendition->m_Output) rendition->m_Output->Release();
+        rendition->m_Output = NULL;
+        result = AP4_FileByteStream::Create(name, AP4_FileByteStream::STREAM_MODE_WRITE, rendition->m_Output);
+        if (AP4_SUCCEEDED(result) && m_Ftyp.GetDataSize()) {
+            result = rendition->m_Output->Write(m_Ftyp.GetData(), m_Ftyp.GetDataSize());
+        }
+        if (AP4_SUCCEEDED(result)) result = moov->Write(*rendition->m_Output);
+
+        ReattachTracks(moov, detached_traks, trak_positions);
+        if (mvex) ReattachTracks(mvex, detached_trexs, trex_positions);
+    }
+    delete moov;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::StartMediaSegments
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::StartMediaSegments()
+{
+    AP4_ContainerAtom* moof = NULL;
+    AP4_Result result = ParseBufferedAtom(moof);
+    if (AP4_FAILED(result)) return result;
+
+    // fragments with more than one 'traf' do not belong to any rendition
+    AP4_UI32     track_id  = 0;
+    AP4_Cardinal traf_count = 0;
+    for (AP4_List<AP4_Atom>::Item* child = moof->GetChildren().FirstItem(); child; child = child->GetNext()) {
+        AP4_ContainerAtom* traf = AP4_DYNAMIC_CAST(AP4_ContainerAtom, child->GetData());
+        if (traf == NULL || traf->GetType() != AP4_ATOM_TYPE_TRAF) continue;
+        AP4_TfhdAtom* tfhd = AP4_DYNAMIC_CAST(AP4_TfhdAtom, traf->GetChild(AP4_ATOM_TYPE_TFHD));
+        if (tfhd == NULL) {
+            delete moof;
+            return AP4_ERROR_INVALID_FORMAT;
+        }
+        track_id = tfhd->GetTrackId();
+        ++traf_count;
+    }
+    delete moof;
+    if (traf_count != 1) track_id = 0;
+
+    // close the current segments and open a new one for the matching rendition
+    for (unsigned int i=0; i<m_Renditions.ItemCount(); i++) {
+        Rendition* rendition = m_Renditions[i];
+        if (rendition->m_Output) {
+            rendition->m_Output->Release();
+            rendition->m_Output = NULL;
+        }
+        if (rendition->m_TrackId != track_id) continue;
+
+        char name[4096];
+        AP4_FormatString(name, sizeof(name), "%s/" AP4_PACKAGE_MEDIA_SEGMENT_PATTERN,
+                         rendition->m_Directory.GetChars(),
+                         (unsigned long long)++rendition->m_SegmentCount);
+        result = AP4_FileByteStream::Create(name, AP4_FileByteStream::STREAM_MODE_WRITE, rendition->m_Output);
+        if (AP4_FAILED(result)) return result;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   SegmentSplitter::Finish
++---------------------------------------------------------------------*/
+AP4_Result
+SegmentSplitter::Finish()
+{
+    // close the last segments
+    for (unsigned int i=0; i<m_Renditions.ItemCount(); i++) {
+        Rendition* rendition = m_Renditions[i];
+        if (rendition->m_Output) {
+            rendition->m_Output->Release();
+            rendition->m_Output = NULL;
+        }
+    }
+
+    // the stream must end on an atom boundary
+    if ((m_InAtom && !m_OpenEnded) || (!m_InAtom && m_HeaderSize)) {
+        return AP4_ERROR_EOS;
+    }
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   PackagingJob
++---------------------------------------------------------------------*/
+/*
+ * All the renditions from one input. The input's 'moov' is parsed once,
+ * when the renditions are added, and the rest of the input is read once
+ * by Run(): it is fragmented if needed, and encrypted on the fly when a
+ * key is set.
+ */
+class PackagingJob : public AP4_Runnable
+{
+public:
+    PackagingJob(const char* input) :
+        m_Input(input),
+        m_InputStream(NULL),
+        m_InputFile(NULL),
+        m_Result(AP4_SUCCESS) {}
+    ~PackagingJob() {
+        for (unsigned int i=0; i<m_Renditions.ItemCount(); i++) {
+            delete m_Renditions[i];
+        }
+        delete m_InputFile;
+        if (m_InputStream) m_InputStream->Release();
+    }
+
+    // AP4_Runnable methods
+    void Run();
+
+    // members
+    const char*           m_Input;
+    AP4_ByteStream*       m_InputStream; // positioned right after the 'moov' atom
+    AP4_File*             m_InputFile;   // top-level atoms up to the 'moov' atom
+    AP4_Array<Rendition*> m_Renditions;
+    AP4_Result            m_Result;
+
+private:
+    // methods
+    AP4_Result Fragment(AP4_ByteStream& output);
+    AP4_Result Encrypt(AP4_ByteStream& output, AP4_AtomFactory& atom_factory);
+};
+
+/*----------------------------------------------------------------------
+|   PackagingJob::Fragment
++---------------------------------------------------------------------*/
+AP4_Result
+PackagingJob::Fragment(AP4_ByteStream& output)
+{
+    // fragment all the tracks, with the same settings as mp4fragment
+    AP4_Fragmenter fragmenter(*m_InputFile, *m_InputStream);
+    unsigned int fragment_duration = Options.fragment_duration;
+    if (fragment_duration == 0) {
+        fragment_duration = fragmenter.AutoDetectFragmentDuration();
+        if (fragment_duration == 0 || fragment_duration > AP4_FRAGMENTER_MAX_AUTO_FRAGMENT_DURATION) {
+            fragment_duration = AP4_FRAGMENTER_DEFAULT_FRAGMENT_DURATION;
+        }
+    }
+    fragmenter.SetFragmentDuration(fragment_duration);
+
+    return fragmenter.Fragment(output);
+}
+
+/*----------------------------------------------------------------------
+|   PackagingJob::Encrypt
++---------------------------------------------------------------------*/
+AP4_Result
+PackagingJob::Encrypt(AP4_ByteStream& output, AP4_AtomFactory& atom_factory)
+{
+    AP4_CencEncryptingProcessor processor(AP4_CENC_VARIANT_MPEG);
+    for (unsigned int i=0; i<m_Renditions.ItemCount(); i++) {
+        AP4_UI32 track_id = m_Renditions[i]->m_TrackId;
+        processor.GetKeyMap().SetKey(track_id, Options.key, 16, m_Renditions[i]->m_Iv, 16);
+        processor.GetPropertyMap().SetProperty(track_id, "KID", Options.kid_hex);
+    }
+    processor.SetStreamingOutput(true);
+
+    // fragmented inputs are encrypted directly, continuing from the 'moov'
+    if (m_InputFile->GetMovie()->HasFragments()) {
+        return processor.Process(*m_InputFile, *m_InputStream, output, NULL, atom_factory);
+    }
+
+    // other inputs are fragmented first, in memory, because the processor
+    // needs to read the fragments back
+    AP4_MemoryByteStream* fragments = new AP4_MemoryByteStream();
+    AP4_Result result = Fragment(*fragments);
+    if (AP4_SUCCEEDED(result)) result = fragments->Seek(0);
+    if (AP4_SUCCEEDED(result)) result = processor.Process(*fragments, output, NULL, atom_factory);
+    fragments->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   PackagingJob::Run
++---------------------------------------------------------------------*/
+void
+PackagingJob::Run()
+{
+    // each job parses with its own factory, so that jobs can run in parallel
+    AP4_DefaultAtomFactory atom_factory;
+
+    SegmentSplitter* splitter = new SegmentSplitter(atom_factory, m_Renditions);
+    if (Options.encrypt) {
+        m_Result = Encrypt(*splitter, atom_factory);
+    } else if (!m_InputFile->GetMovie()->HasFragments()) {
+        m_Result = Fragment(*splitter);
+    } else {
+        // already fragmented: split the input as it is
+        AP4_LargeSize input_size = 0;
+        m_Result = m_InputStream->GetSize(input_size);
+        if (AP4_SUCCEEDED(m_Result)) m_Result = m_InputStream->Seek(0);
+        if (AP4_SUCCEEDED(m_Result)) m_Result = m_InputStream->CopyTo(*splitter, input_size);
+    }
+    AP4_Result result = splitter->Finish();
+    if (AP4_SUCCEEDED(m_Result)) m_Result = result;
+    if (AP4_FAILED(m_Result)) {
+        fprintf(stderr, "ERROR: failed to package %s (%d)\n", m_Input, m_Result);
+    }
+
+    splitter->Release();
+}
+
+/*----------------------------------------------------------------------
+|   PackagingWorker
++---------------------------------------------------------------------*/
+class PackagingWorker : public AP4_Runnable
+{
+public:
+    PackagingWorker() : m_Jobs(NULL), m_NextJob(NULL) {}
+
+    // AP4_Runnable methods
+    void Run() {
+        // atoms cloned by this worker's jobs are parsed with the worker's
+        // own factory, not with one shared by all the workers
+        AP4_CloneFactoryScope clone_scope(m_CloneFactory);
+        for (;;) {
+            AP4_Cardinal next = AP4_System_AtomicIncrement(*m_NextJob);
+            if (next > m_Jobs->ItemCount()) break;
+            (*m_Jobs)[next-1]->Run();
+        }
+    }
+
+    // members
+    AP4_Array<PackagingJob*>* m_Jobs;
+    volatile AP4_Cardinal*    m_NextJob;
+    AP4_DefaultAtomFactory    m_CloneFactory;
+};
+
+/*----------------------------------------------------------------------
+|   AddRenditions
++---------------------------------------------------------------------*/
+static AP4_Result
+AddRenditions(PackagingJob&            job,
+              AP4_Cardinal&            video_count,
+              AP4_Array<AP4_String>&   audio_languages)
+{
+    AP4_Result result = AP4_FileByteStream::Create(job.m_Input,
+                                                   AP4_FileByteStream::STREAM_MODE_READ_MAPPED,
+                                                   job.m_InputStream);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input %s (%d)\n", job.m_Input, result);
+        return result;
+    }
+
+    // only parse up to the 'moov' atom here, the job reads the rest
+    job.m_InputFile = new AP4_File(*job.m_InputStream, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Movie* movie = job.m_InputFile->GetMovie();
+    if (movie == NULL) {
+        fprintf(stderr, "ERROR: no movie found in %s\n", job.m_Input);
+        result = AP4_ERROR_INVALID_FORMAT;
+    }
+
+    for (AP4_List<AP4_Track>::Item* item = movie && AP4_SUCCEEDED(result) ? movie->GetTracks().FirstItem() : NULL;
+                                    item;
+                                    item = item->GetNext()) {
+        AP4_Track* track = item->GetData();
+        char directory[4096];
+        if (track->GetSampleCount() == 0 && !movie->HasFragments()) {
+            // the fragmenter skips tracks without samples
+            fprintf(stderr, "WARNING: track %d of %s has no samples, it will be skipped\n",
+                    track->GetId(), job.m_Input);
+            continue;
+        }
+        if (track->GetType() == AP4_Track::TYPE_VIDEO) {
+            AP4_FormatString(directory, sizeof(directory), "%s/" AP4_PACKAGE_VIDEO_DIR "/%d",
+                             Options.output_dir, ++video_count);
+        } else if (track->GetType() == AP4_Track::TYPE_AUDIO) {
+            // only accept one track for each language
+            const char* language = track->GetTrackLanguage();
+            bool        duplicate = false;
+            for (unsigned int i=0; i<audio_languages.ItemCount(); i++) {
+                if (audio_languages[i] == language) duplicate = true;
+            }
+            if (duplicate) {
+                fprintf(stderr, "WARNING: skipping audio track %d of %s (language %s already used)\n",
+                        track->GetId(), job.m_Input, language);
+                continue;
+            }
+            audio_languages.Append(AP4_String(language));
+            AP4_FormatString(directory, sizeof(directory), "%s/" AP4_PACKAGE_AUDIO_DIR "/%s",
+                             Options.output_dir, language);
+        } else {
+            continue;
+        }
+
+        result = MakeDirectory(directory);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot create directory %s\n", directory);
+            break;
+        }
+        Rendition* rendition = new Rendition(track->GetId(), directory);
+        job.m_Renditions.Append(rendition);
+        if (Options.fixed_iv) {
+            AP4_CopyMemory(rendition->m_Iv, Options.iv, 16);
+        } else if (Options.encrypt) {
+            result = AP4_System_GenerateRandomBytes(rendition->m_Iv, 16);
+            if (AP4_FAILED(result)) {
+                fprintf(stderr, "ERROR: failed to generate random IV (%d)\n", result);
+                break;
+            }
+            rendition->m_Iv[0] &= 0x7F; // always set the MSB to 0 so we don't have wraparounds
+            AP4_SetMemory(&rendition->m_Iv[8], 0, 8);
+        }
+        if (Options.verbose) {
+            printf("%s: track %d -> %s\n", job.m_Input, track->GetId(), directory);
+        }
+    }
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        PrintUsageAndExit();
+    }
+
+    // default options
+    Options.verbose      = false;
+    Options.output_dir   = AP4_PACKAGE_DEFAULT_OUTPUT_DIR;
+    Options.thread_count = AP4_System_GetProcessorCount();
+    Options.fragment_duration = 0;
+    Options.encrypt      = false;
+    Options.kid_hex      = NULL;
+    Options.fixed_iv     = false;
+
+    // parse command line
+    AP4_Array<PackagingJob*> jobs;
+    char** args = argv+1;
+    while (char* arg = *args++) {
+        if (!strcmp(arg, "--verbose")) {
+            Options.verbose = true;
+        } else if (!strcmp(arg, "--output-dir")) {
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --output-dir option\n");
+                return 1;
+            }
+            Options.output_dir = *args++;
+        } else if (!strcmp(arg, "--threads")) {
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --threads option\n");
+                return 1;
+            }
+            Options.thread_count = (AP4_Cardinal)strtoul(*args++, NULL, 10);
+            if (Options.thread_count == 0) Options.thread_count = AP4_System_GetProcessorCount();
+        } else if (!strcmp(arg, "--fragment-duration")) {
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --fragment-duration option\n");
+                return 1;
+            }
+            Options.fragment_duration = (unsigned int)strtoul(*args++, NULL, 10);
+        } else if (!strcmp(arg, "--key")) {
+            char* kid_ascii = NULL;
+            char* key_ascii = NULL;
+            char* iv_ascii  = NULL;
+            if (*args == NULL) {
+                fprintf(stderr, "ERROR: missing argument after --key option\n");
+                return 1;
+            }
+            arg = *args++;
+            if (AP4_FAILED(AP4_SplitArgs(arg, kid_ascii, key_ascii))) {
+                fprintf(stderr, "ERROR: invalid argument for --key option\n");
+                return 1;
+            }
+            AP4_SplitArgs(key_ascii, key_ascii, iv_ascii); // the iv is optional
+            unsigned char kid[16];
+            if (AP4_StringLength(kid_ascii) != 32 || AP4_FAILED(AP4_ParseHex(kid_ascii, kid, 16))) {
+                fprintf(stderr, "ERROR: invalid hex format for kid\n");
+                return 1;
+            }
+            if (AP4_StringLength(key_ascii) != 32 || AP4_FAILED(AP4_ParseHex(key_ascii, Options.key, 16))) {
+                fprintf(stderr, "ERROR: invalid hex format for key\n");
+                return 1;
+            }
+            if (iv_ascii) {
+                AP4_SetMemory(Options.iv, 0, 16);
+                if (AP4_StringLength(iv_ascii) != 16 || AP4_FAILED(AP4_ParseHex(iv_ascii, Options.iv, 8))) {
+                    fprintf(stderr, "ERROR: invalid hex format for iv\n");
+                    return 1;
+                }
+                Options.fixed_iv = true;
+            }
+            Options.kid_hex = kid_ascii;
+            Options.encrypt = true;
+        } else {
+            jobs.Append(new PackagingJob(arg));
+        }
+    }
+    if (jobs.ItemCount() == 0) {
+        fprintf(stderr, "ERROR: missing input file name\n");
+        return 1;
+    }
+
+    // create the output directories and assign the renditions, in input order
+    AP4_Result            result = MakeDirectory(Options.output_dir);
+    AP4_Cardinal          video_count = 0;
+    AP4_Array<AP4_String> audio_languages;
+    char                  media_dir[4096];
+    if (AP4_SUCCEEDED(result)) {
+        AP4_FormatString(media_dir, sizeof(media_dir), "%s/" AP4_PACKAGE_VIDEO_DIR, Options.output_dir);
+        result = MakeDirectory(media_dir);
+    }
+    if (AP4_SUCCEEDED(result)) {
+        AP4_FormatString(media_dir, sizeof(media_dir), "%s/" AP4_PACKAGE_AUDIO_DIR, Options.output_dir);
+        result = MakeDirectory(media_dir);
+    }
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot create output directory %s\n", Options.output_dir);
+        return 1;
+    }
+    for (unsigned int i=0; i<jobs.ItemCount(); i++) {
+        result = AddRenditions(*jobs[i], video_count, audio_languages);
+        if (AP4_FAILED(result)) return 1;
+    }
+
+    // the global options are created lazily, make sure it happens before
+    // the worker threads look them up
+    AP4_GlobalOptions::GetBool("mpeg-cenc.piff-compatible");
+
+    // package all the inputs on a pool of threads
+    unsigned int          worker_count = Options.thread_count;
+    volatile AP4_Cardinal next_job     = 0;
+    if (worker_count > jobs.ItemCount()) worker_count = jobs.ItemCount();
+    if (worker_count < 1) worker_count = 1;
+    PackagingWorker* workers = new PackagingWorker[worker_count];
+    AP4_Thread**     threads = new AP4_Thread*[worker_count];
+    for (unsigned int i=0; i<worker_count; i++) {
+        workers[i].m_Jobs    = &jobs;
+        workers[i].m_NextJob = &next_job;
+        threads[i] = new AP4_Thread(workers[i]);
+        if (AP4_FAILED(threads[i]->Start())) workers[i].Run();
+    }
+    for (unsigned int i=0; i<worker_count; i++) {
+        delete threads[i]; // waits for the thread
+    }
+    delete[] threads;
+    delete[] workers;
+
+    // cleanup
+    int exit_code = 0;
+    for (unsigned int i=0; i<jobs.ItemCount(); i++) {
+        if (AP4_FAILED(jobs[i]->m_Result)) exit_code = 1;
+        delete jobs[i];
+    }
+
+    return exit_code;
+}
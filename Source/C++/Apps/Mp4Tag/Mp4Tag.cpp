@@ -86,6 +86,8 @@ static struct {
     AP4_List<Command> commands;
     bool              need_input;
     bool              need_output;
+    bool              in_place;
+    int               padding;
 } Options;
 
 static const int LINE_WIDTH = 79;
@@ -122,6 +124,14 @@ PrintUsageAndExit()
             "       remove a tag\n"
             "  --extract <key>:<file>\n"
             "       extract the value of a tag and save it to a file\n"
+            "options:\n"
+            "  --in-place\n"
+            "       modify <input> instead of writing an <output> file. The moov atom is\n"
+            "       overwritten if it still fits in its current space (including adjacent\n"
+            "       'free' atoms), otherwise the file is rewritten with padding\n"
+            "  --padding <n>\n"
+            "       reserve <n> bytes of 'free' space after the moov atom when the file is\n"
+            "       rewritten (default: 0, or %d with --in-place)\n"
             "\n"
             "NOTES:\n"
             "  In all commands with a <key> argument, except for '--add', <key> can be \n"
@@ -139,7 +149,8 @@ PrintUsageAndExit()
             "  prefixed by a + character if all the bytes fall in the ASCII range,\n"
             "  or hex-encoded prefixed by a # character (ex: +hello, or #0FC4)\n"
             "  Strings with a language code are expressed as: <lang>:<string>,\n"
-            "  where <lang> is a 3 character language code (ex: eng:hello)\n");
+            "  where <lang> is a 3 character language code (ex: eng:hello)\n",
+            AP4_IN_PLACE_MOOV_WRITER_DEFAULT_PADDING);
     exit(1);
 }
 
@@ -190,6 +201,14 @@ ParseCommandLine(int argc, char** argv)
             }
             Options.commands.Add(new Command(Command::TYPE_EXTRACT, argv[++i]));
             Options.need_input  = true;
+        } else if (AP4_CompareStrings("--in-place", argv[i]) == 0) {
+            Options.in_place = true;
+        } else if (AP4_CompareStrings("--padding", argv[i]) == 0) {
+            if (i == argc-1) {
+                fprintf(stderr, "ERROR: missing argument after --padding option");
+                PrintUsageAndExit();
+            }
+            Options.padding = (int)strtoul(argv[++i], NULL, 10);
         } else {
             if (Options.input_filename == NULL) {
                 Options.input_filename = argv[i];
@@ -763,6 +782,21 @@ end:
     return result;
 }
 
+/*----------------------------------------------------------------------
+|   GetMediaDataOffset
++---------------------------------------------------------------------*/
+static AP4_LargeSize
+GetMediaDataOffset(AP4_File& file)
+{
+    AP4_LargeSize offset = 0;
+    for (AP4_List<AP4_Atom>::Item* item = file.GetTopLevelAtoms().FirstItem();
+         item && item->GetData()->GetType() != AP4_ATOM_TYPE_MDAT;
+         item = item->GetNext()) {
+        offset += item->GetData()->GetSize();
+    }
+    return offset;
+}
+
 /*----------------------------------------------------------------------
 |   main
 +---------------------------------------------------------------------*/
@@ -778,6 +812,8 @@ main(int argc, char** argv)
     Options.output_filename = NULL;
     Options.need_input      = false;
     Options.need_output     = false;
+    Options.in_place        = false;
+    Options.padding         = -1;
 
     // parse command line
     ParseCommandLine(argc-1, argv+1);
@@ -794,7 +830,7 @@ main(int argc, char** argv)
             PrintUsageAndExit();
         }
     }
-    if (Options.need_output) {
+    if (Options.need_output && !Options.in_place) {
         if (Options.output_filename == NULL) {
             fprintf(stderr, "ERROR: output file name missing\n");
             PrintUsageAndExit();
@@ -810,28 +846,32 @@ main(int argc, char** argv)
     AP4_File*       file      = NULL;
     AP4_Movie*      movie     = NULL;
     AP4_MoovAtom*   moov      = NULL;
-    AP4_LargeSize   moov_size = 0;
+    AP4_LargeSize   mdat_offset = 0;
+    AP4_String      temp_filename;
     AP4_Result      result    = AP4_SUCCESS;
+    bool            in_place  = Options.in_place && Options.need_output;
     if (Options.need_input) {
-        result =AP4_FileByteStream::Create(Options.input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+        result =AP4_FileByteStream::Create(Options.input_filename, 
+                                           in_place ? 
+                                           AP4_FileByteStream::STREAM_MODE_READ_WRITE :
+                                           AP4_FileByteStream::STREAM_MODE_READ, 
+                                           input);
         if (AP4_FAILED(result)) {
             fprintf(stderr, "ERROR: cannot open input file\n");
             return 1;
         }
         file = new AP4_File(*input);
         
-        // remember the size of the moov atom
+        // remember where the media data starts
+        mdat_offset = GetMediaDataOffset(*file);
         movie = file->GetMovie();
         if (movie) {
             moov = movie->GetMoovAtom();
-            if (moov) {
-                moov_size = moov->GetSize();
-            }
         }
     }
 
     AP4_ByteStream* output = NULL;
-    if (Options.need_output) {
+    if (Options.need_output && !in_place) {
         result = AP4_FileByteStream::Create(Options.output_filename, AP4_FileByteStream::STREAM_MODE_WRITE, output);
         if (AP4_FAILED(result)) {
             fprintf(stderr, "ERROR: cannot open output file for writing\n");
@@ -879,18 +919,41 @@ main(int argc, char** argv)
         if (AP4_FAILED(result)) goto end;
     }
 
+    if (in_place && moov) {
+        // try to overwrite the moov atom without moving the media data
+        result = AP4_InPlaceMoovWriter::Write(*moov, *input);
+        if (result != AP4_ERROR_NOT_ENOUGH_SPACE) goto end;
+        
+        // it doesn't fit: rewrite the file next to the original, with padding
+        if (Options.padding < 0) Options.padding = AP4_IN_PLACE_MOOV_WRITER_DEFAULT_PADDING;
+        AP4_Size name_length = (AP4_Size)AP4_StringLength(Options.input_filename);
+        temp_filename = AP4_String(name_length+4);
+        AP4_CopyMemory(temp_filename.UseChars(), Options.input_filename, name_length);
+        AP4_CopyMemory(temp_filename.UseChars()+name_length, ".tmp", 4);
+        result = AP4_FileByteStream::Create(temp_filename.GetChars(), AP4_FileByteStream::STREAM_MODE_WRITE, output);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "ERROR: cannot open temporary file for writing\n");
+            temp_filename = "";
+            goto end;
+        }
+    }
+    
     if (output) {
-        // adjust the chunk offsets if the moov is before the mdat
+        // reserve space for future in-place updates
+        if (moov && Options.padding > 0) {
+            AP4_InPlaceMoovWriter::AddPadding(*file, Options.padding);
+        }
+        
+        // adjust the chunk offsets if the media data has moved
         if (moov && file->IsMoovBeforeMdat()) {
-            AP4_LargeSize new_moov_size = moov->GetSize();
-            AP4_SI64 size_diff = new_moov_size-moov_size;
+            AP4_SI64 size_diff = GetMediaDataOffset(*file)-mdat_offset;
             if (size_diff) {
                 moov->AdjustChunkOffsets(size_diff);
             }
         }
         
         // write the modified file
-        AP4_FileCopier::Write(*file, *output);
+        result = AP4_FileCopier::Write(*file, *output);
     }
     
 end:
@@ -898,6 +961,22 @@ end:
     delete input;
     delete output;
     Options.commands.DeleteReferences();
+    
+    // replace the original file with the rewritten one
+    if (temp_filename.GetLength()) {
+        if (AP4_SUCCEEDED(result)) {
+            if (rename(temp_filename.GetChars(), Options.input_filename) != 0) {
+                // some platforms can't rename over an existing file
+                remove(Options.input_filename);
+                if (rename(temp_filename.GetChars(), Options.input_filename) != 0) {
+                    fprintf(stderr, "ERROR: cannot replace the input file\n");
+                    result = AP4_FAILURE;
+                }
+            }
+        } else {
+            remove(temp_filename.GetChars());
+        }
+    }
 
     return result;
 }
@@ -0,0 +1,186 @@
+/*****************************************************************
+|
+|    AP4 - Annex-B Writer
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4AnnexBWriter.h"
+#include "Ap4NalParser.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::ReadNalu
++---------------------------------------------------------------------*/
+bool
+AP4_AnnexBWriter::ReadNalu(const AP4_UI08*& data,
+                           AP4_Size&        data_size,
+                           unsigned int     nalu_length_size,
+                           const AP4_UI08*& nalu,
+                           AP4_Size&        nalu_size)
+{
+    if (data_size < nalu_length_size) return false;
+    switch (nalu_length_size) {
+        case 1: nalu_size = data[0];                   break;
+        case 2: nalu_size = AP4_BytesToUInt16BE(data); break;
+        case 4: nalu_size = AP4_BytesToUInt32BE(data); break;
+        default: return false;
+    }
+    if (nalu_size > data_size-nalu_length_size) return false;
+    nalu       = data+nalu_length_size;
+    data      += nalu_length_size+nalu_size;
+    data_size -= nalu_length_size+nalu_size;
+    
+    return true;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::Escape
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_AnnexBWriter::Escape(const AP4_UI08* payload,
+                         AP4_Size        payload_size,
+                         AP4_UI08*       escaped)
+{
+    AP4_Size     in  = 0;
+    AP4_Size     out = 0;
+    unsigned int zero_count = 0;
+    while (in < payload_size) {
+        AP4_UI08 byte = payload[in];
+        if (zero_count == 2 && byte <= 3) {
+            escaped[out++] = 3;
+            zero_count = 0;
+        }
+        if (byte == 0) {
+            escaped[out++] = 0;
+            ++zero_count;
+            ++in;
+            continue;
+        }
+        zero_count = 0;
+        
+        // copy this byte and all the non-zero bytes that follow it
+        AP4_Size run = 1+AP4_NalParser::FindZeroByte(payload+in+1, payload_size-in-1);
+        AP4_CopyMemory(escaped+out, payload+in, run);
+        in  += run;
+        out += run;
+    }
+    
+    return out;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::Reserve
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AnnexBWriter::Reserve(AP4_Size size)
+{
+    return m_Output.Reserve(m_Output.GetDataSize()+size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AnnexBWriter::Write(const void* data, AP4_Size data_size)
+{
+    if (data_size == 0) return AP4_SUCCESS;
+    AP4_Size   offset = m_Output.GetDataSize();
+    AP4_Result result = Reserve(data_size);
+    if (AP4_FAILED(result)) return result;
+    m_Output.SetDataSize(offset+data_size);
+    AP4_CopyMemory(m_Output.UseData()+offset, data, data_size);
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::WriteStartCode
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AnnexBWriter::WriteStartCode(unsigned int start_code_size)
+{
+    static const AP4_UI08 start_code[4] = {0, 0, 0, 1};
+    if (start_code_size != 3 && start_code_size != 4) {
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
+    return Write(start_code+4-start_code_size, start_code_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::WriteNalu
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AnnexBWriter::WriteNalu(const AP4_UI08* nalu,
+                            AP4_Size        nalu_size,
+                            unsigned int    start_code_size,
+                            bool            prevent_emulation)
+{
+    AP4_Result result = WriteStartCode(start_code_size);
+    if (AP4_FAILED(result)) return result;
+    if (!prevent_emulation) return Write(nalu, nalu_size);
+    
+    AP4_Size offset = m_Output.GetDataSize();
+    result = Reserve(GetMaxEscapedSize(nalu_size));
+    if (AP4_FAILED(result)) return result;
+    AP4_Size escaped_size = Escape(nalu, nalu_size, m_Output.UseData()+offset);
+    
+    return m_Output.SetDataSize(offset+escaped_size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter::WriteSample
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AnnexBWriter::WriteSample(const AP4_UI08* sample,
+                              AP4_Size        sample_size,
+                              unsigned int    nalu_length_size,
+                              unsigned int    start_code_size,
+                              bool            prevent_emulation)
+{
+    // compute how much space we need, so that we only allocate once
+    const AP4_UI08* data      = sample;
+    AP4_Size        data_size = sample_size;
+    const AP4_UI08* nalu      = NULL;
+    AP4_Size        nalu_size = 0;
+    AP4_Size        needed    = 0;
+    while (ReadNalu(data, data_size, nalu_length_size, nalu, nalu_size)) {
+        needed += start_code_size+(prevent_emulation?GetMaxEscapedSize(nalu_size):nalu_size);
+    }
+    AP4_Result result = Reserve(needed);
+    if (AP4_FAILED(result)) return result;
+    
+    // write the NAL units
+    data      = sample;
+    data_size = sample_size;
+    while (ReadNalu(data, data_size, nalu_length_size, nalu, nalu_size)) {
+        result = WriteNalu(nalu, nalu_size, start_code_size, prevent_emulation);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    return AP4_SUCCESS;
+}
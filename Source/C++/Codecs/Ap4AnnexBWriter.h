@@ -0,0 +1,112 @@
+/*****************************************************************
+|
+|    AP4 - Annex-B Writer
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+#ifndef _AP4_ANNEXB_WRITER_H_
+#define _AP4_ANNEXB_WRITER_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Results.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   AP4_AnnexBWriter
++---------------------------------------------------------------------*/
+/**
+ * Converts NAL units stored with a length prefix (as in MP4 samples) to
+ * an Annex-B byte stream (start code prefixed), appending to a buffer.
+ * Space is reserved ahead of time, so a whole access unit is normally
+ * written with a single allocation.
+ */
+class AP4_AnnexBWriter {
+public:
+    // class methods
+    /**
+     * Read the next length prefixed NAL unit of a sample.
+     * When a complete NAL unit is found, nalu and nalu_size are set
+     * and data and data_size are advanced past it.
+     *
+     * @result: true if a NAL unit was read, false at the end of the
+     * data or if the length prefix is invalid.
+     */
+    static bool ReadNalu(const AP4_UI08*& data,
+                         AP4_Size&        data_size,
+                         unsigned int     nalu_length_size,
+                         const AP4_UI08*& nalu,
+                         AP4_Size&        nalu_size);
+
+    /**
+     * Maximum size of a NAL unit payload after emulation prevention.
+     */
+    static AP4_Size GetMaxEscapedSize(AP4_Size payload_size) {
+        return payload_size+payload_size/2+1;
+    }
+
+    /**
+     * Insert emulation prevention bytes (00 00 0x -> 00 00 03 0x, x <= 3)
+     * in a NAL unit payload. The escaped buffer must have room for at
+     * least GetMaxEscapedSize(payload_size) bytes.
+     *
+     * @result: the number of bytes written to the escaped buffer.
+     */
+    static AP4_Size Escape(const AP4_UI08* payload,
+                           AP4_Size        payload_size,
+                           AP4_UI08*       escaped);
+
+    // constructor
+    AP4_AnnexBWriter(AP4_DataBuffer& output) : m_Output(output) {}
+
+    // methods
+    /**
+     * Make room for at least size more bytes in the output buffer.
+     */
+    AP4_Result Reserve(AP4_Size size);
+    AP4_Result Write(const void* data, AP4_Size data_size);
+    AP4_Result WriteStartCode(unsigned int start_code_size = 3);
+    AP4_Result WriteNalu(const AP4_UI08* nalu,
+                         AP4_Size        nalu_size,
+                         unsigned int    start_code_size   = 3,
+                         bool            prevent_emulation = false);
+
+    /**
+     * Write all the NAL units of a sample, each with a start code.
+     */
+    AP4_Result WriteSample(const AP4_UI08* sample,
+                           AP4_Size        sample_size,
+                           unsigned int    nalu_length_size,
+                           unsigned int    start_code_size   = 3,
+                           bool            prevent_emulation = false);
+
+private:
+    // members
+    AP4_DataBuffer& m_Output;
+};
+
+#endif // _AP4_ANNEXB_WRITER_H_
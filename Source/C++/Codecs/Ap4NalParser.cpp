@@ -32,6 +32,52 @@
 #include "Ap4AvcParser.h"
 #include "Ap4Utils.h"
 
+#if defined(AP4_CONFIG_HAVE_SSE2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/*----------------------------------------------------------------------
+|   AP4_NalParser::FindZeroByte
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_NalParser::FindZeroByte(const AP4_UI08* data, AP4_Size data_size)
+{
+    AP4_Size offset = 0;
+#if defined(AP4_CONFIG_HAVE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; offset+16 <= data_size; offset += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data+offset));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+        if (mask) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return offset+index;
+#else
+            return offset+__builtin_ctz(mask);
+#endif
+        }
+    }
+#else
+    // test one machine word at a time (a word has a zero byte if
+    // (w - 0x01..01) & ~w & 0x80..80 is not zero)
+    for (; offset+4 <= data_size; offset += 4) {
+        AP4_UI32 word = ((AP4_UI32)data[offset]        |
+                        ((AP4_UI32)data[offset+1]<< 8) |
+                        ((AP4_UI32)data[offset+2]<<16) |
+                        ((AP4_UI32)data[offset+3]<<24));
+        if ((word-0x01010101) & ~word & 0x80808080) break;
+    }
+#endif
+    for (; offset < data_size; offset++) {
+        if (data[offset] == 0) break;
+    }
+    return offset;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_NalParser::AP4_NalParser
 +---------------------------------------------------------------------*/
@@ -47,24 +93,33 @@ AP4_NalParser::AP4_NalParser() :
 void
 AP4_NalParser::Unescape(AP4_DataBuffer &data)
 {
-    unsigned int zero_count = 0;
-    unsigned int bytes_removed = 0;
     AP4_UI08* out      = data.UseData();
     const AP4_UI08* in = data.GetData();
     AP4_Size  in_size  = data.GetDataSize();
+    AP4_Size  in_pos   = 0; // next byte to copy
+    AP4_Size  out_pos  = 0;
+    AP4_Size  scan     = 0; // next byte to look at
     
-    for (unsigned int i=0; i<in_size; i++) {
-        if (zero_count >= 2 && in[i] == 3 && i+1 < in_size && in[i+1] <= 3) {
-            ++bytes_removed;
-            zero_count = 0;
+    // look for 00 00 03 0x (x <= 3) sequences, jumping from one zero
+    // byte to the next, and move the bytes in between as whole runs
+    while (scan+3 < in_size) {
+        scan += FindZeroByte(in+scan, in_size-scan-3);
+        if (scan+3 >= in_size) break;
+        if (in[scan+1] == 0 && in[scan+2] == 3 && in[scan+3] <= 3) {
+            // keep the two zeros, drop the emulation prevention byte
+            AP4_Size run = scan+2-in_pos;
+            if (out_pos != in_pos) AP4_MoveMemory(out+out_pos, in+in_pos, run);
+            out_pos += run;
+            in_pos = scan = scan+3;
         } else {
-            out[i-bytes_removed] = in[i];
-            if (in[i] == 0) {
-                ++zero_count;
-            }
+            ++scan;
         }
     }
-    data.SetDataSize(in_size-bytes_removed);
+    if (in_pos < in_size) {
+        if (out_pos != in_pos) AP4_MoveMemory(out+out_pos, in+in_pos, in_size-in_pos);
+        out_pos += in_size-in_pos;
+    }
+    data.SetDataSize(out_pos);
 }
 
 /*----------------------------------------------------------------------
@@ -92,6 +147,10 @@ AP4_NalParser::Feed(const void*            data,
             case STATE_RESET:
                 if (byte == 0) {
                     m_State = STATE_START_CODE_1;
+                } else {
+                    // nothing can happen until the next zero byte
+                    data_offset += FindZeroByte((const AP4_UI08*)data+data_offset+1,
+                                                data_size-data_offset-1);
                 }
                 break;
                 
@@ -130,13 +189,17 @@ AP4_NalParser::Feed(const void*            data,
                         found_nalu = true;
                         m_State = STATE_START_NALU;
                         break;
-                    } else {
-                        ++payload_end;
                     }
-                } else {
-                    ++payload_end;
                 }
                 m_ZeroTrail = 0; 
+
+                // this byte and all the non-zero bytes that follow it are payload
+                {
+                    AP4_Size run = 1+FindZeroByte((const AP4_UI08*)data+data_offset+1,
+                                                  data_size-data_offset-1);
+                    payload_end += run;
+                    data_offset += run-1;
+                }
                 break;
         }
     }
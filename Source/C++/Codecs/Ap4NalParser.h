@@ -44,6 +44,14 @@ public:
     // class methods
     static void Unescape(AP4_DataBuffer& data);
     
+    /**
+     * Return the offset of the first 0x00 byte in a buffer, or data_size
+     * if there is none. Start codes and emulation prevention sequences
+     * always begin with a zero byte, so this is used to skip or copy
+     * whole runs of payload at once.
+     */
+    static AP4_Size FindZeroByte(const AP4_UI08* data, AP4_Size data_size);
+    
     AP4_NalParser();
     
     /**
@@ -230,6 +230,8 @@
 #include "Ap4Results.h"
 #include "Ap4Debug.h"
 #include "Ap4Utils.h"
+#include "Ap4Threads.h"
+#include "Ap4Arena.h"
 #include "Ap4DynamicCast.h"
 #include "Ap4FileByteStream.h"
 #include "Ap4Movie.h"
@@ -237,6 +239,9 @@
 #include "Ap4File.h"
 #include "Ap4FileWriter.h"
 #include "Ap4FileCopier.h"
+#include "Ap4FastStart.h"
+#include "Ap4Fragmenter.h"
+#include "Ap4InPlaceMoovWriter.h"
 #include "Ap4HintTrackReader.h"
 #include "Ap4Processor.h"
 #include "Ap4MetaData.h"
@@ -312,6 +317,7 @@
 #include "Ap4SidxAtom.h"
 #include "Ap4AdtsParser.h"
 #include "Ap4AvcParser.h"
+#include "Ap4AnnexBWriter.h"
 #include "Ap4SegmentBuilder.h"
 
 /*----------------------------------------------------------------------
@@ -0,0 +1,267 @@
+/*****************************************************************
+|
+|    AP4 - Arena Allocator
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <new>
+
+#include "Ap4Arena.h"
+#include "Ap4Threads.h"
+#include "Ap4Array.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+// allocations keep the alignment that the heap would have provided, and
+// the header of each block is padded to that alignment
+const AP4_Size AP4_ARENA_ALIGNMENT = 16;
+
+/*----------------------------------------------------------------------
+|   globals
++---------------------------------------------------------------------*/
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+static AP4_CONFIG_THREAD_LOCAL AP4_Arena* AP4_CurrentArena = NULL;
+#endif
+
+// all the live arena blocks, sorted by address, so that the arena of an
+// object can be found when the object is deleted
+static AP4_Mutex             AP4_ArenaBlocksLock;
+static AP4_Array<AP4_UI08*>  AP4_ArenaBlocks;
+static volatile AP4_Cardinal AP4_ArenaBlockCount = 0;
+
+/*----------------------------------------------------------------------
+|   AP4_FindArenaBlock
++---------------------------------------------------------------------*/
+// returns the index of the last block that starts at or before the 
+// address, or -1 if there is none (the caller holds the lock)
+static int
+AP4_FindArenaBlock(const AP4_UI08* address)
+{
+    int first = 0;
+    int last  = (int)AP4_ArenaBlocks.ItemCount()-1;
+    int found = -1;
+    while (first <= last) {
+        int middle = (first+last)/2;
+        if (AP4_ArenaBlocks[middle] <= address) {
+            found = middle;
+            first = middle+1;
+        } else {
+            last = middle-1;
+        }
+    }
+    
+    return found;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::GetCurrent
++---------------------------------------------------------------------*/
+AP4_Arena*
+AP4_Arena::GetCurrent()
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    return AP4_CurrentArena;
+#else
+    return NULL;
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::Allocate
++---------------------------------------------------------------------*/
+void*
+AP4_Arena::Allocate(size_t size)
+{
+    // large objects always come from the heap
+    AP4_Arena* arena = GetCurrent();
+    if (arena && size <= arena->m_BlockSize/4) {
+        void* memory = arena->AllocateFromBlocks((AP4_Size)size);
+        arena->AddReference();
+        return memory;
+    }
+    
+    return ::operator new(size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::Free
++---------------------------------------------------------------------*/
+void
+AP4_Arena::Free(void* object)
+{
+    if (object == NULL) return;
+    
+    AP4_Arena* arena = FindArena(object);
+    if (arena) {
+        arena->Release();
+    } else {
+        ::operator delete(object);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::FindArena
++---------------------------------------------------------------------*/
+AP4_Arena*
+AP4_Arena::FindArena(const void* object)
+{
+    // an object allocated from an arena keeps the arena, and so its blocks,
+    // alive, so when there are no blocks at all the object is a heap object
+    // and there is no need to take the lock
+    if (AP4_ArenaBlockCount == 0) return NULL;
+    
+    AP4_AutoLock lock(AP4_ArenaBlocksLock);
+    const AP4_UI08* address = (const AP4_UI08*)object;
+    int index = AP4_FindArenaBlock(address);
+    if (index < 0) return NULL;
+    Block* block = (Block*)AP4_ArenaBlocks[index];
+    if (address >= (AP4_UI08*)block+AP4_ARENA_ALIGNMENT+block->m_Arena->m_BlockSize) {
+        return NULL;
+    }
+    
+    return block->m_Arena;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::AP4_Arena
++---------------------------------------------------------------------*/
+AP4_Arena::AP4_Arena(AP4_Size block_size) :
+    m_ReferenceCount(1),
+    m_BlockSize(block_size),
+    m_Blocks(NULL),
+    m_Available(NULL),
+    m_AvailableSize(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::~AP4_Arena
++---------------------------------------------------------------------*/
+AP4_Arena::~AP4_Arena()
+{
+    AP4_AutoLock lock(AP4_ArenaBlocksLock);
+    while (m_Blocks) {
+        Block* next = m_Blocks->m_Next;
+        
+        // forget about the block
+        int index = AP4_FindArenaBlock((AP4_UI08*)m_Blocks);
+        if (index >= 0 && AP4_ArenaBlocks[index] == (AP4_UI08*)m_Blocks) {
+            AP4_Cardinal count = AP4_ArenaBlocks.ItemCount();
+            for (unsigned int i=index; i+1<count; i++) {
+                AP4_ArenaBlocks[i] = AP4_ArenaBlocks[i+1];
+            }
+            AP4_ArenaBlocks.RemoveLast();
+            AP4_ArenaBlockCount = AP4_ArenaBlocks.ItemCount();
+        }
+        
+        ::operator delete(m_Blocks);
+        m_Blocks = next;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::AddReference
++---------------------------------------------------------------------*/
+void
+AP4_Arena::AddReference()
+{
+    AP4_System_AtomicIncrement(m_ReferenceCount);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::Release
++---------------------------------------------------------------------*/
+void
+AP4_Arena::Release()
+{
+    // objects allocated from the arena may be deleted on other threads
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
+        delete this;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Arena::AllocateFromBlocks
++---------------------------------------------------------------------*/
+void*
+AP4_Arena::AllocateFromBlocks(AP4_Size size)
+{
+    // keep all allocations aligned
+    size = (size+AP4_ARENA_ALIGNMENT-1) & ~(AP4_ARENA_ALIGNMENT-1);
+    
+    // start a new block if needed
+    if (size > m_AvailableSize) {
+        Block* block = (Block*)::operator new(AP4_ARENA_ALIGNMENT+m_BlockSize);
+        block->m_Next   = m_Blocks;
+        block->m_Arena  = this;
+        m_Blocks        = block;
+        m_Available     = (AP4_UI08*)block+AP4_ARENA_ALIGNMENT;
+        m_AvailableSize = m_BlockSize;
+        
+        // register the block, keeping the list sorted
+        AP4_AutoLock lock(AP4_ArenaBlocksLock);
+        int index = AP4_FindArenaBlock((AP4_UI08*)block)+1;
+        AP4_ArenaBlocks.Append(NULL);
+        for (unsigned int i=AP4_ArenaBlocks.ItemCount()-1; i>(unsigned int)index; i--) {
+            AP4_ArenaBlocks[i] = AP4_ArenaBlocks[i-1];
+        }
+        AP4_ArenaBlocks[index] = (AP4_UI08*)block;
+        AP4_ArenaBlockCount = AP4_ArenaBlocks.ItemCount();
+    }
+    
+    void* memory = m_Available;
+    m_Available     += size;
+    m_AvailableSize -= size;
+    
+    return memory;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ArenaScope::AP4_ArenaScope
++---------------------------------------------------------------------*/
+AP4_ArenaScope::AP4_ArenaScope(AP4_Arena* arena)
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    m_PreviousArena  = AP4_CurrentArena;
+    AP4_CurrentArena = arena;
+#else
+    (void)arena;
+    m_PreviousArena = NULL;
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ArenaScope::~AP4_ArenaScope
++---------------------------------------------------------------------*/
+AP4_ArenaScope::~AP4_ArenaScope()
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    AP4_CurrentArena = m_PreviousArena;
+#endif
+}
@@ -0,0 +1,146 @@
+/*****************************************************************
+|
+|    AP4 - Arena Allocator
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_ARENA_H_
+#define _AP4_ARENA_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stddef.h>
+
+#include "Ap4Config.h"
+#include "Ap4Types.h"
+#include "Ap4Interfaces.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_Size AP4_ARENA_DEFAULT_BLOCK_SIZE = 64*1024;
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+/**
+ * Declares class-specific allocation functions, so that instances of the
+ * class are allocated from the current arena, if there is one.
+ */
+#define AP4_IMPLEMENT_ARENA_ALLOCATION                                          \
+    static void* operator new(size_t size)     { return AP4_Arena::Allocate(size); } \
+    static void  operator delete(void* object) { AP4_Arena::Free(object);           }
+
+/*----------------------------------------------------------------------
+|   AP4_Arena
++---------------------------------------------------------------------*/
+/**
+ * Allocator that carves small objects out of large blocks, and returns
+ * all the blocks to the heap at once.
+ * While an arena is current on a thread (see AP4_ArenaScope), the atoms, 
+ * descriptors and list items created on that thread are allocated from
+ * it. Array storage always comes from the heap. Each object allocated
+ * from an arena keeps a reference to it, so objects can still be deleted
+ * individually, in any order, and on any thread: the blocks are released
+ * when the last object and the last external reference are gone.
+ * Nothing is stored next to the objects: the arena of an object is found
+ * from its address when it is deleted, and heap objects are allocated
+ * exactly as they would be without arena support.
+ * The memory of objects deleted individually is never reused, so code that
+ * keeps creating and deleting objects while an arena is current (for
+ * example when editing a tree parsed into an arena) grows the arena until
+ * it is released.
+ * Only one thread at a time may allocate from an arena.
+ */
+class AP4_Arena : public AP4_Referenceable
+{
+public:
+    // class methods
+    static void*      Allocate(size_t size);
+    static void       Free(void* object);
+    static AP4_Arena* GetCurrent();
+
+    // constructor
+    AP4_Arena(AP4_Size block_size = AP4_ARENA_DEFAULT_BLOCK_SIZE);
+
+    // AP4_Referenceable methods
+    void AddReference();
+    void Release();
+
+private:
+    // types
+    struct Block {
+        Block*     m_Next;
+        AP4_Arena* m_Arena;
+    };
+
+    // class methods
+    static AP4_Arena* FindArena(const void* object);
+
+    // methods
+    ~AP4_Arena();
+    void* AllocateFromBlocks(AP4_Size size);
+
+    // members
+    volatile AP4_Cardinal m_ReferenceCount;
+    AP4_Size              m_BlockSize;
+    Block*                m_Blocks;
+    AP4_UI08*             m_Available;
+    AP4_Size              m_AvailableSize;
+
+    // friends
+    friend class AP4_ArenaScope;
+
+    // prevent copies
+    AP4_Arena(const AP4_Arena&);
+    AP4_Arena& operator=(const AP4_Arena&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_ArenaScope
++---------------------------------------------------------------------*/
+/**
+ * Makes an arena current on the calling thread for the lifetime of the
+ * scope object. Passing NULL makes the following allocations go to the
+ * heap. Scopes can be nested.
+ */
+class AP4_ArenaScope
+{
+public:
+    // constructor and destructor
+    AP4_ArenaScope(AP4_Arena* arena);
+    ~AP4_ArenaScope();
+
+private:
+    // members
+    AP4_Arena* m_PreviousArena;
+
+    // prevent copies
+    AP4_ArenaScope(const AP4_ArenaScope&);
+    AP4_ArenaScope& operator=(const AP4_ArenaScope&);
+};
+
+#endif // _AP4_ARENA_H_
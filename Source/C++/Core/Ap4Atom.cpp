@@ -50,6 +50,13 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_Atom)
 AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_AtomParent)
 AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_NullTerminatedStringAtom)
 
+/*----------------------------------------------------------------------
+|   globals
++---------------------------------------------------------------------*/
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+static AP4_CONFIG_THREAD_LOCAL AP4_AtomFactory* AP4_CurrentCloneFactory = NULL;
+#endif
+
 /*----------------------------------------------------------------------
 |   AP4_Atom::TypeFromString
 +---------------------------------------------------------------------*/
@@ -317,7 +324,12 @@ AP4_Atom::Clone()
     
     // create the clone for the serialized form
     mbs->Seek(0);
-    AP4_DefaultAtomFactory::Instance.CreateAtomFromStream(*mbs, clone);
+    if (AP4_AtomFactory* atom_factory = AP4_CloneFactoryScope::GetCurrent()) {
+        atom_factory->CreateAtomFromStream(*mbs, clone);
+    } else {
+        AP4_DefaultAtomFactory private_factory;
+        private_factory.CreateAtomFromStream(*mbs, clone);
+    }
     
 end:
     // release the memory stream
@@ -326,6 +338,43 @@ end:
     return clone;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CloneFactoryScope::GetCurrent
++---------------------------------------------------------------------*/
+AP4_AtomFactory*
+AP4_CloneFactoryScope::GetCurrent()
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    return AP4_CurrentCloneFactory;
+#else
+    return NULL;
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CloneFactoryScope::AP4_CloneFactoryScope
++---------------------------------------------------------------------*/
+AP4_CloneFactoryScope::AP4_CloneFactoryScope(AP4_AtomFactory& atom_factory)
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    m_PreviousFactory       = AP4_CurrentCloneFactory;
+    AP4_CurrentCloneFactory = &atom_factory;
+#else
+    (void)atom_factory;
+    m_PreviousFactory = NULL;
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CloneFactoryScope::~AP4_CloneFactoryScope
++---------------------------------------------------------------------*/
+AP4_CloneFactoryScope::~AP4_CloneFactoryScope()
+{
+#if defined(AP4_CONFIG_THREAD_LOCAL)
+    AP4_CurrentCloneFactory = m_PreviousFactory;
+#endif
+}
+
 /*----------------------------------------------------------------------
 |   AP4_UnknownAtom::AP4_UnknownAtom
 +---------------------------------------------------------------------*/
@@ -447,6 +496,85 @@ AP4_UnknownAtom::Clone()
     return new AP4_UnknownAtom(*this);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload::AP4_DeferredAtomPayload
++---------------------------------------------------------------------*/
+AP4_DeferredAtomPayload::AP4_DeferredAtomPayload() :
+    m_SourceStream(NULL),
+    m_SourcePosition(0),
+    m_Size(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload::~AP4_DeferredAtomPayload
++---------------------------------------------------------------------*/
+AP4_DeferredAtomPayload::~AP4_DeferredAtomPayload()
+{
+    Detach();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload::Attach
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DeferredAtomPayload::Attach(AP4_ByteStream& stream, AP4_Size payload_size)
+{
+    Detach();
+
+    // store source stream position
+    AP4_Result result = stream.Tell(m_SourcePosition);
+    if (AP4_FAILED(result)) return result;
+    result = stream.Seek(m_SourcePosition+payload_size);
+    if (AP4_FAILED(result)) return result;
+    
+    // keep a reference to the source stream
+    m_SourceStream = &stream;
+    m_SourceStream->AddReference();
+    m_Size = payload_size;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload::Load
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DeferredAtomPayload::Load(void* buffer)
+{
+    if (m_SourceStream == NULL) return AP4_ERROR_INVALID_STATE;
+    
+    // remember the source position
+    AP4_Position position;
+    m_SourceStream->Tell(position);
+
+    // read the payload from the stored offset
+    AP4_Result result = m_SourceStream->Seek(m_SourcePosition);
+    if (AP4_SUCCEEDED(result)) {
+        result = m_SourceStream->Read(buffer, m_Size);
+    }
+    
+    // restore the original stream position
+    m_SourceStream->Seek(position);
+    
+    // we won't need the source anymore
+    Detach();
+    
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload::Detach
++---------------------------------------------------------------------*/
+void
+AP4_DeferredAtomPayload::Detach()
+{
+    if (m_SourceStream) {
+        m_SourceStream->Release();
+        m_SourceStream = NULL;
+    }
+}
+
 /*----------------------------------------------------------------------
 |   AP4_NullTerminatedStringAtom::AP4_NullTerminatedStringAtom
 +---------------------------------------------------------------------*/
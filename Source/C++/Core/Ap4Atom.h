@@ -43,6 +43,7 @@
 #include "Ap4Debug.h"
 #include "Ap4DynamicCast.h"
 #include "Ap4Array.h"
+#include "Ap4Arena.h"
 
 /*----------------------------------------------------------------------
 |   macros
@@ -67,6 +68,7 @@ const AP4_UI32 AP4_ATOM_MAX_URI_SIZE        = 512;
 |   forward references
 +---------------------------------------------------------------------*/
 class AP4_AtomParent;
+class AP4_AtomFactory;
 
 /*----------------------------------------------------------------------
 |   AP4_AtomInspector
@@ -199,6 +201,7 @@ private:
 class AP4_Atom {
 public:
      AP4_IMPLEMENT_DYNAMIC_CAST(AP4_Atom)
+     AP4_IMPLEMENT_ARENA_ALLOCATION
 
    // types
     typedef AP4_UI32 Type;
@@ -275,6 +278,9 @@ public:
      * the atom cannot be cloned.
      * Override this if your want to make an atom cloneable in a more
      * efficient way than the default implementation.
+     * The default implementation parses the clone with the factory set
+     * for the calling thread by an AP4_CloneFactoryScope, or with a 
+     * private factory when there is none.
      */ 
     virtual AP4_Atom* Clone();
 
@@ -290,6 +296,35 @@ public:
     AP4_AtomParent* m_Parent;
 };
 
+/*----------------------------------------------------------------------
+|   AP4_CloneFactoryScope
++---------------------------------------------------------------------*/
+/**
+ * Makes an atom factory the one used by AP4_Atom::Clone() on the calling 
+ * thread for the lifetime of the scope object, so that a thread that 
+ * clones many atoms does not create a new factory for each clone.
+ * The factory must not be used by another thread while the scope exists.
+ * Scopes can be nested.
+ */
+class AP4_CloneFactoryScope
+{
+public:
+    // class methods
+    static AP4_AtomFactory* GetCurrent();
+
+    // constructor and destructor
+    AP4_CloneFactoryScope(AP4_AtomFactory& atom_factory);
+    ~AP4_CloneFactoryScope();
+
+private:
+    // members
+    AP4_AtomFactory* m_PreviousFactory;
+
+    // prevent copies
+    AP4_CloneFactoryScope(const AP4_CloneFactoryScope&);
+    AP4_CloneFactoryScope& operator=(const AP4_CloneFactoryScope&);
+};
+
 /*----------------------------------------------------------------------
 |   AP4_AtomParent
 +---------------------------------------------------------------------*/
@@ -355,6 +390,48 @@ private:
     AP4_DataBuffer  m_Payload;
 };
 
+/*----------------------------------------------------------------------
+|   AP4_DeferredAtomPayload
++---------------------------------------------------------------------*/
+/**
+ * Reference to a range of bytes in the stream from which an atom was
+ * parsed. Atoms with potentially large tables use this to postpone
+ * reading those tables until they are first needed (see
+ * AP4_AtomFactory::SetLazyParsing).
+ * A reference to the source stream is kept until the payload is loaded.
+ */
+class AP4_DeferredAtomPayload {
+public:
+    // constructor and destructor
+    AP4_DeferredAtomPayload();
+    ~AP4_DeferredAtomPayload();
+
+    // methods
+    /**
+     * Remember the current position of the stream, and skip over the
+     * payload_size bytes that would have been read.
+     */
+    AP4_Result Attach(AP4_ByteStream& stream, AP4_Size payload_size);
+    /**
+     * Read the deferred bytes into a buffer of at least GetSize() bytes,
+     * then release the source stream. The stream position is preserved.
+     */
+    AP4_Result Load(void* buffer);
+    void       Detach();
+    bool       IsPending() const { return m_SourceStream != NULL; }
+    AP4_Size   GetSize()   const { return m_Size; }
+
+private:
+    // members
+    AP4_ByteStream* m_SourceStream;
+    AP4_Position    m_SourcePosition;
+    AP4_Size        m_Size;
+
+    // not copyable
+    AP4_DeferredAtomPayload(const AP4_DeferredAtomPayload&);
+    AP4_DeferredAtomPayload& operator=(const AP4_DeferredAtomPayload&);
+};
+
 /*----------------------------------------------------------------------
 |   AP4_NullTerminatedStringAtom
 +---------------------------------------------------------------------*/
@@ -448,6 +525,7 @@ const AP4_Atom::Type AP4_ATOM_TYPE_HMHD = AP4_ATOM_TYPE('h','m','h','d');
 const AP4_Atom::Type AP4_ATOM_TYPE_FRMA = AP4_ATOM_TYPE('f','r','m','a');
 const AP4_Atom::Type AP4_ATOM_TYPE_MDAT = AP4_ATOM_TYPE('m','d','a','t');
 const AP4_Atom::Type AP4_ATOM_TYPE_FREE = AP4_ATOM_TYPE('f','r','e','e');
+const AP4_Atom::Type AP4_ATOM_TYPE_SKIP = AP4_ATOM_TYPE('s','k','i','p');
 const AP4_Atom::Type AP4_ATOM_TYPE_TIMS = AP4_ATOM_TYPE('t','i','m','s');
 const AP4_Atom::Type AP4_ATOM_TYPE_RTP_ = AP4_ATOM_TYPE('r','t','p',' ');
 const AP4_Atom::Type AP4_ATOM_TYPE_HNTI = AP4_ATOM_TYPE('h','n','t','i');
@@ -110,6 +110,18 @@
 AP4_AtomFactory::~AP4_AtomFactory()
 {
     m_TypeHandlers.DeleteReferences();
+    AP4_RELEASE(m_Arena);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AtomFactory::SetArena
++---------------------------------------------------------------------*/
+void
+AP4_AtomFactory::SetArena(AP4_Arena* arena)
+{
+    AP4_ADD_REFERENCE(arena);
+    AP4_RELEASE(m_Arena);
+    m_Arena = arena;
 }
 
 /*----------------------------------------------------------------------
@@ -157,7 +169,8 @@ AP4_AtomFactory::CreateAtomFromStream(AP4_ByteStream& stream,
                                       AP4_LargeSize&  bytes_available,
                                       AP4_Atom*&      atom)
 {
-    AP4_Result result;
+    AP4_ArenaScope arena_scope(m_Arena);
+    AP4_Result     result;
 
     // NULL by default
     atom = NULL;
@@ -345,6 +358,9 @@ AP4_AtomFactory::CreateAtomFromStream(AP4_ByteStream& stream,
           }
         }
     } else {
+        // sample tables may be parsed on demand
+        bool lazy = m_LazyParsing && size_64 > AP4_ATOM_FACTORY_LAZY_PARSING_MIN_SIZE;
+        
         // regular atom
         switch (type) {
           case AP4_ATOM_TYPE_MOOV:
@@ -424,17 +440,17 @@ AP4_AtomFactory::CreateAtomFromStream(AP4_ByteStream& stream,
 
           case AP4_ATOM_TYPE_STCO:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_StcoAtom::Create(size_32, stream);
+            atom = AP4_StcoAtom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_CO64:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_Co64Atom::Create(size_32, stream);
+            atom = AP4_Co64Atom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_STSZ:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_StszAtom::Create(size_32, stream);
+            atom = AP4_StszAtom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_STZ2:
@@ -444,17 +460,17 @@ AP4_AtomFactory::CreateAtomFromStream(AP4_ByteStream& stream,
 
           case AP4_ATOM_TYPE_STTS:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_SttsAtom::Create(size_32, stream);
+            atom = AP4_SttsAtom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_CTTS:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_CttsAtom::Create(size_32, stream);
+            atom = AP4_CttsAtom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_STSS:
             if (atom_is_large) return AP4_ERROR_INVALID_FORMAT;
-            atom = AP4_StssAtom::Create(size_32, stream);
+            atom = AP4_StssAtom::Create(size_32, stream, lazy);
             break;
 
           case AP4_ATOM_TYPE_IODS:
@@ -35,12 +35,22 @@
 #include "Ap4Types.h"
 #include "Ap4Atom.h"
 #include "Ap4Array.h"
+#include "Ap4Arena.h"
 
 /*----------------------------------------------------------------------
 |   class references
 +---------------------------------------------------------------------*/
 class AP4_ByteStream;
 
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+/**
+ * Sample table atoms smaller than this are always parsed immediately,
+ * even when lazy parsing is enabled.
+ */
+const AP4_UI32 AP4_ATOM_FACTORY_LAZY_PARSING_MIN_SIZE = 4096;
+
 /*----------------------------------------------------------------------
 |   AP4_AtomFactory
 +---------------------------------------------------------------------*/
@@ -58,7 +68,7 @@ class AP4_AtomFactory {
     };
 
     // constructor
-    AP4_AtomFactory() {}
+    AP4_AtomFactory() : m_LazyParsing(false), m_Arena(NULL) {}
 
     // destructor
     virtual ~AP4_AtomFactory();
@@ -82,6 +92,25 @@ class AP4_AtomFactory {
                                      AP4_LargeSize   bytes_available,
                                      AP4_AtomParent& atoms);
 
+    /**
+     * When lazy parsing is enabled, the large sample tables (stsz, stco,
+     * co64, stts, ctts and stss) only record where their entries are
+     * located in the source stream, and read them the first time they 
+     * are accessed. The source stream must then remain unchanged for as
+     * long as the atoms exist.
+     */
+    void SetLazyParsing(bool lazy_parsing) { m_LazyParsing = lazy_parsing; }
+    bool GetLazyParsing() const            { return m_LazyParsing;         }
+
+    /**
+     * Set an arena from which the atoms, descriptors, lists and small
+     * tables created by this factory are allocated (NULL to use the heap).
+     * The factory keeps a reference to the arena. See AP4_Arena for the
+     * threading constraints.
+     */
+    void       SetArena(AP4_Arena* arena);
+    AP4_Arena* GetArena() { return m_Arena; }
+
     // context
     void PushContext(AP4_Atom::Type context);
     void PopContext();
@@ -91,6 +120,8 @@ private:
     // members
     AP4_Array<AP4_Atom::Type> m_ContextStack;
     AP4_List<TypeHandler>     m_TypeHandlers;
+    bool                      m_LazyParsing;
+    AP4_Arena*                m_Arena;
 };
 
 /*----------------------------------------------------------------------
@@ -54,7 +54,8 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_AtomSampleTable)
 +---------------------------------------------------------------------*/
 AP4_AtomSampleTable::AP4_AtomSampleTable(AP4_ContainerAtom* stbl, 
                                          AP4_ByteStream&    sample_stream) :
-    m_SampleStream(sample_stream)
+    m_SampleStream(sample_stream),
+    m_IndexState(INDEX_STATE_NONE)
 {
     m_StscAtom = AP4_DYNAMIC_CAST(AP4_StscAtom, stbl->GetChild(AP4_ATOM_TYPE_STSC));
     m_StcoAtom = AP4_DYNAMIC_CAST(AP4_StcoAtom, stbl->GetChild(AP4_ATOM_TYPE_STCO));
@@ -78,6 +79,132 @@ AP4_AtomSampleTable::~AP4_AtomSampleTable()
     m_SampleStream.Release();
 }
 
+/*----------------------------------------------------------------------
+|   AP4_AtomSampleTable::GetSampleSize
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AtomSampleTable::GetSampleSize(AP4_Ordinal sample, AP4_Size& size)
+{
+    size = 0;
+    if (m_StszAtom) {
+        return m_StszAtom->GetSampleSize(sample, size); 
+    } else if (m_Stz2Atom) {
+        return m_Stz2Atom->GetSampleSize(sample, size); 
+    } else {
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AtomSampleTable::BuildIndex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AtomSampleTable::BuildIndex()
+{
+    AP4_Result result;
+    
+    m_SampleIndex.Clear();
+    m_ChunkIndex.Clear();
+    if (m_StscAtom == NULL || m_SttsAtom == NULL) return AP4_ERROR_INVALID_FORMAT;
+    
+    AP4_Cardinal sample_count = GetSampleCount();
+    result = m_SampleIndex.SetItemCount(sample_count+1);
+    if (AP4_FAILED(result)) return result;
+    
+    // walk the tables in sample order, which is where their lookup caches
+    // make each step constant time
+    AP4_UI64 dts      = 0;
+    AP4_UI32 duration = 0;
+    AP4_Size size     = 0;
+    for (AP4_Ordinal i=0; i<sample_count; i++) {
+        AP4_Ordinal sample = i+1; // the tables are 1-based
+        AP4_Ordinal chunk, skip, desc;
+        result = m_StscAtom->GetChunkForSample(sample, chunk, skip, desc);
+        if (AP4_FAILED(result)) return result;
+        if (chunk == 0 || skip > i) return AP4_ERROR_INVALID_FORMAT;
+        
+        SampleIndexEntry& entry = m_SampleIndex[i];
+        entry.m_Chunk = chunk;
+        if (skip == 0) {
+            // first sample in the chunk
+            entry.m_OffsetInChunk = 0;
+            if (chunk > m_ChunkIndex.ItemCount()) {
+                result = m_ChunkIndex.SetItemCount(chunk);
+                if (AP4_FAILED(result)) return result;
+            }
+            m_ChunkIndex[chunk-1].m_FirstSample            = sample;
+            m_ChunkIndex[chunk-1].m_SampleDescriptionIndex = desc;
+        } else {
+            // continues after the previous sample in the same chunk
+            if (m_SampleIndex[i-1].m_Chunk != chunk) return AP4_ERROR_INVALID_FORMAT;
+            
+            // offsets are stored on 32 bits, chunks larger than 4GB are
+            // left to the per-sample table lookups
+            AP4_UI64 offset = (AP4_UI64)m_SampleIndex[i-1].m_OffsetInChunk+size;
+            if (offset > 0xFFFFFFFF) return AP4_ERROR_OUT_OF_RANGE;
+            entry.m_OffsetInChunk = (AP4_UI32)offset;
+        }
+        
+        result = GetSampleSize(sample, size);
+        if (AP4_FAILED(result)) return result;
+        result = m_SttsAtom->GetDts(sample, dts, &duration);
+        if (AP4_FAILED(result)) return result;
+        entry.m_Dts = dts;
+        
+        // the ctts and stss lookups use caches, so resolve them here
+        entry.m_CtsOffset = 0;
+        if (m_CttsAtom) {
+            result = m_CttsAtom->GetCtsOffset(sample, entry.m_CtsOffset);
+            if (AP4_FAILED(result)) return result;
+        }
+        entry.m_IsSync = (m_StssAtom == NULL || m_StssAtom->IsSampleSync(sample));
+    }
+    
+    // the extra entry marks the end of the last sample
+    m_SampleIndex[sample_count].m_Dts           = sample_count?dts+duration:0;
+    m_SampleIndex[sample_count].m_Chunk         = 0;
+    m_SampleIndex[sample_count].m_OffsetInChunk = 0;
+    m_SampleIndex[sample_count].m_CtsOffset     = 0;
+    m_SampleIndex[sample_count].m_IsSync        = false;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AtomSampleTable::EnsureIndex
++---------------------------------------------------------------------*/
+bool
+AP4_AtomSampleTable::EnsureIndex()
+{
+    if (m_IndexState == INDEX_STATE_NONE) {
+        if (AP4_SUCCEEDED(BuildIndex())) {
+            m_IndexState = INDEX_STATE_READY;
+        } else {
+            // fall back to looking up the tables for each sample
+            m_SampleIndex.Clear();
+            m_ChunkIndex.Clear();
+            m_IndexState = INDEX_STATE_UNAVAILABLE;
+        }
+    }
+    
+    return m_IndexState == INDEX_STATE_READY;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AtomSampleTable::PrepareForConcurrentReads
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AtomSampleTable::PrepareForConcurrentReads()
+{
+    // make sure that tables parsed lazily are loaded (the index loads the
+    // other ones when it is built)
+    if (m_StcoAtom) m_StcoAtom->GetChunkOffsets();
+    if (m_Co64Atom) m_Co64Atom->GetChunkOffsets();
+    
+    // without an index, GetSample() updates the lookup caches of the tables
+    return EnsureIndex() ? AP4_SUCCESS : AP4_ERROR_NOT_SUPPORTED;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_AtomSampleTable::GetSample
 +---------------------------------------------------------------------*/
@@ -92,6 +219,28 @@ AP4_AtomSampleTable::GetSample(AP4_Ordinal index,
         return AP4_ERROR_INVALID_FORMAT;
     }
 
+    // use the index if we can
+    if (index < GetSampleCount() && EnsureIndex()) {
+        const SampleIndexEntry& entry = m_SampleIndex[index];
+        AP4_Position chunk_offset = 0;
+        result = GetChunkOffset(entry.m_Chunk-1, chunk_offset);
+        if (AP4_FAILED(result)) return result;
+        
+        sample.SetDescriptionIndex(m_ChunkIndex[entry.m_Chunk-1].m_SampleDescriptionIndex-1);
+        sample.SetDuration((AP4_UI32)(m_SampleIndex[index+1].m_Dts-entry.m_Dts));
+        sample.SetDts(entry.m_Dts);
+        sample.SetCtsDelta(entry.m_CtsOffset);
+        AP4_Size sample_size = 0;
+        result = GetSampleSize(index+1, sample_size);
+        if (AP4_FAILED(result)) return result;
+        sample.SetSize(sample_size);
+        sample.SetSync(entry.m_IsSync);
+        sample.SetOffset(chunk_offset+entry.m_OffsetInChunk);
+        sample.SetDataStream(m_SampleStream);
+        
+        return AP4_SUCCESS;
+    }
+    
     // MP4 uses 1-based indexes internally, so adjust by one
     index++;
 
@@ -245,6 +394,15 @@ AP4_AtomSampleTable::GetChunkForSample(AP4_Ordinal  sample_index,
     // check that we an stsc atom
     if (m_StscAtom == NULL) return AP4_ERROR_INVALID_STATE;
     
+    // use the index if we can
+    if (sample_index < GetSampleCount() && EnsureIndex()) {
+        AP4_UI32 chunk = m_SampleIndex[sample_index].m_Chunk;
+        chunk_index              = chunk-1;
+        position_in_chunk        = sample_index+1-m_ChunkIndex[chunk-1].m_FirstSample;
+        sample_description_index = m_ChunkIndex[chunk-1].m_SampleDescriptionIndex;
+        return AP4_SUCCESS;
+    }
+    
     // get the chunk info from the stsc atom
     AP4_Ordinal chunk = 0;
     AP4_Result result = m_StscAtom->GetChunkForSample(sample_index+1, // the atom API is 1-based 
@@ -307,6 +465,13 @@ AP4_AtomSampleTable::SetChunkOffset(AP4_Ordinal  chunk_index,
 AP4_Result 
 AP4_AtomSampleTable::SetSampleSize(AP4_Ordinal sample_index, AP4_Size size)
 {
+    // the offsets in the index depend on the sample sizes
+    if (m_IndexState == INDEX_STATE_READY) {
+        m_SampleIndex.Clear();
+        m_ChunkIndex.Clear();
+        m_IndexState = INDEX_STATE_NONE;
+    }
+    
     if (m_StszAtom) {
         return m_StszAtom->SetSampleSize(sample_index+1, size);
     } else if (m_Stz2Atom) {
@@ -33,6 +33,7 @@
 |   includes
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
+#include "Ap4Array.h"
 #include "Ap4SampleTable.h"
 
 /*----------------------------------------------------------------------
@@ -73,6 +74,7 @@ class AP4_AtomSampleTable : public AP4_SampleTable
                                                 AP4_Ordinal& position_in_chunk);
     virtual AP4_Result   GetSampleIndexForTimeStamp(AP4_UI64 ts, AP4_Ordinal& sample_index);
     virtual AP4_Ordinal  GetNearestSyncSampleIndex(AP4_Ordinal index, bool before=true);
+    virtual AP4_Result   PrepareForConcurrentReads();
 
     // local methods
     virtual AP4_Result GetChunkForSample(AP4_Ordinal   sample_index,
@@ -84,6 +86,29 @@ class AP4_AtomSampleTable : public AP4_SampleTable
     virtual AP4_Result SetSampleSize(AP4_Ordinal sample_index, AP4_Size size);
 
 private:
+    // types
+    struct SampleIndexEntry {
+        AP4_UI64 m_Dts;
+        AP4_UI32 m_Chunk;         // 1-based
+        AP4_UI32 m_OffsetInChunk; // tables with larger chunks are not indexed
+        AP4_UI32 m_CtsOffset;
+        bool     m_IsSync;
+    };
+    struct ChunkIndexEntry {
+        AP4_UI32 m_FirstSample;   // 1-based
+        AP4_UI32 m_SampleDescriptionIndex;
+    };
+    enum IndexState {
+        INDEX_STATE_NONE,
+        INDEX_STATE_READY,
+        INDEX_STATE_UNAVAILABLE
+    };
+    
+    // methods
+    bool       EnsureIndex();
+    AP4_Result BuildIndex();
+    AP4_Result GetSampleSize(AP4_Ordinal sample, AP4_Size& size); // 1-based
+
     // members
     AP4_ByteStream& m_SampleStream;
     AP4_StscAtom*   m_StscAtom;
@@ -95,6 +120,16 @@ private:
     AP4_StsdAtom*   m_StsdAtom;
     AP4_StssAtom*   m_StssAtom;
     AP4_Co64Atom*   m_Co64Atom;
+    
+    // index, built on demand, so that a sample can be located without 
+    // walking the stsc/stsz/stts tables. The offsets are kept relative 
+    // to the chunk start, so that chunk offsets may change. The sample 
+    // index has one extra entry with the end of the last sample's duration.
+    // Once built, GetSample() only reads from it and from the (loaded)
+    // size and chunk offset tables, so it may be called from any thread.
+    IndexState                  m_IndexState;
+    AP4_Array<SampleIndexEntry> m_SampleIndex;
+    AP4_Array<ChunkIndexEntry>  m_ChunkIndex;
 };
 
 #endif // _AP4_ATOM_SAMPLE_TABLE_H_
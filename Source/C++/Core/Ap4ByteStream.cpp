@@ -33,6 +33,7 @@
 #include "Ap4Utils.h"
 #include "Ap4Debug.h"
 #include "Ap4String.h"
+#include "Ap4Threads.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -63,6 +64,46 @@ AP4_ByteStream::Read(void* buffer, AP4_Size bytes_to_read)
     return AP4_SUCCESS;
 }  
 
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::ReadPartialAt(AP4_Position position,
+                              void*        buffer,
+                              AP4_Size     bytes_to_read,
+                              AP4_Size&    bytes_read)
+{
+    // default implementation: seek and read (not thread-safe)
+    bytes_read = 0;
+    AP4_Result result = Seek(position);
+    if (AP4_FAILED(result)) return result;
+    return ReadPartial(buffer, bytes_to_read, bytes_read);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::ReadAt
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::ReadAt(AP4_Position position, void* buffer, AP4_Size bytes_to_read)
+{
+    // shortcut
+    if (bytes_to_read == 0) return AP4_SUCCESS;
+    
+    // read until failure
+    AP4_Size bytes_read;
+    while (bytes_to_read) {
+        AP4_Result result = ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+        if (AP4_FAILED(result)) return result;
+        if (bytes_read == 0) return AP4_ERROR_INTERNAL;
+        AP4_ASSERT(bytes_read <= bytes_to_read);
+        bytes_to_read -= bytes_read;
+        position      += bytes_read;
+        buffer = (void*)(((AP4_Byte*)buffer)+bytes_read);
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Stream::Write
 +---------------------------------------------------------------------*/
@@ -86,6 +127,136 @@ AP4_ByteStream::Write(const void* buffer, AP4_Size bytes_to_write)
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::ReadvPartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::ReadvPartial(const AP4_IoVector* vectors,
+                             AP4_Cardinal        vector_count,
+                             AP4_Size&           bytes_read)
+{
+    // default implementation: one ReadPartial per vector, stop at the
+    // first short read
+    bytes_read = 0;
+    for (unsigned int i=0; i<vector_count; i++) {
+        if (vectors[i].m_Size == 0) continue;
+        AP4_Size chunk = 0;
+        AP4_Result result = ReadPartial(vectors[i].m_Data, vectors[i].m_Size, chunk);
+        if (AP4_FAILED(result)) {
+            // only report an error if nothing was read
+            return bytes_read ? AP4_SUCCESS : result;
+        }
+        bytes_read += chunk;
+        if (chunk != vectors[i].m_Size) break;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::Readv
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::Readv(const AP4_IoVector* vectors, AP4_Cardinal vector_count)
+{
+    for (;;) {
+        // skip empty vectors
+        while (vector_count && vectors->m_Size == 0) {
+            ++vectors;
+            --vector_count;
+        }
+        if (vector_count == 0) break;
+        
+        // read as much as possible in one call
+        AP4_Size bytes_read = 0;
+        AP4_Result result = ReadvPartial(vectors, vector_count, bytes_read);
+        if (AP4_FAILED(result)) return result;
+        if (bytes_read == 0) return AP4_ERROR_INTERNAL;
+        
+        // skip over the vectors that were completely filled
+        while (vector_count && bytes_read >= vectors->m_Size) {
+            bytes_read -= vectors->m_Size;
+            ++vectors;
+            --vector_count;
+        }
+        
+        // finish the vector that was partially filled
+        if (bytes_read) {
+            result = Read((AP4_UI08*)vectors->m_Data+bytes_read, vectors->m_Size-bytes_read);
+            if (AP4_FAILED(result)) return result;
+            ++vectors;
+            --vector_count;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::WritevPartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::WritevPartial(const AP4_IoVector* vectors,
+                              AP4_Cardinal        vector_count,
+                              AP4_Size&           bytes_written)
+{
+    // default implementation: one WritePartial per vector, stop at the
+    // first short write
+    bytes_written = 0;
+    for (unsigned int i=0; i<vector_count; i++) {
+        if (vectors[i].m_Size == 0) continue;
+        AP4_Size chunk = 0;
+        AP4_Result result = WritePartial(vectors[i].m_Data, vectors[i].m_Size, chunk);
+        if (AP4_FAILED(result)) {
+            // only report an error if nothing was written
+            return bytes_written ? AP4_SUCCESS : result;
+        }
+        bytes_written += chunk;
+        if (chunk != vectors[i].m_Size) break;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ByteStream::Writev
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ByteStream::Writev(const AP4_IoVector* vectors, AP4_Cardinal vector_count)
+{
+    for (;;) {
+        // skip empty vectors
+        while (vector_count && vectors->m_Size == 0) {
+            ++vectors;
+            --vector_count;
+        }
+        if (vector_count == 0) break;
+        
+        // write as much as possible in one call
+        AP4_Size bytes_written = 0;
+        AP4_Result result = WritevPartial(vectors, vector_count, bytes_written);
+        if (AP4_FAILED(result)) return result;
+        if (bytes_written == 0) return AP4_ERROR_INTERNAL;
+        
+        // skip over the vectors that were completely written
+        while (vector_count && bytes_written >= vectors->m_Size) {
+            bytes_written -= vectors->m_Size;
+            ++vectors;
+            --vector_count;
+        }
+        
+        // finish the vector that was partially written
+        if (bytes_written) {
+            result = Write((const AP4_UI08*)vectors->m_Data+bytes_written, vectors->m_Size-bytes_written);
+            if (AP4_FAILED(result)) return result;
+            ++vectors;
+            --vector_count;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_ByteStream::WriteString
 +---------------------------------------------------------------------*/
@@ -519,13 +690,66 @@ AP4_SubStream::Seek(AP4_Position position)
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_SubStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SubStream::ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read)
+{
+    // default values
+    bytes_read = 0;
+
+    // shortcut
+    if (bytes_to_read == 0) {
+        return AP4_SUCCESS;
+    }
+
+    // clamp to range
+    if (position >= m_Size) {
+        return AP4_ERROR_EOS;
+    }
+    if (position+bytes_to_read > m_Size) {
+        bytes_to_read = (AP4_Size)(m_Size - position);
+    }
+
+    // read from the container, without touching our position
+    return m_Container.ReadPartialAt(m_Offset+position, buffer, bytes_to_read, bytes_read);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SubStream::Prefetch
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SubStream::Prefetch(AP4_Position position, AP4_LargeSize size)
+{
+    if (position >= m_Size) return AP4_SUCCESS;
+    if (position+size > m_Size) size = m_Size-position;
+    return m_Container.Prefetch(m_Offset+position, size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SubStream::Borrow
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_SubStream::Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data)
+{
+    data = NULL;
+    if (position+size > m_Size) return AP4_ERROR_OUT_OF_RANGE;
+    return m_Container.Borrow(m_Offset+position, size, data);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_SubStream::AddReference
 +---------------------------------------------------------------------*/
 void
 AP4_SubStream::AddReference()
 {
-    m_ReferenceCount++;
+    AP4_System_AtomicIncrement(m_ReferenceCount);
 }
 
 /*----------------------------------------------------------------------
@@ -534,7 +758,7 @@ AP4_SubStream::AddReference()
 void
 AP4_SubStream::Release()
 {
-    if (--m_ReferenceCount == 0) {
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
         delete this;
     }
 }
@@ -638,7 +862,7 @@ AP4_DupStream::Seek(AP4_Position position)
 void
 AP4_DupStream::AddReference()
 {
-    m_ReferenceCount++;
+    AP4_System_AtomicIncrement(m_ReferenceCount);
 }
 
 /*----------------------------------------------------------------------
@@ -647,7 +871,7 @@ AP4_DupStream::AddReference()
 void
 AP4_DupStream::Release()
 {
-    if (--m_ReferenceCount == 0) {
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
         delete this;
     }
 }
@@ -805,13 +1029,59 @@ AP4_MemoryByteStream::Seek(AP4_Position position)
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_MemoryByteStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_MemoryByteStream::ReadPartialAt(AP4_Position position,
+                                    void*        buffer,
+                                    AP4_Size     bytes_to_read,
+                                    AP4_Size&    bytes_read)
+{
+    // default values
+    bytes_read = 0;
+
+    // shortcut
+    if (bytes_to_read == 0) {
+        return AP4_SUCCESS;
+    }
+
+    // clamp to range
+    if (position >= m_Buffer->GetDataSize()) {
+        return AP4_ERROR_EOS;
+    }
+    if (position+bytes_to_read > m_Buffer->GetDataSize()) {
+        bytes_to_read = (AP4_Size)(m_Buffer->GetDataSize() - position);
+    }
+
+    // read from the memory
+    AP4_CopyMemory(buffer, m_Buffer->GetData()+position, bytes_to_read);
+    bytes_read = bytes_to_read;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_MemoryByteStream::Borrow
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_MemoryByteStream::Borrow(AP4_Position     position,
+                             AP4_Size         size,
+                             const AP4_UI08*& data)
+{
+    data = NULL;
+    if (position+size > m_Buffer->GetDataSize()) return AP4_ERROR_OUT_OF_RANGE;
+    data = m_Buffer->GetData()+position;
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_MemoryByteStream::AddReference
 +---------------------------------------------------------------------*/
 void
 AP4_MemoryByteStream::AddReference()
 {
-    m_ReferenceCount++;
+    AP4_System_AtomicIncrement(m_ReferenceCount);
 }
 
 /*----------------------------------------------------------------------
@@ -820,7 +1090,7 @@ AP4_MemoryByteStream::AddReference()
 void
 AP4_MemoryByteStream::Release()
 {
-    if (--m_ReferenceCount == 0) {
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
         delete this;
     }
 }
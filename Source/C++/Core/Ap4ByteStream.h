@@ -42,6 +42,14 @@
 +---------------------------------------------------------------------*/
 class AP4_String;
 
+/*----------------------------------------------------------------------
+|   AP4_IoVector
++---------------------------------------------------------------------*/
+struct AP4_IoVector {
+    void*    m_Data;
+    AP4_Size m_Size;
+};
+
 /*----------------------------------------------------------------------
 |   AP4_ByteStream
 +---------------------------------------------------------------------*/
@@ -53,6 +61,10 @@ class AP4_ByteStream : public AP4_Referenceable
                                    AP4_Size  bytes_to_read, 
                                    AP4_Size& bytes_read) = 0;
     AP4_Result Read(void* buffer, AP4_Size bytes_to_read);
+    virtual AP4_Result ReadvPartial(const AP4_IoVector* vectors,
+                                    AP4_Cardinal        vector_count,
+                                    AP4_Size&           bytes_read);
+    AP4_Result Readv(const AP4_IoVector* vectors, AP4_Cardinal vector_count);
     AP4_Result ReadDouble(double& value);
     AP4_Result ReadUI64(AP4_UI64& value);
     AP4_Result ReadUI32(AP4_UI32& value);
@@ -65,6 +77,10 @@ class AP4_ByteStream : public AP4_Referenceable
                                     AP4_Size    bytes_to_write, 
                                     AP4_Size&   bytes_written) = 0;
     AP4_Result Write(const void* buffer, AP4_Size bytes_to_write);
+    virtual AP4_Result WritevPartial(const AP4_IoVector* vectors,
+                                     AP4_Cardinal        vector_count,
+                                     AP4_Size&           bytes_written);
+    AP4_Result Writev(const AP4_IoVector* vectors, AP4_Cardinal vector_count);
     AP4_Result WriteString(const char* string_buffer);
     AP4_Result WriteDouble(double value);
     AP4_Result WriteUI64(AP4_UI64 value);
@@ -77,6 +93,38 @@ class AP4_ByteStream : public AP4_Referenceable
     virtual AP4_Result GetSize(AP4_LargeSize& size) = 0;
     virtual AP4_Result CopyTo(AP4_ByteStream& stream, AP4_LargeSize size);
     virtual AP4_Result Flush() { return AP4_SUCCESS; }
+
+    // positional reads: ReadPartialAt reads from 'position' without
+    // using the current stream position. Streams that can do this without
+    // seeking (memory, memory-mapped files, files with pread()) override
+    // it so that several threads can read from the same stream at once.
+    // The default implementation seeks then reads: it moves the stream
+    // position and is not safe to call from more than one thread.
+    virtual AP4_Result ReadPartialAt(AP4_Position position,
+                                     void*        buffer,
+                                     AP4_Size     bytes_to_read,
+                                     AP4_Size&    bytes_read);
+    AP4_Result ReadAt(AP4_Position position, void* buffer, AP4_Size bytes_to_read);
+
+    // read-ahead hint: 'size' bytes starting at 'position' will be read
+    // soon, so the stream may start fetching them in the background (for
+    // example with posix_fadvise() or madvise()). This is only a hint, 
+    // and the default implementation does nothing.
+    virtual AP4_Result Prefetch(AP4_Position  /* position */, 
+                                AP4_LargeSize /* size     */) {
+        return AP4_SUCCESS;
+    }
+
+    // zero-copy access: streams backed by memory may return a pointer
+    // to 'size' bytes starting at 'position', without changing the
+    // current stream position. The pointer remains valid for as long as
+    // the stream is alive. Other streams return AP4_ERROR_NOT_SUPPORTED.
+    virtual AP4_Result Borrow(AP4_Position     /* position */,
+                              AP4_Size         /* size     */,
+                              const AP4_UI08*& data) {
+        data = NULL;
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
 };
 
 /*----------------------------------------------------------------------
@@ -105,6 +153,14 @@ class AP4_SubStream : public AP4_ByteStream
         size = m_Size;
         return AP4_SUCCESS;
     }
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read);
+    AP4_Result Prefetch(AP4_Position position, AP4_LargeSize size);
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data);
 
     // AP4_Referenceable methods
     void AddReference();
@@ -114,11 +170,11 @@ class AP4_SubStream : public AP4_ByteStream
     virtual ~AP4_SubStream();
 
  private:
-    AP4_ByteStream& m_Container;
-    AP4_Position    m_Offset;
-    AP4_LargeSize   m_Size;
-    AP4_Position    m_Position;
-    AP4_Cardinal    m_ReferenceCount;
+    AP4_ByteStream&       m_Container;
+    AP4_Position          m_Offset;
+    AP4_LargeSize         m_Size;
+    AP4_Position          m_Position;
+    volatile AP4_Cardinal m_ReferenceCount;
 };
 
 /*----------------------------------------------------------------------
@@ -144,6 +200,20 @@ class AP4_DupStream : public AP4_ByteStream
     AP4_Result GetSize(AP4_LargeSize& size) {
         return m_OriginalStream.GetSize(size);
     }
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read) {
+        return m_OriginalStream.ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+    }
+    AP4_Result Prefetch(AP4_Position position, AP4_LargeSize size) {
+        return m_OriginalStream.Prefetch(position, size);
+    }
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data) {
+        return m_OriginalStream.Borrow(position, size, data);
+    }
 
     // AP4_Referenceable methods
     void AddReference();
@@ -153,9 +223,9 @@ class AP4_DupStream : public AP4_ByteStream
     virtual ~AP4_DupStream();
 
  private:
-    AP4_ByteStream& m_OriginalStream;
-    AP4_Position    m_Position;
-    AP4_Cardinal    m_ReferenceCount;
+    AP4_ByteStream&       m_OriginalStream;
+    AP4_Position          m_Position;
+    volatile AP4_Cardinal m_ReferenceCount;
 };
 
 /*----------------------------------------------------------------------
@@ -185,6 +255,13 @@ public:
         size = m_Buffer->GetDataSize();
         return AP4_SUCCESS;
     }
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read);
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data); // valid until the next write
 
     // AP4_Referenceable methods
     void AddReference();
@@ -199,10 +276,10 @@ protected:
     virtual ~AP4_MemoryByteStream();
 
 private:
-    AP4_DataBuffer* m_Buffer;
-    bool            m_BufferIsLocal;
-    AP4_Position    m_Position;
-    AP4_Cardinal    m_ReferenceCount;
+    AP4_DataBuffer*       m_Buffer;
+    bool                  m_BufferIsLocal;
+    AP4_Position          m_Position;
+    volatile AP4_Cardinal m_ReferenceCount;
 };
 
 /*----------------------------------------------------------------------
@@ -42,13 +42,13 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_Co64Atom)
 |   AP4_Co64Atom::Create
 +---------------------------------------------------------------------*/
 AP4_Co64Atom*
-AP4_Co64Atom::Create(AP4_Size size, AP4_ByteStream& stream)
+AP4_Co64Atom::Create(AP4_Size size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version != 0) return NULL;
-    return new AP4_Co64Atom(size, version, flags, stream);
+    return new AP4_Co64Atom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
@@ -70,17 +70,28 @@ AP4_Atom(AP4_ATOM_TYPE_CO64,
 AP4_Co64Atom::AP4_Co64Atom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
-    AP4_Atom(AP4_ATOM_TYPE_CO64, size, version, flags)
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
+    AP4_Atom(AP4_ATOM_TYPE_CO64, size, version, flags),
+    m_Entries(NULL)
 {
     stream.ReadUI32(m_EntryCount);
     if (m_EntryCount > (size-AP4_FULL_ATOM_HEADER_SIZE-4)/8) {
         m_EntryCount = (size-AP4_FULL_ATOM_HEADER_SIZE-4)/8;
     }
+    if (lazy && AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, m_EntryCount*8))) {
+        // the table will be read when it is first needed
+        return;
+    }
     m_Entries = new AP4_UI64[m_EntryCount];
-    for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
-        stream.ReadUI64(m_Entries[i]);
+
+    // read the table in one go and convert it in place
+    AP4_Result result = stream.Read(m_Entries, m_EntryCount*8);
+    if (AP4_FAILED(result)) {
+        AP4_SetMemory(m_Entries, 0, m_EntryCount*8);
+        return;
     }
+    AP4_BytesToUInt64BEArray((const unsigned char*)m_Entries, m_Entries, m_EntryCount);
 }
 
 /*----------------------------------------------------------------------
@@ -91,6 +102,25 @@ AP4_Co64Atom::~AP4_Co64Atom()
     delete[] m_Entries;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_Co64Atom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Co64Atom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+
+    m_Entries = new AP4_UI64[m_EntryCount];
+    AP4_Result result = m_DeferredEntries.Load(m_Entries);
+    if (AP4_FAILED(result)) {
+        AP4_SetMemory(m_Entries, 0, m_EntryCount*8);
+        return result;
+    }
+    AP4_BytesToUInt64BEArray((const unsigned char*)m_Entries, m_Entries, m_EntryCount);
+
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Co64Atom::GetChunkOffset
 +---------------------------------------------------------------------*/
@@ -103,6 +133,7 @@ AP4_Co64Atom::GetChunkOffset(AP4_Ordinal chunk, AP4_UI64& chunk_offset)
     }
 
     // get the chunk offset
+    LoadEntries();
     chunk_offset = m_Entries[chunk - 1]; // m_Entries is zero index based
 
     return AP4_SUCCESS;
@@ -119,7 +150,8 @@ AP4_Co64Atom::SetChunkOffset(AP4_Ordinal chunk, AP4_UI64 chunk_offset)
         return AP4_ERROR_OUT_OF_RANGE;
     }
 
-    // get the chunk offset
+    // set the chunk offset
+    LoadEntries();
     m_Entries[chunk - 1] = chunk_offset; // m_Entries is zero index based
 
     return AP4_SUCCESS;
@@ -131,6 +163,7 @@ AP4_Co64Atom::SetChunkOffset(AP4_Ordinal chunk, AP4_UI64 chunk_offset)
 AP4_Result
 AP4_Co64Atom::AdjustChunkOffsets(AP4_SI64 delta)
 {
+    LoadEntries();
     for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
         m_Entries[i] += delta;
     }
@@ -151,6 +184,8 @@ AP4_Co64Atom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries
+    result = LoadEntries();
+    if (AP4_FAILED(result)) return result;
     for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
         result = stream.WriteUI64(m_Entries[i]);
         if (AP4_FAILED(result)) return result;
@@ -167,6 +202,7 @@ AP4_Co64Atom::InspectFields(AP4_AtomInspector& inspector)
 {
     inspector.AddField("entry_count", m_EntryCount);
     if (inspector.GetVerbosity() >= 1) {
+        LoadEntries();
         char header[32];
         for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
             AP4_FormatString(header, sizeof(header), "entry %8d", i);
@@ -53,6 +53,7 @@
 #include "Ap4PsshAtom.h"
 #include "Ap4AvcParser.h"
 #include "Ap4HevcParser.h"
+#include "Ap4Threads.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -71,6 +72,145 @@ AP4_CencSampleEncrypter::~AP4_CencSampleEncrypter()
     delete m_Cipher;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CencSampleEncrypter::Create
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_CencSampleEncrypter::Create(AP4_UI32                  algorithm_id,
+                                AP4_UI32                  format,
+                                AP4_Size                  nalu_length_size,
+                                unsigned int              iv_size,
+                                const AP4_UI08*           key,
+                                AP4_Size                  key_size,
+                                AP4_BlockCipherFactory*   block_cipher_factory,
+                                AP4_CencSampleEncrypter*& encrypter)
+{
+    // default return value
+    encrypter = NULL;
+    
+    // check the parameters
+    if (key == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+    
+    // use the default cipher factory if  none was passed
+    if (block_cipher_factory == NULL) {
+        block_cipher_factory = &AP4_DefaultBlockCipherFactory::Instance;
+    }
+
+    // create a block cipher
+    AP4_BlockCipher*            block_cipher = NULL;
+    AP4_BlockCipher::CipherMode mode;
+    AP4_BlockCipher::CtrParams  ctr_params;
+    const void*                 mode_params = NULL;
+    switch (algorithm_id) {
+        case AP4_CENC_ALGORITHM_ID_CBC:
+            mode = AP4_BlockCipher::CBC;
+            break;
+            
+        case AP4_CENC_ALGORITHM_ID_CTR:
+            mode = AP4_BlockCipher::CTR;
+            ctr_params.counter_size = 8;
+            mode_params = &ctr_params;
+            break;
+            
+        default: 
+            return AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_Result result = block_cipher_factory->CreateCipher(AP4_BlockCipher::AES_128, 
+                                                           AP4_BlockCipher::ENCRYPT, 
+                                                           mode,
+                                                           mode_params,
+                                                           key, 
+                                                           key_size, 
+                                                           block_cipher);
+    if (AP4_FAILED(result)) return result;
+    
+    // create the sample encrypter (NAL unit based formats use subsamples)
+    AP4_StreamCipher* stream_cipher = NULL;
+    if (algorithm_id == AP4_CENC_ALGORITHM_ID_CBC) {
+        stream_cipher = new AP4_CbcStreamCipher(block_cipher);
+        if (nalu_length_size) {
+            encrypter = new AP4_CencCbcSubSampleEncrypter(stream_cipher, nalu_length_size, format);
+        } else {
+            encrypter = new AP4_CencCbcSampleEncrypter(stream_cipher);
+        }
+        
+        // no per-sample IV means that every sample uses the same (constant) IV
+        encrypter->m_ConstantIv = (iv_size == 0);
+    } else {
+        stream_cipher = new AP4_CtrStreamCipher(block_cipher, 16);
+        if (nalu_length_size) {
+            encrypter = new AP4_CencCtrSubSampleEncrypter(stream_cipher, nalu_length_size, iv_size, format);
+        } else {
+            encrypter = new AP4_CencCtrSampleEncrypter(stream_cipher, iv_size);
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencAdvanceCtrIv
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_CencAdvanceCtrIv(AP4_UI08* iv, unsigned int iv_size, AP4_Size encrypted_size)
+{
+    if (iv_size == 16) {
+        // the low 64 bits are a block counter
+        AP4_UI64 counter = AP4_BytesToUInt64BE(&iv[8]);
+        AP4_BytesFromUInt64BE(&iv[8], counter+(encrypted_size+15)/16);
+    } else if (iv_size == 8) {
+        // the high 64 bits are a sample counter
+        AP4_UI64 counter = AP4_BytesToUInt64BE(&iv[0]);
+        AP4_BytesFromUInt64BE(&iv[0], counter+1);
+    } else {
+        return AP4_ERROR_INTERNAL;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencProcessPattern
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_CencProcessPattern(AP4_StreamCipher* cipher,
+                       const AP4_UI08*   in,
+                       AP4_Size          in_size,
+                       AP4_UI08*         out,
+                       unsigned int      crypt_byte_block,
+                       unsigned int      skip_byte_block,
+                       AP4_UI08*         last_block = NULL)
+{
+    // process <crypt_byte_block> blocks, copy the next <skip_byte_block> blocks,
+    // and repeat. A partial pattern at the end is truncated, and a partial block
+    // always remains in the clear. The cipher state carries over from one
+    // encrypted run to the next (CBC chaining or CTR counter).
+    AP4_Size crypt_size = crypt_byte_block*16;
+    AP4_Size skip_size  = skip_byte_block*16;
+    if (crypt_size == 0) return AP4_ERROR_INVALID_PARAMETERS;
+    while (in_size) {
+        AP4_Size chunk = (in_size < crypt_size) ? in_size-(in_size%16) : crypt_size;
+        if (chunk) {
+            AP4_Size out_size = chunk;
+            AP4_Result result = cipher->ProcessBuffer(in, chunk, out, &out_size, false);
+            if (AP4_FAILED(result)) return result;
+            if (last_block) AP4_CopyMemory(last_block, out+chunk-16, 16);
+            in      += chunk;
+            out     += chunk;
+            in_size -= chunk;
+        }
+        AP4_Size clear = (chunk < crypt_size || in_size < skip_size) ? in_size : skip_size;
+        if (clear) {
+            AP4_CopyMemory(out, in, clear);
+            in      += clear;
+            out     += clear;
+            in_size -= clear;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CencCtrSampleEncrypter::EncryptSampleData
 +---------------------------------------------------------------------*/
@@ -90,32 +230,34 @@ AP4_CencCtrSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
     m_Cipher->SetIV(m_Iv);
 
     // process the sample data
-    if (data_in.GetDataSize()) {
+    if (m_CryptByteBlock) {
+        AP4_Result result = AP4_CencProcessPattern(m_Cipher, in, data_in.GetDataSize(), out, m_CryptByteBlock, m_SkipByteBlock);
+        if (AP4_FAILED(result)) return result;
+    } else if (data_in.GetDataSize()) {
         AP4_Size out_size = data_out.GetDataSize();
         AP4_Result result = m_Cipher->ProcessBuffer(in, data_in.GetDataSize(), out, &out_size, false);
         if (AP4_FAILED(result)) return result;
     }
     
-    // update the IV
-    if (m_IvSize == 16) {
-        unsigned int block_count = (data_in.GetDataSize()+15)/16;
-        AP4_UI64 counter = AP4_BytesToUInt64BE(&m_Iv[8]);
-        AP4_BytesFromUInt64BE(&m_Iv[8], counter+block_count);
-    } else if (m_IvSize == 8){
-        AP4_UI64 counter = AP4_BytesToUInt64BE(&m_Iv[0]);
-        AP4_BytesFromUInt64BE(&m_Iv[0], counter+1);
-    } else {
-        return AP4_ERROR_INTERNAL;
-    }
-    
-    return AP4_SUCCESS;
+    // update the IV (with a pattern, the counter may advance past the blocks
+    // actually used, which keeps AdvanceIv independent of the pattern)
+    return AP4_CencAdvanceCtrIv(m_Iv, m_IvSize, data_in.GetDataSize());
 }
 
 /*----------------------------------------------------------------------
-|   AP4_CencCtrSubSampleEncrypter::GetSubSampleMap
+|   AP4_CencCtrSampleEncrypter::AdvanceIv
 +---------------------------------------------------------------------*/
 AP4_Result 
-AP4_CencCtrSubSampleEncrypter::GetSubSampleMap(AP4_DataBuffer&      sample_data, 
+AP4_CencCtrSampleEncrypter::AdvanceIv(AP4_DataBuffer& data_in)
+{
+    return AP4_CencAdvanceCtrIv(m_Iv, m_IvSize, data_in.GetDataSize());
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencSubSampleEncrypter::GetVclSubSampleMap
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_CencSubSampleEncrypter::GetVclSubSampleMap(AP4_DataBuffer&      sample_data, 
                                                AP4_Array<AP4_UI16>& bytes_of_cleartext_data, 
                                                AP4_Array<AP4_UI32>& bytes_of_encrypted_data)
 {
@@ -202,6 +344,17 @@ AP4_CencCtrSubSampleEncrypter::GetSubSampleMap(AP4_DataBuffer&      sample_data,
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CencCtrSubSampleEncrypter::GetSubSampleMap
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_CencCtrSubSampleEncrypter::GetSubSampleMap(AP4_DataBuffer&      sample_data, 
+                                               AP4_Array<AP4_UI16>& bytes_of_cleartext_data, 
+                                               AP4_Array<AP4_UI32>& bytes_of_encrypted_data)
+{
+    return GetVclSubSampleMap(sample_data, bytes_of_cleartext_data, bytes_of_encrypted_data);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CencCtrSubSampleEncrypter::EncryptSampleData
 +---------------------------------------------------------------------*/
@@ -237,11 +390,21 @@ AP4_CencCtrSubSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
         
         // encrypt the rest
         if (bytes_of_encrypted_data[i]) {
-            AP4_Size out_size = bytes_of_encrypted_data[i];
-            m_Cipher->ProcessBuffer(in+bytes_of_cleartext_data[i], 
-                                    bytes_of_encrypted_data[i], 
-                                    out+bytes_of_cleartext_data[i], 
-                                    &out_size);
+            if (m_CryptByteBlock) {
+                result = AP4_CencProcessPattern(m_Cipher,
+                                                in+bytes_of_cleartext_data[i],
+                                                bytes_of_encrypted_data[i],
+                                                out+bytes_of_cleartext_data[i],
+                                                m_CryptByteBlock,
+                                                m_SkipByteBlock);
+                if (AP4_FAILED(result)) return result;
+            } else {
+                AP4_Size out_size = bytes_of_encrypted_data[i];
+                m_Cipher->ProcessBuffer(in+bytes_of_cleartext_data[i], 
+                                        bytes_of_encrypted_data[i], 
+                                        out+bytes_of_cleartext_data[i], 
+                                        &out_size);
+            }
             total_encrypted += bytes_of_encrypted_data[i];
         }
         
@@ -251,13 +414,8 @@ AP4_CencCtrSubSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
     }
     
     // update the IV
-    if (m_IvSize == 16) {
-        AP4_UI64 counter = AP4_BytesToUInt64BE(&m_Iv[8]);
-        AP4_BytesFromUInt64BE(&m_Iv[8], counter+(total_encrypted+15)/16);
-    } else {
-        AP4_UI64 counter = AP4_BytesToUInt64BE(&m_Iv[0]);
-        AP4_BytesFromUInt64BE(&m_Iv[0], counter+1);
-    }
+    result = AP4_CencAdvanceCtrIv(m_Iv, m_IvSize, total_encrypted);
+    if (AP4_FAILED(result)) return result;
     
     // encode the sample infos
     unsigned int sample_info_count = bytes_of_cleartext_data.ItemCount();
@@ -272,6 +430,31 @@ AP4_CencCtrSubSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CencCtrSubSampleEncrypter::AdvanceIv
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_CencCtrSubSampleEncrypter::AdvanceIv(AP4_DataBuffer& data_in)
+{
+    // empty samples leave the IV unchanged (see EncryptSampleData)
+    if (data_in.GetDataSize() == 0) return AP4_SUCCESS;
+    
+    // with 8-byte IVs, the counter does not depend on the sample data
+    if (m_IvSize != 16) return AP4_CencAdvanceCtrIv(m_Iv, m_IvSize, 0);
+    
+    // count the encrypted bytes
+    AP4_Array<AP4_UI16> bytes_of_cleartext_data;
+    AP4_Array<AP4_UI32> bytes_of_encrypted_data;
+    AP4_Result result = GetSubSampleMap(data_in, bytes_of_cleartext_data, bytes_of_encrypted_data);
+    if (AP4_FAILED(result)) return result;
+    AP4_Size total_encrypted = 0;
+    for (unsigned int i=0; i<bytes_of_encrypted_data.ItemCount(); i++) {
+        total_encrypted += bytes_of_encrypted_data[i];
+    }
+    
+    return AP4_CencAdvanceCtrIv(m_Iv, m_IvSize, total_encrypted);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CencCbcSubSampleEncrypter::GetSubSampleMap
 +---------------------------------------------------------------------*/
@@ -280,6 +463,12 @@ AP4_CencCbcSubSampleEncrypter::GetSubSampleMap(AP4_DataBuffer&      sample_data,
                                                AP4_Array<AP4_UI16>& bytes_of_cleartext_data, 
                                                AP4_Array<AP4_UI32>& bytes_of_encrypted_data)
 {
+    // with pattern encryption ('cbcs'), the NAL unit and slice headers stay
+    // in the clear, like with CTR
+    if (m_CryptByteBlock) {
+        return GetVclSubSampleMap(sample_data, bytes_of_cleartext_data, bytes_of_encrypted_data);
+    }
+    
     // setup direct pointers to the buffers
     const AP4_UI08* in = sample_data.GetData();
     
@@ -343,6 +532,11 @@ AP4_CencCbcSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
     m_Cipher->SetIV(m_Iv);
 
     // process the sample data
+    if (m_CryptByteBlock) {
+        return AP4_CencProcessPattern(m_Cipher, in, data_in.GetDataSize(), out, 
+                                      m_CryptByteBlock, m_SkipByteBlock,
+                                      m_ConstantIv ? NULL : m_Iv);
+    }
     unsigned int block_count = data_in.GetDataSize()/16;
     if (block_count) {
         AP4_Size out_size = data_out.GetDataSize();
@@ -351,8 +545,8 @@ AP4_CencCbcSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
         in  += block_count*16;
         out += block_count*16;
         
-        // update the IV (last cipherblock emitted)
-        AP4_CopyMemory(m_Iv, out-16, 16);
+        // update the IV (last cipherblock emitted), unless it is constant
+        if (!m_ConstantIv) AP4_CopyMemory(m_Iv, out-16, 16);
     }
     
     // any partial block at the end remains in the clear
@@ -397,14 +591,30 @@ AP4_CencCbcSubSampleEncrypter::EncryptSampleData(AP4_DataBuffer& data_in,
         
         // encrypt the rest
         if (bytes_of_encrypted_data[i]) {
-            AP4_Size out_size = bytes_of_encrypted_data[i];
-            m_Cipher->ProcessBuffer(in+bytes_of_cleartext_data[i], 
-                                    bytes_of_encrypted_data[i], 
-                                    out+bytes_of_cleartext_data[i], 
-                                    &out_size, false);
+            // with a constant IV, each subsample starts a new chain
+            if (m_ConstantIv) m_Cipher->SetIV(m_Iv);
             
-            // update the IV (last cipherblock emitted)
-            AP4_CopyMemory(m_Iv, out+bytes_of_cleartext_data[i]+bytes_of_encrypted_data[i]-16, 16);            
+            if (m_CryptByteBlock) {
+                result = AP4_CencProcessPattern(m_Cipher,
+                                                in+bytes_of_cleartext_data[i],
+                                                bytes_of_encrypted_data[i],
+                                                out+bytes_of_cleartext_data[i],
+                                                m_CryptByteBlock,
+                                                m_SkipByteBlock,
+                                                m_ConstantIv ? NULL : m_Iv);
+                if (AP4_FAILED(result)) return result;
+            } else {
+                AP4_Size out_size = bytes_of_encrypted_data[i];
+                m_Cipher->ProcessBuffer(in+bytes_of_cleartext_data[i], 
+                                        bytes_of_encrypted_data[i], 
+                                        out+bytes_of_cleartext_data[i], 
+                                        &out_size, false);
+            
+                // update the IV (last cipherblock emitted), unless it is constant
+                if (!m_ConstantIv) {
+                    AP4_CopyMemory(m_Iv, out+bytes_of_cleartext_data[i]+bytes_of_encrypted_data[i]-16, 16);
+                }
+            }
         }
         
         // move the pointers
@@ -435,6 +645,9 @@ public:
                            AP4_UI32                     default_algorithm_id,
                            AP4_UI08                     default_iv_size,
                            const AP4_UI08*              default_kid,
+                           const AP4_UI08*              default_constant_iv,
+                           AP4_UI08                     default_crypt_byte_block,
+                           AP4_UI08                     default_skip_byte_block,
                            AP4_Array<AP4_SampleEntry*>& sample_entries,
                            AP4_UI32                     format);
 
@@ -451,6 +664,10 @@ private:
     AP4_UI32                    m_DefaultAlgorithmId;
     AP4_UI08                    m_DefaultIvSize;
     AP4_UI08                    m_DefaultKid[16];
+    AP4_UI08                    m_DefaultConstantIvSize;
+    AP4_UI08                    m_DefaultConstantIv[16];
+    AP4_UI08                    m_DefaultCryptByteBlock;
+    AP4_UI08                    m_DefaultSkipByteBlock;
 };
 
 /*----------------------------------------------------------------------
@@ -461,15 +678,26 @@ AP4_CencTrackEncrypter::AP4_CencTrackEncrypter(
     AP4_UI32                     default_algorithm_id,
     AP4_UI08                     default_iv_size,
     const AP4_UI08*              default_kid,
+    const AP4_UI08*              default_constant_iv,
+    AP4_UI08                     default_crypt_byte_block,
+    AP4_UI08                     default_skip_byte_block,
     AP4_Array<AP4_SampleEntry*>& sample_entries,
     AP4_UI32                     format) :
     m_Variant(variant),
     m_Format(format),
     m_DefaultAlgorithmId(default_algorithm_id),
-    m_DefaultIvSize(default_iv_size)
+    m_DefaultIvSize(default_iv_size),
+    m_DefaultConstantIvSize(default_constant_iv ? 16 : 0),
+    m_DefaultCryptByteBlock(default_crypt_byte_block),
+    m_DefaultSkipByteBlock(default_skip_byte_block)
 {
-    // copy the KID
+    // copy the KID and the constant IV
     AP4_CopyMemory(m_DefaultKid, default_kid, 16);
+    if (default_constant_iv) {
+        AP4_CopyMemory(m_DefaultConstantIv, default_constant_iv, 16);
+    } else {
+        AP4_SetMemory(m_DefaultConstantIv, 0, 16);
+    }
 
     // copy the sample entry list
     for (unsigned int i=0; i<sample_entries.ItemCount(); i++) {
@@ -507,6 +735,21 @@ AP4_CencTrackEncrypter::ProcessTrack()
                                         m_DefaultIvSize,
                                         m_DefaultKid);
                 break;
+                
+            case AP4_CENC_VARIANT_MPEG_CENS:
+            case AP4_CENC_VARIANT_MPEG_CBCS:
+                schm = new AP4_SchmAtom(m_Variant == AP4_CENC_VARIANT_MPEG_CENS ?
+                                        AP4_PROTECTION_SCHEME_TYPE_CENS :
+                                        AP4_PROTECTION_SCHEME_TYPE_CBCS,
+                                        AP4_PROTECTION_SCHEME_VERSION_CENC_10);
+                tenc = new AP4_TencAtom(m_DefaultAlgorithmId,
+                                        m_DefaultIvSize,
+                                        m_DefaultKid,
+                                        m_DefaultConstantIvSize,
+                                        m_DefaultConstantIv,
+                                        m_DefaultCryptByteBlock,
+                                        m_DefaultSkipByteBlock);
+                break;
         }
         
         // populate the schi container
@@ -554,6 +797,9 @@ public:
     virtual AP4_Result ProcessFragment();
     virtual AP4_Result ProcessSample(AP4_DataBuffer& data_in,
                                      AP4_DataBuffer& data_out);
+    virtual AP4_Result ProcessSamples(AP4_Array<AP4_DataBuffer>& data_in,
+                                      AP4_Array<AP4_DataBuffer>& data_out,
+                                      AP4_ThreadPool&            thread_pool);
     virtual AP4_Result PrepareForSamples(AP4_FragmentSampleTable* sample_table);
     virtual AP4_Result FinishFragment();
     
@@ -646,6 +892,13 @@ AP4_CencFragmentEncrypter::ProcessFragment()
             m_Saio = new AP4_SaioAtom();
             break;
             
+        case AP4_CENC_VARIANT_MPEG_CENS:
+        case AP4_CENC_VARIANT_MPEG_CBCS:
+            m_SampleEncryptionAtom = new AP4_SencAtom((AP4_UI08)m_Encrypter->m_IvSize);
+            m_Saiz = new AP4_SaizAtom();
+            m_Saio = new AP4_SaioAtom();
+            break;
+            
         default:
             return AP4_ERROR_INTERNAL;
     }
@@ -695,14 +948,16 @@ AP4_CencFragmentEncrypter::PrepareForSamples(AP4_FragmentSampleTable* sample_tab
     }
     
     if (!m_Encrypter->m_SampleEncrypter->UseSubSamples()) {
-        m_SampleEncryptionAtom->SetSampleInfosSize(sample_count*m_SampleEncryptionAtom->GetIvSize());
-        if (m_SampleEncryptionAtomShadow) {
-            m_SampleEncryptionAtomShadow->SetSampleInfosSize(sample_count*m_SampleEncryptionAtomShadow->GetIvSize());
-        }
+        // resize saiz first (with a constant IV, it has one entry per sample),
+        // the senc update below recomputes the size of the traf container
         if (m_Saiz) {
             m_Saiz->SetDefaultSampleInfoSize(m_SampleEncryptionAtom->GetIvSize());
             m_Saiz->SetSampleCount(sample_count);
         }
+        m_SampleEncryptionAtom->SetSampleInfosSize(sample_count*m_SampleEncryptionAtom->GetIvSize());
+        if (m_SampleEncryptionAtomShadow) {
+            m_SampleEncryptionAtomShadow->SetSampleInfosSize(sample_count*m_SampleEncryptionAtomShadow->GetIvSize());
+        }
         return AP4_SUCCESS;
     }
         
@@ -773,6 +1028,157 @@ AP4_CencFragmentEncrypter::ProcessSample(AP4_DataBuffer& data_in,
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CencSampleRangeEncrypter
++---------------------------------------------------------------------*/
+/*
+ * Encrypts a contiguous range of the samples of a fragment, starting each
+ * sample from an IV that was computed ahead of time. Each instance uses
+ * its own sample encrypter, so instances can run on different threads.
+ */
+class AP4_CencSampleRangeEncrypter : public AP4_Runnable {
+public:
+    AP4_CencSampleRangeEncrypter(AP4_CencSampleEncrypter&   sample_encrypter,
+                                 AP4_Array<AP4_DataBuffer>& data_in,
+                                 AP4_Array<AP4_DataBuffer>& data_out,
+                                 AP4_Array<AP4_DataBuffer>& sample_infos,
+                                 const AP4_UI08*            ivs,
+                                 AP4_Ordinal                first,
+                                 AP4_Ordinal                end) :
+        m_SampleEncrypter(sample_encrypter),
+        m_DataIn(data_in),
+        m_DataOut(data_out),
+        m_SampleInfos(sample_infos),
+        m_Ivs(ivs),
+        m_First(first),
+        m_End(end),
+        m_Result(AP4_SUCCESS) {}
+    
+    // AP4_Runnable methods
+    virtual void Run();
+    
+    // members
+    AP4_CencSampleEncrypter&   m_SampleEncrypter;
+    AP4_Array<AP4_DataBuffer>& m_DataIn;
+    AP4_Array<AP4_DataBuffer>& m_DataOut;
+    AP4_Array<AP4_DataBuffer>& m_SampleInfos;
+    const AP4_UI08*            m_Ivs;
+    AP4_Ordinal                m_First;
+    AP4_Ordinal                m_End;
+    AP4_Result                 m_Result;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_CencSampleRangeEncrypter::Run
++---------------------------------------------------------------------*/
+void
+AP4_CencSampleRangeEncrypter::Run()
+{
+    for (unsigned int i=m_First; i<m_End; i++) {
+        m_SampleEncrypter.SetIv(&m_Ivs[i*16]);
+        m_Result = m_SampleEncrypter.EncryptSampleData(m_DataIn[i], m_DataOut[i], m_SampleInfos[i]);
+        if (AP4_FAILED(m_Result)) break;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencFragmentEncrypter::ProcessSamples
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_CencFragmentEncrypter::ProcessSamples(AP4_Array<AP4_DataBuffer>& data_in,
+                                          AP4_Array<AP4_DataBuffer>& data_out,
+                                          AP4_ThreadPool&            thread_pool)
+{
+    AP4_Cardinal sample_count = data_in.ItemCount();
+    if (data_out.ItemCount() != sample_count) return AP4_ERROR_INVALID_PARAMETERS;
+    AP4_Cardinal thread_count = thread_pool.GetThreadCount();
+    if (thread_count > sample_count) thread_count = sample_count;
+    
+    // process the samples serially if there is nothing to gain from threads
+    if (thread_count < 2 ||
+        m_Encrypter->m_CurrentFragment < m_Encrypter->m_CleartextFragments ||
+        m_Encrypter->m_Key.GetDataSize() == 0) {
+        return AP4_Processor::FragmentHandler::ProcessSamples(data_in, data_out, thread_pool);
+    }
+    
+    // compute the IV of each sample in advance, which leaves the shared
+    // sample encrypter with the IV for the first sample of the next fragment
+    AP4_CencSampleEncrypter* sample_encrypter = m_Encrypter->m_SampleEncrypter;
+    AP4_DataBuffer ivs(sample_count*16);
+    ivs.SetDataSize(sample_count*16);
+    AP4_UI08* iv = ivs.UseData();
+    AP4_UI64 total_size = 0;
+    for (unsigned int i=0; i<sample_count; i++) {
+        AP4_CopyMemory(&iv[i*16], sample_encrypter->GetIv(), 16);
+        AP4_Result result = sample_encrypter->AdvanceIv(data_in[i]);
+        if (AP4_FAILED(result)) {
+            // the IVs can't be predicted (CBC), so restore the first one and go serial
+            sample_encrypter->SetIv(&iv[0]);
+            if (result != AP4_ERROR_NOT_SUPPORTED) return result;
+            return AP4_Processor::FragmentHandler::ProcessSamples(data_in, data_out, thread_pool);
+        }
+        total_size += data_in[i].GetDataSize();
+    }
+    
+    // create the sample encrypters for the ranges the first time around
+    AP4_Array<AP4_CencSampleEncrypter*>& range_encrypters = m_Encrypter->m_RangeEncrypters;
+    while (range_encrypters.ItemCount() < thread_count) {
+        AP4_CencSampleEncrypter* range_encrypter = NULL;
+        AP4_Result result = AP4_CencSampleEncrypter::Create(m_Encrypter->m_AlgorithmId,
+                                                            m_Encrypter->m_Format,
+                                                            m_Encrypter->m_NaluLengthSize,
+                                                            m_Encrypter->m_IvSize,
+                                                            m_Encrypter->m_Key.GetData(),
+                                                            m_Encrypter->m_Key.GetDataSize(),
+                                                            m_Encrypter->m_BlockCipherFactory,
+                                                            range_encrypter);
+        if (AP4_FAILED(result)) return result;
+        range_encrypter->SetPattern(m_Encrypter->m_CryptByteBlock, m_Encrypter->m_SkipByteBlock);
+        range_encrypters.Append(range_encrypter);
+    }
+    
+    // split the samples into contiguous ranges of about the same number of bytes
+    AP4_Array<AP4_DataBuffer>                 sample_infos;
+    AP4_Array<AP4_CencSampleRangeEncrypter*>  workers;
+    sample_infos.SetItemCount(sample_count);
+    AP4_Ordinal first   = 0;
+    AP4_UI64    running = 0;
+    for (unsigned int t=0; t<thread_count; t++) {
+        AP4_UI64    target = (total_size*(t+1))/thread_count;
+        AP4_Ordinal end    = first;
+        while (end < sample_count && (running < target || end == first || t == thread_count-1)) {
+            running += data_in[end++].GetDataSize();
+        }
+        if (end == first) break;
+        workers.Append(new AP4_CencSampleRangeEncrypter(*range_encrypters[t], data_in, data_out, sample_infos, iv, first, end));
+        first = end;
+    }
+    
+    // hand the ranges to the workers and wait for all of them
+    for (unsigned int i=0; i<workers.ItemCount(); i++) {
+        if (AP4_FAILED(thread_pool.Submit(*workers[i]))) workers[i]->Run();
+    }
+    thread_pool.Wait();
+    
+    // check the results
+    AP4_Result result = AP4_SUCCESS;
+    for (unsigned int i=0; i<workers.ItemCount(); i++) {
+        if (AP4_SUCCEEDED(result)) result = workers[i]->m_Result;
+        delete workers[i];
+    }
+    if (AP4_FAILED(result)) return result;
+    
+    // update the sample infos, in sample order
+    for (unsigned int i=0; i<sample_count; i++) {
+        m_SampleEncryptionAtom->AddSampleInfo(&iv[i*16], sample_infos[i]);
+        if (m_SampleEncryptionAtomShadow) {
+            m_SampleEncryptionAtomShadow->AddSampleInfo(&iv[i*16], sample_infos[i]);
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CencFragmentEncrypter::FinishFragment
 +---------------------------------------------------------------------*/
@@ -873,7 +1279,7 @@ AP4_CencEncryptingProcessor::Initialize(AP4_AtomParent&                  top_lev
             if (!ftyp->HasCompatibleBrand(AP4_PIFF_BRAND)) {
                 compatible_brands.Append(AP4_PIFF_BRAND);
             }
-        } else if (m_Variant == AP4_CENC_VARIANT_MPEG) {
+        } else {
             if (!ftyp->HasCompatibleBrand(AP4_FILE_BRAND_ISO6)) {
                 compatible_brands.Append(AP4_FILE_BRAND_ISO6);
             }
@@ -905,7 +1311,9 @@ AP4_CencEncryptingProcessor::Initialize(AP4_AtomParent&                  top_lev
     if (moov) {
         // create a 'standard EME' pssh atom
         AP4_PsshAtom* eme_pssh = NULL;
-        if (m_Variant == AP4_CENC_VARIANT_MPEG && AP4_GlobalOptions::GetBool("mpeg-cenc.eme-pssh")) {
+        if (m_Variant != AP4_CENC_VARIANT_PIFF_CBC && 
+            m_Variant != AP4_CENC_VARIANT_PIFF_CTR &&
+            AP4_GlobalOptions::GetBool("mpeg-cenc.eme-pssh")) {
             AP4_DataBuffer kids;
             AP4_UI32       kid_count = 0;
             const AP4_List<AP4_TrackPropertyMap::Entry>& prop_entries = m_PropertyMap.GetEntries();
@@ -940,7 +1348,7 @@ AP4_CencEncryptingProcessor::Initialize(AP4_AtomParent&                  top_lev
 
         // check if we need to create a Marlin 'mkid' table
         AP4_PsshAtom* marlin_pssh = NULL;
-        if (m_Variant == AP4_CENC_VARIANT_MPEG) {
+        if (m_Variant != AP4_CENC_VARIANT_PIFF_CBC && m_Variant != AP4_CENC_VARIANT_PIFF_CTR) {
             const AP4_List<AP4_TrackPropertyMap::Entry>& prop_entries = m_PropertyMap.GetEntries();
             AP4_MkidAtom* mkid = NULL;
             for (unsigned int i=0; i<prop_entries.ItemCount(); i++) {
@@ -1104,10 +1512,29 @@ AP4_CencEncryptingProcessor::CreateTrackHandler(AP4_TrakAtom* trak)
         AP4_ParseHex(kid_hex, kid, 16);
     }
         
+    // find the NAL unit length size for formats that use subsamples
+    AP4_Size nalu_length_size = 0;
+    if (format == AP4_ATOM_TYPE_AVC1 ||
+        format == AP4_ATOM_TYPE_AVC2 ||
+        format == AP4_ATOM_TYPE_AVC3 ||
+        format == AP4_ATOM_TYPE_AVC4) {
+        AP4_AvccAtom* avcc = AP4_DYNAMIC_CAST(AP4_AvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_AVCC));
+        if (avcc == NULL) return NULL;
+        nalu_length_size = avcc->GetNaluLengthSize();
+    } else if (format == AP4_ATOM_TYPE_HEV1 ||
+               format == AP4_ATOM_TYPE_HVC1) {
+        AP4_HvccAtom* hvcc = AP4_DYNAMIC_CAST(AP4_HvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_HVCC));
+        if (hvcc == NULL) return NULL;
+        nalu_length_size = hvcc->GetNaluLengthSize();
+    }
+    
     // create the encrypter
     AP4_Processor::TrackHandler* track_encrypter;
-    AP4_UI32 algorithm_id = 0;
-    AP4_UI08 iv_size = 16;
+    AP4_UI32        algorithm_id     = 0;
+    AP4_UI08        iv_size          = 16;
+    const AP4_UI08* constant_iv      = NULL;
+    AP4_UI08        crypt_byte_block = 0;
+    AP4_UI08        skip_byte_block  = 0;
     switch (m_Variant) {
         case AP4_CENC_VARIANT_PIFF_CTR:
             algorithm_id = AP4_CENC_ALGORITHM_ID_CTR;
@@ -1127,86 +1554,55 @@ AP4_CencEncryptingProcessor::CreateTrackHandler(AP4_TrakAtom* trak)
             algorithm_id = AP4_CENC_ALGORITHM_ID_CTR;
             break;
             
+        case AP4_CENC_VARIANT_MPEG_CENS:
+            if (AP4_GlobalOptions::GetBool("mpeg-cenc.iv-size-8")) {
+                iv_size = 8;
+            }
+            algorithm_id = AP4_CENC_ALGORITHM_ID_CTR;
+            break;
+            
+        case AP4_CENC_VARIANT_MPEG_CBCS:
+            // all samples use the IV from the key map
+            iv_size      = 0;
+            constant_iv  = iv->GetData();
+            algorithm_id = AP4_CENC_ALGORITHM_ID_CBC;
+            break;
+            
         default:
             return NULL;
     }
+    
+    // video tracks with NAL units use a 1:9 pattern with the pattern schemes,
+    // other tracks are fully encrypted
+    if ((m_Variant == AP4_CENC_VARIANT_MPEG_CENS || m_Variant == AP4_CENC_VARIANT_MPEG_CBCS) &&
+        nalu_length_size) {
+        crypt_byte_block = 1;
+        skip_byte_block  = 9;
+    }
+    
     track_encrypter = new AP4_CencTrackEncrypter(m_Variant,
                                                  algorithm_id, 
                                                  iv_size,
                                                  kid,
+                                                 constant_iv,
+                                                 crypt_byte_block,
+                                                 skip_byte_block,
                                                  entries, 
                                                  enc_format);
-        
-    // create a block cipher
-    AP4_BlockCipher*            block_cipher = NULL;
-    AP4_BlockCipher::CipherMode mode;
-    AP4_BlockCipher::CtrParams  ctr_params;
-    const void*                 mode_params = NULL;
-    switch (algorithm_id) {
-        case AP4_CENC_ALGORITHM_ID_CBC:
-            mode = AP4_BlockCipher::CBC;
-            break;
-            
-        case AP4_CENC_ALGORITHM_ID_CTR:
-            mode = AP4_BlockCipher::CTR;
-            ctr_params.counter_size = 8;
-            mode_params = &ctr_params;
-            break;
-            
-        default: return NULL;
-    }
-    AP4_Result result = m_BlockCipherFactory->CreateCipher(AP4_BlockCipher::AES_128, 
-                                                           AP4_BlockCipher::ENCRYPT, 
-                                                           mode,
-                                                           mode_params,
-                                                           key->GetData(), 
-                                                           key->GetDataSize(), 
-                                                           block_cipher);
-    if (AP4_FAILED(result)) return NULL;
     
-    // add a new cipher state for this track
+    // create the sample encrypter for this track
     AP4_CencSampleEncrypter* sample_encrypter = NULL;
-    AP4_StreamCipher* stream_cipher = NULL;
-    switch (algorithm_id) {
-        case AP4_CENC_ALGORITHM_ID_CBC:
-            stream_cipher = new AP4_CbcStreamCipher(block_cipher);
-            if (format == AP4_ATOM_TYPE_AVC1 ||
-                format == AP4_ATOM_TYPE_AVC2 ||
-                format == AP4_ATOM_TYPE_AVC3 ||
-                format == AP4_ATOM_TYPE_AVC4) {
-                AP4_AvccAtom* avcc = AP4_DYNAMIC_CAST(AP4_AvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_AVCC));
-                if (avcc == NULL) return NULL;
-                sample_encrypter = new AP4_CencCbcSubSampleEncrypter(stream_cipher, avcc->GetNaluLengthSize(), format);
-            } else if (format == AP4_ATOM_TYPE_HEV1 ||
-                       format == AP4_ATOM_TYPE_HVC1) {
-                AP4_HvccAtom* hvcc = AP4_DYNAMIC_CAST(AP4_HvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_HVCC));
-                if (hvcc == NULL) return NULL;
-                sample_encrypter = new AP4_CencCbcSubSampleEncrypter(stream_cipher, hvcc->GetNaluLengthSize(), format);
-            } else {
-                sample_encrypter = new AP4_CencCbcSampleEncrypter(stream_cipher);
-            }
-            break;
-            
-        case AP4_CENC_ALGORITHM_ID_CTR:
-            stream_cipher = new AP4_CtrStreamCipher(block_cipher, 16);
-            if (format == AP4_ATOM_TYPE_AVC1 ||
-                format == AP4_ATOM_TYPE_AVC2 ||
-                format == AP4_ATOM_TYPE_AVC3 ||
-                format == AP4_ATOM_TYPE_AVC4) {
-                AP4_AvccAtom* avcc = AP4_DYNAMIC_CAST(AP4_AvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_AVCC));
-                if (avcc == NULL) return NULL;
-                sample_encrypter = new AP4_CencCtrSubSampleEncrypter(stream_cipher, avcc->GetNaluLengthSize(), iv_size, format);
-            } else if (format == AP4_ATOM_TYPE_HEV1 ||
-                       format == AP4_ATOM_TYPE_HVC1) {
-                AP4_HvccAtom* hvcc = AP4_DYNAMIC_CAST(AP4_HvccAtom, entries[0]->GetChild(AP4_ATOM_TYPE_HVCC));
-                if (hvcc == NULL) return NULL;
-                sample_encrypter = new AP4_CencCtrSubSampleEncrypter(stream_cipher, hvcc->GetNaluLengthSize(), iv_size, format);
-            } else {
-                sample_encrypter = new AP4_CencCtrSampleEncrypter(stream_cipher, iv_size);
-            }
-            break;
-    }
+    AP4_Result result = AP4_CencSampleEncrypter::Create(algorithm_id,
+                                                        format,
+                                                        nalu_length_size,
+                                                        iv_size,
+                                                        key->GetData(),
+                                                        key->GetDataSize(),
+                                                        m_BlockCipherFactory,
+                                                        sample_encrypter);
+    if (AP4_FAILED(result)) return NULL;
     sample_encrypter->SetIv(iv->GetData());
+    sample_encrypter->SetPattern(crypt_byte_block, skip_byte_block);
 
     // if we need to leave some samples unencrypted, create clones of the sample descriptions
     const char* clear_lead = m_PropertyMap.GetProperty(trak->GetId(), "ClearLeadFragments");
@@ -1219,7 +1615,16 @@ AP4_CencEncryptingProcessor::CreateTrackHandler(AP4_TrakAtom* trak)
         }
     }
     
-    m_Encrypters.Add(new Encrypter(trak->GetId(), clear_fragments, sample_encrypter));
+    Encrypter* encrypter = new Encrypter(trak->GetId(), clear_fragments, sample_encrypter);
+    encrypter->m_AlgorithmId        = algorithm_id;
+    encrypter->m_Format             = format;
+    encrypter->m_NaluLengthSize     = nalu_length_size;
+    encrypter->m_IvSize             = iv_size;
+    encrypter->m_CryptByteBlock     = crypt_byte_block;
+    encrypter->m_SkipByteBlock      = skip_byte_block;
+    encrypter->m_BlockCipherFactory = m_BlockCipherFactory;
+    encrypter->m_Key.SetData(key->GetData(), key->GetDataSize());
+    m_Encrypters.Add(encrypter);
     return track_encrypter;
 }
 
@@ -1407,7 +1812,13 @@ AP4_CencSingleSampleDecrypter::DecryptSampleData(AP4_DataBuffer& data_in,
             
             // decrypt the rest
             if (encrypted_size) {
-                AP4_Result result = m_Cipher->ProcessBuffer(in+cleartext_size, encrypted_size, out+cleartext_size, &encrypted_size, false);
+                if (m_ResetIvAtEachSubsample) m_Cipher->SetIV(iv);
+                AP4_Result result;
+                if (m_CryptByteBlock) {
+                    result = AP4_CencProcessPattern(m_Cipher, in+cleartext_size, encrypted_size, out+cleartext_size, m_CryptByteBlock, m_SkipByteBlock);
+                } else {
+                    result = m_Cipher->ProcessBuffer(in+cleartext_size, encrypted_size, out+cleartext_size, &encrypted_size, false);
+                }
                 if (AP4_FAILED(result)) return result;
             }
             
@@ -1415,6 +1826,10 @@ AP4_CencSingleSampleDecrypter::DecryptSampleData(AP4_DataBuffer& data_in,
             in  += cleartext_size+encrypted_size;
             out += cleartext_size+encrypted_size;
         }
+    } else if (m_CryptByteBlock) {
+        // the pattern leaves any partial block at the end in the clear
+        AP4_Result result = AP4_CencProcessPattern(m_Cipher, in, data_in.GetDataSize(), out, m_CryptByteBlock, m_SkipByteBlock);
+        if (AP4_FAILED(result)) return result;
     } else {
         if (m_FullBlocksOnly) {
             unsigned int block_count = data_in.GetDataSize()/16;
@@ -1541,7 +1956,7 @@ AP4_CencSampleDecrypter::Create(AP4_CencSampleInfoTable*  sample_info_table,
             break;
             
         case AP4_CENC_ALGORITHM_ID_CBC:
-            if (iv_size != 16) {
+            if (iv_size != 16 && !(iv_size == 0 && sample_info_table->GetConstantIv())) {
                 return AP4_ERROR_INVALID_FORMAT;
             }
             break;
@@ -1554,6 +1969,11 @@ AP4_CencSampleDecrypter::Create(AP4_CencSampleInfoTable*  sample_info_table,
     AP4_CencSingleSampleDecrypter* single_sample_decrypter = NULL;
     AP4_Result result = AP4_CencSingleSampleDecrypter::Create(algorithm_id, key, key_size, block_cipher_factory, single_sample_decrypter);
     if (AP4_FAILED(result)) return result;
+    single_sample_decrypter->SetPattern(sample_info_table->GetCryptByteBlock(),
+                                        sample_info_table->GetSkipByteBlock());
+    if (algorithm_id == AP4_CENC_ALGORITHM_ID_CBC && iv_size == 0) {
+        single_sample_decrypter->SetResetIvAtEachSubsample(true);
+    }
 
     // create the decrypter
     decrypter = new AP4_CencSampleDecrypter(single_sample_decrypter, sample_info_table);
@@ -1593,11 +2013,17 @@ AP4_CencSampleDecrypter::DecryptSampleData(AP4_DataBuffer& data_in,
 
     // setup the IV
     unsigned char iv_block[16];
+    unsigned int iv_size = m_SampleInfoTable->GetIvSize();
     if (iv == NULL) {
-        iv = m_SampleInfoTable->GetIv(sample_cursor);
+        if (iv_size) {
+            iv = m_SampleInfoTable->GetIv(sample_cursor);
+        } else {
+            // no per-sample IVs: use the constant IV (zero-padded to 16 bytes)
+            iv = m_SampleInfoTable->GetConstantIv();
+        }
     }
     if (iv == NULL) return AP4_ERROR_INVALID_FORMAT;
-    unsigned int iv_size = m_SampleInfoTable->GetIvSize();
+    if (iv_size == 0) iv_size = 16;
     AP4_CopyMemory(iv_block, iv, iv_size);
     if (iv_size != 16) AP4_SetMemory(&iv_block[iv_size], 0, 16-iv_size);
 
@@ -1836,7 +2262,9 @@ AP4_CencDecryptingProcessor::CreateTrackHandler(AP4_TrakAtom* trak)
             AP4_ProtectedSampleDescription* protected_desc = 
                 static_cast<AP4_ProtectedSampleDescription*>(sample_desc);
             if (protected_desc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_PIFF ||
-                protected_desc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC) {
+                protected_desc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC ||
+                protected_desc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENS ||
+                protected_desc->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CBCS) {
                 sample_descs.Append(protected_desc);
                 sample_entries.Append(sample_entry);
             }
@@ -1928,10 +2356,15 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_CencTrackEncryption)
 |   AP4_CencTrackEncryption::AP4_CencTrackEncryption
 +---------------------------------------------------------------------*/
 AP4_CencTrackEncryption::AP4_CencTrackEncryption() :
+    m_Version(0),
     m_DefaultAlgorithmId(0),
-    m_DefaultIvSize(0)
+    m_DefaultIvSize(0),
+    m_DefaultCryptByteBlock(0),
+    m_DefaultSkipByteBlock(0),
+    m_DefaultConstantIvSize(0)
 {
     AP4_SetMemory(m_DefaultKid, 0, 16);
+    AP4_SetMemory(m_DefaultConstantIv, 0, 16);
 }
 
 /*----------------------------------------------------------------------
@@ -1940,21 +2373,98 @@ AP4_CencTrackEncryption::AP4_CencTrackEncryption() :
 AP4_CencTrackEncryption::AP4_CencTrackEncryption(AP4_UI32        default_algorithm_id,
                                                  AP4_UI08        default_iv_size,
                                                  const AP4_UI08* default_kid) :
+    m_Version(0),
     m_DefaultAlgorithmId(default_algorithm_id),
-    m_DefaultIvSize(default_iv_size)
+    m_DefaultIvSize(default_iv_size),
+    m_DefaultCryptByteBlock(0),
+    m_DefaultSkipByteBlock(0),
+    m_DefaultConstantIvSize(0)
 {
     AP4_CopyMemory(m_DefaultKid, default_kid, 16);
+    AP4_SetMemory(m_DefaultConstantIv, 0, 16);
 }
 
 /*----------------------------------------------------------------------
 |   AP4_CencTrackEncryption::AP4_CencTrackEncryption
 +---------------------------------------------------------------------*/
-AP4_CencTrackEncryption::AP4_CencTrackEncryption(AP4_ByteStream& stream)
+AP4_CencTrackEncryption::AP4_CencTrackEncryption(AP4_UI32        default_algorithm_id,
+                                                 AP4_UI08        default_iv_size,
+                                                 const AP4_UI08* default_kid,
+                                                 AP4_UI08        default_constant_iv_size,
+                                                 const AP4_UI08* default_constant_iv,
+                                                 AP4_UI08        default_crypt_byte_block,
+                                                 AP4_UI08        default_skip_byte_block) :
+    m_Version(1),
+    m_DefaultAlgorithmId(default_algorithm_id),
+    m_DefaultIvSize(default_iv_size),
+    m_DefaultCryptByteBlock(default_crypt_byte_block),
+    m_DefaultSkipByteBlock(default_skip_byte_block),
+    m_DefaultConstantIvSize(0)
 {
-    stream.ReadUI24(m_DefaultAlgorithmId);
+    AP4_CopyMemory(m_DefaultKid, default_kid, 16);
+    AP4_SetMemory(m_DefaultConstantIv, 0, 16);
+    
+    // a constant IV is only used when there are no per-sample IVs
+    if (default_iv_size == 0 && default_constant_iv && 
+        (default_constant_iv_size == 8 || default_constant_iv_size == 16)) {
+        m_DefaultConstantIvSize = default_constant_iv_size;
+        AP4_CopyMemory(m_DefaultConstantIv, default_constant_iv, default_constant_iv_size);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencTrackEncryption::AP4_CencTrackEncryption
++---------------------------------------------------------------------*/
+AP4_CencTrackEncryption::AP4_CencTrackEncryption(AP4_ByteStream& stream, 
+                                                 AP4_UI08        version,
+                                                 AP4_Size        payload_size) :
+    m_Version(version),
+    m_DefaultCryptByteBlock(0),
+    m_DefaultSkipByteBlock(0),
+    m_DefaultConstantIvSize(0)
+{
+    if (version == 0) {
+        stream.ReadUI24(m_DefaultAlgorithmId);
+    } else {
+        // version 1 replaces the second reserved byte with the pattern
+        AP4_UI08 reserved = 0;
+        AP4_UI08 pattern  = 0;
+        AP4_UI08 is_protected = 0;
+        stream.ReadUI08(reserved);
+        stream.ReadUI08(pattern);
+        stream.ReadUI08(is_protected);
+        m_DefaultCryptByteBlock = (pattern>>4)&0x0F;
+        m_DefaultSkipByteBlock  = (pattern   )&0x0F;
+        m_DefaultAlgorithmId    = is_protected;
+    }
     stream.ReadUI08(m_DefaultIvSize);
     AP4_SetMemory(m_DefaultKid, 0, 16);
     stream.Read(m_DefaultKid, 16);
+    
+    // protected tracks without per-sample IVs have a constant IV
+    AP4_SetMemory(m_DefaultConstantIv, 0, 16);
+    if (m_DefaultAlgorithmId && m_DefaultIvSize == 0 && payload_size > 20) {
+        if (AP4_SUCCEEDED(stream.ReadUI08(m_DefaultConstantIvSize))) {
+            if (m_DefaultConstantIvSize > 16 || (AP4_Size)(20+1+m_DefaultConstantIvSize) > payload_size) {
+                m_DefaultConstantIvSize = 0;
+            } else {
+                stream.Read(m_DefaultConstantIv, m_DefaultConstantIvSize);
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_CencTrackEncryption::GetFieldsSize
++---------------------------------------------------------------------*/
+AP4_Size
+AP4_CencTrackEncryption::GetFieldsSize()
+{
+    if (m_DefaultConstantIvSize) {
+        return 20+1+m_DefaultConstantIvSize;
+    } else {
+        return 20;
+    }
 }
 
 /*----------------------------------------------------------------------
@@ -1963,9 +2473,19 @@ AP4_CencTrackEncryption::AP4_CencTrackEncryption(AP4_ByteStream& stream)
 AP4_Result 
 AP4_CencTrackEncryption::DoInspectFields(AP4_AtomInspector& inspector)
 {
-    inspector.AddField("default_AlgorithmID", m_DefaultAlgorithmId);
+    if (m_Version == 0) {
+        inspector.AddField("default_AlgorithmID", m_DefaultAlgorithmId);
+    } else {
+        inspector.AddField("default_crypt_byte_block", m_DefaultCryptByteBlock);
+        inspector.AddField("default_skip_byte_block",  m_DefaultSkipByteBlock);
+        inspector.AddField("default_isProtected",      m_DefaultAlgorithmId ? 1 : 0);
+    }
     inspector.AddField("default_IV_size",     m_DefaultIvSize);
     inspector.AddField("default_KID",         m_DefaultKid, 16);
+    if (m_DefaultConstantIvSize) {
+        inspector.AddField("default_constant_IV_size", m_DefaultConstantIvSize);
+        inspector.AddField("default_constant_IV",      m_DefaultConstantIv, m_DefaultConstantIvSize);
+    }
     
     return AP4_SUCCESS;
 }
@@ -1979,12 +2499,27 @@ AP4_CencTrackEncryption::DoWriteFields(AP4_ByteStream& stream)
     AP4_Result result;
     
     // write the fields   
-    result = stream.WriteUI24(m_DefaultAlgorithmId);
-    if (AP4_FAILED(result)) return result;
+    if (m_Version == 0) {
+        result = stream.WriteUI24(m_DefaultAlgorithmId);
+        if (AP4_FAILED(result)) return result;
+    } else {
+        result = stream.WriteUI08(0);
+        if (AP4_FAILED(result)) return result;
+        result = stream.WriteUI08((AP4_UI08)((m_DefaultCryptByteBlock<<4) | (m_DefaultSkipByteBlock&0x0F)));
+        if (AP4_FAILED(result)) return result;
+        result = stream.WriteUI08(m_DefaultAlgorithmId ? 1 : 0); // isProtected
+        if (AP4_FAILED(result)) return result;
+    }
     result = stream.WriteUI08(m_DefaultIvSize);
     if (AP4_FAILED(result)) return result;
     result = stream.Write(m_DefaultKid, 16);
     if (AP4_FAILED(result)) return result;
+    if (m_DefaultConstantIvSize) {
+        result = stream.WriteUI08(m_DefaultConstantIvSize);
+        if (AP4_FAILED(result)) return result;
+        result = stream.Write(m_DefaultConstantIv, m_DefaultConstantIvSize);
+        if (AP4_FAILED(result)) return result;
+    }
 
     return AP4_SUCCESS;
 }
@@ -2046,7 +2581,9 @@ AP4_CencSampleInfoTable::Create(AP4_ProtectedSampleDescription* sample_descripti
         //if (sample_description->GetSchemeVersion() != AP4_PROTECTION_SCHEME_VERSION_PIFF_11) {
         //    return AP4_ERROR_NOT_SUPPORTED;
         //}
-    } else if (sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC) {
+    } else if (sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENC ||
+               sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENS ||
+               sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CBCS) {
         if (sample_description->GetSchemeVersion() != AP4_PROTECTION_SCHEME_VERSION_CENC_10) {
             return AP4_ERROR_NOT_SUPPORTED;
         }
@@ -2083,6 +2620,16 @@ AP4_CencSampleInfoTable::Create(AP4_ProtectedSampleDescription* sample_descripti
         algorithm_id = track_encryption_atom->GetDefaultAlgorithmId();
         iv_size      = track_encryption_atom->GetDefaultIvSize();
     }
+    
+    // with the pattern schemes, the cipher mode is implied by the scheme, and
+    // the 'tenc' atom only has an isProtected flag
+    if (algorithm_id != AP4_CENC_ALGORITHM_ID_NONE) {
+        if (sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CENS) {
+            algorithm_id = AP4_CENC_ALGORITHM_ID_CTR;
+        } else if (sample_description->GetSchemeType() == AP4_PROTECTION_SCHEME_TYPE_CBCS) {
+            algorithm_id = AP4_CENC_ALGORITHM_ID_CBC;
+        }
+    }
 
     // try to create a sample info table from senc
     if (sample_info_table == NULL && sample_encryption_atom) {
@@ -2097,12 +2644,12 @@ AP4_CencSampleInfoTable::Create(AP4_ProtectedSampleDescription* sample_descripti
                                        child = child->GetNext()) {
             if (child->GetData()->GetType() == AP4_ATOM_TYPE_SAIO) {
                 saio = AP4_DYNAMIC_CAST(AP4_SaioAtom, child->GetData());
-                if (saio->GetAuxInfoType() != 0 && saio->GetAuxInfoType() != AP4_PROTECTION_SCHEME_TYPE_CENC) {
+                if (saio->GetAuxInfoType() != 0 && saio->GetAuxInfoType() != sample_description->GetSchemeType()) {
                     saio = NULL;
                 }
             } else if (child->GetData()->GetType() == AP4_ATOM_TYPE_SAIZ) {
                 saiz = AP4_DYNAMIC_CAST(AP4_SaizAtom, child->GetData());
-                if (saiz->GetAuxInfoType() != 0 && saiz->GetAuxInfoType() != AP4_PROTECTION_SCHEME_TYPE_CENC) {
+                if (saiz->GetAuxInfoType() != 0 && saiz->GetAuxInfoType() != sample_description->GetSchemeType()) {
                     saiz = NULL;
                 }
             }
@@ -2123,6 +2670,16 @@ AP4_CencSampleInfoTable::Create(AP4_ProtectedSampleDescription* sample_descripti
         return AP4_ERROR_INVALID_FORMAT;
     }
     
+    // the pattern and the constant IV only come from the track defaults
+    if (track_encryption_atom) {
+        sample_info_table->SetPattern(track_encryption_atom->GetDefaultCryptByteBlock(),
+                                      track_encryption_atom->GetDefaultSkipByteBlock());
+        if (iv_size == 0 && track_encryption_atom->GetDefaultConstantIvSize()) {
+            sample_info_table->SetConstantIv(track_encryption_atom->GetDefaultConstantIv(),
+                                             track_encryption_atom->GetDefaultConstantIvSize());
+        }
+    }
+    
     return AP4_SUCCESS;
 }
 
@@ -2303,10 +2860,14 @@ AP4_CencSampleInfoTable::Create(const AP4_UI08*           serialized,
 AP4_CencSampleInfoTable::AP4_CencSampleInfoTable(AP4_UI32 sample_count,
                                                  AP4_UI08 iv_size) :
     m_SampleCount(sample_count),
-    m_IvSize(iv_size)
+    m_IvSize(iv_size),
+    m_HasConstantIv(false),
+    m_CryptByteBlock(0),
+    m_SkipByteBlock(0)
 {
     m_IvData.SetDataSize(m_IvSize*sample_count);
     AP4_SetMemory(m_IvData.UseData(), 0, m_IvSize*sample_count);
+    AP4_SetMemory(m_ConstantIv, 0, 16);
 }
 
 /*----------------------------------------------------------------------
@@ -2385,6 +2946,20 @@ AP4_CencSampleInfoTable::GetIv(AP4_Ordinal sample_index)
     return m_IvData.GetData()+(m_IvSize*sample_index);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CencSampleInfoTable::SetConstantIv
++---------------------------------------------------------------------*/
+AP4_Result 
+AP4_CencSampleInfoTable::SetConstantIv(const AP4_UI08* iv, AP4_Size iv_size)
+{
+    if (iv_size > 16) return AP4_ERROR_INVALID_PARAMETERS;
+    AP4_SetMemory(m_ConstantIv, 0, 16);
+    AP4_CopyMemory(m_ConstantIv, iv, iv_size);
+    m_HasConstantIv = true;
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CencSampleInfoTable::AddSubSampleData
 +---------------------------------------------------------------------*/
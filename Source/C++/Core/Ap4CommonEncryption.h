@@ -51,6 +51,8 @@ class AP4_CencSampleInfoTable;
 |   constants
 +---------------------------------------------------------------------*/
 const AP4_UI32 AP4_PROTECTION_SCHEME_TYPE_CENC = AP4_ATOM_TYPE('c','e','n','c');
+const AP4_UI32 AP4_PROTECTION_SCHEME_TYPE_CENS = AP4_ATOM_TYPE('c','e','n','s');
+const AP4_UI32 AP4_PROTECTION_SCHEME_TYPE_CBCS = AP4_ATOM_TYPE('c','b','c','s');
 const AP4_UI32 AP4_PROTECTION_SCHEME_VERSION_CENC_10 = 0x00010000;
 
 const AP4_UI32 AP4_CENC_ALGORITHM_ID_NONE = 0; 
@@ -63,7 +65,9 @@ const AP4_UI32 AP4_CENC_SAMPLE_ENCRYPTION_FLAG_USE_SUB_SAMPLE_ENCRYPTION
 typedef enum {
     AP4_CENC_VARIANT_PIFF_CTR,
     AP4_CENC_VARIANT_PIFF_CBC,
-    AP4_CENC_VARIANT_MPEG
+    AP4_CENC_VARIANT_MPEG,
+    AP4_CENC_VARIANT_MPEG_CENS,
+    AP4_CENC_VARIANT_MPEG_CBCS
 } AP4_CencVariant;
 
 /*----------------------------------------------------------------------
@@ -80,23 +84,44 @@ public:
     AP4_Result DoWriteFields(AP4_ByteStream& stream);
     
     // accessors
-    AP4_UI32        GetDefaultAlgorithmId() { return m_DefaultAlgorithmId; }
-    AP4_UI08        GetDefaultIvSize()      { return m_DefaultIvSize;      }
-    const AP4_UI08* GetDefaultKid()         { return m_DefaultKid;         }
+    AP4_UI32        GetDefaultAlgorithmId()     { return m_DefaultAlgorithmId;     }
+    AP4_UI08        GetDefaultIvSize()          { return m_DefaultIvSize;          }
+    const AP4_UI08* GetDefaultKid()             { return m_DefaultKid;             }
+    AP4_UI08        GetDefaultCryptByteBlock()  { return m_DefaultCryptByteBlock;  }
+    AP4_UI08        GetDefaultSkipByteBlock()   { return m_DefaultSkipByteBlock;   }
+    AP4_UI08        GetDefaultConstantIvSize()  { return m_DefaultConstantIvSize;  }
+    const AP4_UI08* GetDefaultConstantIv()      { return m_DefaultConstantIv;      }
     
 protected:
     // constructors
     AP4_CencTrackEncryption();
-    AP4_CencTrackEncryption(AP4_ByteStream& stream);
+    AP4_CencTrackEncryption(AP4_ByteStream& stream, 
+                            AP4_UI08        version = 0,
+                            AP4_Size        payload_size = 20);
     AP4_CencTrackEncryption(AP4_UI32        default_algorithm_id,
                             AP4_UI08        default_iv_size,
                             const AP4_UI08* default_kid);
+    AP4_CencTrackEncryption(AP4_UI32        default_algorithm_id,
+                            AP4_UI08        default_iv_size,
+                            const AP4_UI08* default_kid,
+                            AP4_UI08        default_constant_iv_size,
+                            const AP4_UI08* default_constant_iv,
+                            AP4_UI08        default_crypt_byte_block,
+                            AP4_UI08        default_skip_byte_block);
+    
+    // methods
+    AP4_Size GetFieldsSize();
     
 private:
     // members
+    AP4_UI08 m_Version;
     AP4_UI32 m_DefaultAlgorithmId;
     AP4_UI08 m_DefaultIvSize;
     AP4_UI08 m_DefaultKid[16];    
+    AP4_UI08 m_DefaultCryptByteBlock;
+    AP4_UI08 m_DefaultSkipByteBlock;
+    AP4_UI08 m_DefaultConstantIvSize;
+    AP4_UI08 m_DefaultConstantIv[16];
 };
 
 /*----------------------------------------------------------------------
@@ -186,10 +211,18 @@ public:
                             AP4_UI08 iv_size);
     
     // methods
-    AP4_UI32        GetSampleCount() { return m_SampleCount; }
-    AP4_UI08        GetIvSize()      { return m_IvSize;      }
+    AP4_UI32        GetSampleCount()    { return m_SampleCount;    }
+    AP4_UI08        GetIvSize()         { return m_IvSize;         }
     AP4_Result      SetIv(AP4_Ordinal sample_index, const AP4_UI08* iv);
     const AP4_UI08* GetIv(AP4_Ordinal sample_index);
+    AP4_Result      SetConstantIv(const AP4_UI08* iv, AP4_Size iv_size);
+    const AP4_UI08* GetConstantIv()     { return m_HasConstantIv ? m_ConstantIv : NULL; }
+    void            SetPattern(AP4_UI08 crypt_byte_block, AP4_UI08 skip_byte_block) {
+        m_CryptByteBlock = crypt_byte_block;
+        m_SkipByteBlock  = skip_byte_block;
+    }
+    AP4_UI08        GetCryptByteBlock() { return m_CryptByteBlock; }
+    AP4_UI08        GetSkipByteBlock()  { return m_SkipByteBlock;  }
     AP4_Result      AddSubSampleData(AP4_Cardinal    subsample_count,
                                      const AP4_UI08* subsample_data);
     bool            HasSubSampleInfo() { 
@@ -223,6 +256,10 @@ private:
     AP4_Array<AP4_UI32>     m_BytesOfEncryptedData;
     AP4_Array<unsigned int> m_SubSampleMapStarts;
     AP4_Array<unsigned int> m_SubSampleMapLengths;
+    bool                    m_HasConstantIv;
+    AP4_UI08                m_ConstantIv[16];
+    AP4_UI08                m_CryptByteBlock;
+    AP4_UI08                m_SkipByteBlock;
 };
 
 /*----------------------------------------------------------------------
@@ -295,8 +332,22 @@ private:
 class AP4_CencSampleEncrypter
 {
 public:
+    // factory
+    static AP4_Result Create(AP4_UI32                  algorithm_id,
+                             AP4_UI32                  format,
+                             AP4_Size                  nalu_length_size,
+                             unsigned int              iv_size,
+                             const AP4_UI08*           key,
+                             AP4_Size                  key_size,
+                             AP4_BlockCipherFactory*   block_cipher_factory,
+                             AP4_CencSampleEncrypter*& encrypter);
+
     // constructor and destructor
-    AP4_CencSampleEncrypter(AP4_StreamCipher* cipher) : m_Cipher(cipher) { 
+    AP4_CencSampleEncrypter(AP4_StreamCipher* cipher) : 
+        m_Cipher(cipher),
+        m_ConstantIv(false),
+        m_CryptByteBlock(0),
+        m_SkipByteBlock(0) { 
         AP4_SetMemory(m_Iv, 0, 16); 
     };
     virtual ~AP4_CencSampleEncrypter();
@@ -306,8 +357,31 @@ public:
                                          AP4_DataBuffer& data_out, 
                                          AP4_DataBuffer& sample_infos) = 0;    
 
+    /**
+     * Update the IV exactly as EncryptSampleData would for this sample,
+     * without encrypting anything. This lets the IVs of a run of samples
+     * be computed up front so that the samples can be encrypted in any
+     * order. Returns AP4_ERROR_NOT_SUPPORTED when the next IV depends on
+     * the encrypted output (CBC chaining without a constant IV).
+     */
+    virtual AP4_Result AdvanceIv(AP4_DataBuffer& /* data_in */) { 
+        return m_ConstantIv ? AP4_SUCCESS : AP4_ERROR_NOT_SUPPORTED; 
+    }
+
+    /**
+     * Use pattern encryption ('cens' and 'cbcs' schemes): in each protected
+     * range, <crypt_byte_block> 16-byte blocks are encrypted, then the next
+     * <skip_byte_block> blocks are left in the clear, and so on. A
+     * <crypt_byte_block> of 0 turns pattern encryption off.
+     */
+    void SetPattern(AP4_UI08 crypt_byte_block, AP4_UI08 skip_byte_block) {
+        m_CryptByteBlock = crypt_byte_block;
+        m_SkipByteBlock  = skip_byte_block;
+    }
+
     void            SetIv(const AP4_UI08* iv) { AP4_CopyMemory(m_Iv, iv, 16); }
     const AP4_UI08* GetIv()                   { return m_Iv;                  }
+    bool            HasConstantIv()           { return m_ConstantIv;          }
     virtual bool    UseSubSamples()           { return false;                 }
     virtual AP4_Result GetSubSampleMap(AP4_DataBuffer&      /* sample_data */, 
                                        AP4_Array<AP4_UI16>& /* bytes_of_cleartext_data */, 
@@ -318,6 +392,9 @@ public:
 protected:
     AP4_UI08          m_Iv[16];
     AP4_StreamCipher* m_Cipher;
+    bool              m_ConstantIv;
+    AP4_UI08          m_CryptByteBlock;
+    AP4_UI08          m_SkipByteBlock;
 };
 
 /*----------------------------------------------------------------------
@@ -335,6 +412,7 @@ public:
     virtual AP4_Result EncryptSampleData(AP4_DataBuffer& data_in,
                                          AP4_DataBuffer& data_out,
                                          AP4_DataBuffer& sample_infos);
+    virtual AP4_Result AdvanceIv(AP4_DataBuffer& data_in);
     
 protected:
     unsigned int m_IvSize;
@@ -373,6 +451,13 @@ public:
     // methods
     virtual bool UseSubSamples() { return true;}
                                          
+protected:
+    // methods
+    AP4_Result GetVclSubSampleMap(AP4_DataBuffer&      sample_data, 
+                                  AP4_Array<AP4_UI16>& bytes_of_cleartext_data, 
+                                  AP4_Array<AP4_UI32>& bytes_of_encrypted_data);
+
+public:
     // members
     AP4_Size m_NaluLengthSize;
     AP4_UI32 m_Format;
@@ -399,6 +484,7 @@ public:
     virtual AP4_Result EncryptSampleData(AP4_DataBuffer& data_in,
                                          AP4_DataBuffer& data_out,
                                          AP4_DataBuffer& sample_infos);
+    virtual AP4_Result AdvanceIv(AP4_DataBuffer& data_in);
     
 protected:
     unsigned int m_IvSize;
@@ -437,12 +523,39 @@ public:
             m_TrackId(track_id),
             m_CurrentFragment(0),
             m_CleartextFragments(cleartext_fragments),
-            m_SampleEncrypter(sample_encrypter) {}
-        ~Encrypter() { delete m_SampleEncrypter; }
+            m_SampleEncrypter(sample_encrypter),
+            m_AlgorithmId(0),
+            m_Format(0),
+            m_NaluLengthSize(0),
+            m_IvSize(0),
+            m_CryptByteBlock(0),
+            m_SkipByteBlock(0),
+            m_BlockCipherFactory(NULL) {}
+        ~Encrypter() { 
+            delete m_SampleEncrypter; 
+            for (unsigned int i=0; i<m_RangeEncrypters.ItemCount(); i++) {
+                delete m_RangeEncrypters[i];
+            }
+        }
         AP4_UI32                 m_TrackId;
         AP4_UI32                 m_CurrentFragment;
         AP4_UI32                 m_CleartextFragments;
         AP4_CencSampleEncrypter* m_SampleEncrypter;
+        
+        // parameters used to create extra sample encrypters when the
+        // samples of a fragment are encrypted by more than one thread
+        AP4_UI32                 m_AlgorithmId;
+        AP4_UI32                 m_Format;
+        AP4_Size                 m_NaluLengthSize;
+        unsigned int             m_IvSize;
+        AP4_UI08                 m_CryptByteBlock;
+        AP4_UI08                 m_SkipByteBlock;
+        AP4_DataBuffer           m_Key;
+        AP4_BlockCipherFactory*  m_BlockCipherFactory;
+        
+        // one sample encrypter per range of samples, kept from one
+        // fragment to the next
+        AP4_Array<AP4_CencSampleEncrypter*> m_RangeEncrypters;
     };
 
     // constructor
@@ -513,8 +626,23 @@ public:
                              AP4_CencSingleSampleDecrypter*& decrypter);
     
     // methods
-    AP4_CencSingleSampleDecrypter(AP4_StreamCipher* cipher) : m_Cipher(cipher), m_FullBlocksOnly(false) {}
+    AP4_CencSingleSampleDecrypter(AP4_StreamCipher* cipher) : 
+        m_Cipher(cipher), 
+        m_FullBlocksOnly(false),
+        m_ResetIvAtEachSubsample(false),
+        m_CryptByteBlock(0),
+        m_SkipByteBlock(0) {}
     virtual ~AP4_CencSingleSampleDecrypter();
+    
+    // see AP4_CencSampleEncrypter::SetPattern
+    void SetPattern(AP4_UI08 crypt_byte_block, AP4_UI08 skip_byte_block) {
+        m_CryptByteBlock = crypt_byte_block;
+        m_SkipByteBlock  = skip_byte_block;
+    }
+    
+    // with a constant IV ('cbcs'), each subsample starts a new CBC chain
+    void SetResetIvAtEachSubsample(bool reset) { m_ResetIvAtEachSubsample = reset; }
+    
     virtual AP4_Result DecryptSampleData(AP4_DataBuffer& data_in,
                                          AP4_DataBuffer& data_out,
                                          
@@ -534,11 +662,17 @@ private:
     // constructor
     AP4_CencSingleSampleDecrypter(AP4_StreamCipher* cipher, bool full_blocks_only) :
         m_Cipher(cipher),
-        m_FullBlocksOnly(full_blocks_only) {}
+        m_FullBlocksOnly(full_blocks_only),
+        m_ResetIvAtEachSubsample(false),
+        m_CryptByteBlock(0),
+        m_SkipByteBlock(0) {}
 
     // members
     AP4_StreamCipher* m_Cipher;
     bool              m_FullBlocksOnly;
+    bool              m_ResetIvAtEachSubsample;
+    AP4_UI08          m_CryptByteBlock;
+    AP4_UI08          m_SkipByteBlock;
 };
 
 /*----------------------------------------------------------------------
@@ -120,6 +120,54 @@
 #define AP4_PLATFORM_BYTE_ORDER AP4_PLATFORM_BYTE_ORDER_LITTLE_ENDIAN
 #endif
 
+/*----------------------------------------------------------------------
+|    posix file I/O (memory mapped files, vectored I/O, read-ahead hints)
++---------------------------------------------------------------------*/
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#if !defined(AP4_CONFIG_NO_MMAP) && !defined(AP4_CONFIG_HAVE_MMAP)
+#define AP4_CONFIG_HAVE_MMAP
+#endif
+#if !defined(AP4_CONFIG_NO_VECTORED_IO) && !defined(AP4_CONFIG_HAVE_VECTORED_IO)
+#define AP4_CONFIG_HAVE_VECTORED_IO
+#endif
+#endif
+#if defined(__linux__) && !defined(AP4_CONFIG_NO_FADVISE) && !defined(AP4_CONFIG_HAVE_FADVISE)
+#define AP4_CONFIG_HAVE_FADVISE
+#endif
+
+/*----------------------------------------------------------------------
+|    hardware accelerated crypto (AES-NI, selected at runtime)
++---------------------------------------------------------------------*/
+#if !defined(AP4_CONFIG_NO_AESNI) && !defined(AP4_CONFIG_HAVE_AESNI)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AP4_CONFIG_HAVE_AESNI
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define AP4_CONFIG_HAVE_AESNI
+#endif
+#endif
+
+/*----------------------------------------------------------------------
+|    SIMD byte scanning (SSE2, part of the x86-64 baseline)
++---------------------------------------------------------------------*/
+#if !defined(AP4_CONFIG_NO_SSE2) && !defined(AP4_CONFIG_HAVE_SSE2)
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#define AP4_CONFIG_HAVE_SSE2
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define AP4_CONFIG_HAVE_SSE2
+#endif
+#endif
+
+/*----------------------------------------------------------------------
+|    thread local storage (used for the current allocation arena)
++---------------------------------------------------------------------*/
+#if !defined(AP4_CONFIG_NO_THREAD_LOCAL) && !defined(AP4_CONFIG_THREAD_LOCAL)
+#if defined(_MSC_VER)
+#define AP4_CONFIG_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define AP4_CONFIG_THREAD_LOCAL __thread
+#endif
+#endif
+
 /*----------------------------------------------------------------------
 |    defaults
 +---------------------------------------------------------------------*/
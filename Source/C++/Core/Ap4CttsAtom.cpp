@@ -42,23 +42,22 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_CttsAtom)
 |   AP4_CttsAtom::Create
 +---------------------------------------------------------------------*/
 AP4_CttsAtom*
-AP4_CttsAtom::Create(AP4_UI32 size, AP4_ByteStream& stream)
+AP4_CttsAtom::Create(AP4_UI32 size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version > 1) return NULL;
-    return new AP4_CttsAtom(size, version, flags, stream);
+    return new AP4_CttsAtom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
 |   AP4_CttsAtom::AP4_CttsAtom
 +---------------------------------------------------------------------*/
 AP4_CttsAtom::AP4_CttsAtom() :
-    AP4_Atom(AP4_ATOM_TYPE_CTTS, AP4_FULL_ATOM_HEADER_SIZE+4, 0, 0)
+    AP4_Atom(AP4_ATOM_TYPE_CTTS, AP4_FULL_ATOM_HEADER_SIZE+4, 0, 0),
+    m_LookupCache(0)
 {
-    m_LookupCache.sample      = 0;
-    m_LookupCache.entry_index = 0;
 }
 
 /*----------------------------------------------------------------------
@@ -67,14 +66,19 @@ AP4_CttsAtom::AP4_CttsAtom() :
 AP4_CttsAtom::AP4_CttsAtom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
-    AP4_Atom(AP4_ATOM_TYPE_CTTS, size, version, flags)
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
+    AP4_Atom(AP4_ATOM_TYPE_CTTS, size, version, flags),
+    m_LookupCache(0)
 {
-    m_LookupCache.sample      = 0;
-    m_LookupCache.entry_index = 0;
-
     AP4_UI32 entry_count;
     stream.ReadUI32(entry_count);
+    
+    // if the table is complete, we can wait until it is needed
+    if (lazy && (AP4_UI64)entry_count*8 <= size-AP4_FULL_ATOM_HEADER_SIZE-4) {
+        if (AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, entry_count*8))) return;
+    }
+    
     m_Entries.SetItemCount(entry_count);
     unsigned char* buffer = new unsigned char[entry_count*8];
     AP4_Result result = stream.Read(buffer, entry_count*8);
@@ -105,17 +109,63 @@ AP4_CttsAtom::AP4_CttsAtom(AP4_UI32        size,
     //}
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CttsAtom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_CttsAtom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+    
+    AP4_Cardinal entry_count = m_DeferredEntries.GetSize()/8;
+    m_Entries.SetItemCount(entry_count);
+    unsigned char* buffer = new unsigned char[entry_count*8];
+    AP4_Result result = m_DeferredEntries.Load(buffer);
+    if (AP4_SUCCEEDED(result)) {
+        for (unsigned i=0; i<entry_count; i++) {
+            m_Entries[i].m_SampleCount  = AP4_BytesToUInt32BE(&buffer[i*8  ]);
+            m_Entries[i].m_SampleOffset = AP4_BytesToUInt32BE(&buffer[i*8+4]);
+        }
+    }
+    delete[] buffer;
+    
+    return result;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CttsAtom::AddEntry
 +---------------------------------------------------------------------*/
 AP4_Result
 AP4_CttsAtom::AddEntry(AP4_UI32 count, AP4_UI32 cts_offset)
 {
+    LoadEntries();
     m_Entries.Append(AP4_CttsTableEntry(count, cts_offset));
     m_Size32 += 8;
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CttsAtom::UpdateIndex
++---------------------------------------------------------------------*/
+void
+AP4_CttsAtom::UpdateIndex()
+{
+    LoadEntries();
+    
+    // entries are only ever appended, so the index is up to date if it
+    // has one more item than the table
+    AP4_Cardinal entry_count = m_Entries.ItemCount();
+    if (m_EntrySampleStarts.ItemCount() == entry_count+1) return;
+    
+    m_EntrySampleStarts.SetItemCount(entry_count+1);
+    AP4_UI32 sample_start = 0;
+    for (AP4_Ordinal i=0; i<entry_count; i++) {
+        m_EntrySampleStarts[i] = sample_start;
+        sample_start += m_Entries[i].m_SampleCount;
+    }
+    m_EntrySampleStarts[entry_count] = sample_start;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CttsAtom::GetCtsOffset
 +---------------------------------------------------------------------*/
@@ -127,37 +177,41 @@ AP4_CttsAtom::GetCtsOffset(AP4_Ordinal sample, AP4_UI32& cts_offset)
     
     // sample indexes start at 1
     if (sample == 0) return AP4_ERROR_OUT_OF_RANGE;
+    --sample;
     
-    // check the lookup cache
-    AP4_Ordinal lookup_start = 0;
-    AP4_Ordinal sample_start = 0;
-    if (sample >= m_LookupCache.sample) {
-        // start from the cached entry
-        lookup_start = m_LookupCache.entry_index;
-        sample_start = m_LookupCache.sample;
+    // check that the sample is in the table
+    UpdateIndex();
+    AP4_Cardinal entry_count = m_Entries.ItemCount();
+    if (sample >= m_EntrySampleStarts[entry_count]) {
+        return AP4_ERROR_OUT_OF_RANGE;
     }
-
-    for (AP4_Ordinal i = lookup_start; i < m_Entries.ItemCount(); i++) {
-        AP4_CttsTableEntry& entry = m_Entries[i];
-
-        // check if we have reached the sample
-        if (sample <= sample_start+entry.m_SampleCount) {
-            // we are within the sample range for the current entry
-            cts_offset = entry.m_SampleOffset;
-
-            // update the lookup cache
-            m_LookupCache.entry_index = i;
-            m_LookupCache.sample      = sample_start;
-
+    
+    // check the lookup cache first, then the next entry, which covers 
+    // sequential access
+    for (AP4_Ordinal i=m_LookupCache; i<m_LookupCache+2 && i<entry_count; i++) {
+        if (sample >= m_EntrySampleStarts[i] && sample < m_EntrySampleStarts[i+1]) {
+            m_LookupCache = i;
+            cts_offset = m_Entries[i].m_SampleOffset;
             return AP4_SUCCESS;
         }
-
-        // update the upper bound
-        sample_start += entry.m_SampleCount;        
     }
 
-    // sample is greater than the number of samples
-    return AP4_ERROR_OUT_OF_RANGE;
+    // binary search for the last entry that starts at or before the sample
+    // (skipping empty entries, which start where the next one starts)
+    AP4_Ordinal lo = 0;
+    AP4_Ordinal hi = entry_count;
+    while (lo < hi) {
+        AP4_Ordinal mid = lo+(hi-lo)/2;
+        if (m_EntrySampleStarts[mid+1] <= sample) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    m_LookupCache = lo;
+    cts_offset = m_Entries[lo].m_SampleOffset;
+    
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
@@ -166,7 +220,8 @@ AP4_CttsAtom::GetCtsOffset(AP4_Ordinal sample, AP4_UI32& cts_offset)
 AP4_Result
 AP4_CttsAtom::WriteFields(AP4_ByteStream& stream)
 {
-    AP4_Result result;
+    AP4_Result result = LoadEntries();
+    if (AP4_FAILED(result)) return result;
 
     // write the entry count
     AP4_Cardinal entry_count = m_Entries.ItemCount();
@@ -193,9 +248,10 @@ AP4_CttsAtom::WriteFields(AP4_ByteStream& stream)
 AP4_Result
 AP4_CttsAtom::InspectFields(AP4_AtomInspector& inspector)
 {
-    inspector.AddField("entry_count", m_Entries.ItemCount());
+    inspector.AddField("entry_count", m_DeferredEntries.IsPending()?m_DeferredEntries.GetSize()/8:m_Entries.ItemCount());
 
     if (inspector.GetVerbosity() >= 2) {
+        LoadEntries();
         char header[32];
         char value[64];
         for (AP4_Ordinal i=0; i<m_Entries.ItemCount(); i++) {
@@ -67,7 +67,9 @@ public:
     AP4_IMPLEMENT_DYNAMIC_CAST_D(AP4_CttsAtom, AP4_Atom)
 
     // class methods
-    static AP4_CttsAtom* Create(AP4_UI32 size, AP4_ByteStream& stream);
+    static AP4_CttsAtom* Create(AP4_UI32        size, 
+                                AP4_ByteStream& stream,
+                                bool            lazy = false);
 
     // constructor
     AP4_CttsAtom();
@@ -83,14 +85,19 @@ private:
     AP4_CttsAtom(AP4_UI32        size, 
                  AP4_UI08        version,
                  AP4_UI32        flags,
-                 AP4_ByteStream& stream);
+                 AP4_ByteStream& stream,
+                 bool            lazy);
+    AP4_Result LoadEntries();
+    void       UpdateIndex();
 
     // members
     AP4_Array<AP4_CttsTableEntry> m_Entries;
-    struct {
-        AP4_Ordinal sample;
-        AP4_Ordinal entry_index;
-    } m_LookupCache;
+    AP4_DeferredAtomPayload       m_DeferredEntries;
+    
+    // index, built on demand: number of samples in all the entries before
+    // each entry (plus one entry for the whole table)
+    AP4_Array<AP4_UI32>           m_EntrySampleStarts;
+    AP4_Ordinal                   m_LookupCache;
 };
 
 #endif // _AP4_CTTS_ATOM_H_
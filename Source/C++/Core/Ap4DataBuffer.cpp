@@ -37,6 +37,7 @@
 +---------------------------------------------------------------------*/
 AP4_DataBuffer::AP4_DataBuffer() :
     m_BufferIsLocal(true),
+    m_BufferIsView(false),
     m_Buffer(NULL),
     m_BufferSize(0),
     m_DataSize(0)
@@ -48,6 +49,7 @@ AP4_DataBuffer::AP4_DataBuffer() :
 +---------------------------------------------------------------------*/
 AP4_DataBuffer::AP4_DataBuffer(AP4_Size buffer_size) :
     m_BufferIsLocal(true),
+    m_BufferIsView(false),
     m_Buffer(NULL),
     m_BufferSize(buffer_size),
     m_DataSize(0)
@@ -60,6 +62,7 @@ AP4_DataBuffer::AP4_DataBuffer(AP4_Size buffer_size) :
 +---------------------------------------------------------------------*/
 AP4_DataBuffer::AP4_DataBuffer(const void* data, AP4_Size data_size) :
     m_BufferIsLocal(true),
+    m_BufferIsView(false),
     m_Buffer(NULL),
     m_BufferSize(data_size),
     m_DataSize(data_size)
@@ -75,6 +78,7 @@ AP4_DataBuffer::AP4_DataBuffer(const void* data, AP4_Size data_size) :
 +---------------------------------------------------------------------*/
 AP4_DataBuffer::AP4_DataBuffer(const AP4_DataBuffer& other) :
     m_BufferIsLocal(true),
+    m_BufferIsView(false),
     m_Buffer(NULL),
     m_BufferSize(other.m_DataSize),
     m_DataSize(other.m_DataSize)
@@ -99,6 +103,10 @@ AP4_DataBuffer::~AP4_DataBuffer()
 AP4_Result
 AP4_DataBuffer::Reserve(AP4_Size size)
 {
+    if (m_BufferIsView) {
+        AP4_Result result = DetachView();
+        if (AP4_FAILED(result)) return result;
+    }
     if (size <= m_BufferSize) return AP4_SUCCESS;
 
     // try doubling the buffer to accomodate for the new size
@@ -120,6 +128,7 @@ AP4_DataBuffer::SetBuffer(AP4_Byte* buffer, AP4_Size buffer_size)
 
     // we're now using an external buffer
     m_BufferIsLocal = false;
+    m_BufferIsView  = false;
     m_Buffer = buffer;
     m_BufferSize = buffer_size;
 
@@ -132,6 +141,10 @@ AP4_DataBuffer::SetBuffer(AP4_Byte* buffer, AP4_Size buffer_size)
 AP4_Result
 AP4_DataBuffer::SetBufferSize(AP4_Size buffer_size)
 {
+    if (m_BufferIsView) {
+        AP4_Result result = DetachView();
+        if (AP4_FAILED(result)) return result;
+    }
     if (m_BufferIsLocal) {
         return ReallocateBuffer(buffer_size);
     } else {
@@ -146,6 +159,10 @@ AP4_DataBuffer::SetBufferSize(AP4_Size buffer_size)
 AP4_Result
 AP4_DataBuffer::SetDataSize(AP4_Size size)
 {
+    if (m_BufferIsView) {
+        AP4_Result result = DetachView();
+        if (AP4_FAILED(result)) return result;
+    }
     if (size > m_BufferSize) {
         if (m_BufferIsLocal) {
             AP4_Result result = ReallocateBuffer(size);
@@ -164,6 +181,14 @@ AP4_DataBuffer::SetDataSize(AP4_Size size)
 AP4_Result
 AP4_DataBuffer::SetData(const AP4_Byte* data, AP4_Size size)
 {
+    if (m_BufferIsView) {
+        // the current data will be replaced, so there's no need to copy it
+        m_BufferIsView  = false;
+        m_BufferIsLocal = true;
+        m_Buffer        = NULL;
+        m_BufferSize    = 0;
+        m_DataSize      = 0;
+    }
     if (size > m_BufferSize) {
         if (m_BufferIsLocal) {
             AP4_Result result = ReallocateBuffer(size);
@@ -178,6 +203,51 @@ AP4_DataBuffer::SetData(const AP4_Byte* data, AP4_Size size)
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_DataBuffer::SetView
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DataBuffer::SetView(const AP4_Byte* data, AP4_Size data_size)
+{
+    if (m_BufferIsLocal) {
+        // destroy the local buffer
+        delete[] m_Buffer;
+    }
+
+    // we're now pointing to external data that we can't modify
+    m_BufferIsLocal = false;
+    m_BufferIsView  = true;
+    m_Buffer        = const_cast<AP4_Byte*>(data);
+    m_BufferSize    = data_size;
+    m_DataSize      = data_size;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_DataBuffer::DetachView
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_DataBuffer::DetachView()
+{
+    // make a local copy of the data we're viewing
+    const AP4_Byte* data      = m_Buffer;
+    AP4_Size        data_size = m_DataSize;
+    m_BufferIsView  = false;
+    m_BufferIsLocal = true;
+    m_Buffer        = NULL;
+    m_BufferSize    = 0;
+    m_DataSize      = 0;
+    if (data_size) {
+        m_Buffer = new AP4_Byte[data_size];
+        AP4_CopyMemory(m_Buffer, data, data_size);
+        m_BufferSize = data_size;
+        m_DataSize   = data_size;
+    }
+
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_DataBuffer::AppendData
 +---------------------------------------------------------------------*/
@@ -54,24 +54,33 @@ class AP4_DataBuffer
 
     // data handling methods
     const AP4_Byte* GetData() const { return m_Buffer; }
-    AP4_Byte*       UseData() { return m_Buffer; };
+    AP4_Byte*       UseData() { if (m_BufferIsView) DetachView(); return m_Buffer; };
     AP4_Size        GetDataSize() const { return m_DataSize; }
     AP4_Result      SetDataSize(AP4_Size size);
     AP4_Result      SetData(const AP4_Byte* data, AP4_Size data_size);
     AP4_Result      AppendData(const AP4_Byte* data, AP4_Size data_size);
 
+    // view handling methods: a view points to read-only data owned by
+    // someone else (ex: a memory mapped stream), nothing is copied.
+    // Any method that needs to modify the data will first turn the view
+    // back into a local copy.
+    AP4_Result      SetView(const AP4_Byte* data, AP4_Size data_size);
+    bool            IsView() const { return m_BufferIsView; }
+
     // memory management
     AP4_Result      Reserve(AP4_Size size);
 
  protected:
     // members
     bool      m_BufferIsLocal;
+    bool      m_BufferIsView;
     AP4_Byte* m_Buffer;
     AP4_Size  m_BufferSize;
     AP4_Size  m_DataSize;
 
     // methods
     AP4_Result ReallocateBuffer(AP4_Size size);
+    AP4_Result DetachView();
 
 private:
     // forbid this
@@ -33,6 +33,7 @@
 |   includes
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
+#include "Ap4Arena.h"
 #include "Ap4DataBuffer.h"
 
 /*----------------------------------------------------------------------
@@ -47,6 +48,9 @@ class AP4_AtomInspector;
 class AP4_Expandable
 {
  public:
+    // allocation
+    AP4_IMPLEMENT_ARENA_ALLOCATION
+
     // types
     enum ClassIdSize {
         CLASS_ID_SIZE_08
@@ -0,0 +1,257 @@
+/*****************************************************************
+|
+|    AP4 - Fast Start
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4FastStart.h"
+#include "Ap4ByteStream.h"
+#include "Ap4AtomFactory.h"
+#include "Ap4MoovAtom.h"
+#include "Ap4TrakAtom.h"
+#include "Ap4ContainerAtom.h"
+#include "Ap4StcoAtom.h"
+#include "Ap4Co64Atom.h"
+#include "Ap4DataBuffer.h"
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_CopyRange
++---------------------------------------------------------------------*/
+static AP4_Result
+AP4_FastStart_CopyRange(AP4_ByteStream& input,
+                        AP4_ByteStream& output,
+                        AP4_Position    offset,
+                        AP4_LargeSize   size,
+                        AP4_DataBuffer& buffer)
+{
+    AP4_Result result = input.Seek(offset);
+    if (AP4_FAILED(result)) return result;
+    while (size) {
+        AP4_Size chunk = buffer.GetBufferSize();
+        if (size < chunk) chunk = (AP4_Size)size;
+        result = input.Read(buffer.UseData(), chunk);
+        if (AP4_FAILED(result)) return result;
+        result = output.Write(buffer.GetData(), chunk);
+        if (AP4_FAILED(result)) return result;
+        size -= chunk;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart_MoveOffset
++---------------------------------------------------------------------*/
+static AP4_UI64
+AP4_FastStart_MoveOffset(AP4_UI64      offset,
+                         AP4_Position  mdat_offset,
+                         AP4_Position  moov_offset,
+                         AP4_LargeSize old_moov_size,
+                         AP4_LargeSize new_moov_size)
+{
+    // the data between the first mdat and the old moov location moves
+    // forward by the size of the new moov, and the data after the old moov
+    // by the difference between the new and the old moov sizes
+    if (offset >= mdat_offset && offset < moov_offset) {
+        return offset+new_moov_size;
+    } else if (offset >= moov_offset+old_moov_size) {
+        return offset+new_moov_size-old_moov_size;
+    } else {
+        return offset;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FastStart::Write(AP4_ByteStream& input, AP4_ByteStream& output, bool* moved)
+{
+    AP4_Result result;
+    if (moved) *moved = false;
+    
+    AP4_LargeSize input_size = 0;
+    result = input.GetSize(input_size);
+    if (AP4_FAILED(result)) return result;
+    
+    // locate the moov atom and the first mdat atom from the atom headers
+    AP4_Position  moov_offset = 0;
+    AP4_LargeSize moov_size   = 0;
+    AP4_Position  mdat_offset = 0;
+    bool          have_moov   = false;
+    bool          have_mdat   = false;
+    AP4_Position  offset      = 0;
+    while (offset+8 <= input_size) {
+        AP4_UI32 size_32 = 0;
+        AP4_UI32 type    = 0;
+        result = input.Seek(offset);
+        if (AP4_FAILED(result)) return result;
+        result = input.ReadUI32(size_32);
+        if (AP4_FAILED(result)) return result;
+        result = input.ReadUI32(type);
+        if (AP4_FAILED(result)) return result;
+        AP4_UI64 size = size_32;
+        if (size_32 == 1) {
+            result = input.ReadUI64(size);
+            if (AP4_FAILED(result)) return result;
+        } else if (size_32 == 0) {
+            size = input_size-offset;
+        }
+        if (size < 8 || offset+size > input_size) return AP4_ERROR_INVALID_FORMAT;
+        
+        if (type == AP4_ATOM_TYPE_MOOV && !have_moov) {
+            have_moov   = true;
+            moov_offset = offset;
+            moov_size   = size;
+        } else if (type == AP4_ATOM_TYPE_MDAT && !have_mdat) {
+            have_mdat   = true;
+            mdat_offset = offset;
+        }
+        offset += size;
+    }
+    if (!have_moov) return AP4_ERROR_INVALID_FORMAT;
+    
+    AP4_DataBuffer buffer;
+    buffer.SetBufferSize(AP4_FAST_START_COPY_BUFFER_SIZE);
+    
+    // nothing to do if the moov atom is already before the media data
+    if (!have_mdat || moov_offset < mdat_offset) {
+        return AP4_FastStart_CopyRange(input, output, 0, input_size, buffer);
+    }
+    
+    // parse the moov atom
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_Atom* atom = NULL;
+    result = input.Seek(moov_offset);
+    if (AP4_FAILED(result)) return result;
+    result = atom_factory.CreateAtomFromStream(input, atom);
+    if (AP4_FAILED(result)) return result;
+    AP4_MoovAtom* moov = AP4_DYNAMIC_CAST(AP4_MoovAtom, atom);
+    if (moov == NULL) {
+        delete atom;
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+    
+    // fragment offsets are not covered by the chunk offset tables
+    if (moov->GetChild(AP4_ATOM_TYPE_MVEX)) {
+        delete moov;
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    
+    // get the original chunk offsets of all the tracks
+    AP4_Array<AP4_TrakAtom*>         traks;
+    AP4_Array<AP4_Array<AP4_UI64>* > chunk_offsets;
+    for (AP4_List<AP4_TrakAtom>::Item* item = moov->GetTrakAtoms().FirstItem();
+         item;
+         item = item->GetNext()) {
+        AP4_Array<AP4_UI64>* offsets = new AP4_Array<AP4_UI64>();
+        traks.Append(item->GetData());
+        chunk_offsets.Append(offsets);
+        result = item->GetData()->GetChunkOffsets(*offsets);
+        if (AP4_FAILED(result)) goto end;
+    }
+    
+    // the new moov atom grows each time an stco table has to be promoted
+    // to co64, which moves the media data further
+    for (bool promoted = true; promoted; ) {
+        promoted = false;
+        AP4_LargeSize new_moov_size = moov->GetSize();
+        for (unsigned int t=0; t<traks.ItemCount(); t++) {
+            AP4_StcoAtom* stco = AP4_DYNAMIC_CAST(AP4_StcoAtom, traks[t]->FindChild("mdia/minf/stbl/stco"));
+            if (stco == NULL) continue;
+            AP4_Array<AP4_UI64>& offsets = *chunk_offsets[t];
+            bool fits = true;
+            for (unsigned int i=0; i<offsets.ItemCount(); i++) {
+                if (AP4_FastStart_MoveOffset(offsets[i],
+                                             mdat_offset,
+                                             moov_offset,
+                                             moov_size,
+                                             new_moov_size) > 0xFFFFFFFF) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) continue;
+            
+            // replace the stco atom with a co64 atom at the same position
+            AP4_ContainerAtom* stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, stco->GetParent());
+            if (stbl == NULL) {
+                result = AP4_ERROR_INTERNAL;
+                goto end;
+            }
+            int position = 0;
+            for (AP4_List<AP4_Atom>::Item* child = stbl->GetChildren().FirstItem();
+                 child && child->GetData() != stco;
+                 child = child->GetNext()) {
+                ++position;
+            }
+            AP4_Co64Atom* co64 = new AP4_Co64Atom(offsets.ItemCount()?&offsets[0]:NULL, offsets.ItemCount());
+            stbl->RemoveChild(stco);
+            delete stco;
+            stbl->AddChild(co64, position);
+            promoted = true;
+        }
+    }
+    
+    // shift the chunk offsets
+    {
+        AP4_LargeSize new_moov_size = moov->GetSize();
+        for (unsigned int t=0; t<traks.ItemCount(); t++) {
+            AP4_Array<AP4_UI64>& offsets = *chunk_offsets[t];
+            for (unsigned int i=0; i<offsets.ItemCount(); i++) {
+                offsets[i] = AP4_FastStart_MoveOffset(offsets[i],
+                                                      mdat_offset,
+                                                      moov_offset,
+                                                      moov_size,
+                                                      new_moov_size);
+            }
+            result = traks[t]->SetChunkOffsets(offsets);
+            if (AP4_FAILED(result)) goto end;
+        }
+    }
+    
+    // everything before the first mdat, the new moov, and then the rest
+    // of the file without the old moov
+    result = AP4_FastStart_CopyRange(input, output, 0, mdat_offset, buffer);
+    if (AP4_FAILED(result)) goto end;
+    result = moov->Write(output);
+    if (AP4_FAILED(result)) goto end;
+    result = AP4_FastStart_CopyRange(input, output, mdat_offset, moov_offset-mdat_offset, buffer);
+    if (AP4_FAILED(result)) goto end;
+    result = AP4_FastStart_CopyRange(input, output, moov_offset+moov_size, input_size-(moov_offset+moov_size), buffer);
+    if (AP4_FAILED(result)) goto end;
+    if (moved) *moved = true;
+    
+end:
+    for (unsigned int i=0; i<chunk_offsets.ItemCount(); i++) {
+        delete chunk_offsets[i];
+    }
+    delete moov;
+    
+    return result;
+}
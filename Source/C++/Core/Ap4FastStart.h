@@ -0,0 +1,77 @@
+/*****************************************************************
+|
+|    AP4 - Fast Start
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_FAST_START_H_
+#define _AP4_FAST_START_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_Size AP4_FAST_START_COPY_BUFFER_SIZE = 1024*1024;
+
+/*----------------------------------------------------------------------
+|   AP4_FastStart
++---------------------------------------------------------------------*/
+/**
+ * Rewrites a file so that its moov atom comes before its media data,
+ * for progressive download. Only the top-level atom headers and the
+ * moov atom are parsed: the moov is inserted before the first mdat, the
+ * chunk offsets that point past the insertion point are shifted (stco
+ * tables are promoted to co64 if needed), and all the other bytes of the
+ * file are copied unchanged, in large sequential blocks.
+ */
+class AP4_FastStart {
+public:
+    // class methods
+    /**
+     * Copy input to output with the moov atom moved before the first
+     * mdat atom. If the moov atom is already there, the input is copied
+     * as is.
+     *
+     * @param moved: if not NULL, set to true if the moov atom was moved.
+     */
+    static AP4_Result Write(AP4_ByteStream& input, 
+                            AP4_ByteStream& output,
+                            bool*           moved = NULL);
+
+private:
+    // don't instantiate this class
+    AP4_FastStart() {}
+};
+
+#endif // _AP4_FAST_START_H_
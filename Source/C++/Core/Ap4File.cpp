@@ -61,6 +61,9 @@ AP4_File::AP4_File(AP4_ByteStream&  stream,
     m_MetaData(NULL),
     m_MoovIsBeforeMdat(true)
 {
+    // allocate the atom tree and the movie from the factory's arena, if any
+    AP4_ArenaScope arena_scope(atom_factory.GetArena());
+    
     // parse top-level atoms
     AP4_Atom*    atom;
     AP4_Position stream_position;
@@ -46,7 +46,8 @@ public:
     typedef enum {
         STREAM_MODE_READ        = 0,
         STREAM_MODE_WRITE       = 1,
-        STREAM_MODE_READ_WRITE  = 2
+        STREAM_MODE_READ_WRITE  = 2,
+        STREAM_MODE_READ_MAPPED = 3  // read-only, memory mapped when the platform supports it
     } Mode;
 
     /**
@@ -82,10 +83,34 @@ public:
                             AP4_Size&   bytesWritten) {
         return m_Delegate->WritePartial(buffer, bytesToWrite, bytesWritten);
     }
+    AP4_Result ReadvPartial(const AP4_IoVector* vectors,
+                            AP4_Cardinal        vector_count,
+                            AP4_Size&           bytes_read) {
+        return m_Delegate->ReadvPartial(vectors, vector_count, bytes_read);
+    }
+    AP4_Result WritevPartial(const AP4_IoVector* vectors,
+                             AP4_Cardinal        vector_count,
+                             AP4_Size&           bytes_written) {
+        return m_Delegate->WritevPartial(vectors, vector_count, bytes_written);
+    }
     AP4_Result Seek(AP4_Position position)  { return m_Delegate->Seek(position); }
     AP4_Result Tell(AP4_Position& position) { return m_Delegate->Tell(position); }
     AP4_Result GetSize(AP4_LargeSize& size) { return m_Delegate->GetSize(size);  }
     AP4_Result Flush()                      { return m_Delegate->Flush();        }
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read) {
+        return m_Delegate->ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+    }
+    AP4_Result Prefetch(AP4_Position position, AP4_LargeSize size) {
+        return m_Delegate->Prefetch(position, size);
+    }
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data) {
+        return m_Delegate->Borrow(position, size, data);
+    }
 
     // AP4_Referenceable methods
     void AddReference() { m_Delegate->AddReference(); }
@@ -101,6 +126,21 @@ protected:
     AP4_ByteStream* m_Delegate;
 };
 
+/*----------------------------------------------------------------------
+|   AP4_System_CreateMappedFileByteStream
++---------------------------------------------------------------------*/
+#if defined(AP4_CONFIG_HAVE_MMAP)
+/**
+ * Create a read-only stream backed by a memory mapping of a file.
+ * This is implemented by the platform-specific System layer, and used
+ * by AP4_FileByteStream::Create for STREAM_MODE_READ_MAPPED.
+ */
+AP4_Result
+AP4_System_CreateMappedFileByteStream(AP4_FileByteStream* delegator,
+                                      const char*         name,
+                                      AP4_ByteStream*&    stream);
+#endif
+
 #endif // _AP4_FILE_BYTE_STREAM_H_
 
 
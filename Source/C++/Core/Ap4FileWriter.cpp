@@ -39,12 +39,99 @@
 #include "Ap4DataBuffer.h"
 #include "Ap4FtypAtom.h"
 #include "Ap4SampleTable.h"
+#include "Ap4ContainerAtom.h"
+#include "Ap4StscAtom.h"
+#include "Ap4StcoAtom.h"
+#include "Ap4Co64Atom.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriterChunk
++---------------------------------------------------------------------*/
+struct AP4_FileWriterChunk {
+    AP4_Ordinal  m_TrackIndex;
+    AP4_Ordinal  m_FirstSample;
+    AP4_Cardinal m_SampleCount;
+    AP4_Ordinal  m_SampleDescriptionIndex;
+    AP4_UI64     m_StartTime; // microseconds
+    AP4_UI64     m_Size;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriterChunkTable
+|
+|   Replacement stsc and stco/co64 atoms for one track, and the atoms
+|   they temporarily replace in the track's stbl.
++---------------------------------------------------------------------*/
+struct AP4_FileWriterChunkTable {
+    AP4_FileWriterChunkTable() : 
+        m_Stbl(NULL), 
+        m_OldStsc(NULL), m_OldStco(NULL), 
+        m_NewStsc(NULL), m_NewStco(NULL),
+        m_StscPosition(0), m_StcoPosition(0) {}
+    AP4_ContainerAtom* m_Stbl;
+    AP4_Atom*          m_OldStsc;
+    AP4_Atom*          m_OldStco;
+    AP4_Atom*          m_NewStsc;
+    AP4_Atom*          m_NewStco;
+    int                m_StscPosition;
+    int                m_StcoPosition;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter_GetChildPosition
++---------------------------------------------------------------------*/
+static int
+AP4_FileWriter_GetChildPosition(AP4_ContainerAtom* parent, AP4_Atom* child)
+{
+    int position = 0;
+    for (AP4_List<AP4_Atom>::Item* item = parent->GetChildren().FirstItem();
+         item;
+         item = item->GetNext(), ++position) {
+        if (item->GetData() == child) return position;
+    }
+    return -1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter_SwapChild
++---------------------------------------------------------------------*/
+static void
+AP4_FileWriter_SwapChild(AP4_ContainerAtom* parent, 
+                         AP4_Atom*          current, 
+                         AP4_Atom*          replacement, 
+                         int                position)
+{
+    parent->RemoveChild(current);
+    parent->AddChild(replacement, position);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter_RestoreChunkTables
++---------------------------------------------------------------------*/
+static void
+AP4_FileWriter_RestoreChunkTables(AP4_Array<AP4_FileWriterChunkTable>& chunk_tables)
+{
+    for (unsigned int t=0; t<chunk_tables.ItemCount(); t++) {
+        AP4_FileWriterChunkTable& table = chunk_tables[t];
+        if (table.m_NewStsc == NULL) continue;
+        AP4_FileWriter_SwapChild(table.m_Stbl, table.m_NewStco, table.m_OldStco, table.m_StcoPosition);
+        AP4_FileWriter_SwapChild(table.m_Stbl, table.m_NewStsc, table.m_OldStsc, table.m_StscPosition);
+        delete table.m_NewStsc;
+        delete table.m_NewStco;
+        table.m_NewStsc = NULL;
+        table.m_NewStco = NULL;
+    }
+}
 
 /*----------------------------------------------------------------------
 |   AP4_FileWriter::Write
 +---------------------------------------------------------------------*/
 AP4_Result
-AP4_FileWriter::Write(AP4_File& file, AP4_ByteStream& stream, Interleaving /* interleaving */)
+AP4_FileWriter::Write(AP4_File&       file, 
+                      AP4_ByteStream& stream, 
+                      Interleaving    interleaving,
+                      AP4_UI32        chunk_duration)
 {
     // get the file type
     AP4_FtypAtom* file_type = file.GetFileType();
@@ -68,6 +155,10 @@ AP4_FileWriter::Write(AP4_File& file, AP4_ByteStream& stream, Interleaving /* in
     AP4_Movie* movie = file.GetMovie();
     if (movie == NULL) return AP4_SUCCESS;
 
+    if (interleaving == INTERLEAVING_TIME) {
+        return WriteInterleaved(*movie, stream, chunk_duration);
+    }
+    
     // see how much we've written so far
     AP4_Position position;
     stream.Tell(position);
@@ -148,3 +239,192 @@ end:
     
     return result;
 }
+
+/*----------------------------------------------------------------------
+|   AP4_FileWriter::WriteInterleaved
+|
+|   The samples of each track are regrouped into chunks of at most
+|   chunk_duration ms, and the chunks of all the tracks are laid out in
+|   the mdat in order of their start time, so that the output can be
+|   read sequentially. The new stsc and stco/co64 atoms are only swapped
+|   into the tracks while the moov atom is written.
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_FileWriter::WriteInterleaved(AP4_Movie&      movie, 
+                                 AP4_ByteStream& stream, 
+                                 AP4_UI32        chunk_duration)
+{
+    AP4_Result result = AP4_SUCCESS;
+    if (chunk_duration == 0) chunk_duration = AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION;
+    
+    // see how much we've written so far
+    AP4_Position position;
+    stream.Tell(position);
+
+    // split the samples of each track into chunks
+    AP4_Array<AP4_Track*>               tracks;
+    AP4_Array<AP4_FileWriterChunk>      chunks;
+    AP4_Array<AP4_Ordinal>              track_first_chunk;
+    AP4_Array<AP4_FileWriterChunkTable> chunk_tables;
+    for (AP4_List<AP4_Track>::Item* track_item = movie.GetTracks().FirstItem();
+         track_item;
+         track_item = track_item->GetNext()) {
+        AP4_Track* track = track_item->GetData();
+        tracks.Append(track);
+        track_first_chunk.Append(chunks.ItemCount());
+        
+        AP4_UI32 timescale = track->GetMediaTimeScale();
+        if (timescale == 0) timescale = 1000;
+        AP4_UI64 max_chunk_duration = AP4_ConvertTime(chunk_duration, 1000, timescale);
+        if (max_chunk_duration == 0) max_chunk_duration = 1;
+        
+        AP4_FileWriterChunk chunk;
+        AP4_UI64            chunk_start_dts = 0;
+        AP4_Cardinal        sample_count = track->GetSampleCount();
+        AP4_Sample          sample;
+        chunk.m_SampleCount = 0;
+        for (AP4_Ordinal i=0; i<sample_count; i++) {
+            result = track->GetSample(i, sample);
+            if (AP4_FAILED(result)) return result;
+            if (chunk.m_SampleCount &&
+                (sample.GetDescriptionIndex() != chunk.m_SampleDescriptionIndex ||
+                 sample.GetDts() >= chunk_start_dts+max_chunk_duration)) {
+                chunks.Append(chunk);
+                chunk.m_SampleCount = 0;
+            }
+            if (chunk.m_SampleCount == 0) {
+                chunk_start_dts                = sample.GetDts();
+                chunk.m_TrackIndex             = tracks.ItemCount()-1;
+                chunk.m_FirstSample            = i;
+                chunk.m_SampleDescriptionIndex = sample.GetDescriptionIndex();
+                chunk.m_StartTime              = AP4_ConvertTime(chunk_start_dts, timescale, 1000000);
+                chunk.m_Size                   = 0;
+            }
+            ++chunk.m_SampleCount;
+            chunk.m_Size += sample.GetSize();
+        }
+        if (chunk.m_SampleCount) chunks.Append(chunk);
+    }
+    track_first_chunk.Append(chunks.ItemCount());
+    
+    // create the new chunk tables and swap them in
+    chunk_tables.SetItemCount(tracks.ItemCount());
+    for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+        AP4_FileWriterChunkTable& table = chunk_tables[t];
+        table.m_Stbl = AP4_DYNAMIC_CAST(AP4_ContainerAtom, tracks[t]->UseTrakAtom()->FindChild("mdia/minf/stbl"));
+        if (table.m_Stbl == NULL) {
+            result = AP4_ERROR_INVALID_FORMAT;
+            goto end;
+        }
+        table.m_OldStsc = table.m_Stbl->GetChild(AP4_ATOM_TYPE_STSC);
+        table.m_OldStco = table.m_Stbl->GetChild(AP4_ATOM_TYPE_STCO);
+        if (table.m_OldStco == NULL) table.m_OldStco = table.m_Stbl->GetChild(AP4_ATOM_TYPE_CO64);
+        if (table.m_OldStsc == NULL || table.m_OldStco == NULL) {
+            table.m_OldStsc = table.m_OldStco = NULL;
+            result = AP4_ERROR_INVALID_FORMAT;
+            goto end;
+        }
+        
+        // sample to chunk table, with runs of identical chunks merged
+        AP4_StscAtom* stsc = new AP4_StscAtom();
+        AP4_Ordinal   first_chunk = track_first_chunk[t];
+        AP4_Cardinal  chunk_count = track_first_chunk[t+1]-first_chunk;
+        for (AP4_Ordinal i=first_chunk; i<first_chunk+chunk_count; ) {
+            AP4_Ordinal run_end = i+1;
+            while (run_end < first_chunk+chunk_count &&
+                   chunks[run_end].m_SampleCount            == chunks[i].m_SampleCount &&
+                   chunks[run_end].m_SampleDescriptionIndex == chunks[i].m_SampleDescriptionIndex) {
+                ++run_end;
+            }
+            stsc->AddEntry(run_end-i, chunks[i].m_SampleCount, chunks[i].m_SampleDescriptionIndex+1);
+            i = run_end;
+        }
+        table.m_NewStsc = stsc;
+        
+        // chunk offsets, of the same width as before, filled in below
+        if (table.m_OldStco->GetType() == AP4_ATOM_TYPE_STCO) {
+            AP4_Array<AP4_UI32> offsets;
+            offsets.SetItemCount(chunk_count);
+            table.m_NewStco = new AP4_StcoAtom(chunk_count?&offsets[0]:NULL, chunk_count);
+        } else {
+            AP4_Array<AP4_UI64> offsets;
+            offsets.SetItemCount(chunk_count);
+            table.m_NewStco = new AP4_Co64Atom(chunk_count?&offsets[0]:NULL, chunk_count);
+        }
+        
+        table.m_StscPosition = AP4_FileWriter_GetChildPosition(table.m_Stbl, table.m_OldStsc);
+        AP4_FileWriter_SwapChild(table.m_Stbl, table.m_OldStsc, table.m_NewStsc, table.m_StscPosition);
+        table.m_StcoPosition = AP4_FileWriter_GetChildPosition(table.m_Stbl, table.m_OldStco);
+        AP4_FileWriter_SwapChild(table.m_Stbl, table.m_OldStco, table.m_NewStco, table.m_StcoPosition);
+    }
+    
+    {
+        // order the chunks of all tracks by start time and compute their offsets
+        AP4_Array<AP4_Ordinal> chunk_order;
+        AP4_Array<AP4_UI64>    chunk_offsets;
+        AP4_Array<AP4_Ordinal> next_chunk;
+        AP4_UI64               mdat_size = AP4_ATOM_HEADER_SIZE;
+        AP4_UI64               mdat_position = position+movie.GetMoovAtom()->GetSize();
+        chunk_offsets.SetItemCount(chunks.ItemCount());
+        next_chunk.SetItemCount(tracks.ItemCount());
+        for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+            next_chunk[t] = track_first_chunk[t];
+        }
+        for (;;) {
+            int best = -1;
+            for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+                if (next_chunk[t] == track_first_chunk[t+1]) continue;
+                if (best < 0 || chunks[next_chunk[t]].m_StartTime < chunks[next_chunk[best]].m_StartTime) {
+                    best = (int)t;
+                }
+            }
+            if (best < 0) break;
+            AP4_Ordinal c = next_chunk[best]++;
+            chunk_order.Append(c);
+            chunk_offsets[c] = mdat_position+mdat_size;
+            mdat_size += chunks[c].m_Size;
+        }
+        for (unsigned int t=0; t<tracks.ItemCount(); t++) {
+            AP4_Array<AP4_UI64> track_offsets;
+            AP4_Cardinal chunk_count = track_first_chunk[t+1]-track_first_chunk[t];
+            track_offsets.SetItemCount(chunk_count);
+            for (unsigned int i=0; i<chunk_count; i++) {
+                track_offsets[i] = chunk_offsets[track_first_chunk[t]+i];
+            }
+            result = tracks[t]->UseTrakAtom()->SetChunkOffsets(track_offsets);
+            if (AP4_FAILED(result)) goto end;
+        }
+        
+        // write the moov atom
+        result = movie.GetMoovAtom()->Write(stream);
+        if (AP4_FAILED(result)) goto end;
+        
+        // restore the original tables before reading any sample
+        AP4_FileWriter_RestoreChunkTables(chunk_tables);
+        
+        // create and write the media data (mdat)
+        // FIXME: this only supports 32-bit mdat size
+        stream.WriteUI32((AP4_UI32)mdat_size);
+        stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
+        
+        // write the chunks in order
+        AP4_Sample     sample;
+        AP4_DataBuffer sample_data;
+        for (unsigned int i=0; i<chunk_order.ItemCount(); i++) {
+            const AP4_FileWriterChunk& chunk = chunks[chunk_order[i]];
+            AP4_Track* track = tracks[chunk.m_TrackIndex];
+            for (AP4_Ordinal s=chunk.m_FirstSample; s<chunk.m_FirstSample+chunk.m_SampleCount; s++) {
+                result = track->ReadSample(s, sample, sample_data);
+                if (AP4_FAILED(result)) return result;
+                result = stream.Write(sample_data.GetData(), sample_data.GetDataSize());
+                if (AP4_FAILED(result)) return result;
+            }
+        }
+    }
+    
+end:
+    // restore the original tables if we bailed out early
+    AP4_FileWriter_RestoreChunkTables(chunk_tables);
+    
+    return result;
+}
@@ -39,6 +39,12 @@
 +---------------------------------------------------------------------*/
 class AP4_ByteStream;
 class AP4_File;
+class AP4_Movie;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI32 AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION = 500; // ms
 
 /*----------------------------------------------------------------------
 |   AP4_FileWriter
@@ -47,15 +53,22 @@ class AP4_FileWriter {
 public:
     // types
     typedef enum {
-        INTERLEAVING_SEQUENTIAL
+        INTERLEAVING_SEQUENTIAL, // all the samples of a track, one track after the other
+        INTERLEAVING_TIME        // chunks of at most chunk_duration ms, ordered by time
     } Interleaving;
     
     // class methods
     static AP4_Result Write(AP4_File&       file, 
                             AP4_ByteStream& stream, 
-                            Interleaving    interleaving = INTERLEAVING_SEQUENTIAL);
+                            Interleaving    interleaving = INTERLEAVING_SEQUENTIAL,
+                            AP4_UI32        chunk_duration = AP4_FILE_WRITER_DEFAULT_CHUNK_DURATION);
                             
 private:
+    // class methods
+    static AP4_Result WriteInterleaved(AP4_Movie&      movie,
+                                       AP4_ByteStream& stream,
+                                       AP4_UI32        chunk_duration);
+
     // don't instantiate this class
     AP4_FileWriter() {}
 };
@@ -0,0 +1,899 @@
+/*****************************************************************
+|
+|    AP4 - Fragmenter
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Fragmenter.h"
+#include "Ap4File.h"
+#include "Ap4Movie.h"
+#include "Ap4Track.h"
+#include "Ap4Sample.h"
+#include "Ap4DataBuffer.h"
+#include "Ap4ByteStream.h"
+#include "Ap4AtomFactory.h"
+#include "Ap4ContainerAtom.h"
+#include "Ap4FtypAtom.h"
+#include "Ap4MoovAtom.h"
+#include "Ap4MehdAtom.h"
+#include "Ap4TrexAtom.h"
+#include "Ap4MfhdAtom.h"
+#include "Ap4TfhdAtom.h"
+#include "Ap4TfdtAtom.h"
+#include "Ap4TrunAtom.h"
+#include "Ap4TfraAtom.h"
+#include "Ap4MfroAtom.h"
+#include "Ap4SidxAtom.h"
+#include "Ap4SyntheticSampleTable.h"
+#include "Ap4LinearReader.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_FragmenterSampleArray
++---------------------------------------------------------------------*/
+class AP4_FragmenterSampleArray {
+public:
+    AP4_FragmenterSampleArray(AP4_Track* track) :
+        m_Track(track) {
+        m_SampleCount = m_Track->GetSampleCount();
+    }
+    virtual ~AP4_FragmenterSampleArray() {}
+
+    virtual AP4_Cardinal GetSampleCount() {
+        return m_SampleCount;
+    }
+    virtual AP4_Result GetSample(AP4_Ordinal index, AP4_Sample& sample) {
+        return m_Track->GetSample(index, sample);
+    }
+    virtual AP4_Result AddSample(AP4_Sample& /*sample*/) {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+
+protected:
+    AP4_Track*   m_Track;
+    AP4_Cardinal m_SampleCount;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_FragmenterCachedSampleArray
++---------------------------------------------------------------------*/
+class AP4_FragmenterCachedSampleArray : public AP4_FragmenterSampleArray {
+public:
+    AP4_FragmenterCachedSampleArray(AP4_Track* track) :
+        AP4_FragmenterSampleArray(track) {}
+
+    virtual AP4_Cardinal GetSampleCount() {
+        return m_Samples.ItemCount();
+    }
+    virtual AP4_Result GetSample(AP4_Ordinal index, AP4_Sample& sample) {
+        if (index >= m_Samples.ItemCount()) {
+            return AP4_ERROR_OUT_OF_RANGE;
+        } else {
+            sample = m_Samples[index];
+            return AP4_SUCCESS;
+        }
+    }
+    virtual AP4_Result AddSample(AP4_Sample& sample) {
+        return m_Samples.Append(sample);
+    }
+
+protected:
+    AP4_Array<AP4_Sample> m_Samples;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::TrackCursor
++---------------------------------------------------------------------*/
+class AP4_Fragmenter::TrackCursor
+{
+public:
+    TrackCursor(AP4_Track* track, AP4_FragmenterSampleArray* samples);
+    ~TrackCursor();
+
+    AP4_Result    Init();
+    AP4_Result    SetSampleIndex(AP4_Ordinal sample_index);
+
+    AP4_Track*                 m_Track;
+    AP4_FragmenterSampleArray* m_Samples;
+    AP4_Ordinal                m_SampleIndex;
+    AP4_Ordinal                m_FragmentIndex;
+    AP4_Sample                 m_Sample;
+    AP4_UI64                   m_Timestamp;
+    bool                       m_Eos;
+    AP4_TfraAtom*              m_Tfra;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::TrackCursor::TrackCursor
++---------------------------------------------------------------------*/
+AP4_Fragmenter::TrackCursor::TrackCursor(AP4_Track* track, AP4_FragmenterSampleArray* samples) :
+    m_Track(track),
+    m_Samples(samples),
+    m_SampleIndex(0),
+    m_FragmentIndex(0),
+    m_Timestamp(0),
+    m_Eos(false),
+    m_Tfra(new AP4_TfraAtom(0))
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::TrackCursor::~TrackCursor
++---------------------------------------------------------------------*/
+AP4_Fragmenter::TrackCursor::~TrackCursor()
+{
+    delete m_Tfra;
+    delete m_Samples;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::TrackCursor::Init
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Fragmenter::TrackCursor::Init()
+{
+    return m_Samples->GetSample(0, m_Sample);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::TrackCursor::SetSampleIndex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Fragmenter::TrackCursor::SetSampleIndex(AP4_Ordinal sample_index)
+{
+    m_SampleIndex = sample_index;
+
+    // check if we're at the end
+    if (sample_index >= m_Samples->GetSampleCount()) {
+        AP4_UI64 end_dts = m_Sample.GetDts()+m_Sample.GetDuration();
+        m_Sample.Reset();
+        m_Sample.SetDts(end_dts);
+        m_Eos = true;
+    } else {
+        return m_Samples->GetSample(m_SampleIndex, m_Sample);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_FragmenterFragmentInfo
++---------------------------------------------------------------------*/
+class AP4_FragmenterFragmentInfo {
+public:
+    AP4_FragmenterFragmentInfo(AP4_FragmenterSampleArray* samples,
+                               AP4_TfraAtom*              tfra,
+                               AP4_UI64                   timestamp,
+                               AP4_ContainerAtom*         moof) :
+        m_Samples(samples),
+        m_Tfra(tfra),
+        m_Timestamp(timestamp),
+        m_Duration(0),
+        m_Moof(moof),
+        m_MoofPosition(0),
+        m_MdatSize(0) {}
+    ~AP4_FragmenterFragmentInfo() { delete m_Moof; }
+
+    AP4_FragmenterSampleArray* m_Samples;
+    AP4_TfraAtom*              m_Tfra;
+    AP4_UI64                   m_Timestamp;
+    AP4_UI32                   m_Duration;
+    AP4_Array<AP4_UI32>        m_SampleIndexes;
+    AP4_ContainerAtom*         m_Moof;
+    AP4_Position               m_MoofPosition;
+    AP4_UI32                   m_MdatSize;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::AP4_Fragmenter
++---------------------------------------------------------------------*/
+AP4_Fragmenter::AP4_Fragmenter(AP4_File& input_file, AP4_ByteStream& input_stream) :
+    m_InputFile(input_file),
+    m_InputStream(input_stream),
+    m_FragmentDuration(AP4_FRAGMENTER_DEFAULT_FRAGMENT_DURATION),
+    m_Timescale(0),
+    m_TrackId(0),
+    m_CreateSegmentIndex(false),
+    m_CreateTfdt(true),
+    m_Trim(false),
+    m_Done(false),
+    m_Listener(NULL)
+{
+    AP4_Movie* movie = input_file.GetMovie();
+    if (movie == NULL) return;
+
+    // create a cursor for each track that we can read from
+    for (AP4_List<AP4_Track>::Item* track_item = movie->GetTracks().FirstItem();
+                                    track_item;
+                                    track_item = track_item->GetNext()) {
+        AP4_Track* track = track_item->GetData();
+
+        // skip tracks with no samples
+        if (track->GetSampleCount() == 0 && !movie->HasFragments()) continue;
+
+        // create a sample array for this track
+        AP4_FragmenterSampleArray* sample_array;
+        if (movie->HasFragments()) {
+            sample_array = new AP4_FragmenterCachedSampleArray(track);
+        } else {
+            sample_array = new AP4_FragmenterSampleArray(track);
+        }
+
+        // create a cursor for the track
+        TrackCursor* cursor = new TrackCursor(track, sample_array);
+        cursor->m_Tfra->SetTrackId(track->GetId());
+        m_Cursors.Append(cursor);
+    }
+
+    // for fragmented input files, we need to populate the sample arrays
+    if (movie->HasFragments()) {
+        // remember where the stream was
+        AP4_Position position;
+        input_stream.Tell(position);
+
+        AP4_LinearReader reader(*movie, &input_stream);
+        for (unsigned int i=0; i<m_Cursors.ItemCount(); i++) {
+            reader.EnableTrack(m_Cursors[i]->m_Track->GetId());
+        }
+        AP4_UI32   track_id;
+        AP4_Sample sample;
+        AP4_Result result;
+        do {
+            result = reader.GetNextSample(sample, track_id);
+            if (AP4_SUCCEEDED(result)) {
+                for (unsigned int i=0; i<m_Cursors.ItemCount(); i++) {
+                    if (m_Cursors[i]->m_Track->GetId() == track_id) {
+                        m_Cursors[i]->m_Samples->AddSample(sample);
+                        break;
+                    }
+                }
+            }
+        } while (AP4_SUCCEEDED(result));
+
+        // return the stream to its original position
+        input_stream.Seek(position);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::~AP4_Fragmenter
++---------------------------------------------------------------------*/
+AP4_Fragmenter::~AP4_Fragmenter()
+{
+    for (unsigned int i=0; i<m_Cursors.ItemCount(); i++) {
+        delete m_Cursors[i];
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::GetTrack
++---------------------------------------------------------------------*/
+AP4_Track*
+AP4_Fragmenter::GetTrack(AP4_Ordinal index)
+{
+    if (index >= m_Cursors.ItemCount()) return NULL;
+    return m_Cursors[index]->m_Track;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::AutoDetectFragmentDuration
++---------------------------------------------------------------------*/
+unsigned int
+AP4_Fragmenter::AutoDetectFragmentDuration()
+{
+    TrackCursor* video_cursor = NULL;
+    TrackCursor* audio_cursor = NULL;
+    for (unsigned int i=0; i<m_Cursors.ItemCount(); i++) {
+        AP4_Track::Type type = m_Cursors[i]->m_Track->GetType();
+        if (type == AP4_Track::TYPE_VIDEO && video_cursor == NULL) {
+            video_cursor = m_Cursors[i];
+        } else if (type == AP4_Track::TYPE_AUDIO && audio_cursor == NULL) {
+            audio_cursor = m_Cursors[i];
+        }
+    }
+
+    if (video_cursor) {
+        return AutoDetectVideoFragmentDuration(video_cursor);
+    } else if (audio_cursor && m_InputFile.GetMovie()->HasFragments()) {
+        return AutoDetectAudioFragmentDuration(audio_cursor);
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::AutoDetectVideoFragmentDuration
++---------------------------------------------------------------------*/
+unsigned int
+AP4_Fragmenter::AutoDetectVideoFragmentDuration(TrackCursor* cursor)
+{
+    AP4_Sample   sample;
+    unsigned int sample_count = cursor->m_Samples->GetSampleCount();
+
+    // get the first sample as the starting point (it must be an I frame)
+    AP4_Result result = cursor->m_Samples->GetSample(0, sample);
+    if (AP4_FAILED(result)) return 0;
+    if (!sample.IsSync()) return 0;
+
+    for (unsigned int interval = 1; interval < sample_count; interval++) {
+        bool irregular = false;
+        unsigned int sync_count = 0;
+        unsigned int i;
+        for (i = 0; i < sample_count; i += interval) {
+            result = cursor->m_Samples->GetSample(i, sample);
+            if (AP4_FAILED(result)) return 0;
+            if (!sample.IsSync()) {
+                irregular = true;
+                break;
+            }
+            ++sync_count;
+        }
+        if (sync_count < 1) continue;
+        if (!irregular) {
+            // found a pattern
+            AP4_UI64 duration = sample.GetDts();
+            double fps = (double)(interval*(sync_count-1))/((double)duration/(double)cursor->m_Track->GetMediaTimeScale());
+            if (m_Listener) m_Listener->OnSyncIntervalDetected(interval, fps);
+            return (unsigned int)(1000.0*(double)interval/fps);
+        }
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::AutoDetectAudioFragmentDuration
++---------------------------------------------------------------------*/
+unsigned int
+AP4_Fragmenter::AutoDetectAudioFragmentDuration(TrackCursor* cursor)
+{
+    // remember where we are in the stream
+    AP4_Position where = 0;
+    m_InputStream.Tell(where);
+    AP4_LargeSize stream_size = 0;
+    m_InputStream.GetSize(stream_size);
+    AP4_LargeSize bytes_available = stream_size-where;
+
+    // parse with a private factory, the fragmenter may be used by more
+    // than one thread at a time
+    AP4_DefaultAtomFactory atom_factory;
+    AP4_UI64  fragment_count = 0;
+    AP4_UI32  last_fragment_size = 0;
+    AP4_Atom* atom = NULL;
+    while (AP4_SUCCEEDED(atom_factory.CreateAtomFromStream(m_InputStream, bytes_available, atom))) {
+        if (atom && atom->GetType() == AP4_ATOM_TYPE_MOOF) {
+            AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+            AP4_TfhdAtom* tfhd = AP4_DYNAMIC_CAST(AP4_TfhdAtom, moof->FindChild("traf/tfhd"));
+            if (tfhd && tfhd->GetTrackId() == cursor->m_Track->GetId()) {
+                ++fragment_count;
+                AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, moof->FindChild("traf/trun"));
+                if (trun) {
+                    last_fragment_size = trun->GetEntries().ItemCount();
+                }
+            }
+        }
+        delete atom;
+        atom = NULL;
+    }
+
+    // restore the stream to its original position
+    m_InputStream.Seek(where);
+
+    // decide if we can infer an fragment size
+    if (fragment_count == 0 || cursor->m_Samples->GetSampleCount() == 0) {
+        return 0;
+    }
+    // don't count the last fragment if we have more than one
+    if (fragment_count > 1 && last_fragment_size) {
+        --fragment_count;
+    }
+    if (fragment_count <= 1 || cursor->m_Samples->GetSampleCount() < last_fragment_size) {
+        last_fragment_size = 0;
+    }
+    AP4_Sample sample;
+    AP4_UI64 total_duration = 0;
+    for (unsigned int i=0; i<cursor->m_Samples->GetSampleCount()-last_fragment_size; i++) {
+        cursor->m_Samples->GetSample(i, sample);
+        total_duration += sample.GetDuration();
+    }
+    return (unsigned int)AP4_ConvertTime(total_duration/fragment_count, cursor->m_Track->GetMediaTimeScale(), 1000);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter::Fragment
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Fragmenter::Fragment(AP4_ByteStream& output_stream)
+{
+    AP4_List<AP4_FragmenterFragmentInfo> fragments;
+    AP4_Array<TrackCursor*>&             cursors           = m_Cursors;
+    unsigned int                         fragment_duration = m_FragmentDuration;
+    AP4_UI32                             timescale         = m_Timescale;
+    AP4_UI32                             track_id          = m_TrackId;
+    TrackCursor*                         index_cursor      = NULL;
+    TrackCursor*                         anchor_cursor     = NULL;
+    AP4_Movie*                           output_movie      = NULL;
+    AP4_FtypAtom*                        ftyp              = NULL;
+    AP4_SidxAtom*                        sidx              = NULL;
+    AP4_Result                           result            = AP4_SUCCESS;
+
+    if (m_Done) return AP4_ERROR_INVALID_STATE;
+    m_Done = true;
+    if (fragment_duration == 0) return AP4_ERROR_INVALID_PARAMETERS;
+
+    AP4_Movie* input_movie = m_InputFile.GetMovie();
+    if (input_movie == NULL) return AP4_ERROR_INVALID_FORMAT;
+    if (cursors.ItemCount() == 0) return AP4_ERROR_INVALID_FORMAT;
+
+    // create the output file object
+    output_movie = new AP4_Movie(1000);
+
+    // create an mvex container
+    AP4_ContainerAtom* mvex = new AP4_ContainerAtom(AP4_ATOM_TYPE_MVEX);
+    AP4_MehdAtom*      mehd = new AP4_MehdAtom(0);
+    mvex->AddChild(mehd);
+
+    // add an output track for each track in the input file
+    for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+        AP4_Track* track = cursors[i]->m_Track;
+
+        // skip non matching tracks if we have a selector
+        if (track_id && track->GetId() != track_id) {
+            continue;
+        }
+
+        result = cursors[i]->Init();
+        if (AP4_FAILED(result)) {
+            delete mvex;
+            goto end;
+        }
+
+        // create a sample table (with no samples) to hold the sample description
+        AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable();
+        for (unsigned int j=0; j<track->GetSampleDescriptionCount(); j++) {
+            AP4_SampleDescription* sample_description = track->GetSampleDescription(j);
+            sample_table->AddSampleDescription(sample_description, false);
+        }
+
+        // create the track
+        AP4_Track* output_track = new AP4_Track(sample_table,
+                                                track->GetId(),
+                                                timescale?timescale:1000,
+                                                AP4_ConvertTime(track->GetDuration(),
+                                                                input_movie->GetTimeScale(),
+                                                                timescale?timescale:1000),
+                                                timescale?timescale:track->GetMediaTimeScale(),
+                                                0,//track->GetMediaDuration(),
+                                                track);
+        output_movie->AddTrack(output_track);
+
+        // add a trex entry to the mvex container
+        AP4_TrexAtom* trex = new AP4_TrexAtom(track->GetId(),
+                                              1,
+                                              0,
+                                              0,
+                                              0);
+        mvex->AddChild(trex);
+    }
+
+    // select the anchor cursor
+    for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+        if (cursors[i]->m_Track->GetId() == track_id) {
+            anchor_cursor = cursors[i];
+        }
+    }
+    if (anchor_cursor == NULL) {
+        for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+            // use this as the anchor track if it is the first video track
+            if (cursors[i]->m_Track->GetType() == AP4_Track::TYPE_VIDEO) {
+                anchor_cursor = cursors[i];
+                break;
+            }
+        }
+    }
+    if (anchor_cursor == NULL) {
+        // no video track to anchor with, pick the first audio track
+        for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+            if (cursors[i]->m_Track->GetType() == AP4_Track::TYPE_AUDIO) {
+                anchor_cursor = cursors[i];
+                break;
+            }
+        }
+        // no audio track to anchor with, pick the first subtitles track
+        for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+            if (cursors[i]->m_Track->GetType() == AP4_Track::TYPE_SUBTITLES) {
+                anchor_cursor = cursors[i];
+                break;
+            }
+        }
+    }
+    if (anchor_cursor == NULL) {
+        // no audio, video or subtitles track
+        delete mvex;
+        result = AP4_ERROR_INVALID_FORMAT;
+        goto end;
+    }
+    if (m_CreateSegmentIndex) {
+        index_cursor = anchor_cursor;
+    }
+    if (m_Listener) {
+        m_Listener->OnAnchorSelected(anchor_cursor->m_Track->GetId(), false);
+    }
+
+    // update the mehd duration
+    mehd->SetDuration(output_movie->GetDuration());
+
+    // add the mvex container to the moov container
+    output_movie->GetMoovAtom()->AddChild(mvex);
+
+    // compute all the fragments
+    {
+    unsigned int sequence_number = 1;
+    for(;;) {
+        TrackCursor* cursor = NULL;
+
+        // pick the first track with a fragment index lower than the anchor's
+        for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+            if (track_id && cursors[i]->m_Track->GetId() != track_id) continue;
+            if (cursors[i]->m_Eos) continue;
+            if (cursors[i]->m_FragmentIndex < anchor_cursor->m_FragmentIndex) {
+                cursor = cursors[i];
+                break;
+            }
+        }
+
+        // check if we found a non-anchor cursor to use
+        if (cursor == NULL) {
+            // the anchor should be used in this round, check if we can use it
+            if (anchor_cursor->m_Eos) {
+                // the anchor is done, pick a new anchor unless we need to trim
+                anchor_cursor = NULL;
+                if (!m_Trim) {
+                    for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+                        if (track_id && cursors[i]->m_Track->GetId() != track_id) continue;
+                        if (cursors[i]->m_Eos) continue;
+                        if (anchor_cursor == NULL ||
+                            cursors[i]->m_Track->GetType() == AP4_Track::TYPE_VIDEO ||
+                            cursors[i]->m_Track->GetType() == AP4_Track::TYPE_AUDIO) {
+                            anchor_cursor = cursors[i];
+                            if (m_Listener) {
+                                m_Listener->OnAnchorSelected(anchor_cursor->m_Track->GetId(), true);
+                            }
+                        }
+                    }
+                }
+            }
+            cursor = anchor_cursor;
+        }
+        if (cursor == NULL) break; // all done
+
+        // decide how many samples go into this fragment
+        AP4_UI64 target_dts;
+        if (cursor == anchor_cursor) {
+            // compute the current dts in milliseconds
+            AP4_UI64 anchor_dts_ms = AP4_ConvertTime(cursor->m_Sample.GetDts(),
+                                                     cursor->m_Track->GetMediaTimeScale(),
+                                                     1000);
+            // round to the nearest multiple of fragment_duration
+            AP4_UI64 anchor_position = (anchor_dts_ms + (fragment_duration/2))/fragment_duration;
+
+            // pick the next fragment_duration multiple at our target
+            target_dts = AP4_ConvertTime(fragment_duration*(anchor_position+1),
+                                         1000,
+                                         cursor->m_Track->GetMediaTimeScale());
+        } else {
+            target_dts = AP4_ConvertTime(anchor_cursor->m_Sample.GetDts(),
+                                         anchor_cursor->m_Track->GetMediaTimeScale(),
+                                         cursor->m_Track->GetMediaTimeScale());
+            if (target_dts <= cursor->m_Sample.GetDts()) {
+                // we must be at the end, past the last anchor sample, just use the target duration
+                target_dts = AP4_ConvertTime(fragment_duration*(cursor->m_FragmentIndex+1),
+                                            1000,
+                                            cursor->m_Track->GetMediaTimeScale());
+
+                if (target_dts <= cursor->m_Sample.GetDts()) {
+                    // we're still behind, there may have been an alignment/rounding error, just advance by one segment duration
+                    target_dts = cursor->m_Sample.GetDts()+AP4_ConvertTime(fragment_duration,
+                                                                           1000,
+                                                                           cursor->m_Track->GetMediaTimeScale());
+                }
+            }
+        }
+
+        unsigned int end_sample_index = cursor->m_Samples->GetSampleCount();
+        AP4_UI64 smallest_diff = (AP4_UI64)(0xFFFFFFFFFFFFFFFFULL);
+        AP4_Sample sample;
+        for (unsigned int i=cursor->m_SampleIndex+1; i<=cursor->m_Samples->GetSampleCount(); i++) {
+            AP4_UI64 dts;
+            if (i < cursor->m_Samples->GetSampleCount()) {
+                result = cursor->m_Samples->GetSample(i, sample);
+                if (AP4_FAILED(result)) goto end;
+                if (!sample.IsSync()) continue; // only look for sync samples
+                dts = sample.GetDts();
+            } else {
+                result = cursor->m_Samples->GetSample(i-1, sample);
+                if (AP4_FAILED(result)) goto end;
+                dts = sample.GetDts()+sample.GetDuration();
+            }
+            AP4_SI64 diff = dts-target_dts;
+            AP4_UI64 abs_diff = diff<0?-diff:diff;
+            if (abs_diff < smallest_diff) {
+                // this sample is the closest to the target so far
+                end_sample_index = i;
+                smallest_diff = abs_diff;
+            }
+            if (diff >= 0) {
+                // this sample is past the target, it is not going to get any better, stop looking
+                break;
+            }
+        }
+        if (cursor->m_Eos) continue;
+
+        // remember where the fragment starts, for the listener
+        AP4_UI64    start_dts          = cursor->m_Sample.GetDts();
+        AP4_Ordinal start_sample_index = cursor->m_SampleIndex;
+
+        // decide which sample description index to use
+        // (this is not very sophisticated, we only look at the sample description
+        // index of the first sample in the group, which may not be correct. This
+        // should be fixed later)
+        unsigned int sample_desc_index = cursor->m_Sample.GetDescriptionIndex();
+        unsigned int tfhd_flags = AP4_TFHD_FLAG_DEFAULT_BASE_IS_MOOF;
+        if (sample_desc_index > 0) {
+            tfhd_flags |= AP4_TFHD_FLAG_SAMPLE_DESCRIPTION_INDEX_PRESENT;
+        }
+        if (cursor->m_Track->GetType() == AP4_Track::TYPE_VIDEO) {
+            tfhd_flags |= AP4_TFHD_FLAG_DEFAULT_SAMPLE_FLAGS_PRESENT;
+        }
+
+        // setup the moof structure
+        AP4_ContainerAtom* moof = new AP4_ContainerAtom(AP4_ATOM_TYPE_MOOF);
+        AP4_MfhdAtom* mfhd = new AP4_MfhdAtom(sequence_number++);
+        moof->AddChild(mfhd);
+        AP4_ContainerAtom* traf = new AP4_ContainerAtom(AP4_ATOM_TYPE_TRAF);
+        AP4_TfhdAtom* tfhd = new AP4_TfhdAtom(tfhd_flags,
+                                              cursor->m_Track->GetId(),
+                                              0,
+                                              sample_desc_index+1,
+                                              0,
+                                              0,
+                                              0);
+        if (tfhd_flags & AP4_TFHD_FLAG_DEFAULT_SAMPLE_FLAGS_PRESENT) {
+            tfhd->SetDefaultSampleFlags(0x1010000); // sample_is_non_sync_sample=1, sample_depends_on=1 (not I frame)
+        }
+
+        traf->AddChild(tfhd);
+        if (m_CreateTfdt) {
+            AP4_TfdtAtom* tfdt = new AP4_TfdtAtom(1, cursor->m_Timestamp);
+            traf->AddChild(tfdt);
+        }
+        AP4_UI32 trun_flags = AP4_TRUN_FLAG_DATA_OFFSET_PRESENT     |
+                              AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT |
+                              AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT;
+        AP4_UI32 first_sample_flags = 0;
+        if (cursor->m_Track->GetType() == AP4_Track::TYPE_VIDEO) {
+            trun_flags |= AP4_TRUN_FLAG_FIRST_SAMPLE_FLAGS_PRESENT;
+            first_sample_flags = 0x2000000; // sample_depends_on=2 (I frame)
+        }
+        AP4_TrunAtom* trun = new AP4_TrunAtom(trun_flags, 0, first_sample_flags);
+
+        traf->AddChild(trun);
+        moof->AddChild(traf);
+
+        // create a new fragment info object to store the fragment details
+        AP4_FragmenterFragmentInfo* fragment = new AP4_FragmenterFragmentInfo(cursor->m_Samples,
+                                                                              cursor->m_Tfra,
+                                                                              cursor->m_Timestamp,
+                                                                              moof);
+        fragments.Add(fragment);
+
+        // add samples to the fragment
+        unsigned int                   sample_count = 0;
+        AP4_Array<AP4_TrunAtom::Entry> trun_entries;
+        fragment->m_MdatSize = AP4_ATOM_HEADER_SIZE;
+        for (;;) {
+            // if we have one non-zero CTS delta, we'll need to express it
+            if (cursor->m_Sample.GetCtsDelta()) {
+                trun->SetFlags(trun->GetFlags() | AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT);
+            }
+
+            // add one sample
+            trun_entries.SetItemCount(sample_count+1);
+            AP4_TrunAtom::Entry& trun_entry = trun_entries[sample_count];
+            trun_entry.sample_duration                = timescale?
+                                                        (AP4_UI32)AP4_ConvertTime(cursor->m_Sample.GetDuration(),
+                                                                                  cursor->m_Track->GetMediaTimeScale(),
+                                                                                  timescale):
+                                                        cursor->m_Sample.GetDuration();
+            trun_entry.sample_size                    = cursor->m_Sample.GetSize();
+            trun_entry.sample_composition_time_offset = timescale?
+                                                        (AP4_UI32)AP4_ConvertTime(cursor->m_Sample.GetCtsDelta(),
+                                                                                  cursor->m_Track->GetMediaTimeScale(),
+                                                                                  timescale):
+                                                        cursor->m_Sample.GetCtsDelta();
+
+            fragment->m_SampleIndexes.SetItemCount(sample_count+1);
+            fragment->m_SampleIndexes[sample_count] = cursor->m_SampleIndex;
+            fragment->m_MdatSize += trun_entry.sample_size;
+            fragment->m_Duration += trun_entry.sample_duration;
+
+            // next sample
+            cursor->m_Timestamp += trun_entry.sample_duration;
+            result = cursor->SetSampleIndex(cursor->m_SampleIndex+1);
+            if (AP4_FAILED(result)) goto end;
+            sample_count++;
+            if (cursor->m_Eos) break;
+            if (cursor->m_SampleIndex >= end_sample_index) {
+                break; // done with this fragment
+            }
+        }
+        if (m_Listener) {
+            m_Listener->OnFragment(cursor->m_Track->GetId(),
+                                   cursor == anchor_cursor,
+                                   start_dts,
+                                   target_dts,
+                                   start_sample_index,
+                                   end_sample_index,
+                                   sample_count,
+                                   cursor->m_Eos);
+        }
+
+        // update moof and children
+        trun->SetEntries(trun_entries);
+        trun->SetDataOffset((AP4_UI32)moof->GetSize()+AP4_ATOM_HEADER_SIZE);
+
+        // advance the cursor's fragment index
+        ++cursor->m_FragmentIndex;
+    }
+    }
+
+    // write the ftyp atom
+    ftyp = m_InputFile.GetFileType();
+    if (ftyp) {
+        // keep the existing brand and compatible brands
+        AP4_Array<AP4_UI32> compatible_brands;
+        compatible_brands.EnsureCapacity(ftyp->GetCompatibleBrands().ItemCount()+1);
+        for (unsigned int i=0; i<ftyp->GetCompatibleBrands().ItemCount(); i++) {
+            compatible_brands.Append(ftyp->GetCompatibleBrands()[i]);
+        }
+
+        // add the compatible brand if it is not already there
+        if (!ftyp->HasCompatibleBrand(AP4_FILE_BRAND_ISO5)) {
+            compatible_brands.Append(AP4_FILE_BRAND_ISO5);
+        }
+
+        // create a replacement
+        ftyp = new AP4_FtypAtom(ftyp->GetMajorBrand(),
+                                ftyp->GetMinorVersion(),
+                                &compatible_brands[0],
+                                compatible_brands.ItemCount());
+    } else {
+        AP4_UI32 compat = AP4_FILE_BRAND_ISO5;
+        ftyp = new AP4_FtypAtom(AP4_FTYP_BRAND_MP42, 0, &compat, 1);
+    }
+    result = ftyp->Write(output_stream);
+    delete ftyp;
+    if (AP4_FAILED(result)) goto end;
+
+    // write the moov atom
+    result = output_movie->GetMoovAtom()->Write(output_stream);
+    if (AP4_FAILED(result)) goto end;
+
+    // write the (not-yet fully computed) index if needed
+    {
+    AP4_Position sidx_position = 0;
+    output_stream.Tell(sidx_position);
+    if (m_CreateSegmentIndex) {
+        sidx = new AP4_SidxAtom(index_cursor->m_Track->GetId(),
+                                index_cursor->m_Track->GetMediaTimeScale(),
+                                0,
+                                0);
+        // reserve space for the entries now, but they will be computed and updated later
+        sidx->SetReferenceCount(fragments.ItemCount());
+        result = sidx->Write(output_stream);
+        if (AP4_FAILED(result)) goto end;
+    }
+
+    // write all fragments
+    for (AP4_List<AP4_FragmenterFragmentInfo>::Item* item = fragments.FirstItem();
+                                                     item;
+                                                     item = item->GetNext()) {
+        AP4_FragmenterFragmentInfo* fragment = item->GetData();
+
+        // remember the time and position of this fragment
+        output_stream.Tell(fragment->m_MoofPosition);
+        fragment->m_Tfra->AddEntry(fragment->m_Timestamp, fragment->m_MoofPosition);
+
+        // write the moof
+        result = fragment->m_Moof->Write(output_stream);
+        if (AP4_FAILED(result)) goto end;
+
+        // write mdat
+        output_stream.WriteUI32(fragment->m_MdatSize);
+        output_stream.WriteUI32(AP4_ATOM_TYPE_MDAT);
+        AP4_DataBuffer sample_data;
+        AP4_Sample     sample;
+        for (unsigned int i=0; i<fragment->m_SampleIndexes.ItemCount(); i++) {
+            // get the sample
+            result = fragment->m_Samples->GetSample(fragment->m_SampleIndexes[i], sample);
+            if (AP4_FAILED(result)) goto end;
+
+            // read the sample data (without copying it if the input is in memory)
+            result = sample.ReadDataView(sample_data);
+            if (AP4_FAILED(result)) goto end;
+
+            // write the sample data
+            result = output_stream.Write(sample_data.GetData(), sample_data.GetDataSize());
+            if (AP4_FAILED(result)) goto end;
+        }
+    }
+
+    // update the index and re-write it if needed
+    if (m_CreateSegmentIndex) {
+        unsigned int segment_index = 0;
+        AP4_SidxAtom::Reference reference;
+        for (AP4_List<AP4_FragmenterFragmentInfo>::Item* item = fragments.FirstItem();
+                                                         item;
+                                                         item = item->GetNext()) {
+            AP4_FragmenterFragmentInfo* fragment = item->GetData();
+            reference.m_ReferencedSize     = (AP4_UI32)(fragment->m_Moof->GetSize()+fragment->m_MdatSize);
+            reference.m_SubsegmentDuration = fragment->m_Duration;
+            reference.m_StartsWithSap      = true;
+            sidx->SetReference(segment_index++, reference);
+        }
+        AP4_Position here = 0;
+        output_stream.Tell(here);
+        result = output_stream.Seek(sidx_position);
+        if (AP4_SUCCEEDED(result)) result = sidx->Write(output_stream);
+        if (AP4_SUCCEEDED(result)) result = output_stream.Seek(here);
+        if (AP4_FAILED(result)) goto end;
+    }
+    }
+
+    // create an mfra container and write out the index
+    {
+    AP4_ContainerAtom mfra(AP4_ATOM_TYPE_MFRA);
+    for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+        if (track_id && cursors[i]->m_Track->GetId() != track_id) {
+            continue;
+        }
+        mfra.AddChild(cursors[i]->m_Tfra);
+        cursors[i]->m_Tfra = NULL;
+    }
+    AP4_MfroAtom* mfro = new AP4_MfroAtom((AP4_UI32)mfra.GetSize()+16);
+    mfra.AddChild(mfro);
+    result = mfra.Write(output_stream);
+    }
+
+end:
+    // cleanup
+    fragments.DeleteReferences();
+    delete sidx;
+    delete output_movie;
+
+    return result;
+}
@@ -0,0 +1,161 @@
+/*****************************************************************
+|
+|    AP4 - Fragmenter
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_FRAGMENTER_H_
+#define _AP4_FRAGMENTER_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Array.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+class AP4_File;
+class AP4_Track;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int AP4_FRAGMENTER_DEFAULT_FRAGMENT_DURATION  = 2000;  // ms
+const unsigned int AP4_FRAGMENTER_MAX_AUTO_FRAGMENT_DURATION = 40000; // ms
+
+/*----------------------------------------------------------------------
+|   AP4_Fragmenter
++---------------------------------------------------------------------*/
+/**
+ * Converts a file into a fragmented file: an 'ftyp' and a 'moov' with
+ * an 'mvex', one 'moof' and 'mdat' per track fragment, an optional 'sidx'
+ * and an 'mfra' at the end. Fragments start on sync samples, as close as
+ * possible to multiples of the fragment duration of the anchor track (the
+ * first video track, or else the first audio or subtitles track). Files
+ * that are already fragmented are re-fragmented.
+ *
+ * The output is written strictly forward, except for the 'sidx', which is
+ * updated in place at the end when a segment index is created.
+ */
+class AP4_Fragmenter {
+public:
+    /**
+     * Receives notifications about the choices made while fragmenting,
+     * for example to trace them.
+     */
+    class Listener {
+    public:
+        virtual ~Listener() {}
+
+        /**
+         * Called when AutoDetectFragmentDuration() finds a regular
+         * sync sample interval in the video track.
+         */
+        virtual void OnSyncIntervalDetected(unsigned int /* interval */,
+                                            double       /* frame_rate */) {}
+
+        /**
+         * Called when a track becomes the anchor, at the start and each
+         * time the previous anchor track ends.
+         */
+        virtual void OnAnchorSelected(AP4_UI32 /* track_id */,
+                                      bool     /* replacement */) {}
+
+        /**
+         * Called when the samples of a fragment have been selected.
+         * The samples are [start_sample, start_sample+sample_count).
+         */
+        virtual void OnFragment(AP4_UI32     /* track_id     */,
+                                bool         /* anchor       */,
+                                AP4_UI64     /* dts          */,
+                                AP4_UI64     /* target_dts   */,
+                                AP4_Ordinal  /* start_sample */,
+                                AP4_Ordinal  /* end_sample   */,
+                                AP4_Cardinal /* sample_count */,
+                                bool         /* end_of_track */) {}
+    };
+
+    // constructor and destructor
+    /**
+     * The input file must be parsed from input_stream (only the 'moov'
+     * is needed). Tracks without samples are skipped, unless the input
+     * is fragmented, in which case the samples of the fragments are read
+     * here and the stream is returned to its current position.
+     */
+    AP4_Fragmenter(AP4_File& input_file, AP4_ByteStream& input_stream);
+    ~AP4_Fragmenter();
+
+    // methods
+    AP4_Cardinal GetTrackCount() { return m_Cursors.ItemCount(); }
+    AP4_Track*   GetTrack(AP4_Ordinal index);
+
+    /**
+     * Returns a fragment duration in milliseconds that matches the sync
+     * sample interval of the first video track or, for fragmented inputs
+     * without video, the fragment duration of the first audio track.
+     * Returns 0 if no duration can be detected.
+     */
+    unsigned int AutoDetectFragmentDuration();
+
+    void SetFragmentDuration(unsigned int duration) { m_FragmentDuration = duration; }
+    void SetTimescale(AP4_UI32 timescale)           { m_Timescale = timescale;       }
+    void SetTrackId(AP4_UI32 track_id)              { m_TrackId = track_id;          }
+    void SetCreateSegmentIndex(bool create)         { m_CreateSegmentIndex = create; }
+    void SetCreateTfdt(bool create)                 { m_CreateTfdt = create;         }
+    void SetTrim(bool trim)                         { m_Trim = trim;                 }
+    void SetListener(Listener* listener)            { m_Listener = listener;         }
+
+    /**
+     * Write the fragmented file. This can only be called once.
+     * The output stream must be seekable if a segment index is created.
+     */
+    AP4_Result Fragment(AP4_ByteStream& output);
+
+private:
+    // types
+    class TrackCursor;
+
+    // methods
+    unsigned int AutoDetectVideoFragmentDuration(TrackCursor* cursor);
+    unsigned int AutoDetectAudioFragmentDuration(TrackCursor* cursor);
+
+    // members
+    AP4_File&               m_InputFile;
+    AP4_ByteStream&         m_InputStream;
+    AP4_Array<TrackCursor*> m_Cursors;
+    unsigned int            m_FragmentDuration;
+    AP4_UI32                m_Timescale;
+    AP4_UI32                m_TrackId;
+    bool                    m_CreateSegmentIndex;
+    bool                    m_CreateTfdt;
+    bool                    m_Trim;
+    bool                    m_Done;
+    Listener*               m_Listener;
+};
+
+#endif // _AP4_FRAGMENTER_H_
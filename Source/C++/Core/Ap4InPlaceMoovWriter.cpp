@@ -0,0 +1,195 @@
+/*****************************************************************
+|
+|    AP4 - In-Place Moov Writer
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4InPlaceMoovWriter.h"
+#include "Ap4Atom.h"
+#include "Ap4ByteStream.h"
+#include "Ap4DataBuffer.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_InPlaceMoovWriter_TopLevelAtom
++---------------------------------------------------------------------*/
+struct AP4_InPlaceMoovWriter_TopLevelAtom {
+    AP4_Atom::Type m_Type;
+    AP4_Position   m_Offset;
+    AP4_UI64       m_Size;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_InPlaceMoovWriter_IsPadding
++---------------------------------------------------------------------*/
+static bool
+AP4_InPlaceMoovWriter_IsPadding(AP4_Atom::Type type)
+{
+    return type == AP4_ATOM_TYPE_FREE || type == AP4_ATOM_TYPE_SKIP;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_InPlaceMoovWriter::Write
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_InPlaceMoovWriter::Write(AP4_Atom& moov, AP4_ByteStream& stream)
+{
+    AP4_Result result;
+    
+    AP4_LargeSize stream_size = 0;
+    result = stream.GetSize(stream_size);
+    if (AP4_FAILED(result)) return result;
+    
+    // list the top-level atoms from their headers
+    AP4_Array<AP4_InPlaceMoovWriter_TopLevelAtom> atoms;
+    int                                           moov_index = -1;
+    AP4_Position                                  offset = 0;
+    while (offset+8 <= stream_size) {
+        AP4_UI32 size_32 = 0;
+        AP4_UI32 type    = 0;
+        result = stream.Seek(offset);
+        if (AP4_FAILED(result)) return result;
+        result = stream.ReadUI32(size_32);
+        if (AP4_FAILED(result)) return result;
+        result = stream.ReadUI32(type);
+        if (AP4_FAILED(result)) return result;
+        AP4_UI64 size = size_32;
+        if (size_32 == 1) {
+            result = stream.ReadUI64(size);
+            if (AP4_FAILED(result)) return result;
+        } else if (size_32 == 0) {
+            size = stream_size-offset;
+        }
+        if (size < 8 || offset+size > stream_size) return AP4_ERROR_INVALID_FORMAT;
+        
+        AP4_InPlaceMoovWriter_TopLevelAtom atom = { type, offset, size };
+        if (type == AP4_ATOM_TYPE_MOOV && moov_index < 0) {
+            moov_index = atoms.ItemCount();
+        }
+        atoms.Append(atom);
+        offset += size;
+    }
+    if (moov_index < 0) return AP4_ERROR_INVALID_FORMAT;
+    
+    // the available space is the moov atom and the padding around it
+    unsigned int first = moov_index;
+    unsigned int last  = moov_index;
+    while (first > 0 && AP4_InPlaceMoovWriter_IsPadding(atoms[first-1].m_Type)) {
+        --first;
+    }
+    while (last+1 < atoms.ItemCount() && AP4_InPlaceMoovWriter_IsPadding(atoms[last+1].m_Type)) {
+        ++last;
+    }
+    AP4_Position  region_offset = atoms[first].m_Offset;
+    AP4_LargeSize region_size   = atoms[last].m_Offset+atoms[last].m_Size-region_offset;
+    
+    // the leftover space must be able to hold at least a 'free' atom header
+    AP4_LargeSize moov_size = moov.GetSize();
+    if (moov_size > region_size) return AP4_ERROR_NOT_ENOUGH_SPACE;
+    AP4_LargeSize free_size = region_size-moov_size;
+    if (free_size && free_size < AP4_ATOM_HEADER_SIZE) return AP4_ERROR_NOT_ENOUGH_SPACE;
+    
+    // serialize the moov atom before overwriting anything, since some of 
+    // its atoms may still read their payload from the same stream
+    AP4_MemoryByteStream* buffer = new AP4_MemoryByteStream();
+    result = moov.Write(*buffer);
+    if (AP4_SUCCEEDED(result) && buffer->GetDataSize() != moov_size) {
+        result = AP4_ERROR_INTERNAL;
+    }
+    if (AP4_SUCCEEDED(result)) result = stream.Seek(region_offset);
+    if (AP4_SUCCEEDED(result)) result = stream.Write(buffer->GetData(), buffer->GetDataSize());
+    buffer->Release();
+    if (AP4_FAILED(result)) return result;
+    
+    // fill the remaining space with a 'free' atom
+    if (free_size) {
+        AP4_LargeSize header_size = AP4_ATOM_HEADER_SIZE;
+        if (free_size > 0xFFFFFFFF) {
+            result = stream.WriteUI32(1);
+            if (AP4_FAILED(result)) return result;
+            result = stream.WriteUI32(AP4_ATOM_TYPE_FREE);
+            if (AP4_FAILED(result)) return result;
+            result = stream.WriteUI64(free_size);
+            if (AP4_FAILED(result)) return result;
+            header_size += 8;
+        } else {
+            result = stream.WriteUI32((AP4_UI32)free_size);
+            if (AP4_FAILED(result)) return result;
+            result = stream.WriteUI32(AP4_ATOM_TYPE_FREE);
+            if (AP4_FAILED(result)) return result;
+        }
+        
+        // clear the payload, so that no stale atom data remains
+        AP4_UI08 zeros[4096];
+        AP4_SetMemory(zeros, 0, sizeof(zeros));
+        for (AP4_LargeSize remaining = free_size-header_size; remaining; ) {
+            AP4_Size chunk = sizeof(zeros);
+            if (remaining < chunk) chunk = (AP4_Size)remaining;
+            result = stream.Write(zeros, chunk);
+            if (AP4_FAILED(result)) return result;
+            remaining -= chunk;
+        }
+    }
+    
+    return stream.Flush();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_InPlaceMoovWriter::AddPadding
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_InPlaceMoovWriter::AddPadding(AP4_AtomParent& top_level, AP4_UI32 padding)
+{
+    // find the moov atom
+    AP4_Atom* moov = top_level.GetChild(AP4_ATOM_TYPE_MOOV);
+    if (moov == NULL) return AP4_ERROR_INVALID_STATE;
+    int position = 0;
+    AP4_List<AP4_Atom>::Item* item = top_level.GetChildren().FirstItem();
+    while (item && item->GetData() != moov) {
+        item = item->GetNext();
+        ++position;
+    }
+    if (item == NULL) return AP4_ERROR_INTERNAL;
+    
+    // remove the existing padding after the moov atom
+    for (item = item->GetNext(); 
+         item && AP4_InPlaceMoovWriter_IsPadding(item->GetData()->GetType()); ) {
+        AP4_Atom* atom = item->GetData();
+        item = item->GetNext();
+        top_level.RemoveChild(atom);
+        delete atom;
+    }
+    
+    // add the new padding
+    if (padding < AP4_ATOM_HEADER_SIZE) return AP4_SUCCESS;
+    AP4_DataBuffer payload(padding-AP4_ATOM_HEADER_SIZE);
+    payload.SetDataSize(padding-AP4_ATOM_HEADER_SIZE);
+    AP4_SetMemory(payload.UseData(), 0, payload.GetDataSize());
+    AP4_Atom* free_atom = new AP4_UnknownAtom(AP4_ATOM_TYPE_FREE, payload.GetData(), payload.GetDataSize());
+    return top_level.AddChild(free_atom, position+1);
+}
@@ -0,0 +1,85 @@
+/*****************************************************************
+|
+|    AP4 - In-Place Moov Writer
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_IN_PLACE_MOOV_WRITER_H_
+#define _AP4_IN_PLACE_MOOV_WRITER_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+
+/*----------------------------------------------------------------------
+|   class references
++---------------------------------------------------------------------*/
+class AP4_ByteStream;
+class AP4_Atom;
+class AP4_AtomParent;
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const AP4_UI32 AP4_IN_PLACE_MOOV_WRITER_DEFAULT_PADDING = 4096;
+
+/*----------------------------------------------------------------------
+|   AP4_InPlaceMoovWriter
++---------------------------------------------------------------------*/
+/**
+ * Writes an updated moov atom over the original one, for metadata edits
+ * that don't touch the media data. The new moov atom may use the space
+ * of the original moov atom and of the 'free' and 'skip' atoms directly
+ * before or after it. Any space left over is turned into a 'free' atom,
+ * so the media data never moves and the chunk offsets stay valid.
+ */
+class AP4_InPlaceMoovWriter {
+public:
+    // class methods
+    /**
+     * Overwrite the moov atom of a file.
+     *
+     * @param moov: the updated moov atom. Its chunk offsets must be those 
+     * of the original file.
+     * @param stream: the file, opened for reading and writing.
+     * @result AP4_ERROR_NOT_ENOUGH_SPACE if the new moov atom does not fit,
+     * in which case nothing is written.
+     */
+    static AP4_Result Write(AP4_Atom& moov, AP4_ByteStream& stream);
+
+    /**
+     * Replace the 'free' and 'skip' atoms that follow the moov atom in a
+     * list of top-level atoms with a single 'free' atom of padding bytes,
+     * so that a file being rewritten can be updated in place next time.
+     */
+    static AP4_Result AddPadding(AP4_AtomParent& top_level, AP4_UI32 padding);
+
+private:
+    // don't instantiate this class
+    AP4_InPlaceMoovWriter() {}
+};
+
+#endif // _AP4_IN_PLACE_MOOV_WRITER_H_
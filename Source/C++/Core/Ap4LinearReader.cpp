@@ -36,6 +36,195 @@
 #include "Ap4FragmentSampleTable.h"
 #include "Ap4AtomFactory.h"
 #include "Ap4TfraAtom.h"
+#include "Ap4Utils.h"
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream
++---------------------------------------------------------------------*/
+/**
+ * Stream through which sample data is read. Reads are served from a 
+ * window filled with one large read from the source, and the following
+ * window is hinted to the source so that it can be fetched while the
+ * current one is consumed. Sources that are already in memory (memory
+ * or memory-mapped streams) are read directly, only the hints are given.
+ */
+class AP4_LinearReader::ReadAheadStream : public AP4_ByteStream
+{
+public:
+    ReadAheadStream(AP4_ByteStream& source, AP4_Size window_size);
+    
+    // methods
+    AP4_ByteStream& GetSource() { return m_Source; }
+    
+    // AP4_ByteStream methods
+    AP4_Result ReadPartial(void*     buffer, 
+                           AP4_Size  bytes_to_read, 
+                           AP4_Size& bytes_read);
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read);
+    AP4_Result WritePartial(const void* /* buffer         */, 
+                            AP4_Size    /* bytes_to_write */, 
+                            AP4_Size&   bytes_written) {
+        bytes_written = 0;
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_Result Seek(AP4_Position position) {
+        m_Position = position;
+        return AP4_SUCCESS;
+    }
+    AP4_Result Tell(AP4_Position& position) {
+        position = m_Position;
+        return AP4_SUCCESS;
+    }
+    AP4_Result GetSize(AP4_LargeSize& size) { return m_Source.GetSize(size); }
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data) {
+        return m_Source.Borrow(position, size, data);
+    }
+    
+    // AP4_Referenceable methods
+    void AddReference() { ++m_ReferenceCount; }
+    void Release()      { if (--m_ReferenceCount == 0) delete this; }
+    
+private:
+    // methods
+    ~ReadAheadStream() { m_Source.Release(); }
+    AP4_Result Fill(AP4_Position position);
+    void       Prefetch(AP4_Position position);
+
+    // members
+    AP4_ByteStream& m_Source;
+    bool            m_SourceIsInMemory;
+    AP4_Size        m_WindowSize;
+    AP4_DataBuffer  m_Window;
+    AP4_Position    m_WindowPosition;
+    AP4_Position    m_PrefetchPosition; // end of the range hinted so far
+    AP4_Position    m_Position;
+    AP4_Cardinal    m_ReferenceCount;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream::ReadAheadStream
++---------------------------------------------------------------------*/
+AP4_LinearReader::ReadAheadStream::ReadAheadStream(AP4_ByteStream& source, 
+                                                   AP4_Size        window_size) :
+    m_Source(source),
+    m_WindowSize(window_size),
+    m_WindowPosition(0),
+    m_PrefetchPosition(0),
+    m_Position(0),
+    m_ReferenceCount(1)
+{
+    m_Source.AddReference();
+    
+    // streams that can lend their data don't need a copy
+    const AP4_UI08* data = NULL;
+    m_SourceIsInMemory = AP4_SUCCEEDED(m_Source.Borrow(0, 0, data));
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream::Prefetch
++---------------------------------------------------------------------*/
+void
+AP4_LinearReader::ReadAheadStream::Prefetch(AP4_Position position)
+{
+    // start over after a seek backwards
+    if (m_PrefetchPosition > position+2*(AP4_Position)m_WindowSize) {
+        m_PrefetchPosition = 0;
+    }
+    
+    // keep about two windows ahead of the reads hinted
+    if (m_PrefetchPosition < position+m_WindowSize) {
+        AP4_Position start = position > m_PrefetchPosition ? position : m_PrefetchPosition;
+        AP4_Position end   = position+2*(AP4_Position)m_WindowSize;
+        m_Source.Prefetch(start, end-start);
+        m_PrefetchPosition = end;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream::Fill
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_LinearReader::ReadAheadStream::Fill(AP4_Position position)
+{
+    AP4_Result result = m_Window.SetDataSize(m_WindowSize);
+    if (AP4_FAILED(result)) return result;
+    m_WindowPosition = position;
+    Prefetch(position);
+    
+    // read as much of the window as we can (it is short at the end)
+    AP4_Size filled = 0;
+    while (filled < m_WindowSize) {
+        AP4_Size chunk = 0;
+        result = m_Source.ReadPartialAt(position+filled, 
+                                        m_Window.UseData()+filled, 
+                                        m_WindowSize-filled, 
+                                        chunk);
+        if (AP4_FAILED(result) || chunk == 0) break;
+        filled += chunk;
+    }
+    m_Window.SetDataSize(filled);
+    if (filled == 0) return AP4_FAILED(result)?result:AP4_ERROR_EOS;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_LinearReader::ReadAheadStream::ReadPartialAt(AP4_Position position,
+                                                 void*        buffer,
+                                                 AP4_Size     bytes_to_read,
+                                                 AP4_Size&    bytes_read)
+{
+    bytes_read = 0;
+    if (bytes_to_read == 0) return AP4_SUCCESS;
+    
+    // the data doesn't need to be copied ahead, only fetched
+    if (m_SourceIsInMemory) {
+        Prefetch(position);
+        return m_Source.ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+    }
+    
+    // refill the window if the data isn't in it
+    if (position < m_WindowPosition || 
+        position >= m_WindowPosition+m_Window.GetDataSize()) {
+        if (bytes_to_read >= m_WindowSize) {
+            // too large to be worth copying through the window
+            Prefetch(position);
+            return m_Source.ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+        }
+        AP4_Result result = Fill(position);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    // copy from the window
+    AP4_Size available = (AP4_Size)(m_WindowPosition+m_Window.GetDataSize()-position);
+    if (bytes_to_read > available) bytes_to_read = available;
+    AP4_CopyMemory(buffer, m_Window.GetData()+(position-m_WindowPosition), bytes_to_read);
+    bytes_read = bytes_to_read;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::ReadAheadStream::ReadPartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_LinearReader::ReadAheadStream::ReadPartial(void*     buffer, 
+                                               AP4_Size  bytes_to_read, 
+                                               AP4_Size& bytes_read)
+{
+    AP4_Result result = ReadPartialAt(m_Position, buffer, bytes_to_read, bytes_read);
+    if (AP4_SUCCEEDED(result)) m_Position += bytes_read;
+    
+    return result;
+}
 
 /*----------------------------------------------------------------------
 |   AP4_LinearReader::AP4_LinearReader
@@ -50,7 +239,9 @@ AP4_LinearReader::AP4_LinearReader(AP4_Movie&      movie,
     m_BufferFullness(0),
     m_BufferFullnessPeak(0),
     m_MaxBufferFullness(max_buffer),
-    m_Mfra(NULL)
+    m_Mfra(NULL),
+    m_ReadAheadSize(AP4_LINEAR_READER_DEFAULT_READ_AHEAD_SIZE),
+    m_ReadAheadStream(NULL)
 {
     m_HasFragments = movie.HasFragments();
     if (fragment_stream) {
@@ -70,6 +261,42 @@ AP4_LinearReader::~AP4_LinearReader()
     delete m_Fragment;
     delete m_Mfra;
     if (m_FragmentStream) m_FragmentStream->Release();
+    if (m_ReadAheadStream) m_ReadAheadStream->Release();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::SetReadAheadSize
++---------------------------------------------------------------------*/
+void
+AP4_LinearReader::SetReadAheadSize(AP4_Size size)
+{
+    m_ReadAheadSize = size;
+    
+    // the next read will create a stream with the new window size
+    if (m_ReadAheadStream) {
+        m_ReadAheadStream->Release();
+        m_ReadAheadStream = NULL;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_LinearReader::AttachReadAheadStream
++---------------------------------------------------------------------*/
+void
+AP4_LinearReader::AttachReadAheadStream(AP4_Sample& sample)
+{
+    AP4_ByteStream* source = sample.GetDataStream();
+    if (source == NULL) return;
+    
+    // (re)create the read-ahead stream when the samples come from a new source
+    if (m_ReadAheadStream == NULL || &m_ReadAheadStream->GetSource() != source) {
+        if (m_ReadAheadStream) m_ReadAheadStream->Release();
+        AP4_Size window_size = m_ReadAheadSize;
+        if (window_size > m_MaxBufferFullness) window_size = m_MaxBufferFullness;
+        m_ReadAheadStream = new ReadAheadStream(*source, window_size);
+    }
+    sample.SetDataStream(*m_ReadAheadStream);
+    source->Release();
 }
 
 /*----------------------------------------------------------------------
@@ -451,6 +678,9 @@ AP4_LinearReader::Advance(bool read_data)
         SampleBuffer* buffer = new SampleBuffer(next_tracker->m_NextSample);
         AP4_Result result;
         if (read_data) {
+            if (m_ReadAheadSize && m_MaxBufferFullness) {
+                AttachReadAheadStream(*buffer->m_Sample);
+            }
             if (next_tracker->m_Reader) {
                 result = next_tracker->m_Reader->ReadSampleData(*buffer->m_Sample, buffer->m_Data);
             } else {
@@ -50,7 +50,8 @@ class AP4_MovieFragment;
 const unsigned int AP4_LINEAR_READER_INITIALIZED = 1;
 const unsigned int AP4_LINEAR_READER_FLAG_EOS    = 2;
 
-const unsigned int AP4_LINEAR_READER_DEFAULT_BUFFER_SIZE = 16*1024*1024;
+const unsigned int AP4_LINEAR_READER_DEFAULT_BUFFER_SIZE     = 16*1024*1024;
+const unsigned int AP4_LINEAR_READER_DEFAULT_READ_AHEAD_SIZE = 1024*1024;
 
 /*----------------------------------------------------------------------
 |   AP4_LinearReader
@@ -88,6 +89,16 @@ public:
     
     AP4_Result SeekTo(AP4_UI32 time_ms, AP4_UI32* actual_time_ms = 0);
     
+    /**
+     * Set the size of the window in which sample data is read ahead of
+     * the samples being returned (capped to the maximum buffer size).
+     * Sample data is then fetched from the source in large sequential 
+     * reads, and the next window is announced to the stream with 
+     * AP4_ByteStream::Prefetch() so that the I/O for it can overlap with
+     * the processing of the current one. A size of 0 disables read-ahead.
+     */
+    void SetReadAheadSize(AP4_Size size);
+    
     // accessors
     AP4_Size GetBufferFullness() { return m_BufferFullness; }
     
@@ -156,6 +167,8 @@ protected:
         } m_SeekPoint;
     };
     
+    class ReadAheadStream;
+    
     // methods that can be overridden
     virtual AP4_Result ProcessTrack(AP4_Track* track);
     virtual AP4_Result ProcessMoof(AP4_ContainerAtom* moof, 
@@ -172,6 +185,7 @@ protected:
                               AP4_UI32&       track_id);
     void       FlushQueue(Tracker* tracker);
     void       FlushQueues();
+    void       AttachReadAheadStream(AP4_Sample& sample);
     
     // members
     AP4_Movie&          m_Movie;
@@ -184,6 +198,8 @@ protected:
     AP4_Size            m_BufferFullnessPeak;
     AP4_Size            m_MaxBufferFullness;
     AP4_ContainerAtom*  m_Mfra;
+    AP4_Size            m_ReadAheadSize;
+    ReadAheadStream*    m_ReadAheadStream;
 };
 
 /*----------------------------------------------------------------------
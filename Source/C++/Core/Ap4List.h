@@ -34,6 +34,7 @@
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
 #include "Ap4Results.h"
+#include "Ap4Arena.h"
 
 /*----------------------------------------------------------------------
 |   forward references
@@ -68,6 +69,9 @@ public:
             virtual AP4_Result Test(T* data) const = 0;
         };
 
+        // allocation
+        AP4_IMPLEMENT_ARENA_ALLOCATION
+
         // methods
         Item(T* data) : m_Data(data), m_Next(0), m_Prev(0) {}
        ~Item() {}
@@ -236,6 +236,22 @@ AP4_Movie::GetDurationMs()
     }
 }
 
+/*----------------------------------------------------------------------
+|   AP4_Movie::PrepareForConcurrentReads
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Movie::PrepareForConcurrentReads()
+{
+    for (AP4_List<AP4_Track>::Item* item = m_Tracks.FirstItem();
+                                     item;
+                                     item = item->GetNext()) {
+        AP4_Result result = item->GetData()->PrepareForConcurrentReads();
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Movie::HasFragments
 +---------------------------------------------------------------------*/
@@ -66,6 +66,15 @@ public:
     AP4_UI64     GetDuration();
     AP4_UI32     GetDurationMs();
     bool         HasFragments();
+
+    /**
+     * Prepare all the tracks so that their samples can then be read with
+     * AP4_Track::GetSample() and AP4_Track::ReadSample() from several 
+     * threads at once, without locks. This requires a sample stream that
+     * can be read positionally from several threads (memory, memory-mapped
+     * and read-only file streams, see AP4_ByteStream::ReadPartialAt).
+     */
+    AP4_Result   PrepareForConcurrentReads();
     
 private:
     // members
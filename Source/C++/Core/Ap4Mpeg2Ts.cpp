@@ -36,6 +36,7 @@
 #include "Ap4Utils.h"
 #include "Ap4Mp4AudioInfo.h"
 #include "Ap4AvcParser.h"
+#include "Ap4AnnexBWriter.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -208,16 +209,15 @@ ComputeCRC(const unsigned char* data, unsigned int data_size)
 }
 
 /*----------------------------------------------------------------------
-|   AP4_Mpeg2TsWriter::Stream::WritePacketHeader
+|   AP4_Mpeg2TsWriter::Stream::MakePacketHeader
 +---------------------------------------------------------------------*/
-void
-AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start, 
-                                             unsigned int&   payload_size,
-                                             bool            with_pcr,
-                                             AP4_UI64        pcr,
-                                             AP4_ByteStream& output)
+unsigned int
+AP4_Mpeg2TsWriter::Stream::MakePacketHeader(bool          payload_start, 
+                                            unsigned int& payload_size,
+                                            bool          with_pcr,
+                                            AP4_UI64      pcr,
+                                            AP4_UI08*     header)
 {
-    unsigned char header[4];
     header[0] = AP4_MPEG2TS_SYNC_BYTE;
     header[1] = (AP4_UI08)(((payload_start?1:0)<<6) | (m_PID >> 8));
     header[2] = m_PID & 0xFF;
@@ -238,36 +238,51 @@ AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start,
     if (adaptation_field_size == 0) {
         // no adaptation field
         header[3] = (1<<4) | ((m_ContinuityCounter++)&0x0F);
-        output.Write(header, 4);
+        return 4;
+    } 
+    
+    // adaptation field present
+    header[3] = (3<<4) | ((m_ContinuityCounter++)&0x0F);
+    if (adaptation_field_size == 1) {
+        // just one byte (stuffing)
+        header[4] = 0;
     } else {
-        // adaptation field present
-        header[3] = (3<<4) | ((m_ContinuityCounter++)&0x0F);
-        output.Write(header, 4);
-        
-        if (adaptation_field_size == 1) {
-            // just one byte (stuffing)
-            output.WriteUI08(0);
-        } else {
-            // two or more bytes (stuffing and/or PCR)
-            output.WriteUI08((AP4_UI08)(adaptation_field_size-1));
-            output.WriteUI08(with_pcr?(1<<4):0);
-            unsigned int pcr_size = 0;
-            if (with_pcr) {
-                pcr_size = AP4_MPEG2TS_PCR_ADAPTATION_SIZE;
-                AP4_UI64 pcr_base = pcr/300;
-                AP4_UI32 pcr_ext  = (AP4_UI32)(pcr%300);
-                AP4_BitWriter writer(pcr_size);
-                writer.Write((AP4_UI32)(pcr_base>>32), 1);
-                writer.Write((AP4_UI32)pcr_base, 32);
-                writer.Write(0x3F, 6);
-                writer.Write(pcr_ext, 9);
-                output.Write(writer.GetData(), pcr_size);
-            } 
-            if (adaptation_field_size > 2) {
-                output.Write(StuffingBytes, adaptation_field_size-pcr_size-2);
-            }
+        // two or more bytes (stuffing and/or PCR)
+        header[4] = (AP4_UI08)(adaptation_field_size-1);
+        header[5] = (AP4_UI08)(with_pcr?(1<<4):0);
+        unsigned int pcr_size = 0;
+        if (with_pcr) {
+            pcr_size = AP4_MPEG2TS_PCR_ADAPTATION_SIZE;
+            AP4_UI64 pcr_base = pcr/300;
+            AP4_UI32 pcr_ext  = (AP4_UI32)(pcr%300);
+            AP4_BitWriter writer(pcr_size);
+            writer.Write((AP4_UI32)(pcr_base>>32), 1);
+            writer.Write((AP4_UI32)pcr_base, 32);
+            writer.Write(0x3F, 6);
+            writer.Write(pcr_ext, 9);
+            AP4_CopyMemory(&header[6], writer.GetData(), pcr_size);
+        } 
+        if (adaptation_field_size > 2) {
+            AP4_CopyMemory(&header[6+pcr_size], StuffingBytes, adaptation_field_size-pcr_size-2);
         }
     }
+    
+    return 4+adaptation_field_size;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mpeg2TsWriter::Stream::WritePacketHeader
++---------------------------------------------------------------------*/
+void
+AP4_Mpeg2TsWriter::Stream::WritePacketHeader(bool            payload_start, 
+                                             unsigned int&   payload_size,
+                                             bool            with_pcr,
+                                             AP4_UI64        pcr,
+                                             AP4_ByteStream& output)
+{
+    AP4_UI08 header[AP4_MPEG2TS_PACKET_SIZE];
+    unsigned int header_size = MakePacketHeader(payload_start, payload_size, with_pcr, pcr, header);
+    output.Write(header, header_size);
 } 
 
 /*----------------------------------------------------------------------
@@ -325,27 +340,49 @@ AP4_Mpeg2TsWriter::SampleStream::WritePES(const unsigned char* data,
         pes_header.Write(1, 1);                    // market_bit
     }
     
-    bool first_packet = true;
+    // prepare all the packets of the PES, so that they can be written
+    // with a single gather write.
+    // Only the first packet (PCR) and the last one (stuffing) can have an
+    // adaptation field, all other packet headers are 4 bytes.
     data_size += pes_header_size; // add size of PES header
+    unsigned int max_packet_count = data_size/AP4_MPEG2TS_PACKET_PAYLOAD_SIZE+2;
+    m_PacketHeaders.SetDataSize(4*max_packet_count+2*AP4_MPEG2TS_PACKET_PAYLOAD_SIZE);
+    m_Vectors.Clear();
+    m_Vectors.EnsureCapacity(2*max_packet_count+1);
+    AP4_UI08* packet_header = m_PacketHeaders.UseData();
+    bool first_packet = true;
     while (data_size) {
         unsigned int payload_size = data_size;
         if (payload_size > AP4_MPEG2TS_PACKET_PAYLOAD_SIZE) payload_size = AP4_MPEG2TS_PACKET_PAYLOAD_SIZE;
         
+        // packet header
+        AP4_IoVector vector;
+        vector.m_Data = packet_header;
+        vector.m_Size = MakePacketHeader(first_packet, 
+                                         payload_size, 
+                                         first_packet && with_pcr, 
+                                         first_packet ? (with_dts?dts:pts)*300 : 0, 
+                                         packet_header);
+        packet_header += vector.m_Size;
+        m_Vectors.Append(vector);
+        
+        // payload
         if (first_packet)  {
-            WritePacketHeader(first_packet, payload_size, with_pcr, (with_dts?dts:pts)*300, output);
+            vector.m_Data = (void*)pes_header.GetData();
+            vector.m_Size = pes_header_size;
+            m_Vectors.Append(vector);
+            vector.m_Size = payload_size-pes_header_size;
             first_packet = false;
-            output.Write(pes_header.GetData(), pes_header_size);
-            output.Write(data, payload_size-pes_header_size);
-            data += payload_size-pes_header_size;
         } else {
-            WritePacketHeader(first_packet, payload_size, false, 0, output);
-            output.Write(data, payload_size);
-            data += payload_size;
+            vector.m_Size = payload_size;
         }
+        vector.m_Data = (void*)data;
+        m_Vectors.Append(vector);
+        data      += vector.m_Size;
         data_size -= payload_size;
     }
     
-    return AP4_SUCCESS;
+    return output.Writev(&m_Vectors[0], m_Vectors.ItemCount());
 }
 
 /*----------------------------------------------------------------------
@@ -628,38 +665,23 @@ AP4_Mpeg2TsVideoSampleStream::WriteSample(AP4_Sample&            sample,
     }
     
     // write the NAL units
-    const unsigned char* data      = sample_data.GetData();
-    unsigned int         data_size = sample_data.GetDataSize();
-    
-    // allocate a buffer for the PES packet
-    AP4_DataBuffer pes_data;
-
-    // output all NALUs
-    for (unsigned int nalu_count = 0; data_size; nalu_count++) {
-        // sanity check
-        if (data_size < m_NaluLengthSize) break;
-        
-        // get the next NAL unit
-        AP4_UI32 nalu_size;
-        if (m_NaluLengthSize == 1) {
-            nalu_size = *data++;
-            data_size--;
-        } else if (m_NaluLengthSize == 2) {
-            nalu_size = AP4_BytesToInt16BE(data);
-            data      += 2;
-            data_size -= 2;
-        } else if (m_NaluLengthSize == 4) {
-            nalu_size = AP4_BytesToInt32BE(data);
-            data      += 4;
-            data_size -= 4;
-        } else {
-            break;
-        }
-        if (nalu_size > data_size) break;
-        
+    const AP4_UI08* data      = sample_data.GetData();
+    AP4_Size        data_size = sample_data.GetDataSize();
+    const AP4_UI08* nalu      = NULL;
+    AP4_Size        nalu_size = 0;
+    
+    // allocate a buffer for the PES packet (with 4-byte NALU lengths,
+    // the 3-byte start codes always fit in the space reserved here)
+    AP4_DataBuffer   pes_data;
+    AP4_AnnexBWriter writer(pes_data);
+    writer.Reserve(6+m_Prefix.GetDataSize()+data_size);
+
+    // output the first NALU
+    if (AP4_AnnexBWriter::ReadNalu(data, data_size, m_NaluLengthSize, nalu, nalu_size)) {
         // check if we need to add a delimiter before the NALU
-        if (nalu_count == 0 && sample_description->GetType() == AP4_SampleDescription::TYPE_AVC) {
-            if (nalu_size != 2 || (data[0] & 0x1F) != AP4_AVC_NAL_UNIT_TYPE_ACCESS_UNIT_DELIMITER) {
+        bool prefix_after_nalu = false;
+        if (sample_description->GetType() == AP4_SampleDescription::TYPE_AVC) {
+            if (nalu_size != 2 || (nalu[0] & 0x1F) != AP4_AVC_NAL_UNIT_TYPE_ACCESS_UNIT_DELIMITER) {
                 // the first NAL unit is not an Access Unit Delimiter, we need to add one
                 unsigned char delimiter[6];
                 delimiter[0] = 0;
@@ -668,40 +690,25 @@ AP4_Mpeg2TsVideoSampleStream::WriteSample(AP4_Sample&            sample,
                 delimiter[3] = 1;
                 delimiter[4] = 9;    // NAL type = Access Unit Delimiter;
                 delimiter[5] = 0xF0; // Slice types = ANY
-                pes_data.AppendData(delimiter, 6);
-
-                if (emit_prefix) {
-                    pes_data.AppendData(m_Prefix.GetData(), m_Prefix.GetDataSize());
-                    emit_prefix = false;
-                }
-            }
-        } else {
-            if (emit_prefix) {
-                pes_data.AppendData(m_Prefix.GetData(), m_Prefix.GetDataSize());
-                emit_prefix = false;
+                writer.Write(delimiter, 6);
+            } else {
+                // for AVC streams that do start with a NAL unit delimiter, the prefix goes after it
+                prefix_after_nalu = true;
             }
         }
+        if (emit_prefix && !prefix_after_nalu) {
+            writer.Write(m_Prefix.GetData(), m_Prefix.GetDataSize());
+        }
         
-        // add a start code before the NAL unit
-        unsigned char start_code[3];
-        start_code[0] = 0;
-        start_code[1] = 0;
-        start_code[2] = 1;
-        pes_data.AppendData(start_code, 3);
-        
-        // add the NALU
-        pes_data.AppendData(data, nalu_size);
-        
-        // for AVC streams that do start with a NAL unit delimiter, we need to add the prefix now
-        if (emit_prefix) {
-            pes_data.AppendData(m_Prefix.GetData(), m_Prefix.GetDataSize());
-            emit_prefix = false;
+        // add the NALU, with a start code
+        writer.WriteNalu(nalu, nalu_size);
+        if (emit_prefix && prefix_after_nalu) {
+            writer.Write(m_Prefix.GetData(), m_Prefix.GetDataSize());
         }
-
-        // move to the next NAL unit
-        data      += nalu_size;
-        data_size -= nalu_size;
-    } 
+        
+        // output all the other NALUs
+        writer.WriteSample(data, data_size, m_NaluLengthSize);
+    }
     
     // compute the timestamp
     AP4_UI64 dts = AP4_ConvertTime(sample.GetDts(), m_TimeScale, 90000);
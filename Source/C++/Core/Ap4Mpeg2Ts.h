@@ -33,6 +33,8 @@
 |   includes
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
+#include "Ap4Array.h"
+#include "Ap4ByteStream.h"
 #include "Ap4DataBuffer.h"
 
 /*----------------------------------------------------------------------
@@ -83,6 +85,13 @@ public:
                                bool            with_pcr,
                                AP4_UI64        pcr,
                                AP4_ByteStream& output);
+        // same as WritePacketHeader, but into memory (at least 188 bytes)
+        // returns the number of bytes in the header
+        unsigned int MakePacketHeader(bool          payload_start, 
+                                      unsigned int& payload_size,
+                                      bool          with_pcr,
+                                      AP4_UI64      pcr,
+                                      AP4_UI08*     header);
         
     private:
         AP4_UI16     m_PID;
@@ -126,6 +135,11 @@ public:
         AP4_UI16       m_StreamId;
         AP4_UI32       m_TimeScale;
         AP4_DataBuffer m_Descriptor;
+        
+    private:
+        // scratch space for WritePES, kept from one PES to the next
+        AP4_DataBuffer          m_PacketHeaders;
+        AP4_Array<AP4_IoVector> m_Vectors;
     };
     
     // constructor
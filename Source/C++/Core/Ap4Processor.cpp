@@ -46,6 +46,7 @@
 #include "Ap4SidxAtom.h"
 #include "Ap4DataBuffer.h"
 #include "Ap4Debug.h"
+#include "Ap4Threads.h"
 
 /*----------------------------------------------------------------------
 |   types
@@ -104,6 +105,32 @@ AP4_DefaultFragmentHandler::ProcessSample(AP4_DataBuffer& data_in, AP4_DataBuffe
     return m_TrackHandler->ProcessSample(data_in, data_out);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_Processor::~AP4_Processor
++---------------------------------------------------------------------*/
+AP4_Processor::~AP4_Processor()
+{
+    delete m_ThreadPool; // stops and joins the workers
+    m_ExternalTrackData.DeleteReferences();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Processor::FragmentHandler::ProcessSamples
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Processor::FragmentHandler::ProcessSamples(AP4_Array<AP4_DataBuffer>& data_in,
+                                               AP4_Array<AP4_DataBuffer>& data_out,
+                                               AP4_ThreadPool&            /* thread_pool */)
+{
+    if (data_out.ItemCount() != data_in.ItemCount()) return AP4_ERROR_INVALID_PARAMETERS;
+    for (unsigned int i=0; i<data_in.ItemCount(); i++) {
+        AP4_Result result = ProcessSample(data_in[i], data_out[i]);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Processor::ProcessFragments
 +---------------------------------------------------------------------*/
@@ -204,17 +231,25 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
             if (AP4_FAILED(result)) return result;
         }
              
-        // write the moof
-        AP4_UI64 moof_out_start = 0;
+        // write the moof and an mdat header, to be updated later, or, for
+        // streaming output, collect the mdat payload in memory so that the
+        // moof and mdat can be written once everything is known
+        AP4_UI64              moof_out_start = 0;
+        AP4_Position          mdat_out_start;
+        AP4_UI64              mdat_size = AP4_ATOM_HEADER_SIZE;
+        AP4_MemoryByteStream* mdat_payload = NULL;
         output.Tell(moof_out_start);
-        moof->Write(output);
-            
-        // write an mdat header
-        AP4_Position mdat_out_start;
-        AP4_UI64 mdat_size = AP4_ATOM_HEADER_SIZE;
-        output.Tell(mdat_out_start);
-        output.WriteUI32(0);
-        output.WriteUI32(AP4_ATOM_TYPE_MDAT);
+        if (m_StreamingOutput) {
+            // the moof size does not change during the processing
+            mdat_out_start = moof_out_start+moof->GetSize();
+            mdat_payload   = new AP4_MemoryByteStream();
+        } else {
+            moof->Write(output);
+            output.Tell(mdat_out_start);
+            output.WriteUI32(0);
+            output.WriteUI32(AP4_ATOM_TYPE_MDAT);
+        }
+        AP4_ByteStream& mdat_output = mdat_payload ? *mdat_payload : output;
 
         // process all track runs
         for (unsigned int i=0; i<handlers.ItemCount(); i++) {
@@ -249,6 +284,30 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
             AP4_TrunAtom* trun = truns[0];
             trun->SetDataOffset((AP4_SI32)((mdat_out_start+mdat_size)-base_data_offset));
             
+            // when more than one thread may be used, let the handler process
+            // all the samples of the fragment at once before we write them out
+            AP4_Array<AP4_DataBuffer> batch_data_in;
+            AP4_Array<AP4_DataBuffer> batch_data_out;
+            bool                      batch = (handler && m_ThreadCount > 1);
+            if (batch) {
+                // the workers are started for the first fragment and
+                // then stay around until the processor is destroyed
+                if (m_ThreadPool == NULL) {
+                    m_ThreadPool = new AP4_ThreadPool();
+                    m_ThreadPool->Start(m_ThreadCount);
+                }
+                AP4_Cardinal sample_count = sample_tables[i]->GetSampleCount();
+                batch_data_in.SetItemCount(sample_count);
+                batch_data_out.SetItemCount(sample_count);
+                for (unsigned int j=0; j<sample_count; j++) {
+                    result = sample_tables[i]->GetSample(j, sample);
+                    if (AP4_FAILED(result)) goto end;
+                    sample.ReadDataView(batch_data_in[j]);
+                }
+                result = handler->ProcessSamples(batch_data_in, batch_data_out, *m_ThreadPool);
+                if (AP4_FAILED(result)) goto end;
+            }
+
             // write the mdat
             for (unsigned int j=0; j<sample_tables[i]->GetSampleCount(); j++, trun_sample_index++) {
                 // advance the trun index if necessary
@@ -258,19 +317,29 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
                     trun_sample_index = 0;
                 }
                 
+                // samples processed as a batch only need to be written out
+                if (batch) {
+                    const AP4_DataBuffer& batch_out = batch_data_out[j];
+                    result = mdat_output.Write(batch_out.GetData(), batch_out.GetDataSize());
+                    if (AP4_FAILED(result)) goto end;
+                    mdat_size += batch_out.GetDataSize();
+                    trun->UseEntries()[trun_sample_index].sample_size = batch_out.GetDataSize();
+                    continue;
+                }
+                
                 // get the next sample
                 result = sample_tables[i]->GetSample(j, sample);
-                if (AP4_FAILED(result)) return result;
-                sample.ReadData(sample_data_in);
+                if (AP4_FAILED(result)) goto end;
+                sample.ReadDataView(sample_data_in);
                 
                 // process the sample data
                 if (handler) {
                     result = handler->ProcessSample(sample_data_in, sample_data_out);
-                    if (AP4_FAILED(result)) return result;
+                    if (AP4_FAILED(result)) goto end;
 
                     // write the sample data
-                    result = output.Write(sample_data_out.GetData(), sample_data_out.GetDataSize());
-                    if (AP4_FAILED(result)) return result;
+                    result = mdat_output.Write(sample_data_out.GetData(), sample_data_out.GetDataSize());
+                    if (AP4_FAILED(result)) goto end;
 
                     // update the mdat size
                     mdat_size += sample_data_out.GetDataSize();
@@ -279,8 +348,8 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
                     trun->UseEntries()[trun_sample_index].sample_size = sample_data_out.GetDataSize();
                 } else {
                     // write the sample data (unmodified)
-                    result = output.Write(sample_data_in.GetData(), sample_data_in.GetDataSize());
-                    if (AP4_FAILED(result)) return result;
+                    result = mdat_output.Write(sample_data_in.GetData(), sample_data_in.GetDataSize());
+                    if (AP4_FAILED(result)) goto end;
 
                     // update the mdat size
                     mdat_size += sample_data_in.GetDataSize();
@@ -301,20 +370,33 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
             }
         }
 
-        // update the mdat header
         AP4_Position mdat_out_end;
-        output.Tell(mdat_out_end);
+        if (mdat_payload) {
+            // write the final moof and the mdat
+            moof->Write(output);
+            output.WriteUI32((AP4_UI32)mdat_size);
+            output.WriteUI32(AP4_ATOM_TYPE_MDAT);
+            result = output.Write(mdat_payload->GetData(), mdat_payload->GetDataSize());
+            if (AP4_FAILED(result)) goto end;
+            output.Tell(mdat_out_end);
 #if defined(AP4_DEBUG)
-        AP4_ASSERT(mdat_out_end-mdat_out_start == mdat_size);
+            AP4_ASSERT(mdat_out_end-mdat_out_start == mdat_size);
 #endif
-        output.Seek(mdat_out_start);
-        output.WriteUI32((AP4_UI32)mdat_size);
-        output.Seek(mdat_out_end);
-        
-        // update the moof if needed
-        output.Seek(moof_out_start);
-        moof->Write(output);
-        output.Seek(mdat_out_end);
+        } else {
+            // update the mdat header
+            output.Tell(mdat_out_end);
+#if defined(AP4_DEBUG)
+            AP4_ASSERT(mdat_out_end-mdat_out_start == mdat_size);
+#endif
+            output.Seek(mdat_out_start);
+            output.WriteUI32((AP4_UI32)mdat_size);
+            output.Seek(mdat_out_end);
+            
+            // update the moof if needed
+            output.Seek(moof_out_start);
+            moof->Write(output);
+            output.Seek(mdat_out_end);
+        }
         
         // update the mfra if we have one
         if (mfra) {
@@ -344,7 +426,11 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
             sidx_ref.m_ReferencedSize = (AP4_UI32)fragment_size;
         }
         
+        result = AP4_SUCCESS;
+        
+end:
         // cleanup
+        if (mdat_payload) mdat_payload->Release();
         delete fragment;
         
         for (unsigned int i=0; i<handlers.ItemCount(); i++) {
@@ -353,6 +439,7 @@ AP4_Processor::ProcessFragments(AP4_MoovAtom*              moov,
         for (unsigned int i=0; i<sample_tables.ItemCount(); i++) {
             delete sample_tables[i];
         }
+        if (AP4_FAILED(result)) return result;
     }
      
     return AP4_SUCCESS;
@@ -383,17 +470,20 @@ AP4_Processor::CreateFragmentHandler(AP4_TrakAtom*      /* trak */,
 |   AP4_Processor::Process
 +---------------------------------------------------------------------*/
 AP4_Result
-AP4_Processor::Process(AP4_ByteStream&   input, 
+AP4_Processor::Process(AP4_AtomParent&   top_level,
+                       AP4_ByteStream&   input, 
                        AP4_ByteStream&   output,
                        AP4_ByteStream*   fragments,
                        ProgressListener* listener,
                        AP4_AtomFactory&  atom_factory)
 {
-    // read all atoms.
-    // keep all atoms except [mdat]
+    // read all atoms, starting with the ones already in top_level
+    // (they are taken out, and put back only if they are kept below,
+    // so top_level is modified).
+    // keep all atoms except [mdat], [ssix], [mfra] and extra [sidx]
     // keep a ref to [moov]
     // put [moof] atoms in a separate list
-    AP4_AtomParent              top_level;
+    AP4_Cardinal                parsed_count = top_level.GetChildren().ItemCount();
     AP4_MoovAtom*               moov = NULL;
     AP4_ContainerAtom*          mfra = NULL;
     AP4_SidxAtom*               sidx = NULL;
@@ -401,9 +491,14 @@ AP4_Processor::Process(AP4_ByteStream&   input,
     AP4_UI64                    stream_offset = 0;
     bool                        in_fragments = false;
     unsigned int                sidx_count = 0;
-    for (AP4_Atom* atom = NULL;
-        AP4_SUCCEEDED(atom_factory.CreateAtomFromStream(input, atom));
-        input.Tell(stream_offset)) {
+    for (AP4_Atom* atom = NULL;; input.Tell(stream_offset)) {
+        if (parsed_count) {
+            --parsed_count;
+            atom = top_level.GetChildren().FirstItem()->GetData();
+            atom->Detach();
+        } else if (AP4_FAILED(atom_factory.CreateAtomFromStream(input, atom))) {
+            break;
+        }
         if (atom->GetType() == AP4_ATOM_TYPE_MDAT) {
             delete atom;
             continue;
@@ -435,7 +530,8 @@ AP4_Processor::Process(AP4_ByteStream&   input,
     }
 
     // check that we have at most one sidx (we can't deal with multi-sidx streams here
-    if (sidx_count > 1) {
+    // and we can't go back to update it when streaming)
+    if (sidx_count > 1 || (sidx && m_StreamingOutput)) {
         top_level.RemoveChild(sidx);
         delete sidx;
         sidx = NULL;
@@ -633,7 +729,7 @@ AP4_Processor::Process(AP4_ByteStream&   input,
             AP4_DataBuffer data_out;
             for (unsigned int i=0; i<locators.ItemCount(); i++) {
                 AP4_SampleLocator& locator = locators[i];
-                locator.m_Sample.ReadData(data_in);
+                locator.m_Sample.ReadDataView(data_in);
                 TrackHandler* handler = m_TrackHandlers[locator.m_TrakIndex];
                 if (handler) {
                     result = handler->ProcessSample(data_in, data_out);
@@ -716,7 +812,21 @@ AP4_Processor::Process(AP4_ByteStream&   input,
                        ProgressListener* listener,
                        AP4_AtomFactory&  atom_factory)
 {
-    return Process(input, output, NULL, listener, atom_factory);
+    AP4_AtomParent top_level;
+    return Process(top_level, input, output, NULL, listener, atom_factory);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Processor::Process
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Processor::Process(AP4_AtomParent&   top_level,
+                       AP4_ByteStream&   input, 
+                       AP4_ByteStream&   output,
+                       ProgressListener* listener,
+                       AP4_AtomFactory&  atom_factory)
+{
+    return Process(top_level, input, output, NULL, listener, atom_factory);
 }
 
 /*----------------------------------------------------------------------
@@ -729,7 +839,8 @@ AP4_Processor::Process(AP4_ByteStream&   fragments,
                        ProgressListener* listener,
                        AP4_AtomFactory&  atom_factory)
 {
-    return Process(init, output, &fragments, listener, atom_factory);
+    AP4_AtomParent top_level;
+    return Process(top_level, init, output, &fragments, listener, atom_factory);
 }
 
 /*----------------------------------------------------------------------
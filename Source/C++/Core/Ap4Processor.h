@@ -48,6 +48,7 @@ class AP4_TrakAtom;
 class AP4_TrexAtom;
 class AP4_SidxAtom;
 class AP4_FragmentSampleTable;
+class AP4_ThreadPool;
 struct AP4_AtomLocator;
 
 /*----------------------------------------------------------------------
@@ -156,12 +157,55 @@ public:
          */
         virtual AP4_Result ProcessSample(AP4_DataBuffer& data_in,
                                          AP4_DataBuffer& data_out) = 0;
+
+        /**
+         * Process the data of all the samples of the fragment at once.
+         * This method is only called when the processor is configured to
+         * use more than one thread. The default implementation calls
+         * ProcessSample() for each sample, in order. A fragment handler 
+         * may override this method to spread the work over several threads,
+         * as long as the result is identical to that of the serial version.
+         * @param data_in Array of data buffers with the data of the samples
+         * to process.
+         * @param data_out Array of data buffers, with the same number of 
+         * entries as data_in, in which the processed sample data is returned.
+         * @param thread_pool Worker pool of the processor, started once and
+         * shared by all the fragments, to which the work may be submitted.
+         */
+        virtual AP4_Result ProcessSamples(AP4_Array<AP4_DataBuffer>& data_in,
+                                          AP4_Array<AP4_DataBuffer>& data_out,
+                                          AP4_ThreadPool&            thread_pool);
     };
 
+    /**
+     * Default constructor
+     */
+    AP4_Processor() : m_ThreadCount(1), m_ThreadPool(NULL), m_StreamingOutput(false) {}
+    
     /**
      *  Default destructor
      */
-    virtual ~AP4_Processor() { m_ExternalTrackData.DeleteReferences(); }
+    virtual ~AP4_Processor();
+
+    /**
+     * Set the maximum number of threads that fragment handlers may use
+     * to process the samples of a fragment. A value of 0 or 1 means that
+     * all samples are processed serially by the calling thread.
+     */
+    void SetThreadCount(AP4_Cardinal thread_count) { 
+        m_ThreadCount = thread_count ? thread_count : 1; 
+    }
+    AP4_Cardinal GetThreadCount() const { return m_ThreadCount; }
+
+    /**
+     * Enable or disable streaming output. When enabled, the output is 
+     * written strictly forward, without ever seeking back, so that it can
+     * be a pipe or a socket. Each fragment is processed entirely in memory
+     * before it is written out. An input 'sidx' index cannot be updated
+     * without seeking back, so it is not copied to the output in this mode.
+     */
+    void SetStreamingOutput(bool streaming) { m_StreamingOutput = streaming; }
+    bool GetStreamingOutput() const         { return m_StreamingOutput;      }
 
     /**
      * Process the input stream into an output stream.
@@ -178,6 +222,31 @@ public:
                        AP4_AtomFactory&  atom_factory = 
                            AP4_DefaultAtomFactory::Instance);
 
+    /**
+     * Process an input stream of which the top-level atoms, up to and
+     * including the 'moov' atom, have already been parsed, for example
+     * by an AP4_File created with moov_only set to true. The other atoms
+     * are read from the current position of the input stream. The parsed
+     * atoms are processed in place, so they are modified by this call:
+     * when it returns, top_level no longer contains the 'mdat', 'ssix'
+     * and 'mfra' atoms, nor the 'sidx' atoms that are not kept, and the 
+     * 'moof' atoms, as well as all the atoms that follow the first one, 
+     * have been removed and deleted.
+     * @param top_level Atoms already parsed from the input stream.
+     * @param input Input stream from which the atoms were parsed.
+     * @param output Output stream to which the processed input
+     * will be written.
+     * @param listener Pointer to a listener, or NULL. The listener
+     * will be called one or more times before this method returns, 
+     * with progress information.
+     */
+    AP4_Result Process(AP4_AtomParent&   top_level,
+                       AP4_ByteStream&   input, 
+                       AP4_ByteStream&   output,
+                       ProgressListener* listener = NULL,
+                       AP4_AtomFactory&  atom_factory = 
+                           AP4_DefaultAtomFactory::Instance);
+
     /**
      * Process a fragment input stream into an output stream.
      * @param fragments Input stream from which to read the fragments.
@@ -252,7 +321,8 @@ protected:
         AP4_ByteStream* m_MediaData;
     };
 
-    AP4_Result Process(AP4_ByteStream&   input, 
+    AP4_Result Process(AP4_AtomParent&   top_level,
+                       AP4_ByteStream&   input, 
                        AP4_ByteStream&   output,
                        AP4_ByteStream*   fragments,
                        ProgressListener* listener,
@@ -270,6 +340,9 @@ protected:
     AP4_List<ExternalTrackData> m_ExternalTrackData;
     AP4_Array<AP4_UI32>         m_TrackIds;
     AP4_Array<TrackHandler*>    m_TrackHandlers;
+    AP4_Cardinal                m_ThreadCount;
+    AP4_ThreadPool*             m_ThreadPool;
+    bool                        m_StreamingOutput;
 };
 
 #endif // _AP4_PROCESSOR_H_
@@ -791,7 +791,9 @@ AP4_SampleDecrypter::Create(AP4_ProtectedSampleDescription* sample_description,
 
     switch(sample_description->GetSchemeType()) {
         case AP4_PROTECTION_SCHEME_TYPE_PIFF: 
-        case AP4_PROTECTION_SCHEME_TYPE_CENC: {
+        case AP4_PROTECTION_SCHEME_TYPE_CENC: 
+        case AP4_PROTECTION_SCHEME_TYPE_CENS: 
+        case AP4_PROTECTION_SCHEME_TYPE_CBCS: {
             AP4_CencSampleDecrypter* decrypter = NULL;
             AP4_Result result = AP4_CencSampleDecrypter::Create(sample_description, 
                                                                 traf,
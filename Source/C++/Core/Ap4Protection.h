@@ -313,6 +313,15 @@ public:
                                AP4_Size        input_size,
                                AP4_UI08*       output,
                                const AP4_UI08* iv) = 0;
+
+    // encrypt 'block_count' independent blocks with the forward cipher
+    // (no chaining, no IV). This lets CTR mode compute many keystream blocks
+    // in a single call. Ciphers that can't do this return AP4_ERROR_NOT_SUPPORTED
+    virtual AP4_Result EncryptBlocks(const AP4_UI08* /* input       */,
+                                     AP4_Cardinal    /* block_count */,
+                                     AP4_UI08*       /* output      */) {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
 };
 
 /*----------------------------------------------------------------------
@@ -128,6 +128,25 @@ AP4_Sample::ReadData(AP4_DataBuffer& data)
 }
 
 
+/*----------------------------------------------------------------------
+|   AP4_Sample::ReadDataView
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Sample::ReadDataView(AP4_DataBuffer& data)
+{
+    // check that we have a stream
+    if (m_DataStream == NULL) return AP4_FAILURE;
+
+    // try to borrow the data directly from the stream
+    const AP4_UI08* view = NULL;
+    if (m_Size && AP4_SUCCEEDED(m_DataStream->Borrow(m_Offset, m_Size, view))) {
+        return data.SetView(view, m_Size);
+    }
+
+    // fallback to a copy
+    return ReadData(data, m_Size);
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Sample::ReadData
 +---------------------------------------------------------------------*/
@@ -147,10 +166,9 @@ AP4_Sample::ReadData(AP4_DataBuffer& data, AP4_Size size, AP4_Size offset)
     AP4_Result result = data.SetDataSize(size);
     if (AP4_FAILED(result)) return result;
 
-    // get the data from the stream
-    result = m_DataStream->Seek(m_Offset+offset);
-    if (AP4_FAILED(result)) return result;
-    return m_DataStream->Read(data.UseData(), size);
+    // get the data from the stream (positional read, so that samples
+    // can be read from several threads when the stream supports it)
+    return m_DataStream->ReadAt(m_Offset+offset, data.UseData(), size);
 }
 
 /*----------------------------------------------------------------------
@@ -91,6 +91,14 @@ public:
     AP4_Result      ReadData(AP4_DataBuffer& data, 
                              AP4_Size        size, 
                              AP4_Size        offset = 0);
+    /**
+     * Read the sample data without copying it when possible.
+     * If the data stream supports AP4_ByteStream::Borrow (memory and memory
+     * mapped streams), the buffer is set to be a read-only view of the 
+     * stream's data, which remains valid only as long as the stream does.
+     * Otherwise the data is copied, like with ReadData.
+     */
+    AP4_Result      ReadDataView(AP4_DataBuffer& data);
     void            Detach();
     
     // sample properties accessors
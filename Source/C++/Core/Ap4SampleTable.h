@@ -33,6 +33,7 @@
 |   includes
 +---------------------------------------------------------------------*/
 #include "Ap4Types.h"
+#include "Ap4Results.h"
 #include "Ap4DynamicCast.h"
 
 /*----------------------------------------------------------------------
@@ -64,6 +65,13 @@ public:
     virtual AP4_Result   GetSampleIndexForTimeStamp(AP4_UI64     ts,
                                                     AP4_Ordinal& index) = 0;
     virtual AP4_Ordinal  GetNearestSyncSampleIndex(AP4_Ordinal index, bool before=true) = 0;
+
+    /**
+     * Build any state that GetSample() would otherwise create lazily, so
+     * that GetSample() can then be called from several threads at once
+     * (as long as the table is not modified at the same time).
+     */
+    virtual AP4_Result   PrepareForConcurrentReads() { return AP4_SUCCESS; }
 };
 
 #endif // _AP4_SAMPLE_TABLE_H_
@@ -86,12 +86,19 @@ AP4_SbgpAtom::AP4_SbgpAtom(AP4_UI32        size,
     if (remains < entry_count*8) {
         return;
     }
+    if (entry_count == 0) return;
+
+    // read the table in one go and convert it
+    AP4_DataBuffer buffer(entry_count*8);
+    buffer.SetDataSize(entry_count*8);
+    result = stream.Read(buffer.UseData(), entry_count*8);
+    if (AP4_FAILED(result)) return;
+    AP4_UI32* fields = (AP4_UI32*)buffer.UseData();
+    AP4_BytesToUInt32BEArray(buffer.GetData(), fields, entry_count*2);
     m_Entries.SetItemCount(entry_count);
     for (unsigned int i=0; i<entry_count; i++) {
-        Entry entry;
-        stream.ReadUI32(entry.sample_count);
-        stream.ReadUI32(entry.group_description_index);
-        m_Entries[i] = entry;
+        m_Entries[i].sample_count            = fields[2*i  ];
+        m_Entries[i].group_description_index = fields[2*i+1];
     }
 }
 
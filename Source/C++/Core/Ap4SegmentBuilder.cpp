@@ -43,6 +43,7 @@
 #include "Ap4MfhdAtom.h"
 #include "Ap4TrunAtom.h"
 #include "Ap4TfdtAtom.h"
+#include "Ap4Utils.h"
 
 /*----------------------------------------------------------------------
 |   constants
@@ -62,7 +63,11 @@ AP4_SegmentBuilder::AP4_SegmentBuilder(AP4_Track::Type track_type,
     m_SampleStartNumber(0),
     m_MediaTimeOrigin(media_time_origin),
     m_MediaStartTime(0),
-    m_MediaDuration(0)
+    m_MediaDuration(0),
+    m_ChunkListener(NULL),
+    m_MaxChunkSamples(0),
+    m_MaxChunkDuration(0),
+    m_ChunkSequenceNumber(1)
 {
 }
 
@@ -80,13 +85,80 @@ AP4_SegmentBuilder::~AP4_SegmentBuilder()
 AP4_Result
 AP4_SegmentBuilder::AddSample(AP4_Sample& sample)
 {
-    AP4_Result result = m_Samples.Append(sample);
+    AP4_Result result;
+    
+    // in low-latency mode, a full chunk is delivered before the next sample
+    if (m_ChunkListener && IsChunkFull() && CanStartChunk(sample)) {
+        result = FlushChunk();
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    result = m_Samples.Append(sample);
     if (AP4_FAILED(result)) return result;
     m_MediaDuration += sample.GetDuration();
     
     return AP4_SUCCESS;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::SetChunkListener
++---------------------------------------------------------------------*/
+void
+AP4_SegmentBuilder::SetChunkListener(ChunkListener* listener,
+                                     AP4_Cardinal   max_chunk_samples,
+                                     AP4_UI32       max_chunk_duration_ms)
+{
+    m_ChunkListener    = listener;
+    m_MaxChunkSamples  = max_chunk_samples;
+    m_MaxChunkDuration = max_chunk_duration_ms;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::IsChunkFull
++---------------------------------------------------------------------*/
+bool
+AP4_SegmentBuilder::IsChunkFull()
+{
+    if (m_Samples.ItemCount() == 0) return false;
+    if (m_MaxChunkSamples && m_Samples.ItemCount() >= m_MaxChunkSamples) {
+        return true;
+    }
+    if (m_MaxChunkDuration && m_Timescale &&
+        AP4_ConvertTime(m_MediaDuration, m_Timescale, 1000) >= m_MaxChunkDuration) {
+        return true;
+    }
+    return false;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SegmentBuilder::FlushChunk
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SegmentBuilder::FlushChunk()
+{
+    if (m_ChunkListener == NULL) return AP4_ERROR_INVALID_STATE;
+    if (m_Samples.ItemCount() == 0) return AP4_SUCCESS;
+    
+    // remember the chunk info, WriteMediaSegment() resets it
+    AP4_UI64 media_start_time = m_MediaTimeOrigin+m_MediaStartTime;
+    AP4_UI64 media_duration   = m_MediaDuration;
+    bool     independent      = m_Samples[0].IsSync();
+    
+    // write the 'moof' and 'mdat' to memory
+    m_ChunkData.SetDataSize(0);
+    AP4_MemoryByteStream* stream = new AP4_MemoryByteStream(m_ChunkData);
+    AP4_Result result = WriteMediaSegment(*stream, m_ChunkSequenceNumber);
+    stream->Release();
+    if (AP4_FAILED(result)) return result;
+    
+    result = m_ChunkListener->OnChunk(m_ChunkData,
+                                      m_ChunkSequenceNumber++,
+                                      media_start_time,
+                                      media_duration,
+                                      independent);
+    return result;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_FeedSegmentBuilder::AP4_FeedSegmentBuilder
 +---------------------------------------------------------------------*/
@@ -145,9 +217,22 @@ AP4_SegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int seque
     AP4_UI32 first_sample_flags = 0;
     if (m_TrackType == AP4_Track::TYPE_VIDEO) {
         trun_flags |= AP4_TRUN_FLAG_FIRST_SAMPLE_FLAGS_PRESENT;
-        first_sample_flags = 0x2000000; // sample_depends_on=2 (I frame)
+        if (m_Samples.ItemCount() && !m_Samples[0].IsSync()) {
+            first_sample_flags = 0x1010000; // sample_is_non_sync_sample=1, sample_depends_on=1 (not I frame)
+        } else {
+            first_sample_flags = 0x2000000; // sample_depends_on=2 (I frame)
+        }
+    }
+    
+    // negative CTS offsets need a version 1 'trun'
+    AP4_UI08 trun_version = 0;
+    for (unsigned int i=0; i<m_Samples.ItemCount(); i++) {
+        if ((AP4_SI32)m_Samples[i].GetCtsDelta() < 0) {
+            trun_version = 1;
+            break;
+        }
     }
-    AP4_TrunAtom* trun = new AP4_TrunAtom(trun_flags, 0, first_sample_flags);
+    AP4_TrunAtom* trun = new AP4_TrunAtom(trun_flags, 0, first_sample_flags, trun_version);
     
     traf->AddChild(trun);
     moof->AddChild(traf);
@@ -240,6 +325,23 @@ AP4_AvcSegmentBuilder::Feed(const void* data,
             sample_data->Write(access_unit_info.nal_units[i]->GetData(), access_unit_info.nal_units[i]->GetDataSize());
         }
         
+        // in low-latency mode, a full chunk is delivered before this access
+        // unit, unless the pending pictures could still be reordered across
+        // the boundary (the access unit must be an IDR or be displayed after
+        // all the pending pictures)
+        if (m_ChunkListener && IsChunkFull()) {
+            bool can_start_chunk = true;
+            if (!access_unit_info.is_idr) {
+                for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
+                    if (m_SampleOrders[i].m_DisplayOrder >= access_unit_info.display_order) {
+                        can_start_chunk = false;
+                        break;
+                    }
+                }
+            }
+            if (can_start_chunk) result = FlushChunk();
+        }
+        
         // compute the timestamp in a drift-less manner
         AP4_UI32 duration = 0;
         AP4_UI64 dts      = 0;
@@ -252,7 +354,7 @@ AP4_AvcSegmentBuilder::Feed(const void* data,
 
         // create a new sample and add it to the list
         AP4_Sample sample(*sample_data, 0, sample_data_size, duration, 0, dts, 0, access_unit_info.is_idr);
-        AddSample(sample);
+        if (AP4_SUCCEEDED(result)) result = AddSample(sample);
         sample_data->Release();
         
         // remember the sample order
@@ -263,6 +365,7 @@ AP4_AvcSegmentBuilder::Feed(const void* data,
             delete access_unit_info.nal_units[i];
         }
         access_unit_info.nal_units.Clear();
+        if (AP4_FAILED(result)) return result;
         
         return 1; // one access unit returned
     }
@@ -299,6 +402,16 @@ AP4_AvcSegmentBuilder::SortSamples(SampleOrder* array, unsigned int n)
     SortSamples(left, (unsigned int)(array + n - left));
 }
 
+/*----------------------------------------------------------------------
+|   AP4_AvcSegmentBuilder::CanStartChunk
++---------------------------------------------------------------------*/
+bool
+AP4_AvcSegmentBuilder::CanStartChunk(const AP4_Sample& /* sample */)
+{
+    // chunks are delivered by Feed(), where the display order is known
+    return false;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_AvcSegmentBuilder::WriteMediaSegment
 +---------------------------------------------------------------------*/
@@ -324,6 +437,23 @@ AP4_AvcSegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int se
             }
         }
 
+        // in low-latency mode, the pictures of a chunk are not reordered
+        // across chunks, so they are displayed within the chunk's own time
+        // range, which may mean negative CTS offsets
+        if (m_ChunkListener) {
+            for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
+                if (m_SampleOrders[i].m_DecodeOrder >= m_Samples.ItemCount()) continue;
+                AP4_Sample& sample = m_Samples[m_SampleOrders[i].m_DecodeOrder];
+                AP4_UI64 cts = m_Samples[i].GetDts();
+                if (m_Timescale) {
+                    cts = (AP4_UI64)((double)m_Timescale/m_FramesPerSecond*(double)i);
+                }
+                sample.SetCtsDelta((AP4_UI32)(cts-sample.GetDts()));
+            }
+            m_SampleOrders.Clear();
+            return AP4_SegmentBuilder::WriteMediaSegment(stream, sequence_number);
+        }
+        
         // compute the max CTS delta
         unsigned int max_delta = 0;
         for (unsigned int i=0; i<m_SampleOrders.ItemCount(); i++) {
@@ -345,9 +475,8 @@ AP4_AvcSegmentBuilder::WriteMediaSegment(AP4_ByteStream& stream, unsigned int se
                 m_Samples[m_SampleOrders[i].m_DecodeOrder].SetCts(dts);
             }
         }
-    
-        m_SampleOrders.Clear();
     }
+    m_SampleOrders.Clear();
     
     return AP4_SegmentBuilder::WriteMediaSegment(stream, sequence_number);
 }
@@ -52,6 +52,23 @@ class AP4_MpegAudioSampleDescription;
 class AP4_SegmentBuilder
 {
 public:
+    // types
+    /**
+     * Listener that receives the chunks produced in low-latency mode.
+     * Each chunk is a complete 'moof' + 'mdat' pair (a CMAF chunk) that
+     * can be sent as soon as it is delivered. The chunk data is only valid
+     * for the duration of the call.
+     */
+    class ChunkListener {
+    public:
+        virtual ~ChunkListener() {}
+        virtual AP4_Result OnChunk(const AP4_DataBuffer& chunk,
+                                   unsigned int          sequence_number,
+                                   AP4_UI64              media_start_time,
+                                   AP4_UI64              media_duration,
+                                   bool                  independent) = 0;
+    };
+
     // constructor and destructor
     AP4_SegmentBuilder(AP4_Track::Type track_type,
                        AP4_UI32        track_id,
@@ -69,9 +86,31 @@ public:
     virtual AP4_Result AddSample(AP4_Sample& sample);
     virtual AP4_Result WriteMediaSegment(AP4_ByteStream& stream, unsigned int sequence_number);
     virtual AP4_Result WriteInitSegment(AP4_ByteStream& stream) = 0;
-    
+
+    /**
+     * Switch to low-latency mode. Instead of being kept until the next call
+     * to WriteMediaSegment(), the samples are delivered to the listener as
+     * chunks of at most max_chunk_samples samples or max_chunk_duration_ms
+     * milliseconds (0 means no limit). A chunk is closed when the first
+     * sample that does not fit arrives, so that it can start the next one.
+     * Chunks are numbered from 1. Pass NULL to go back to whole segments.
+     */
+    void SetChunkListener(ChunkListener* listener,
+                          AP4_Cardinal   max_chunk_samples,
+                          AP4_UI32       max_chunk_duration_ms = 0);
+
+    /**
+     * Deliver the pending samples as a chunk right away, for example at the
+     * end of a segment or of the stream.
+     */
+    AP4_Result FlushChunk();
+
 protected:
     // methods
+    bool         IsChunkFull();
+    virtual bool CanStartChunk(const AP4_Sample& /* sample */) { return true; }
+
+    // members
     AP4_Track::Type       m_TrackType;
     AP4_UI32              m_TrackId;
     AP4_String            m_TrackLanguage;
@@ -81,6 +120,11 @@ protected:
     AP4_UI64              m_MediaStartTime;
     AP4_UI64              m_MediaDuration;
     AP4_Array<AP4_Sample> m_Samples;
+    ChunkListener*        m_ChunkListener;
+    AP4_Cardinal          m_MaxChunkSamples;
+    AP4_UI32              m_MaxChunkDuration;
+    unsigned int          m_ChunkSequenceNumber;
+    AP4_DataBuffer        m_ChunkData;
 };
 
 /*----------------------------------------------------------------------
@@ -133,6 +177,9 @@ protected:
     // methods
     void SortSamples(SampleOrder* array, unsigned int n);
 
+    // AP4_SegmentBuilder methods
+    virtual bool CanStartChunk(const AP4_Sample& sample);
+
     // members
     AP4_AvcFrameParser     m_FrameParser;
     double                 m_FramesPerSecond;
@@ -42,13 +42,13 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_StcoAtom)
 |   AP4_StcoAtom::Create
 +---------------------------------------------------------------------*/
 AP4_StcoAtom*
-AP4_StcoAtom::Create(AP4_Size size, AP4_ByteStream& stream)
+AP4_StcoAtom::Create(AP4_Size size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version != 0) return NULL;
-    return new AP4_StcoAtom(size, version, flags, stream);
+    return new AP4_StcoAtom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
@@ -70,24 +70,25 @@ AP4_Atom(AP4_ATOM_TYPE_STCO,
 AP4_StcoAtom::AP4_StcoAtom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
-    AP4_Atom(AP4_ATOM_TYPE_STCO, size, version, flags)
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
+    AP4_Atom(AP4_ATOM_TYPE_STCO, size, version, flags),
+    m_Entries(NULL)
 {
     stream.ReadUI32(m_EntryCount);
     if (m_EntryCount > (size-AP4_FULL_ATOM_HEADER_SIZE-4)/4) {
         m_EntryCount = (size-AP4_FULL_ATOM_HEADER_SIZE-4)/4;
     }
-    m_Entries = new AP4_UI32[m_EntryCount];
-    unsigned char* buffer = new unsigned char[m_EntryCount*4];
-    AP4_Result result = stream.Read(buffer, m_EntryCount*4);
-    if (AP4_FAILED(result)) {
-        delete[] buffer;
+    if (lazy && AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, m_EntryCount*4))) {
+        // the table will be read when it is first needed
         return;
     }
-    for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
-        m_Entries[i] = AP4_BytesToUInt32BE(&buffer[i*4]);
-    }
-    delete[] buffer;
+    m_Entries = new AP4_UI32[m_EntryCount];
+    
+    // read the table in one go and convert it in place
+    AP4_Result result = stream.Read(m_Entries, m_EntryCount*4);
+    if (AP4_FAILED(result)) return;
+    AP4_BytesToUInt32BEArray((const unsigned char*)m_Entries, m_Entries, m_EntryCount);
 }
 
 /*----------------------------------------------------------------------
@@ -98,6 +99,25 @@ AP4_StcoAtom::~AP4_StcoAtom()
     delete[] m_Entries;
 }
 
+/*----------------------------------------------------------------------
+|   AP4_StcoAtom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StcoAtom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+
+    m_Entries = new AP4_UI32[m_EntryCount];
+    AP4_Result result = m_DeferredEntries.Load(m_Entries);
+    if (AP4_FAILED(result)) {
+        AP4_SetMemory(m_Entries, 0, m_EntryCount*4);
+        return result;
+    }
+    AP4_BytesToUInt32BEArray((const unsigned char*)m_Entries, m_Entries, m_EntryCount);
+
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_StcoAtom::GetChunkOffset
 +---------------------------------------------------------------------*/
@@ -110,6 +130,7 @@ AP4_StcoAtom::GetChunkOffset(AP4_Ordinal chunk, AP4_UI32& chunk_offset)
     }
 
     // get the chunk offset
+    LoadEntries();
     chunk_offset = m_Entries[chunk - 1]; // m_Entries is zero index based
 
     return AP4_SUCCESS;
@@ -126,7 +147,8 @@ AP4_StcoAtom::SetChunkOffset(AP4_Ordinal chunk, AP4_UI32 chunk_offset)
         return AP4_ERROR_OUT_OF_RANGE;
     }
 
-    // get the chunk offset
+    // set the chunk offset
+    LoadEntries();
     m_Entries[chunk - 1] = chunk_offset; // m_Entries is zero index based
 
     return AP4_SUCCESS;
@@ -138,6 +160,7 @@ AP4_StcoAtom::SetChunkOffset(AP4_Ordinal chunk, AP4_UI32 chunk_offset)
 AP4_Result
 AP4_StcoAtom::AdjustChunkOffsets(int delta)
 {
+    LoadEntries();
     for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
         m_Entries[i] += delta;
     }
@@ -158,6 +181,8 @@ AP4_StcoAtom::WriteFields(AP4_ByteStream& stream)
     if (AP4_FAILED(result)) return result;
 
     // entries
+    result = LoadEntries();
+    if (AP4_FAILED(result)) return result;
     for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
         result = stream.WriteUI32(m_Entries[i]);
         if (AP4_FAILED(result)) return result;
@@ -174,6 +199,7 @@ AP4_StcoAtom::InspectFields(AP4_AtomInspector& inspector)
 {
     inspector.AddField("entry_count", m_EntryCount);
     if (inspector.GetVerbosity() >= 1) {
+        LoadEntries();
         char header[32];
         for (AP4_Ordinal i=0; i<m_EntryCount; i++) {
             AP4_FormatString(header, sizeof(header), "entry %8d", i);
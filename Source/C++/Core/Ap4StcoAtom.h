@@ -44,7 +44,9 @@ public:
     AP4_IMPLEMENT_DYNAMIC_CAST_D(AP4_StcoAtom, AP4_Atom)
 
     // class methods
-    static AP4_StcoAtom* Create(AP4_Size size, AP4_ByteStream& stream);
+    static AP4_StcoAtom* Create(AP4_Size        size, 
+                                AP4_ByteStream& stream,
+                                bool            lazy = false);
 
     // methods
     AP4_StcoAtom(AP4_UI32* offsets, AP4_UI32 offset_count);
@@ -52,7 +54,7 @@ public:
     virtual AP4_Result InspectFields(AP4_AtomInspector& inspector);
     virtual AP4_Result WriteFields(AP4_ByteStream& stream);
     AP4_Cardinal GetChunkCount()   { return m_EntryCount;  }
-    AP4_UI32*    GetChunkOffsets() { return m_Entries;     }
+    AP4_UI32*    GetChunkOffsets() { LoadEntries(); return m_Entries; }
     AP4_Result   GetChunkOffset(AP4_Ordinal chunk, AP4_UI32& chunk_offset);
     AP4_Result   SetChunkOffset(AP4_Ordinal chunk, AP4_UI32  chunk_offset);
     AP4_Result   AdjustChunkOffsets(int delta);
@@ -62,11 +64,14 @@ private:
     AP4_StcoAtom(AP4_UI32        size, 
                  AP4_UI08        version,
                  AP4_UI32        flags,
-                 AP4_ByteStream& stream);
+                 AP4_ByteStream& stream,
+                 bool            lazy);
+    AP4_Result LoadEntries();
 
     // members
-    AP4_UI32* m_Entries;
-    AP4_UI32  m_EntryCount;
+    AP4_UI32*               m_Entries;
+    AP4_UI32                m_EntryCount;
+    AP4_DeferredAtomPayload m_DeferredEntries;
 };
 
 #endif // _AP4_STCO_ATOM_H_
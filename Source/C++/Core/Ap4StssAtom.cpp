@@ -42,13 +42,13 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_StssAtom)
 |   AP4_StssAtom::Create
 +---------------------------------------------------------------------*/
 AP4_StssAtom*
-AP4_StssAtom::Create(AP4_Size size, AP4_ByteStream& stream)
+AP4_StssAtom::Create(AP4_Size size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version != 0) return NULL;
-    return new AP4_StssAtom(size, version, flags, stream);
+    return new AP4_StssAtom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
@@ -65,7 +65,8 @@ AP4_StssAtom::AP4_StssAtom() :
 AP4_StssAtom::AP4_StssAtom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
     AP4_Atom(AP4_ATOM_TYPE_STSS, size, version, flags),
     m_LookupCache(0)
 {
@@ -75,18 +76,46 @@ AP4_StssAtom::AP4_StssAtom(AP4_UI32        size,
     // check for bogus values
     if (entry_count*4 > size) return;
     
-    // read the table into a local array for conversion
-    unsigned char* buffer = new unsigned char[entry_count*4];
-    AP4_Result result = stream.Read(buffer, entry_count*4);
+    // if the table is complete, we can wait until it is needed
+    if (lazy && (AP4_UI64)entry_count*4 <= size-AP4_FULL_ATOM_HEADER_SIZE-4) {
+        if (AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, entry_count*4))) return;
+    }
+
+    // read the table in one go and convert it in place
+    m_Entries.SetItemCount(entry_count);
+    if (entry_count == 0) return;
+    AP4_UI32* entries = &m_Entries[0];
+    AP4_Result result = stream.Read(entries, entry_count*4);
     if (AP4_FAILED(result)) {
-        delete[] buffer;
+        m_Entries.SetItemCount(0);
         return;
     }
+    AP4_BytesToUInt32BEArray((const unsigned char*)entries, entries, entry_count);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_StssAtom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StssAtom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+    
+    AP4_Cardinal entry_count = m_DeferredEntries.GetSize()/4;
     m_Entries.SetItemCount(entry_count);
-    for (unsigned int i=0; i<entry_count; i++) {
-        m_Entries[i] = AP4_BytesToUInt32BE(&buffer[i*4]);
+    if (entry_count == 0) {
+        m_DeferredEntries.Detach();
+        return AP4_SUCCESS;
+    }
+    AP4_UI32* entries = &m_Entries[0];
+    AP4_Result result = m_DeferredEntries.Load(entries);
+    if (AP4_FAILED(result)) {
+        m_Entries.SetItemCount(0);
+        return result;
     }
-    delete[] buffer;
+    AP4_BytesToUInt32BEArray((const unsigned char*)entries, entries, entry_count);
+    
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
@@ -95,7 +124,8 @@ AP4_StssAtom::AP4_StssAtom(AP4_UI32        size,
 AP4_Result
 AP4_StssAtom::WriteFields(AP4_ByteStream& stream)
 {
-    AP4_Result result;
+    AP4_Result result = LoadEntries();
+    if (AP4_FAILED(result)) return result;
 
     // entry count
     AP4_Cardinal entry_count = m_Entries.ItemCount();
@@ -117,6 +147,7 @@ AP4_StssAtom::WriteFields(AP4_ByteStream& stream)
 AP4_Result
 AP4_StssAtom::AddEntry(AP4_UI32 sample)
 {
+    LoadEntries();
     m_Entries.Append(sample);
     m_Size32 += 4;
     
@@ -132,6 +163,7 @@ AP4_StssAtom::IsSampleSync(AP4_Ordinal sample)
     unsigned int entry_index = 0;
 
     // check bounds
+    LoadEntries();
     if (sample == 0 || m_Entries.ItemCount() == 0) return false;
 
     // see if we can start from the cached index
@@ -158,7 +190,7 @@ AP4_StssAtom::IsSampleSync(AP4_Ordinal sample)
 AP4_Result
 AP4_StssAtom::InspectFields(AP4_AtomInspector& inspector)
 {
-    inspector.AddField("entry_count", m_Entries.ItemCount());
+    inspector.AddField("entry_count", m_DeferredEntries.IsPending()?m_DeferredEntries.GetSize()/4:m_Entries.ItemCount());
 
     return AP4_SUCCESS;
 }
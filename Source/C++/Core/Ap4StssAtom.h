@@ -44,14 +44,16 @@ public:
     AP4_IMPLEMENT_DYNAMIC_CAST_D(AP4_StssAtom, AP4_Atom)
 
     // class methods
-    static AP4_StssAtom* Create(AP4_Size size, AP4_ByteStream& stream);
+    static AP4_StssAtom* Create(AP4_Size        size, 
+                                AP4_ByteStream& stream,
+                                bool            lazy = false);
 
     // constructor
     AP4_StssAtom();
     
     // methods
     // methods
-    const AP4_Array<AP4_UI32>& GetEntries() { return m_Entries; }
+    const AP4_Array<AP4_UI32>& GetEntries() { LoadEntries(); return m_Entries; }
     AP4_Result                 AddEntry(AP4_UI32 sample);
     virtual AP4_Result         InspectFields(AP4_AtomInspector& inspector);
     virtual bool               IsSampleSync(AP4_Ordinal sample);
@@ -62,11 +64,14 @@ private:
     AP4_StssAtom(AP4_UI32        size, 
                  AP4_UI08        version,
                  AP4_UI32        flags,
-                 AP4_ByteStream& stream);
+                 AP4_ByteStream& stream,
+                 bool            lazy);
+    AP4_Result LoadEntries();
     
     // members
-    AP4_Array<AP4_UI32> m_Entries;
-    AP4_Ordinal         m_LookupCache;
+    AP4_Array<AP4_UI32>     m_Entries;
+    AP4_DeferredAtomPayload m_DeferredEntries;
+    AP4_Ordinal             m_LookupCache;
 };
 
 #endif // _AP4_STSS_ATOM_H_
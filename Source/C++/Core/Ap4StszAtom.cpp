@@ -42,13 +42,13 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_StszAtom)
 |   AP4_StszAtom::Create
 +---------------------------------------------------------------------*/
 AP4_StszAtom*
-AP4_StszAtom::Create(AP4_Size size, AP4_ByteStream& stream)
+AP4_StszAtom::Create(AP4_Size size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version != 0) return NULL;
-    return new AP4_StszAtom(size, version, flags, stream);
+    return new AP4_StszAtom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
@@ -67,27 +67,59 @@ AP4_StszAtom::AP4_StszAtom() :
 AP4_StszAtom::AP4_StszAtom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
     AP4_Atom(AP4_ATOM_TYPE_STSZ, size, version, flags)
 {
     stream.ReadUI32(m_SampleSize);
     stream.ReadUI32(m_SampleCount);
     if (m_SampleSize == 0) { // means that the samples have different sizes
         AP4_Cardinal sample_count = m_SampleCount;
+        
+        // if the table is complete, we can wait until it is needed
+        if (lazy && (AP4_UI64)sample_count*4 <= size-AP4_FULL_ATOM_HEADER_SIZE-8) {
+            if (AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, sample_count*4))) return;
+        }
+
         m_Entries.SetItemCount(sample_count);
-        unsigned char* buffer = new unsigned char[sample_count*4];
-        AP4_Result result = stream.Read(buffer, sample_count*4);
+        if (sample_count == 0) return;
+        
+        // read the table in one go and convert it in place
+        AP4_UI32* entries = &m_Entries[0];
+        AP4_Result result = stream.Read(entries, sample_count*4);
         if (AP4_FAILED(result)) {
-            delete[] buffer;
+            AP4_SetMemory(entries, 0, sample_count*4);
             return;
         }
-        for (unsigned int i=0; i<sample_count; i++) {
-            m_Entries[i] = AP4_BytesToUInt32BE(&buffer[i*4]);
-        }
-        delete[] buffer;
+        AP4_BytesToUInt32BEArray((const unsigned char*)entries, entries, sample_count);
     }
 }
 
+/*----------------------------------------------------------------------
+|   AP4_StszAtom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StszAtom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+    
+    AP4_Cardinal sample_count = m_SampleCount;
+    m_Entries.SetItemCount(sample_count);
+    if (sample_count == 0) {
+        m_DeferredEntries.Detach();
+        return AP4_SUCCESS;
+    }
+    AP4_UI32* entries = &m_Entries[0];
+    AP4_Result result = m_DeferredEntries.Load(entries);
+    if (AP4_FAILED(result)) {
+        AP4_SetMemory(entries, 0, sample_count*4);
+        return result;
+    }
+    AP4_BytesToUInt32BEArray((const unsigned char*)entries, entries, sample_count);
+    
+    return AP4_SUCCESS;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_StszAtom::WriteFields
 +---------------------------------------------------------------------*/
@@ -106,6 +138,8 @@ AP4_StszAtom::WriteFields(AP4_ByteStream& stream)
 
     // entries if needed (the samples have different sizes)
     if (m_SampleSize == 0) {
+        result = LoadEntries();
+        if (AP4_FAILED(result)) return result;
         for (AP4_UI32 i=0; i<m_SampleCount; i++) {
             result = stream.WriteUI32(m_Entries[i]);
             if (AP4_FAILED(result)) return result;
@@ -139,6 +173,7 @@ AP4_StszAtom::GetSampleSize(AP4_Ordinal sample, AP4_Size& sample_size)
         if (m_SampleSize != 0) { // constant size
             sample_size = m_SampleSize;
         } else {
+            LoadEntries();
             sample_size = m_Entries[sample - 1];
         }
         return AP4_SUCCESS;
@@ -155,6 +190,7 @@ AP4_StszAtom::SetSampleSize(AP4_Ordinal sample, AP4_Size sample_size)
     if (sample > m_SampleCount || sample == 0) {
         return AP4_ERROR_OUT_OF_RANGE;
     } else {
+        LoadEntries();
         if (m_Entries.ItemCount() == 0) {
             // all samples must have the same size
             if (sample_size != m_SampleSize) {
@@ -183,6 +219,7 @@ AP4_StszAtom::SetSampleSize(AP4_Ordinal sample, AP4_Size sample_size)
 AP4_Result 
 AP4_StszAtom::AddEntry(AP4_UI32 size)
 {
+    LoadEntries();
     m_Entries.Append(size);
     m_SampleCount++;
     m_Size32 += 4;
@@ -197,9 +234,10 @@ AP4_Result
 AP4_StszAtom::InspectFields(AP4_AtomInspector& inspector)
 {
     inspector.AddField("sample_size", m_SampleSize);
-    inspector.AddField("sample_count", m_Entries.ItemCount());
+    inspector.AddField("sample_count", m_DeferredEntries.IsPending()?m_SampleCount:m_Entries.ItemCount());
 
     if (inspector.GetVerbosity() >= 2) {
+        LoadEntries();
         char header[32];
         for (AP4_Ordinal i=0; i<m_Entries.ItemCount(); i++) {
             AP4_FormatString(header, sizeof(header), "entry %8d", i);
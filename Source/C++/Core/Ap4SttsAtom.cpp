@@ -42,24 +42,22 @@ AP4_DEFINE_DYNAMIC_CAST_ANCHOR(AP4_SttsAtom)
 |   AP4_SttsAtom::Create
 +---------------------------------------------------------------------*/
 AP4_SttsAtom*
-AP4_SttsAtom::Create(AP4_Size size, AP4_ByteStream& stream)
+AP4_SttsAtom::Create(AP4_Size size, AP4_ByteStream& stream, bool lazy)
 {
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(AP4_Atom::ReadFullHeader(stream, version, flags))) return NULL;
     if (version != 0) return NULL;
-    return new AP4_SttsAtom(size, version, flags, stream);
+    return new AP4_SttsAtom(size, version, flags, stream, lazy);
 }
 
 /*----------------------------------------------------------------------
 |   AP4_SttsAtom::AP4_SttsAtom
 +---------------------------------------------------------------------*/
 AP4_SttsAtom::AP4_SttsAtom() :
-    AP4_Atom(AP4_ATOM_TYPE_STTS, AP4_FULL_ATOM_HEADER_SIZE+4, 0, 0)
+    AP4_Atom(AP4_ATOM_TYPE_STTS, AP4_FULL_ATOM_HEADER_SIZE+4, 0, 0),
+    m_LookupCache(0)
 {
-    m_LookupCache.entry_index = 0;
-    m_LookupCache.sample      = 0;
-    m_LookupCache.dts         = 0;
 }
 
 /*----------------------------------------------------------------------
@@ -68,15 +66,19 @@ AP4_SttsAtom::AP4_SttsAtom() :
 AP4_SttsAtom::AP4_SttsAtom(AP4_UI32        size, 
                            AP4_UI08        version,
                            AP4_UI32        flags,
-                           AP4_ByteStream& stream) :
-    AP4_Atom(AP4_ATOM_TYPE_STTS, size, version, flags)
+                           AP4_ByteStream& stream,
+                           bool            lazy) :
+    AP4_Atom(AP4_ATOM_TYPE_STTS, size, version, flags),
+    m_LookupCache(0)
 {
-    m_LookupCache.entry_index = 0;
-    m_LookupCache.sample      = 0;
-    m_LookupCache.dts         = 0;
-
     AP4_UI32 entry_count;
     stream.ReadUI32(entry_count);
+    
+    // if the table is complete, we can wait until it is needed
+    if (lazy && (AP4_UI64)entry_count*8 <= size-AP4_FULL_ATOM_HEADER_SIZE-4) {
+        if (AP4_SUCCEEDED(m_DeferredEntries.Attach(stream, entry_count*8))) return;
+    }
+    
     while (entry_count--) {
         AP4_UI32 sample_count;
         AP4_UI32 sample_duration;
@@ -88,6 +90,88 @@ AP4_SttsAtom::AP4_SttsAtom(AP4_UI32        size,
     }
 }
 
+/*----------------------------------------------------------------------
+|   AP4_SttsAtom::LoadEntries
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_SttsAtom::LoadEntries()
+{
+    if (!m_DeferredEntries.IsPending()) return AP4_SUCCESS;
+    
+    AP4_Cardinal entry_count = m_DeferredEntries.GetSize()/8;
+    AP4_UI32*    fields      = new AP4_UI32[2*entry_count];
+    AP4_Result   result      = m_DeferredEntries.Load(fields);
+    if (AP4_SUCCEEDED(result)) {
+        AP4_BytesToUInt32BEArray((const unsigned char*)fields, fields, 2*entry_count);
+        m_Entries.EnsureCapacity(entry_count);
+        for (AP4_Ordinal i=0; i<entry_count; i++) {
+            m_Entries.Append(AP4_SttsTableEntry(fields[2*i], fields[2*i+1]));
+        }
+    }
+    delete[] fields;
+    
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SttsAtom::UpdateIndex
++---------------------------------------------------------------------*/
+void
+AP4_SttsAtom::UpdateIndex()
+{
+    LoadEntries();
+    
+    // entries are only ever appended, so the index is up to date if it
+    // has one more item than the table
+    AP4_Cardinal entry_count = m_Entries.ItemCount();
+    if (m_EntryDtsStarts.ItemCount() == entry_count+1) return;
+    
+    m_EntrySampleStarts.SetItemCount(entry_count+1);
+    m_EntryDtsStarts.SetItemCount(entry_count+1);
+    AP4_UI32 sample_start = 0;
+    AP4_UI64 dts_start    = 0;
+    for (AP4_Ordinal i=0; i<entry_count; i++) {
+        m_EntrySampleStarts[i] = sample_start;
+        m_EntryDtsStarts[i]    = dts_start;
+        sample_start += m_Entries[i].m_SampleCount;
+        dts_start    += (AP4_UI64)m_Entries[i].m_SampleCount*(AP4_UI64)m_Entries[i].m_SampleDuration;
+    }
+    m_EntrySampleStarts[entry_count] = sample_start;
+    m_EntryDtsStarts[entry_count]    = dts_start;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_SttsAtom::FindEntryForSample
++---------------------------------------------------------------------*/
+AP4_Ordinal
+AP4_SttsAtom::FindEntryForSample(AP4_Ordinal sample)
+{
+    // sample is 0-based here, and must be less than the total sample count
+    
+    // check the lookup cache first, then the next entry, which covers 
+    // sequential access
+    for (AP4_Ordinal i=m_LookupCache; i<m_LookupCache+2 && i<m_Entries.ItemCount(); i++) {
+        if (sample >= m_EntrySampleStarts[i] && sample < m_EntrySampleStarts[i+1]) {
+            return m_LookupCache = i;
+        }
+    }
+    
+    // binary search for the last entry that starts at or before the sample
+    // (skipping empty entries, which start where the next one starts)
+    AP4_Ordinal lo = 0;
+    AP4_Ordinal hi = m_Entries.ItemCount();
+    while (lo < hi) {
+        AP4_Ordinal mid = lo+(hi-lo)/2;
+        if (m_EntrySampleStarts[mid+1] <= sample) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    
+    return m_LookupCache = lo;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_SttsAtom::GetDts
 +---------------------------------------------------------------------*/
@@ -100,43 +184,22 @@ AP4_SttsAtom::GetDts(AP4_Ordinal sample, AP4_UI64& dts, AP4_UI32* duration)
     
     // sample indexes start at 1
     if (sample == 0) return AP4_ERROR_OUT_OF_RANGE;
-
-    // check the lookup cache
-    AP4_Ordinal lookup_start = 0;
-    AP4_Ordinal sample_start = 0;
-    AP4_UI64    dts_start    = 0;
-    if (sample >= m_LookupCache.sample) {
-        // start from the cached entry
-        lookup_start = m_LookupCache.entry_index;
-        sample_start = m_LookupCache.sample;
-        dts_start    = m_LookupCache.dts;
-    }
-
-    // look from the last known point
-    for (AP4_Ordinal i = lookup_start; i < m_Entries.ItemCount(); i++) {
-        AP4_SttsTableEntry& entry = m_Entries[i];
-
-        // check if we have reached the sample
-        if (sample <= sample_start+entry.m_SampleCount) {
-            // we are within the sample range for the current entry
-            dts = dts_start + (AP4_UI64)(sample-1 - sample_start) * (AP4_UI64)entry.m_SampleDuration;
-            if (duration) *duration = entry.m_SampleDuration;
-            
-            // update the lookup cache
-            m_LookupCache.entry_index = i;
-            m_LookupCache.sample      = sample_start;
-            m_LookupCache.dts         = dts_start;
-            
-            return AP4_SUCCESS;
-        }
- 
-        // update the sample and dts bases
-        sample_start += entry.m_SampleCount;
-        dts_start    += entry.m_SampleCount*entry.m_SampleDuration;
+    --sample;
+    
+    // check that the sample is in the table
+    UpdateIndex();
+    if (sample >= m_EntrySampleStarts[m_Entries.ItemCount()]) {
+        return AP4_ERROR_OUT_OF_RANGE;
     }
-
-    // sample is greater than the number of samples
-    return AP4_ERROR_OUT_OF_RANGE;
+    
+    // compute the dts from the start of its entry
+    AP4_Ordinal               entry_index = FindEntryForSample(sample);
+    const AP4_SttsTableEntry& entry       = m_Entries[entry_index];
+    dts = m_EntryDtsStarts[entry_index] + 
+          (AP4_UI64)(sample-m_EntrySampleStarts[entry_index]) * (AP4_UI64)entry.m_SampleDuration;
+    if (duration) *duration = entry.m_SampleDuration;
+    
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
@@ -145,6 +208,7 @@ AP4_SttsAtom::GetDts(AP4_Ordinal sample, AP4_UI64& dts, AP4_UI32* duration)
 AP4_Result
 AP4_SttsAtom::AddEntry(AP4_UI32 sample_count, AP4_UI32 sample_duration)
 {
+    LoadEntries();
     m_Entries.Append(AP4_SttsTableEntry(sample_count, sample_duration));
     m_Size32 += 8;
 
@@ -157,7 +221,8 @@ AP4_SttsAtom::AddEntry(AP4_UI32 sample_count, AP4_UI32 sample_duration)
 AP4_Result
 AP4_SttsAtom::WriteFields(AP4_ByteStream& stream)
 {
-    AP4_Result result;
+    AP4_Result result = LoadEntries();
+    if (AP4_FAILED(result)) return result;
 
     // write the entry count
     AP4_Cardinal entry_count = m_Entries.ItemCount();
@@ -186,29 +251,29 @@ AP4_SttsAtom::GetSampleIndexForTimeStamp(AP4_UI64      ts,
                                          AP4_Ordinal&  sample_index)
 {
     // init
-    AP4_Cardinal entry_count = m_Entries.ItemCount();
-    AP4_UI64 accumulated = 0;
     sample_index = 0;
+    UpdateIndex();
     
-    for (AP4_Ordinal i=0; i<entry_count; i++) {
-        AP4_UI64 next_accumulated = 
-            accumulated +
-            (AP4_UI64)m_Entries[i].m_SampleCount * 
-            (AP4_UI64)m_Entries[i].m_SampleDuration;
-        
-        // check if the ts is in the range of this entry
-        if (ts < next_accumulated) {
-            sample_index += (AP4_UI32)((ts - accumulated) / m_Entries[i].m_SampleDuration);
-            return AP4_SUCCESS;
+    // check that the ts is in range of the table
+    AP4_Cardinal entry_count = m_Entries.ItemCount();
+    if (ts >= m_EntryDtsStarts[entry_count]) return AP4_FAILURE;
+    
+    // binary search for the last entry that starts at or before the ts
+    // (skipping entries with no duration)
+    AP4_Ordinal lo = 0;
+    AP4_Ordinal hi = entry_count;
+    while (lo < hi) {
+        AP4_Ordinal mid = lo+(hi-lo)/2;
+        if (m_EntryDtsStarts[mid+1] <= ts) {
+            lo = mid+1;
+        } else {
+            hi = mid;
         }
-
-        // update accumulated and sample
-        accumulated = next_accumulated;
-        sample_index += m_Entries[i].m_SampleCount;
     }
-
-    // ts not in range of the table
-    return AP4_FAILURE;
+    
+    sample_index = m_EntrySampleStarts[lo] + 
+                   (AP4_UI32)((ts - m_EntryDtsStarts[lo]) / m_Entries[lo].m_SampleDuration);
+    return AP4_SUCCESS;
 }
 
 /*----------------------------------------------------------------------
@@ -217,9 +282,10 @@ AP4_SttsAtom::GetSampleIndexForTimeStamp(AP4_UI64      ts,
 AP4_Result
 AP4_SttsAtom::InspectFields(AP4_AtomInspector& inspector)
 {
-    inspector.AddField("entry_count", m_Entries.ItemCount());
+    inspector.AddField("entry_count", m_DeferredEntries.IsPending()?m_DeferredEntries.GetSize()/8:m_Entries.ItemCount());
 
     if (inspector.GetVerbosity() >= 1) {
+        LoadEntries();
         char header[32];
         char value[256];
         for (AP4_Ordinal i=0; i<m_Entries.ItemCount(); i++) {
@@ -61,7 +61,9 @@ public:
     AP4_IMPLEMENT_DYNAMIC_CAST_D(AP4_SttsAtom, AP4_Atom)
 
     // class methods
-    static AP4_SttsAtom* Create(AP4_Size size, AP4_ByteStream& stream);
+    static AP4_SttsAtom* Create(AP4_Size        size, 
+                                AP4_ByteStream& stream,
+                                bool            lazy = false);
 
     // methods
     AP4_SttsAtom();
@@ -77,15 +79,21 @@ private:
     AP4_SttsAtom(AP4_UI32        size, 
                  AP4_UI08        version,
                  AP4_UI32        flags,
-                 AP4_ByteStream& stream);
+                 AP4_ByteStream& stream,
+                 bool            lazy);
+    AP4_Result  LoadEntries();
+    void        UpdateIndex();
+    AP4_Ordinal FindEntryForSample(AP4_Ordinal sample);
 
     // members
     AP4_Array<AP4_SttsTableEntry> m_Entries;
-    struct {
-        AP4_Ordinal entry_index;
-        AP4_Ordinal sample;
-        AP4_UI64    dts;
-    } m_LookupCache;
+    AP4_DeferredAtomPayload       m_DeferredEntries;
+    
+    // index, built on demand: number of samples and total duration of all
+    // the entries before each entry (plus one entry for the whole table)
+    AP4_Array<AP4_UI32>           m_EntrySampleStarts;
+    AP4_Array<AP4_UI64>           m_EntryDtsStarts;
+    AP4_Ordinal                   m_LookupCache;
 };
 
 #endif // _AP4_STTS_ATOM_H_
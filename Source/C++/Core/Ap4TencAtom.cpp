@@ -46,7 +46,7 @@ AP4_TencAtom::Create(AP4_Size size, AP4_ByteStream& stream)
     AP4_UI08 version;
     AP4_UI32 flags;
     if (AP4_FAILED(ReadFullHeader(stream, version, flags))) return NULL;
-    if (version != 0) return NULL;
+    if (version > 1) return NULL;
     return new AP4_TencAtom(size, version, flags, stream);
 }
 
@@ -63,6 +63,28 @@ AP4_TencAtom::AP4_TencAtom(AP4_UI32        default_algorithm_id,
 {
 }
 
+/*----------------------------------------------------------------------
+|   AP4_TencAtom::AP4_TencAtom
++---------------------------------------------------------------------*/
+AP4_TencAtom::AP4_TencAtom(AP4_UI32        default_algorithm_id,
+                           AP4_UI08        default_iv_size,
+                           const AP4_UI08* default_kid,
+                           AP4_UI08        default_constant_iv_size,
+                           const AP4_UI08* default_constant_iv,
+                           AP4_UI08        default_crypt_byte_block,
+                           AP4_UI08        default_skip_byte_block) :
+    AP4_Atom(AP4_ATOM_TYPE_TENC, AP4_FULL_ATOM_HEADER_SIZE, 1, 0),
+    AP4_CencTrackEncryption(default_algorithm_id,
+                            default_iv_size,
+                            default_kid,
+                            default_constant_iv_size,
+                            default_constant_iv,
+                            default_crypt_byte_block,
+                            default_skip_byte_block)
+{
+    m_Size32 += GetFieldsSize();
+}
+
 /*----------------------------------------------------------------------
 |   AP4_TencAtom::AP4_TencAtom
 +---------------------------------------------------------------------*/
@@ -71,7 +93,7 @@ AP4_TencAtom::AP4_TencAtom(AP4_UI32        size,
                            AP4_UI32        flags,
                            AP4_ByteStream& stream) :
     AP4_Atom(AP4_ATOM_TYPE_TENC, size, version, flags),
-    AP4_CencTrackEncryption(stream)
+    AP4_CencTrackEncryption(stream, version, size-AP4_FULL_ATOM_HEADER_SIZE)
 {
 }
 
@@ -50,6 +50,13 @@ public:
     AP4_TencAtom(AP4_UI32        default_algorithm_id,
                  AP4_UI08        default_iv_size,
                  const AP4_UI08* default_kid);
+    AP4_TencAtom(AP4_UI32        default_algorithm_id,
+                 AP4_UI08        default_iv_size,
+                 const AP4_UI08* default_kid,
+                 AP4_UI08        default_constant_iv_size,
+                 const AP4_UI08* default_constant_iv,
+                 AP4_UI08        default_crypt_byte_block,
+                 AP4_UI08        default_skip_byte_block);
   
     // methods
     virtual AP4_Result InspectFields(AP4_AtomInspector& inspector);
@@ -0,0 +1,264 @@
+/*****************************************************************
+|
+|    AP4 - Threads
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Threads.h"
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::AP4_Thread(AP4_Runnable& target) :
+    m_Target(target),
+    m_Handle(NULL)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::~AP4_Thread
++---------------------------------------------------------------------*/
+AP4_Thread::~AP4_Thread()
+{
+    Wait();
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Start
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Start()
+{
+    if (m_Handle) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_StartThread(m_Target, m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Thread::Wait
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Thread::Wait()
+{
+    if (m_Handle == NULL) return AP4_SUCCESS;
+    AP4_Result result = AP4_System_WaitThread(m_Handle);
+    m_Handle = NULL;
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::AP4_Mutex() :
+    m_Handle(NULL)
+{
+    AP4_System_CreateMutex(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::~AP4_Mutex
++---------------------------------------------------------------------*/
+AP4_Mutex::~AP4_Mutex()
+{
+    if (m_Handle) AP4_System_DestroyMutex(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Lock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Lock()
+{
+    if (m_Handle == NULL) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_LockMutex(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex::Unlock
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Mutex::Unlock()
+{
+    if (m_Handle == NULL) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_UnlockMutex(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Condition::AP4_Condition
++---------------------------------------------------------------------*/
+AP4_Condition::AP4_Condition() :
+    m_Handle(NULL)
+{
+    AP4_System_CreateCondition(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Condition::~AP4_Condition
++---------------------------------------------------------------------*/
+AP4_Condition::~AP4_Condition()
+{
+    if (m_Handle) AP4_System_DestroyCondition(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Condition::Wait
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Condition::Wait(AP4_Mutex& mutex)
+{
+    if (m_Handle == NULL || mutex.m_Handle == NULL) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_WaitCondition(m_Handle, mutex.m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Condition::Signal
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Condition::Signal()
+{
+    if (m_Handle == NULL) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_SignalCondition(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Condition::Broadcast
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Condition::Broadcast()
+{
+    if (m_Handle == NULL) return AP4_ERROR_INVALID_STATE;
+    return AP4_System_BroadcastCondition(m_Handle);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::AP4_ThreadPool
++---------------------------------------------------------------------*/
+AP4_ThreadPool::AP4_ThreadPool() :
+    m_Worker(*this),
+    m_NextTask(0),
+    m_PendingTaskCount(0),
+    m_Stopping(false)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::~AP4_ThreadPool
++---------------------------------------------------------------------*/
+AP4_ThreadPool::~AP4_ThreadPool()
+{
+    // let the workers finish what was queued, then stop them
+    m_Lock.Lock();
+    m_Stopping = true;
+    m_TaskAvailable.Broadcast();
+    m_Lock.Unlock();
+    for (unsigned int i=0; i<m_Threads.ItemCount(); i++) {
+        delete m_Threads[i]; // joins the thread
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::Start
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ThreadPool::Start(AP4_Cardinal thread_count)
+{
+    if (m_Threads.ItemCount()) return AP4_ERROR_INVALID_STATE;
+    for (unsigned int i=0; i<thread_count; i++) {
+        AP4_Thread* thread = new AP4_Thread(m_Worker);
+        if (AP4_FAILED(thread->Start())) {
+            delete thread;
+            break;
+        }
+        m_Threads.Append(thread);
+    }
+    
+    return m_Threads.ItemCount() ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::Submit
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ThreadPool::Submit(AP4_Runnable& task)
+{
+    // without workers, the task runs right away on this thread
+    if (m_Threads.ItemCount() == 0) {
+        task.Run();
+        return AP4_SUCCESS;
+    }
+    
+    AP4_AutoLock lock(m_Lock);
+    AP4_Result result = m_Tasks.Append(&task);
+    if (AP4_FAILED(result)) return result;
+    ++m_PendingTaskCount;
+    m_TaskAvailable.Signal();
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::Wait
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_ThreadPool::Wait()
+{
+    AP4_AutoLock lock(m_Lock);
+    while (m_PendingTaskCount) {
+        AP4_Result result = m_TasksDone.Wait(m_Lock);
+        if (AP4_FAILED(result)) return result;
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool::RunTasks
++---------------------------------------------------------------------*/
+void
+AP4_ThreadPool::RunTasks()
+{
+    AP4_AutoLock lock(m_Lock);
+    for (;;) {
+        while (m_NextTask == m_Tasks.ItemCount() && !m_Stopping) {
+            m_TaskAvailable.Wait(m_Lock);
+        }
+        if (m_NextTask == m_Tasks.ItemCount()) break; // stopping
+        
+        // take the next task, and reset the queue once it is empty
+        AP4_Runnable* task = m_Tasks[m_NextTask++];
+        if (m_NextTask == m_Tasks.ItemCount()) {
+            m_Tasks.Clear();
+            m_NextTask = 0;
+        }
+        
+        m_Lock.Unlock();
+        task->Run();
+        m_Lock.Lock();
+        
+        if (--m_PendingTaskCount == 0) m_TasksDone.Broadcast();
+    }
+}
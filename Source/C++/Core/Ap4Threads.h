@@ -0,0 +1,238 @@
+/*****************************************************************
+|
+|    AP4 - Threads
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+#ifndef _AP4_THREADS_H_
+#define _AP4_THREADS_H_
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include "Ap4Types.h"
+#include "Ap4Results.h"
+#include "Ap4Array.h"
+
+/*----------------------------------------------------------------------
+|   AP4_Runnable
++---------------------------------------------------------------------*/
+class AP4_Runnable
+{
+public:
+    virtual ~AP4_Runnable() {}
+    virtual void Run() = 0;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Thread
++---------------------------------------------------------------------*/
+/**
+ * Minimal joinable thread. The target runs on a new thread when Start()
+ * is called; Wait() (or the destructor) joins it.
+ */
+class AP4_Thread
+{
+public:
+    // constructor and destructor
+    AP4_Thread(AP4_Runnable& target);
+    ~AP4_Thread();
+
+    // methods
+    AP4_Result Start();
+    AP4_Result Wait();
+
+private:
+    // members
+    AP4_Runnable& m_Target;
+    void*         m_Handle;
+
+    // prevent copies
+    AP4_Thread(const AP4_Thread&);
+    AP4_Thread& operator=(const AP4_Thread&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Mutex
++---------------------------------------------------------------------*/
+/**
+ * Minimal non-recursive mutex.
+ */
+class AP4_Mutex
+{
+public:
+    // constructor and destructor
+    AP4_Mutex();
+    ~AP4_Mutex();
+
+    // methods
+    AP4_Result Lock();
+    AP4_Result Unlock();
+
+private:
+    // friends
+    friend class AP4_Condition;
+
+    // members
+    void* m_Handle;
+
+    // prevent copies
+    AP4_Mutex(const AP4_Mutex&);
+    AP4_Mutex& operator=(const AP4_Mutex&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_AutoLock
++---------------------------------------------------------------------*/
+/**
+ * Locks a mutex for the lifetime of the object.
+ */
+class AP4_AutoLock
+{
+public:
+    AP4_AutoLock(AP4_Mutex& mutex) : m_Mutex(mutex) { m_Mutex.Lock();   }
+    ~AP4_AutoLock()                                 { m_Mutex.Unlock(); }
+
+private:
+    AP4_Mutex& m_Mutex;
+
+    // prevent copies
+    AP4_AutoLock(const AP4_AutoLock&);
+    AP4_AutoLock& operator=(const AP4_AutoLock&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_Condition
++---------------------------------------------------------------------*/
+/**
+ * Minimal condition variable, used with an AP4_Mutex that is locked by
+ * the caller of Wait().
+ */
+class AP4_Condition
+{
+public:
+    // constructor and destructor
+    AP4_Condition();
+    ~AP4_Condition();
+
+    // methods
+    AP4_Result Wait(AP4_Mutex& mutex);
+    AP4_Result Signal();
+    AP4_Result Broadcast();
+
+private:
+    // members
+    void* m_Handle;
+
+    // prevent copies
+    AP4_Condition(const AP4_Condition&);
+    AP4_Condition& operator=(const AP4_Condition&);
+};
+
+/*----------------------------------------------------------------------
+|   AP4_ThreadPool
++---------------------------------------------------------------------*/
+/**
+ * Fixed set of worker threads that run queued tasks. The threads are
+ * started once by Start() and run until the pool is destroyed, so the
+ * same pool can be fed work many times (for example once per fragment).
+ * Tasks are not owned by the pool and must stay alive until Wait()
+ * returns.
+ */
+class AP4_ThreadPool
+{
+public:
+    // constructor and destructor
+    AP4_ThreadPool();
+    ~AP4_ThreadPool();
+
+    // methods
+    /**
+     * Start up to thread_count worker threads. Returns an error if no
+     * thread could be started, in which case Submit() runs the tasks
+     * on the calling thread.
+     */
+    AP4_Result   Start(AP4_Cardinal thread_count);
+    AP4_Cardinal GetThreadCount() { return m_Threads.ItemCount(); }
+    AP4_Result   Submit(AP4_Runnable& task);
+
+    /**
+     * Wait until all the tasks submitted so far have run.
+     */
+    AP4_Result   Wait();
+
+private:
+    // types
+    class Worker : public AP4_Runnable {
+    public:
+        Worker(AP4_ThreadPool& pool) : m_Pool(pool) {}
+        virtual void Run() { m_Pool.RunTasks(); }
+    private:
+        AP4_ThreadPool& m_Pool;
+    };
+
+    // methods
+    void RunTasks();
+
+    // members
+    Worker                   m_Worker;
+    AP4_Array<AP4_Thread*>   m_Threads;
+    AP4_Mutex                m_Lock;
+    AP4_Condition            m_TaskAvailable;
+    AP4_Condition            m_TasksDone;
+    AP4_Array<AP4_Runnable*> m_Tasks;
+    AP4_Ordinal              m_NextTask;
+    AP4_Cardinal             m_PendingTaskCount;
+    bool                     m_Stopping;
+
+    // prevent copies
+    AP4_ThreadPool(const AP4_ThreadPool&);
+    AP4_ThreadPool& operator=(const AP4_ThreadPool&);
+};
+
+/*----------------------------------------------------------------------
+|   system functions
++---------------------------------------------------------------------*/
+AP4_Result   AP4_System_StartThread(AP4_Runnable& target, void*& handle);
+AP4_Result   AP4_System_WaitThread(void* handle);
+AP4_Result   AP4_System_CreateMutex(void*& handle);
+AP4_Result   AP4_System_DestroyMutex(void* handle);
+AP4_Result   AP4_System_LockMutex(void* handle);
+AP4_Result   AP4_System_UnlockMutex(void* handle);
+AP4_Result   AP4_System_CreateCondition(void*& handle);
+AP4_Result   AP4_System_DestroyCondition(void* handle);
+AP4_Result   AP4_System_WaitCondition(void* handle, void* mutex_handle);
+AP4_Result   AP4_System_SignalCondition(void* handle);
+AP4_Result   AP4_System_BroadcastCondition(void* handle);
+AP4_Cardinal AP4_System_GetProcessorCount();
+
+/**
+ * Atomically increment or decrement a counter and return its new value.
+ * Used for reference counts of objects that may be shared by threads.
+ */
+AP4_Cardinal AP4_System_AtomicIncrement(volatile AP4_Cardinal& value);
+AP4_Cardinal AP4_System_AtomicDecrement(volatile AP4_Cardinal& value);
+
+#endif // _AP4_THREADS_H_
@@ -471,6 +471,67 @@ AP4_Track::ReadSample(AP4_Ordinal     index,
     return sample.ReadData(data);
 }
 
+/*----------------------------------------------------------------------
+|   AP4_Track::ReadSampleChunk
++---------------------------------------------------------------------*/
+AP4_Result   
+AP4_Track::ReadSampleChunk(AP4_Ordinal            index, 
+                           AP4_Array<AP4_Sample>& samples,
+                           AP4_DataBuffer&        data,
+                           AP4_Size               max_size)
+{
+    AP4_Result result;
+    
+    // default values
+    samples.Clear();
+    data.SetDataSize(0);
+    if (m_SampleTable == NULL) return AP4_FAILURE;
+    
+    // collect the samples that are contiguous with the first one
+    AP4_Cardinal    sample_count = m_SampleTable->GetSampleCount();
+    AP4_ByteStream* stream       = NULL;
+    AP4_Position    start        = 0;
+    AP4_Size        size         = 0;
+    AP4_Sample      sample;
+    for (AP4_Ordinal i=index; i<sample_count; i++) {
+        result = m_SampleTable->GetSample(i, sample);
+        if (AP4_FAILED(result)) {
+            if (samples.ItemCount()) break;
+            return result;
+        }
+        AP4_ByteStream* sample_stream = sample.GetDataStream();
+        if (sample_stream) sample_stream->Release(); // only compared
+        if (samples.ItemCount() == 0) {
+            stream = sample_stream;
+            start  = sample.GetOffset();
+        } else if (sample_stream != stream              ||
+                   sample.GetOffset() != start+size     ||
+                   size+sample.GetSize() > max_size) {
+            break;
+        }
+        result = samples.Append(sample);
+        if (AP4_FAILED(result)) return result;
+        size += sample.GetSize();
+    }
+    if (samples.ItemCount() == 0) return AP4_ERROR_OUT_OF_RANGE;
+    if (stream == NULL) return AP4_FAILURE;
+    
+    // read all the data at once
+    result = data.SetDataSize(size);
+    if (AP4_FAILED(result)) return result;
+    return stream->ReadAt(start, data.UseData(), size);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_Track::PrepareForConcurrentReads
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_Track::PrepareForConcurrentReads()
+{
+    // delegate to the sample table
+    return m_SampleTable ? m_SampleTable->PrepareForConcurrentReads() : AP4_FAILURE;
+}
+
 /*----------------------------------------------------------------------
 |   AP4_Track::GetSampleIndexForTimeStampMs
 +---------------------------------------------------------------------*/
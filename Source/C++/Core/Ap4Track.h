@@ -51,6 +51,7 @@ class AP4_SampleTable;
 |   constants
 +---------------------------------------------------------------------*/
 const AP4_UI32 AP4_TRACK_DEFAULT_MOVIE_TIMESCALE = 1000;
+const AP4_Size AP4_TRACK_DEFAULT_CHUNK_READ_SIZE  = 1024*1024;
 
 const AP4_UI32 AP4_TRACK_FLAG_ENABLED    = 0x0001;
 const AP4_UI32 AP4_TRACK_FLAG_IN_MOVIE   = 0x0002;
@@ -117,6 +118,19 @@ class AP4_Track {
     AP4_Result   ReadSample(AP4_Ordinal     index, 
                             AP4_Sample&     sample,
                             AP4_DataBuffer& data);
+    /**
+     * Read the sample at 'index' together with the samples that follow it
+     * contiguously in the file (typically the rest of its chunk), with a 
+     * single read of at most 'max_size' bytes (at least one sample is 
+     * always read). The samples are returned in 'samples', and their data
+     * back to back in 'data': the data of samples[i] starts at
+     * samples[i].GetOffset()-samples[0].GetOffset().
+     */
+    AP4_Result   ReadSampleChunk(AP4_Ordinal            index,
+                                 AP4_Array<AP4_Sample>& samples,
+                                 AP4_DataBuffer&        data,
+                                 AP4_Size               max_size = AP4_TRACK_DEFAULT_CHUNK_READ_SIZE);
+    AP4_Result   PrepareForConcurrentReads();
     AP4_Result   GetSampleIndexForTimeStampMs(AP4_UI32     ts_ms, 
                                               AP4_Ordinal& index);
     AP4_Ordinal  GetNearestSyncSampleIndex(AP4_Ordinal index, bool before=true);
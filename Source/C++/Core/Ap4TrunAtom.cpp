@@ -83,8 +83,9 @@ AP4_TrunAtom::ComputeOptionalFieldsCount(AP4_UI32 flags)
 +---------------------------------------------------------------------*/
 AP4_TrunAtom::AP4_TrunAtom(AP4_UI32 flags, 
                            AP4_SI32 data_offset,
-                           AP4_UI32 first_sample_flags) :
-    AP4_Atom(AP4_ATOM_TYPE_TRUN, AP4_FULL_ATOM_HEADER_SIZE+4, 0, flags),
+                           AP4_UI32 first_sample_flags,
+                           AP4_UI08 version) :
+    AP4_Atom(AP4_ATOM_TYPE_TRUN, AP4_FULL_ATOM_HEADER_SIZE+4, version, flags),
     m_DataOffset(data_offset),
     m_FirstSampleFlags(first_sample_flags)
 {
@@ -122,31 +123,38 @@ AP4_TrunAtom::AP4_TrunAtom(AP4_UI32        size,
         stream.ReadUI32(discard);
     }
     
-    int record_fields_count = (int)ComputeRecordFieldsCount(flags);
+    // check for bogus values
+    unsigned int record_fields_count = ComputeRecordFieldsCount(flags);
+    unsigned int header_fields_count = 1+ComputeOptionalFieldsCount(flags);
+    if (size < GetHeaderSize()+4*header_fields_count) return;
+    AP4_UI32 payload_size = size-GetHeaderSize()-4*header_fields_count;
+    if (record_fields_count && sample_count > payload_size/(4*record_fields_count)) return;
     m_Entries.SetItemCount(sample_count);
+    if (record_fields_count == 0 || sample_count == 0) return;
+    
+    // read all the records in one go and convert them
+    AP4_Cardinal   field_count = sample_count*record_fields_count;
+    AP4_DataBuffer buffer(field_count*4);
+    buffer.SetDataSize(field_count*4);
+    if (AP4_FAILED(stream.Read(buffer.UseData(), field_count*4))) return;
+    AP4_UI32* fields = (AP4_UI32*)buffer.UseData();
+    AP4_BytesToUInt32BEArray(buffer.GetData(), fields, field_count);
     for (unsigned int i=0; i<sample_count; i++) {
+        // unknown fields, if any, come after the known ones and are skipped
+        const AP4_UI32* record = fields;
         if (flags & AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT) {
-            stream.ReadUI32(m_Entries[i].sample_duration);
-            --record_fields_count;
+            m_Entries[i].sample_duration = *record++;
         }
         if (flags & AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT) {
-            stream.ReadUI32(m_Entries[i].sample_size);
-            --record_fields_count;
+            m_Entries[i].sample_size = *record++;
         }
         if (flags & AP4_TRUN_FLAG_SAMPLE_FLAGS_PRESENT) {
-            stream.ReadUI32(m_Entries[i].sample_flags);
-            --record_fields_count;
+            m_Entries[i].sample_flags = *record++;
         }
         if (flags & AP4_TRUN_FLAG_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) {
-            stream.ReadUI32(m_Entries[i].sample_composition_time_offset);
-            --record_fields_count;
-        }
-    
-        // skip unknown fields 
-        for (int j=0;j<record_fields_count; j++) {
-            AP4_UI32 discard;
-            stream.ReadUI32(discard);
+            m_Entries[i].sample_composition_time_offset = *record;
         }
+        fields += record_fields_count;
     }
 }
 
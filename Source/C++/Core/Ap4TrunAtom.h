@@ -70,7 +70,8 @@ public:
     // methods
     AP4_TrunAtom(AP4_UI32 flags, 
                  AP4_SI32 data_offset,
-                 AP4_UI32 first_sample_flags);
+                 AP4_UI32 first_sample_flags,
+                 AP4_UI08 version = 0);
     virtual AP4_Result InspectFields(AP4_AtomInspector& inspector);
     virtual AP4_Result WriteFields(AP4_ByteStream& stream);
 
@@ -115,6 +115,56 @@ AP4_BytesToUInt64BE(const unsigned char* bytes)
         ( ((AP4_UI64)bytes[7])     );    
 }
 
+/*----------------------------------------------------------------------
+|   AP4_BytesToUInt32BEArray
++---------------------------------------------------------------------*/
+void
+AP4_BytesToUInt32BEArray(const unsigned char* bytes, AP4_UI32* values, AP4_Cardinal count)
+{
+#if defined(AP4_PLATFORM_BYTE_ORDER) && (AP4_PLATFORM_BYTE_ORDER == AP4_PLATFORM_BYTE_ORDER_LITTLE_ENDIAN) && \
+    (defined(__GNUC__) || defined(__clang__))
+    // load each value as a native word and swap it, which compiles to a
+    // simple (and usually vectorized) loop
+    for (AP4_Ordinal i=0; i<count; i++) {
+        AP4_UI32 value;
+        AP4_CopyMemory(&value, bytes+4*i, 4);
+        values[i] = __builtin_bswap32(value);
+    }
+#elif defined(AP4_PLATFORM_BYTE_ORDER) && (AP4_PLATFORM_BYTE_ORDER == AP4_PLATFORM_BYTE_ORDER_BIG_ENDIAN)
+    if ((const void*)bytes != (const void*)values) {
+        memmove(values, bytes, 4*count);
+    }
+#else
+    for (AP4_Ordinal i=0; i<count; i++) {
+        values[i] = AP4_BytesToUInt32BE(bytes+4*i);
+    }
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_BytesToUInt64BEArray
++---------------------------------------------------------------------*/
+void
+AP4_BytesToUInt64BEArray(const unsigned char* bytes, AP4_UI64* values, AP4_Cardinal count)
+{
+#if defined(AP4_PLATFORM_BYTE_ORDER) && (AP4_PLATFORM_BYTE_ORDER == AP4_PLATFORM_BYTE_ORDER_LITTLE_ENDIAN) && \
+    (defined(__GNUC__) || defined(__clang__))
+    for (AP4_Ordinal i=0; i<count; i++) {
+        AP4_UI64 value;
+        AP4_CopyMemory(&value, bytes+8*i, 8);
+        values[i] = __builtin_bswap64(value);
+    }
+#elif defined(AP4_PLATFORM_BYTE_ORDER) && (AP4_PLATFORM_BYTE_ORDER == AP4_PLATFORM_BYTE_ORDER_BIG_ENDIAN)
+    if ((const void*)bytes != (const void*)values) {
+        memmove(values, bytes, 8*count);
+    }
+#else
+    for (AP4_Ordinal i=0; i<count; i++) {
+        values[i] = AP4_BytesToUInt64BE(bytes+8*i);
+    }
+#endif
+}
+
 /*----------------------------------------------------------------------
 |   AP4_BytesFromDoubleBE
 +---------------------------------------------------------------------*/
@@ -66,6 +66,14 @@ AP4_UI64 AP4_BytesToUInt64BE(const unsigned char* bytes);
 void AP4_BytesFromDoubleBE(unsigned char* bytes, double value);
 void AP4_BytesFromUInt64BE(unsigned char* bytes, AP4_UI64 value);
 
+/**
+ * Decode an array of big-endian integers, as found in the tables of
+ * atoms like 'stsz' or 'trun'. The decoding can be done in place (the
+ * bytes and values pointers may point to the same buffer).
+ */
+void AP4_BytesToUInt32BEArray(const unsigned char* bytes, AP4_UI32* values, AP4_Cardinal count);
+void AP4_BytesToUInt64BEArray(const unsigned char* bytes, AP4_UI64* values, AP4_Cardinal count);
+
 /*----------------------------------------------------------------------
 |   AP4_BytesToUInt32BE
 +---------------------------------------------------------------------*/
@@ -190,6 +198,7 @@ extern int AP4_FormatStringVN(char *buffer, size_t count, const char *format, va
 #include <string.h>
 #define AP4_StringLength(x) strlen(x)
 #define AP4_CopyMemory(x,y,z) memcpy(x,y,z)
+#define AP4_MoveMemory(x,y,z) memmove(x,y,z)
 #define AP4_CompareMemory(x, y, z) memcmp(x, y, z)
 #define AP4_SetMemory(x,y,z) memset(x,y,z)
 #define AP4_CompareStrings(x,y) strcmp(x,y)
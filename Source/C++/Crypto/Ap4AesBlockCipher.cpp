@@ -40,6 +40,16 @@ Issue Date: 29/07/2002
 #include "Ap4Results.h"
 #include "Ap4Utils.h"
 
+#if defined(AP4_CONFIG_HAVE_AESNI)
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
 /*----------------------------------------------------------------------
 |   AES types
 +---------------------------------------------------------------------*/
@@ -1963,6 +1973,382 @@ AP4_AesCtrBlockCipher::Process(const AP4_UI08* input,
     return AP4_SUCCESS;
 }
 
+#if defined(AP4_CONFIG_HAVE_AESNI)
+/*----------------------------------------------------------------------
+|   AES-NI support
++---------------------------------------------------------------------*/
+#if defined(_MSC_VER)
+#define AP4_AESNI_TARGET
+#else
+#define AP4_AESNI_TARGET __attribute__((target("sse2,aes")))
+#endif
+
+// number of blocks processed in parallel when the mode allows it
+#define AP4_AESNI_PIPELINE_DEPTH 8
+
+const unsigned int AP4_AESNI_ROUND_COUNT = 10; // AES-128
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_DetectSupport
++---------------------------------------------------------------------*/
+static bool
+AP4_AesNi_DetectSupport()
+{
+#if defined(_MSC_VER)
+    int info[4] = {0, 0, 0, 0};
+    __cpuid(info, 1);
+    return (info[2] & (1<<25)) && (info[3] & (1<<26));
+#else
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+           (ecx & (1<<25)) && (edx & (1<<26));
+#endif
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_Supported
++---------------------------------------------------------------------*/
+// detected during static initialization, before any thread can create a
+// cipher (function-local statics are not thread-safe in C++98)
+static const bool AP4_AesNi_Supported = AP4_AesNi_DetectSupport();
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_IsSupported
++---------------------------------------------------------------------*/
+static bool
+AP4_AesNi_IsSupported()
+{
+    return AP4_AesNi_Supported;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_ExpandKeyStep
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static inline __m128i
+AP4_AesNi_ExpandKeyStep(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, _MM_SHUFFLE(3,3,3,3));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_ExpandKey
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static void
+AP4_AesNi_ExpandKey(const AP4_UI08* key, bool for_decryption, AP4_UI08* round_keys)
+{
+    __m128i k[AP4_AESNI_ROUND_COUNT+1];
+    k[0]  = _mm_loadu_si128((const __m128i*)key);
+    k[1]  = AP4_AesNi_ExpandKeyStep(k[0], _mm_aeskeygenassist_si128(k[0], 0x01));
+    k[2]  = AP4_AesNi_ExpandKeyStep(k[1], _mm_aeskeygenassist_si128(k[1], 0x02));
+    k[3]  = AP4_AesNi_ExpandKeyStep(k[2], _mm_aeskeygenassist_si128(k[2], 0x04));
+    k[4]  = AP4_AesNi_ExpandKeyStep(k[3], _mm_aeskeygenassist_si128(k[3], 0x08));
+    k[5]  = AP4_AesNi_ExpandKeyStep(k[4], _mm_aeskeygenassist_si128(k[4], 0x10));
+    k[6]  = AP4_AesNi_ExpandKeyStep(k[5], _mm_aeskeygenassist_si128(k[5], 0x20));
+    k[7]  = AP4_AesNi_ExpandKeyStep(k[6], _mm_aeskeygenassist_si128(k[6], 0x40));
+    k[8]  = AP4_AesNi_ExpandKeyStep(k[7], _mm_aeskeygenassist_si128(k[7], 0x80));
+    k[9]  = AP4_AesNi_ExpandKeyStep(k[8], _mm_aeskeygenassist_si128(k[8], 0x1B));
+    k[10] = AP4_AesNi_ExpandKeyStep(k[9], _mm_aeskeygenassist_si128(k[9], 0x36));
+
+    __m128i* out = (__m128i*)round_keys;
+    if (for_decryption) {
+        // equivalent inverse cipher: reversed order, InvMixColumns on the inner keys
+        _mm_storeu_si128(&out[0], k[AP4_AESNI_ROUND_COUNT]);
+        for (unsigned int i=1; i<AP4_AESNI_ROUND_COUNT; i++) {
+            _mm_storeu_si128(&out[i], _mm_aesimc_si128(k[AP4_AESNI_ROUND_COUNT-i]));
+        }
+        _mm_storeu_si128(&out[AP4_AESNI_ROUND_COUNT], k[0]);
+    } else {
+        for (unsigned int i=0; i<=AP4_AESNI_ROUND_COUNT; i++) {
+            _mm_storeu_si128(&out[i], k[i]);
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_LoadKeys
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static inline void
+AP4_AesNi_LoadKeys(const AP4_UI08* round_keys, __m128i* k)
+{
+    for (unsigned int i=0; i<=AP4_AESNI_ROUND_COUNT; i++) {
+        k[i] = _mm_loadu_si128((const __m128i*)(round_keys+16*i));
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_EncryptBlock
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static inline __m128i
+AP4_AesNi_EncryptBlock(__m128i block, const __m128i* k)
+{
+    block = _mm_xor_si128(block, k[0]);
+    for (unsigned int r=1; r<AP4_AESNI_ROUND_COUNT; r++) {
+        block = _mm_aesenc_si128(block, k[r]);
+    }
+    return _mm_aesenclast_si128(block, k[AP4_AESNI_ROUND_COUNT]);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_DecryptBlock
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static inline __m128i
+AP4_AesNi_DecryptBlock(__m128i block, const __m128i* k)
+{
+    block = _mm_xor_si128(block, k[0]);
+    for (unsigned int r=1; r<AP4_AESNI_ROUND_COUNT; r++) {
+        block = _mm_aesdec_si128(block, k[r]);
+    }
+    return _mm_aesdeclast_si128(block, k[AP4_AESNI_ROUND_COUNT]);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNi_EncryptBlocks
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET static void
+AP4_AesNi_EncryptBlocks(const AP4_UI08* round_keys,
+                        const AP4_UI08* input,
+                        AP4_Cardinal    block_count,
+                        AP4_UI08*       output)
+{
+    __m128i k[AP4_AESNI_ROUND_COUNT+1];
+    AP4_AesNi_LoadKeys(round_keys, k);
+
+    while (block_count >= AP4_AESNI_PIPELINE_DEPTH) {
+        __m128i b[AP4_AESNI_PIPELINE_DEPTH];
+        for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input+16*i)), k[0]);
+        }
+        for (unsigned int r=1; r<AP4_AESNI_ROUND_COUNT; r++) {
+            for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                b[i] = _mm_aesenc_si128(b[i], k[r]);
+            }
+        }
+        for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+            _mm_storeu_si128((__m128i*)(output+16*i), _mm_aesenclast_si128(b[i], k[AP4_AESNI_ROUND_COUNT]));
+        }
+        input       += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+        output      += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+        block_count -= AP4_AESNI_PIPELINE_DEPTH;
+    }
+    for (unsigned int i=0; i<block_count; i++) {
+        __m128i b = AP4_AesNi_EncryptBlock(_mm_loadu_si128((const __m128i*)input), k);
+        _mm_storeu_si128((__m128i*)output, b);
+        input  += AP4_AES_BLOCK_SIZE;
+        output += AP4_AES_BLOCK_SIZE;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNiCbcBlockCipher
++---------------------------------------------------------------------*/
+class AP4_AesNiCbcBlockCipher : public AP4_AesBlockCipher
+{
+public:
+    AP4_AesNiCbcBlockCipher(CipherDirection direction,
+                            const AP4_UI08* key) :
+        AP4_AesBlockCipher(direction, CBC, NULL) {
+        AP4_AesNi_ExpandKey(key, direction == DECRYPT, m_RoundKeys);
+    }
+        
+    // AP4_BlockCipher methods
+    virtual AP4_Result Process(const AP4_UI08* input, 
+                               AP4_Size        input_size,
+                               AP4_UI08*       output,
+                               const AP4_UI08* iv);
+    virtual AP4_Result EncryptBlocks(const AP4_UI08* input,
+                                     AP4_Cardinal    block_count,
+                                     AP4_UI08*       output) {
+        // the decryption key schedule can't run the forward cipher
+        if (m_Direction == DECRYPT) return AP4_ERROR_NOT_SUPPORTED;
+        AP4_AesNi_EncryptBlocks(m_RoundKeys, input, block_count, output);
+        return AP4_SUCCESS;
+    }
+
+private:
+    // members
+    AP4_UI08 m_RoundKeys[16*(AP4_AESNI_ROUND_COUNT+1)];
+};
+
+/*----------------------------------------------------------------------
+|   AP4_AesNiCbcBlockCipher::Process
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET AP4_Result 
+AP4_AesNiCbcBlockCipher::Process(const AP4_UI08* input, 
+                                 AP4_Size        input_size,
+                                 AP4_UI08*       output,
+                                 const AP4_UI08* iv)
+{
+    // check the parameters
+    if (input_size%AP4_AES_BLOCK_SIZE) {
+        return AP4_ERROR_INVALID_PARAMETERS;
+    }
+
+    __m128i k[AP4_AESNI_ROUND_COUNT+1];
+    AP4_AesNi_LoadKeys(m_RoundKeys, k);
+    
+    // setup the chaining block from the IV
+    __m128i chaining_block = iv ? _mm_loadu_si128((const __m128i*)iv) : _mm_setzero_si128();
+    
+    unsigned int block_count = input_size/AP4_AES_BLOCK_SIZE;
+    if (m_Direction == ENCRYPT) {
+        // each block depends on the previous one, so this is serial
+        for (unsigned int i=0; i<block_count; i++) {
+            __m128i block = _mm_loadu_si128((const __m128i*)input);
+            chaining_block = AP4_AesNi_EncryptBlock(_mm_xor_si128(block, chaining_block), k);
+            _mm_storeu_si128((__m128i*)output, chaining_block);
+            input  += AP4_AES_BLOCK_SIZE;
+            output += AP4_AES_BLOCK_SIZE;
+        }
+    } else {
+        // decryption can run several independent blocks through the pipeline
+        while (block_count >= AP4_AESNI_PIPELINE_DEPTH) {
+            __m128i in[AP4_AESNI_PIPELINE_DEPTH];
+            __m128i out[AP4_AESNI_PIPELINE_DEPTH];
+            for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                in[i]  = _mm_loadu_si128((const __m128i*)(input+16*i));
+                out[i] = _mm_xor_si128(in[i], k[0]);
+            }
+            for (unsigned int r=1; r<AP4_AESNI_ROUND_COUNT; r++) {
+                for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                    out[i] = _mm_aesdec_si128(out[i], k[r]);
+                }
+            }
+            for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                out[i] = _mm_aesdeclast_si128(out[i], k[AP4_AESNI_ROUND_COUNT]);
+                out[i] = _mm_xor_si128(out[i], i ? in[i-1] : chaining_block);
+                _mm_storeu_si128((__m128i*)(output+16*i), out[i]);
+            }
+            chaining_block = in[AP4_AESNI_PIPELINE_DEPTH-1];
+            input       += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+            output      += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+            block_count -= AP4_AESNI_PIPELINE_DEPTH;
+        }
+        for (unsigned int i=0; i<block_count; i++) {
+            __m128i block = _mm_loadu_si128((const __m128i*)input);
+            __m128i clear = _mm_xor_si128(AP4_AesNi_DecryptBlock(block, k), chaining_block);
+            _mm_storeu_si128((__m128i*)output, clear);
+            chaining_block = block;
+            input  += AP4_AES_BLOCK_SIZE;
+            output += AP4_AES_BLOCK_SIZE;
+        }
+    }
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_AesNiCtrBlockCipher
++---------------------------------------------------------------------*/
+class AP4_AesNiCtrBlockCipher : public AP4_AesBlockCipher
+{
+public:
+    AP4_AesNiCtrBlockCipher(CipherDirection direction,
+                            const AP4_UI08* key) :
+        AP4_AesBlockCipher(direction, CTR, NULL) {
+        AP4_AesNi_ExpandKey(key, false, m_RoundKeys);
+    }
+        
+    // AP4_BlockCipher methods
+    virtual AP4_Result Process(const AP4_UI08* input, 
+                               AP4_Size        input_size,
+                               AP4_UI08*       output,
+                               const AP4_UI08* iv);
+    virtual AP4_Result EncryptBlocks(const AP4_UI08* input,
+                                     AP4_Cardinal    block_count,
+                                     AP4_UI08*       output) {
+        AP4_AesNi_EncryptBlocks(m_RoundKeys, input, block_count, output);
+        return AP4_SUCCESS;
+    }
+
+private:
+    // members
+    AP4_UI08 m_RoundKeys[16*(AP4_AESNI_ROUND_COUNT+1)];
+};
+
+/*----------------------------------------------------------------------
+|   AP4_AesNiCtrBlockCipher::Process
++---------------------------------------------------------------------*/
+AP4_AESNI_TARGET AP4_Result 
+AP4_AesNiCtrBlockCipher::Process(const AP4_UI08* input, 
+                                 AP4_Size        input_size,
+                                 AP4_UI08*       output,
+                                 const AP4_UI08* iv)
+{
+    __m128i k[AP4_AESNI_ROUND_COUNT+1];
+    AP4_AesNi_LoadKeys(m_RoundKeys, k);
+
+    // split the counter in two halves so that it can be incremented cheaply.
+    // like AP4_AesCtrBlockCipher, the carry never propagates into byte 0
+    AP4_UI64 counter_hi = 0;
+    AP4_UI64 counter_lo = 0;
+    if (iv) {
+        counter_hi = AP4_BytesToUInt64BE(iv);
+        counter_lo = AP4_BytesToUInt64BE(iv+8);
+    }
+    const AP4_UI64 carry_mask = (((AP4_UI64)1)<<56)-1;
+    
+    AP4_UI08 counters[AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE];
+    while (input_size) {
+        unsigned int block_count = (input_size+AP4_AES_BLOCK_SIZE-1)/AP4_AES_BLOCK_SIZE;
+        if (block_count > AP4_AESNI_PIPELINE_DEPTH) block_count = AP4_AESNI_PIPELINE_DEPTH;
+        
+        // lay out the counter blocks for this batch
+        for (unsigned int i=0; i<block_count; i++) {
+            AP4_BytesFromUInt64BE(&counters[16*i],   counter_hi);
+            AP4_BytesFromUInt64BE(&counters[16*i+8], counter_lo);
+            if (++counter_lo == 0) {
+                counter_hi = (counter_hi & ~carry_mask) | ((counter_hi+1) & carry_mask);
+            }
+        }
+        
+        if (block_count == AP4_AESNI_PIPELINE_DEPTH && input_size >= AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE) {
+            // full batch: interleave the rounds of all the blocks
+            __m128i ks[AP4_AESNI_PIPELINE_DEPTH];
+            for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                ks[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i*)&counters[16*i]), k[0]);
+            }
+            for (unsigned int r=1; r<AP4_AESNI_ROUND_COUNT; r++) {
+                for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                    ks[i] = _mm_aesenc_si128(ks[i], k[r]);
+                }
+            }
+            for (unsigned int i=0; i<AP4_AESNI_PIPELINE_DEPTH; i++) {
+                ks[i] = _mm_aesenclast_si128(ks[i], k[AP4_AESNI_ROUND_COUNT]);
+                __m128i in = _mm_loadu_si128((const __m128i*)(input+16*i));
+                _mm_storeu_si128((__m128i*)(output+16*i), _mm_xor_si128(in, ks[i]));
+            }
+            input      += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+            output     += AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+            input_size -= AP4_AESNI_PIPELINE_DEPTH*AP4_AES_BLOCK_SIZE;
+        } else {
+            // tail: one block at a time, the last one may be partial
+            for (unsigned int i=0; i<block_count; i++) {
+                __m128i ks = AP4_AesNi_EncryptBlock(_mm_loadu_si128((const __m128i*)&counters[16*i]), k);
+                if (input_size >= AP4_AES_BLOCK_SIZE) {
+                    __m128i in = _mm_loadu_si128((const __m128i*)input);
+                    _mm_storeu_si128((__m128i*)output, _mm_xor_si128(in, ks));
+                    input      += AP4_AES_BLOCK_SIZE;
+                    output     += AP4_AES_BLOCK_SIZE;
+                    input_size -= AP4_AES_BLOCK_SIZE;
+                } else {
+                    AP4_UI08 block[AP4_AES_BLOCK_SIZE];
+                    _mm_storeu_si128((__m128i*)block, ks);
+                    for (unsigned int j=0; j<input_size; j++) {
+                        output[j] = input[j]^block[j];
+                    }
+                    input_size = 0;
+                }
+            }
+        }
+    }
+    return AP4_SUCCESS;
+}
+#endif // AP4_CONFIG_HAVE_AESNI
+
 /*----------------------------------------------------------------------
 |   AP4_AesBlockCipher::Create
 +---------------------------------------------------------------------*/
@@ -1975,6 +2361,24 @@ AP4_AesBlockCipher::Create(const AP4_UI08*      key,
 {
     cipher = NULL;
 
+#if defined(AP4_CONFIG_HAVE_AESNI)
+    // use the hardware implementation when the CPU supports it
+    if (AP4_AesNi_IsSupported()) {
+        switch (mode) {
+            case AP4_BlockCipher::CBC:
+                cipher = new AP4_AesNiCbcBlockCipher(direction, key);
+                return AP4_SUCCESS;
+                
+            case AP4_BlockCipher::CTR:
+                cipher = new AP4_AesNiCtrBlockCipher(direction, key);
+                return AP4_SUCCESS;
+                
+            default:
+                return AP4_ERROR_INVALID_PARAMETERS;
+        }
+    }
+#endif
+
     aes_ctx* context = new aes_ctx();
     
     switch (mode) {
@@ -2012,3 +2416,25 @@ AP4_AesBlockCipher::~AP4_AesBlockCipher()
 {
     delete m_Context;
 }
+
+/*----------------------------------------------------------------------
+|   AP4_AesBlockCipher::EncryptBlocks
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_AesBlockCipher::EncryptBlocks(const AP4_UI08* input,
+                                  AP4_Cardinal    block_count,
+                                  AP4_UI08*       output)
+{
+    // CBC decryption contexts only hold the inverse key schedule
+    if (m_Context == NULL || (m_Mode == CBC && m_Direction == DECRYPT)) {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    
+    for (unsigned int i=0; i<block_count; i++) {
+        aes_enc_blk(input, output, m_Context);
+        input  += AP4_AES_BLOCK_SIZE;
+        output += AP4_AES_BLOCK_SIZE;
+    }
+    
+    return AP4_SUCCESS;
+}
@@ -39,6 +39,9 @@ public:
     virtual ~AP4_AesBlockCipher();
 
     virtual CipherDirection GetDirection() { return m_Direction; }
+    virtual AP4_Result      EncryptBlocks(const AP4_UI08* input,
+                                          AP4_Cardinal    block_count,
+                                          AP4_UI08*       output);
     
 protected:
     // constructor
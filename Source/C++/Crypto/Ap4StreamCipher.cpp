@@ -32,6 +32,35 @@
 #include "Ap4StreamCipher.h"
 #include "Ap4Utils.h"
 
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+// number of keystream blocks generated per call to the block cipher
+const unsigned int AP4_CTR_STREAM_CIPHER_BATCH_SIZE = 64;
+
+/*----------------------------------------------------------------------
+|   AP4_XorBytes
++---------------------------------------------------------------------*/
+static void
+AP4_XorBytes(AP4_UI08* out, const AP4_UI08* a, const AP4_UI08* b, AP4_Size size)
+{
+    // work on 64-bit words (memcpy keeps this safe for unaligned buffers)
+    while (size >= 8) {
+        AP4_UI64 x, y;
+        AP4_CopyMemory(&x, a, 8);
+        AP4_CopyMemory(&y, b, 8);
+        x ^= y;
+        AP4_CopyMemory(out, &x, 8);
+        out  += 8;
+        a    += 8;
+        b    += 8;
+        size -= 8;
+    }
+    while (size--) {
+        *out++ = *a++ ^ *b++;
+    }
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CtrStreamCipher::AP4_CtrStreamCipher
 +---------------------------------------------------------------------*/
@@ -123,6 +152,25 @@ AP4_CtrStreamCipher::ComputeCounter(AP4_UI64 stream_offset,
     }
 }
 
+/*----------------------------------------------------------------------
+|   AP4_CtrStreamCipher::IncrementCounter
++---------------------------------------------------------------------*/
+void
+AP4_CtrStreamCipher::IncrementCounter(AP4_UI08  counter_block[AP4_CIPHER_BLOCK_SIZE],
+                                      AP4_UI64& counter_low)
+{
+    // the low 8 bytes are kept in counter_low, the block holds the high 8 bytes.
+    // only the last m_CounterSize bytes are part of the counter
+    if (m_CounterSize < 8) {
+        AP4_UI64 mask = (((AP4_UI64)1)<<(8*m_CounterSize))-1;
+        counter_low = (counter_low & ~mask) | ((counter_low+1) & mask);
+    } else if (++counter_low == 0) {
+        for (unsigned int i=8; i<m_CounterSize; i++) {
+            if (++counter_block[AP4_CIPHER_BLOCK_SIZE-1-i]) break;
+        }
+    }
+}
+
 /*----------------------------------------------------------------------
 |   AP4_CtrStreamCipher::ProcessBuffer
 +---------------------------------------------------------------------*/
@@ -180,7 +228,47 @@ AP4_CtrStreamCipher::ProcessBuffer(const AP4_UI08* in,
         AP4_UI08 counter_block[AP4_CIPHER_BLOCK_SIZE];
         ComputeCounter(m_StreamOffset, counter_block);
         
-        // process the data
+        // generate the keystream in batches when the block cipher supports it
+        AP4_UI08 counter_blocks[AP4_CTR_STREAM_CIPHER_BATCH_SIZE*AP4_CIPHER_BLOCK_SIZE];
+        AP4_UI08 keystream[AP4_CTR_STREAM_CIPHER_BATCH_SIZE*AP4_CIPHER_BLOCK_SIZE];
+        AP4_UI64 counter_low = AP4_BytesToUInt64BE(&counter_block[8]);
+        while (in_size) {
+            unsigned int block_count = (in_size+AP4_CIPHER_BLOCK_SIZE-1)/AP4_CIPHER_BLOCK_SIZE;
+            if (block_count > AP4_CTR_STREAM_CIPHER_BATCH_SIZE) {
+                block_count = AP4_CTR_STREAM_CIPHER_BATCH_SIZE;
+            }
+            for (unsigned int i=0; i<block_count; i++) {
+                AP4_UI08* counter = &counter_blocks[i*AP4_CIPHER_BLOCK_SIZE];
+                AP4_CopyMemory(counter, counter_block, 8);
+                for (unsigned int j=0; j<8; j++) {
+                    counter[8+j] = (AP4_UI08)(counter_low>>(56-8*j));
+                }
+                IncrementCounter(counter_block, counter_low);
+            }
+            AP4_Result result = m_BlockCipher->EncryptBlocks(counter_blocks, block_count, keystream);
+            if (result == AP4_ERROR_NOT_SUPPORTED) break;
+            if (AP4_FAILED(result)) {
+                if (out_size) *out_size = 0;
+                return result;
+            }
+            
+            unsigned int chunk = block_count*AP4_CIPHER_BLOCK_SIZE;
+            if (chunk > in_size) {
+                // keep the last keystream block for the next call
+                chunk = in_size;
+                AP4_CopyMemory(m_CacheBlock, &keystream[(block_count-1)*AP4_CIPHER_BLOCK_SIZE], AP4_CIPHER_BLOCK_SIZE);
+                m_CacheValid = true;
+            }
+            AP4_XorBytes(out, in, keystream, chunk);
+            m_StreamOffset += chunk;
+            in             += chunk;
+            out            += chunk;
+            in_size        -= chunk;
+        }
+        if (in_size == 0) return AP4_SUCCESS;
+        
+        // let the block cipher do the work in CTR mode
+        ComputeCounter(m_StreamOffset, counter_block);
         AP4_Result result = m_BlockCipher->Process(in, in_size, out, counter_block);
         if (AP4_FAILED(result)) {
             if (out_size) *out_size = 0;
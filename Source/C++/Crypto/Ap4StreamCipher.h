@@ -103,6 +103,8 @@ private:
     // methods
     void ComputeCounter(AP4_UI64 stream_offset, 
                         AP4_UI08 counter_block[AP4_CIPHER_BLOCK_SIZE]);
+    void IncrementCounter(AP4_UI08  counter_block[AP4_CIPHER_BLOCK_SIZE],
+                          AP4_UI64& counter_low);
                         
     // members
     AP4_UI64         m_StreamOffset;
@@ -0,0 +1,361 @@
+/*****************************************************************
+|
+|    AP4 - Posix Memory Mapped File Byte Stream implementation
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#define _LARGEFILE_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "Ap4FileByteStream.h"
+#include "Ap4Utils.h"
+#include "Ap4Threads.h"
+
+#if defined(AP4_CONFIG_HAVE_MMAP)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream
++---------------------------------------------------------------------*/
+class AP4_PosixMappedFileByteStream: public AP4_ByteStream
+{
+public:
+    // class methods
+    static AP4_Result Create(AP4_FileByteStream* delegator,
+                             const char*         name,
+                             AP4_ByteStream*&    stream);
+
+    // methods
+    AP4_PosixMappedFileByteStream(AP4_FileByteStream* delegator,
+                                  const AP4_UI08*     data,
+                                  AP4_LargeSize       size);
+    ~AP4_PosixMappedFileByteStream();
+
+    // AP4_ByteStream methods
+    AP4_Result ReadPartial(void*     buffer, 
+                           AP4_Size  bytes_to_read, 
+                           AP4_Size& bytes_read);
+    AP4_Result WritePartial(const void* buffer, 
+                            AP4_Size    bytes_to_write, 
+                            AP4_Size&   bytes_written);
+    AP4_Result Seek(AP4_Position position);
+    AP4_Result Tell(AP4_Position& position);
+    AP4_Result GetSize(AP4_LargeSize& size);
+    AP4_Result CopyTo(AP4_ByteStream& stream, AP4_LargeSize size);
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read);
+    AP4_Result Prefetch(AP4_Position position, AP4_LargeSize size);
+    AP4_Result Borrow(AP4_Position     position,
+                      AP4_Size         size,
+                      const AP4_UI08*& data);
+
+    // AP4_Referenceable methods
+    void AddReference();
+    void Release();
+
+private:
+    // members
+    AP4_ByteStream*       m_Delegator;
+    volatile AP4_Cardinal m_ReferenceCount;
+    const AP4_UI08*       m_Data;
+    AP4_LargeSize         m_Size;
+    AP4_Position          m_Position;
+};
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Create
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::Create(AP4_FileByteStream* delegator,
+                                      const char*         name,
+                                      AP4_ByteStream*&    stream)
+{
+    // default value
+    stream = NULL;
+
+    // check arguments
+    if (name == NULL) return AP4_ERROR_INVALID_PARAMETERS;
+
+    // open the file
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return AP4_ERROR_NO_SUCH_FILE;
+        } else if (errno == EACCES) {
+            return AP4_ERROR_PERMISSION_DENIED;
+        } else {
+            return AP4_ERROR_CANNOT_OPEN_FILE;
+        }
+    }
+
+    // get the size, only regular files can be mapped
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+    AP4_LargeSize size = (AP4_LargeSize)info.st_size;
+    if (size != (AP4_LargeSize)(size_t)size) {
+        // too large for the address space
+        close(fd);
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+
+    // map the file (empty files can't be mapped, but don't need to be)
+    const AP4_UI08* data = NULL;
+    if (size) {
+        void* mapping = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return AP4_ERROR_NOT_SUPPORTED;
+        }
+        data = (const AP4_UI08*)mapping;
+    }
+
+    // the mapping stays valid after the file descriptor is closed
+    close(fd);
+
+    stream = new AP4_PosixMappedFileByteStream(delegator, data, size);
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::AP4_PosixMappedFileByteStream
++---------------------------------------------------------------------*/
+AP4_PosixMappedFileByteStream::AP4_PosixMappedFileByteStream(AP4_FileByteStream* delegator,
+                                                             const AP4_UI08*     data,
+                                                             AP4_LargeSize       size) :
+    m_Delegator(delegator),
+    m_ReferenceCount(1),
+    m_Data(data),
+    m_Size(size),
+    m_Position(0)
+{
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::~AP4_PosixMappedFileByteStream
++---------------------------------------------------------------------*/
+AP4_PosixMappedFileByteStream::~AP4_PosixMappedFileByteStream()
+{
+    if (m_Data) {
+        munmap((void*)m_Data, (size_t)m_Size);
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::AddReference
++---------------------------------------------------------------------*/
+void
+AP4_PosixMappedFileByteStream::AddReference()
+{
+    AP4_System_AtomicIncrement(m_ReferenceCount);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Release
++---------------------------------------------------------------------*/
+void
+AP4_PosixMappedFileByteStream::Release()
+{
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
+        if (m_Delegator) {
+            delete m_Delegator;
+        } else {
+            delete this;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::ReadPartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::ReadPartial(void*     buffer, 
+                                           AP4_Size  bytes_to_read, 
+                                           AP4_Size& bytes_read)
+{
+    // default values
+    bytes_read = 0;
+
+    // shortcut
+    if (bytes_to_read == 0) {
+        return AP4_SUCCESS;
+    }
+
+    // clamp to range
+    if (m_Position+bytes_to_read > m_Size) {
+        bytes_to_read = (AP4_Size)(m_Size - m_Position);
+    }
+
+    // check for end of stream
+    if (bytes_to_read == 0) {
+        return AP4_ERROR_EOS;
+    }
+
+    // read from the mapping
+    AP4_CopyMemory(buffer, m_Data+m_Position, bytes_to_read);
+    m_Position += bytes_to_read;
+    bytes_read = bytes_to_read;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::WritePartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::WritePartial(const void* /*buffer*/, 
+                                            AP4_Size    /*bytes_to_write*/, 
+                                            AP4_Size&   bytes_written)
+{
+    bytes_written = 0;
+    return AP4_ERROR_NOT_SUPPORTED;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Seek
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::Seek(AP4_Position position)
+{
+    if (position > m_Size) return AP4_FAILURE;
+    m_Position = position;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Tell
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::Tell(AP4_Position& position)
+{
+    position = m_Position;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::GetSize
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::GetSize(AP4_LargeSize& size)
+{
+    size = m_Size;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::CopyTo
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::CopyTo(AP4_ByteStream& stream, AP4_LargeSize size)
+{
+    // write directly from the mapping, without an intermediate buffer
+    if (m_Position+size > m_Size) return AP4_ERROR_EOS;
+    while (size) {
+        AP4_Size chunk = size > 0x40000000 ? 0x40000000 : (AP4_Size)size;
+        AP4_Result result = stream.Write(m_Data+m_Position, chunk);
+        if (AP4_FAILED(result)) return result;
+        m_Position += chunk;
+        size       -= chunk;
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::ReadPartialAt(AP4_Position position,
+                                             void*        buffer,
+                                             AP4_Size     bytes_to_read,
+                                             AP4_Size&    bytes_read)
+{
+    // copy from the mapping, without touching the current position
+    bytes_read = 0;
+    if (bytes_to_read == 0) return AP4_SUCCESS;
+    if (position >= m_Size) return AP4_ERROR_EOS;
+    if (position+bytes_to_read > m_Size) {
+        bytes_to_read = (AP4_Size)(m_Size - position);
+    }
+    AP4_CopyMemory(buffer, m_Data+position, bytes_to_read);
+    bytes_read = bytes_to_read;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Prefetch
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::Prefetch(AP4_Position position, AP4_LargeSize size)
+{
+    // ask the kernel to start paging in the range (page aligned)
+    if (position >= m_Size || size == 0) return AP4_SUCCESS;
+    if (position+size > m_Size) size = m_Size-position;
+    long page_size = sysconf(_SC_PAGESIZE);
+    AP4_Position start = page_size > 0 ? position-(position%page_size) : position;
+    madvise((void*)(m_Data+start), (size_t)(position+size-start), MADV_WILLNEED);
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_PosixMappedFileByteStream::Borrow
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_PosixMappedFileByteStream::Borrow(AP4_Position     position,
+                                      AP4_Size         size,
+                                      const AP4_UI08*& data)
+{
+    data = NULL;
+    if (position+size > m_Size) return AP4_ERROR_OUT_OF_RANGE;
+    data = m_Data+position;
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_CreateMappedFileByteStream
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_CreateMappedFileByteStream(AP4_FileByteStream* delegator,
+                                      const char*         name,
+                                      AP4_ByteStream*&    stream)
+{
+    return AP4_PosixMappedFileByteStream::Create(delegator, name, stream);
+}
+
+#endif // AP4_CONFIG_HAVE_MMAP
@@ -0,0 +1,215 @@
+/*****************************************************************
+|
+|    AP4 - Posix Threads implementation
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <pthread.h>
+#include <unistd.h>
+
+#include "Ap4Threads.h"
+
+/*----------------------------------------------------------------------
+|   AP4_PosixThread_EntryPoint
++---------------------------------------------------------------------*/
+extern "C" {
+static void*
+AP4_PosixThread_EntryPoint(void* argument)
+{
+    AP4_Runnable* target = reinterpret_cast<AP4_Runnable*>(argument);
+    target->Run();
+    return NULL;
+}
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_StartThread
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_StartThread(AP4_Runnable& target, void*& handle)
+{
+    handle = NULL;
+    pthread_t* thread = new pthread_t;
+    if (pthread_create(thread, NULL, AP4_PosixThread_EntryPoint, &target)) {
+        delete thread;
+        return AP4_FAILURE;
+    }
+    handle = thread;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_WaitThread
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_WaitThread(void* handle)
+{
+    pthread_t* thread = reinterpret_cast<pthread_t*>(handle);
+    int result = pthread_join(*thread, NULL);
+    delete thread;
+    
+    return result ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_CreateMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_CreateMutex(void*& handle)
+{
+    handle = NULL;
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    if (pthread_mutex_init(mutex, NULL)) {
+        delete mutex;
+        return AP4_FAILURE;
+    }
+    handle = mutex;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_DestroyMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_DestroyMutex(void* handle)
+{
+    pthread_mutex_t* mutex = reinterpret_cast<pthread_mutex_t*>(handle);
+    int result = pthread_mutex_destroy(mutex);
+    delete mutex;
+
+    return result ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_LockMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_LockMutex(void* handle)
+{
+    return pthread_mutex_lock(reinterpret_cast<pthread_mutex_t*>(handle)) ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_UnlockMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_UnlockMutex(void* handle)
+{
+    return pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(handle)) ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_CreateCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_CreateCondition(void*& handle)
+{
+    handle = NULL;
+    pthread_cond_t* condition = new pthread_cond_t;
+    if (pthread_cond_init(condition, NULL)) {
+        delete condition;
+        return AP4_FAILURE;
+    }
+    handle = condition;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_DestroyCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_DestroyCondition(void* handle)
+{
+    pthread_cond_t* condition = reinterpret_cast<pthread_cond_t*>(handle);
+    int result = pthread_cond_destroy(condition);
+    delete condition;
+
+    return result ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_WaitCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_WaitCondition(void* handle, void* mutex_handle)
+{
+    return pthread_cond_wait(reinterpret_cast<pthread_cond_t*>(handle),
+                             reinterpret_cast<pthread_mutex_t*>(mutex_handle)) ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_SignalCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_SignalCondition(void* handle)
+{
+    return pthread_cond_signal(reinterpret_cast<pthread_cond_t*>(handle)) ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_BroadcastCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_BroadcastCondition(void* handle)
+{
+    return pthread_cond_broadcast(reinterpret_cast<pthread_cond_t*>(handle)) ? AP4_FAILURE : AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_GetProcessorCount
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_GetProcessorCount()
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0) return (AP4_Cardinal)count;
+#endif
+    return 1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_AtomicIncrement
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_AtomicIncrement(volatile AP4_Cardinal& value)
+{
+    return __sync_add_and_fetch(&value, 1);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_AtomicDecrement
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_AtomicDecrement(volatile AP4_Cardinal& value)
+{
+    return __sync_sub_and_fetch(&value, 1);
+}
@@ -40,6 +40,26 @@
 #endif
 
 #include "Ap4FileByteStream.h"
+#include "Ap4Threads.h"
+
+#if defined(AP4_CONFIG_HAVE_VECTORED_IO)
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+#if defined(AP4_CONFIG_HAVE_FADVISE)
+#include <fcntl.h>
+#endif
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+// files that are written get a larger stdio buffer than the default
+// (usually 4KB), so that many small writes (TS packets, atom headers)
+// are combined into fewer system calls
+const unsigned int AP4_STDC_FILE_BYTE_STREAM_WRITE_BUFFER_SIZE = 65536;
+#if defined(AP4_CONFIG_HAVE_VECTORED_IO)
+const unsigned int AP4_STDC_FILE_BYTE_STREAM_MAX_IOVECS        = 64;
+#endif
 
 /*----------------------------------------------------------------------
 |   compatibility wrappers
@@ -81,7 +101,9 @@ public:
     // methods
     AP4_StdcFileByteStream(AP4_FileByteStream* delegator,
                            FILE*               file, 
-                           AP4_LargeSize       size);
+                           AP4_LargeSize       size,
+                           bool                read_only = false,
+                           char*               buffer = NULL);
     
     ~AP4_StdcFileByteStream();
 
@@ -96,6 +118,18 @@ public:
     AP4_Result Tell(AP4_Position& position);
     AP4_Result GetSize(AP4_LargeSize& size);
     AP4_Result Flush();
+#if defined(AP4_CONFIG_HAVE_FADVISE)
+    AP4_Result Prefetch(AP4_Position position, AP4_LargeSize size);
+#endif
+#if defined(AP4_CONFIG_HAVE_VECTORED_IO)
+    AP4_Result ReadPartialAt(AP4_Position position,
+                             void*        buffer,
+                             AP4_Size     bytes_to_read,
+                             AP4_Size&    bytes_read);
+    AP4_Result ReadvPartial(const AP4_IoVector* vectors,
+                            AP4_Cardinal        vector_count,
+                            AP4_Size&           bytes_read);
+#endif
 
     // AP4_Referenceable methods
     void AddReference();
@@ -103,11 +137,13 @@ public:
 
 private:
     // members
-    AP4_ByteStream* m_Delegator;
-    AP4_Cardinal    m_ReferenceCount;
-    FILE*           m_File;
-    AP4_Position    m_Position;
-    AP4_LargeSize   m_Size;
+    AP4_ByteStream*       m_Delegator;
+    volatile AP4_Cardinal m_ReferenceCount;
+    FILE*                 m_File;
+    AP4_Position          m_Position;
+    AP4_LargeSize         m_Size;
+    bool                  m_ReadOnly;
+    char*                 m_Buffer;
 };
 
 /*----------------------------------------------------------------------
@@ -127,6 +163,7 @@ AP4_StdcFileByteStream::Create(AP4_FileByteStream*      delegator,
     
     // open the file
     FILE* file = NULL;
+    char* buffer = NULL;
     AP4_Position size = 0;
     if (!strcmp(name, "-stdin")) {
         file = stdin;
@@ -137,6 +174,16 @@ AP4_StdcFileByteStream::Create(AP4_FileByteStream*      delegator,
     } else {
         int open_result;
         switch (mode) {
+          case AP4_FileByteStream::STREAM_MODE_READ_MAPPED:
+#if defined(AP4_CONFIG_HAVE_MMAP)
+            if (AP4_SUCCEEDED(AP4_System_CreateMappedFileByteStream(delegator, name, stream))) {
+                return AP4_SUCCESS;
+            }
+#endif
+            // fallback: use a regular read-only file
+            open_result = fopen_s(&file, name, "rb");
+            break;
+
           case AP4_FileByteStream::STREAM_MODE_READ:
             open_result = fopen_s(&file, name, "rb");
             break;
@@ -163,6 +210,17 @@ AP4_StdcFileByteStream::Create(AP4_FileByteStream*      delegator,
             }
         }
 
+        // use a larger buffer for files that are written
+        // (the buffer must outlive the FILE, so the stream owns it)
+        if (mode == AP4_FileByteStream::STREAM_MODE_WRITE ||
+            mode == AP4_FileByteStream::STREAM_MODE_READ_WRITE) {
+            buffer = new char[AP4_STDC_FILE_BYTE_STREAM_WRITE_BUFFER_SIZE];
+            if (setvbuf(file, buffer, _IOFBF, AP4_STDC_FILE_BYTE_STREAM_WRITE_BUFFER_SIZE) != 0) {
+                delete[] buffer;
+                buffer = NULL;
+            }
+        }
+
         // get the size
         if (AP4_fseek(file, 0, SEEK_END) >= 0) {
             size = AP4_ftell(file);
@@ -171,7 +229,12 @@ AP4_StdcFileByteStream::Create(AP4_FileByteStream*      delegator,
         
     }
 
-    stream = new AP4_StdcFileByteStream(delegator, file, size);
+    // only read-only files can be read positionally without going through
+    // (and being confused by) data buffered by stdio for writing
+    bool read_only = (file != stdin && file != stdout && file != stderr &&
+                      (mode == AP4_FileByteStream::STREAM_MODE_READ ||
+                       mode == AP4_FileByteStream::STREAM_MODE_READ_MAPPED));
+    stream = new AP4_StdcFileByteStream(delegator, file, size, read_only, buffer);
     return AP4_SUCCESS;
 }
 
@@ -180,12 +243,16 @@ AP4_StdcFileByteStream::Create(AP4_FileByteStream*      delegator,
 +---------------------------------------------------------------------*/
 AP4_StdcFileByteStream::AP4_StdcFileByteStream(AP4_FileByteStream* delegator,
                                                FILE*               file,
-                                               AP4_LargeSize       size) :
+                                               AP4_LargeSize       size,
+                                               bool                read_only,
+                                               char*               buffer) :
     m_Delegator(delegator),
     m_ReferenceCount(1),
     m_File(file),
     m_Position(0),
-    m_Size(size)
+    m_Size(size),
+    m_ReadOnly(read_only),
+    m_Buffer(buffer)
 {
 }
 
@@ -197,6 +264,7 @@ AP4_StdcFileByteStream::~AP4_StdcFileByteStream()
     if (m_File && m_File != stdin && m_File != stdout && m_File != stderr) {
         fclose(m_File);
     }
+    delete[] m_Buffer;
 }
 
 /*----------------------------------------------------------------------
@@ -205,7 +273,7 @@ AP4_StdcFileByteStream::~AP4_StdcFileByteStream()
 void
 AP4_StdcFileByteStream::AddReference()
 {
-    m_ReferenceCount++;
+    AP4_System_AtomicIncrement(m_ReferenceCount);
 }
 
 /*----------------------------------------------------------------------
@@ -214,7 +282,7 @@ AP4_StdcFileByteStream::AddReference()
 void
 AP4_StdcFileByteStream::Release()
 {
-    if (--m_ReferenceCount == 0) {
+    if (AP4_System_AtomicDecrement(m_ReferenceCount) == 0) {
         if (m_Delegator) {
             delete m_Delegator;
         } else {
@@ -271,6 +339,100 @@ AP4_StdcFileByteStream::WritePartial(const void* buffer,
     }
 }
 
+#if defined(AP4_CONFIG_HAVE_FADVISE)
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::Prefetch
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::Prefetch(AP4_Position position, AP4_LargeSize size)
+{
+    // ask the kernel to start reading the range asynchronously
+    if (!m_ReadOnly || size == 0) return AP4_SUCCESS;
+    posix_fadvise(fileno(m_File), (off_t)position, (off_t)size, POSIX_FADV_WILLNEED);
+    
+    return AP4_SUCCESS;
+}
+#endif
+
+#if defined(AP4_CONFIG_HAVE_VECTORED_IO)
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::ReadPartialAt
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::ReadPartialAt(AP4_Position position,
+                                      void*        buffer,
+                                      AP4_Size     bytes_to_read,
+                                      AP4_Size&    bytes_read)
+{
+    // pipes and files open for writing use the default seek+read
+    if (!m_ReadOnly) {
+        return AP4_ByteStream::ReadPartialAt(position, buffer, bytes_to_read, bytes_read);
+    }
+
+    // read directly from the file descriptor, leaving the stdio stream
+    // and the current position untouched, so that this can be called
+    // from several threads at once
+    bytes_read = 0;
+    if (bytes_to_read == 0) return AP4_SUCCESS;
+    ssize_t nb_read;
+    do {
+        nb_read = pread(fileno(m_File), buffer, bytes_to_read, (off_t)position);
+    } while (nb_read < 0 && errno == EINTR);
+    if (nb_read < 0) return AP4_ERROR_READ_FAILED;
+    if (nb_read == 0) return AP4_ERROR_EOS;
+    bytes_read = (AP4_Size)nb_read;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_StdcFileByteStream::ReadvPartial
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_StdcFileByteStream::ReadvPartial(const AP4_IoVector* vectors,
+                                     AP4_Cardinal        vector_count,
+                                     AP4_Size&           bytes_read)
+{
+    // pipes can't be read at a specific position
+    if (m_File == stdin) {
+        return AP4_ByteStream::ReadvPartial(vectors, vector_count, bytes_read);
+    }
+
+    bytes_read = 0;
+    if (vector_count > AP4_STDC_FILE_BYTE_STREAM_MAX_IOVECS) {
+        vector_count = AP4_STDC_FILE_BYTE_STREAM_MAX_IOVECS;
+    }
+    struct iovec iov[AP4_STDC_FILE_BYTE_STREAM_MAX_IOVECS];
+    for (unsigned int i=0; i<vector_count; i++) {
+        iov[i].iov_base = vectors[i].m_Data;
+        iov[i].iov_len  = vectors[i].m_Size;
+    }
+    
+    // read directly from the file descriptor at the current position,
+    // bypassing (and then invalidating) the stdio buffer
+    int fd = fileno(m_File);
+    if (lseek(fd, (off_t)m_Position, SEEK_SET) < 0) {
+        return AP4_ERROR_READ_FAILED;
+    }
+    ssize_t nb_read = readv(fd, iov, (int)vector_count);
+    if (nb_read < 0) {
+        AP4_fseek(m_File, m_Position, SEEK_SET);
+        return AP4_ERROR_READ_FAILED;
+    }
+    if (nb_read == 0) {
+        AP4_fseek(m_File, m_Position, SEEK_SET);
+        return AP4_ERROR_EOS;
+    }
+    bytes_read = (AP4_Size)nb_read;
+    m_Position += nb_read;
+    
+    // resync the stdio stream with the file descriptor
+    AP4_fseek(m_File, m_Position, SEEK_SET);
+    
+    return AP4_SUCCESS;
+}
+#endif
+
 /*----------------------------------------------------------------------
 |   AP4_StdcFileByteStream::Seek
 +---------------------------------------------------------------------*/
@@ -0,0 +1,211 @@
+/*****************************************************************
+|
+|    AP4 - Win32 Threads implementation
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+// condition variables need Windows Vista or later
+#if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+#undef  _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#include <process.h>
+
+#include "Ap4Threads.h"
+
+/*----------------------------------------------------------------------
+|   AP4_Win32Thread_EntryPoint
++---------------------------------------------------------------------*/
+static unsigned int __stdcall
+AP4_Win32Thread_EntryPoint(void* argument)
+{
+    AP4_Runnable* target = reinterpret_cast<AP4_Runnable*>(argument);
+    target->Run();
+    return 0;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_StartThread
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_StartThread(AP4_Runnable& target, void*& handle)
+{
+    // use _beginthreadex so that the C runtime is initialized for the thread
+    uintptr_t thread = _beginthreadex(NULL, 0, AP4_Win32Thread_EntryPoint, &target, 0, NULL);
+    if (thread == 0) {
+        handle = NULL;
+        return AP4_FAILURE;
+    }
+    handle = (void*)thread;
+    
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_WaitThread
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_WaitThread(void* handle)
+{
+    DWORD result = WaitForSingleObject((HANDLE)handle, INFINITE);
+    CloseHandle((HANDLE)handle);
+    
+    return result == WAIT_OBJECT_0 ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_CreateMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_CreateMutex(void*& handle)
+{
+    CRITICAL_SECTION* mutex = new CRITICAL_SECTION;
+    InitializeCriticalSection(mutex);
+    handle = mutex;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_DestroyMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_DestroyMutex(void* handle)
+{
+    CRITICAL_SECTION* mutex = reinterpret_cast<CRITICAL_SECTION*>(handle);
+    DeleteCriticalSection(mutex);
+    delete mutex;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_LockMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_LockMutex(void* handle)
+{
+    EnterCriticalSection(reinterpret_cast<CRITICAL_SECTION*>(handle));
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_UnlockMutex
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_UnlockMutex(void* handle)
+{
+    LeaveCriticalSection(reinterpret_cast<CRITICAL_SECTION*>(handle));
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_CreateCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_CreateCondition(void*& handle)
+{
+    CONDITION_VARIABLE* condition = new CONDITION_VARIABLE;
+    InitializeConditionVariable(condition);
+    handle = condition;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_DestroyCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_DestroyCondition(void* handle)
+{
+    // condition variables don't need to be deleted
+    delete reinterpret_cast<CONDITION_VARIABLE*>(handle);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_WaitCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_WaitCondition(void* handle, void* mutex_handle)
+{
+    return SleepConditionVariableCS(reinterpret_cast<CONDITION_VARIABLE*>(handle),
+                                    reinterpret_cast<CRITICAL_SECTION*>(mutex_handle),
+                                    INFINITE) ? AP4_SUCCESS : AP4_FAILURE;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_SignalCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_SignalCondition(void* handle)
+{
+    WakeConditionVariable(reinterpret_cast<CONDITION_VARIABLE*>(handle));
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_BroadcastCondition
++---------------------------------------------------------------------*/
+AP4_Result
+AP4_System_BroadcastCondition(void* handle)
+{
+    WakeAllConditionVariable(reinterpret_cast<CONDITION_VARIABLE*>(handle));
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_GetProcessorCount
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_GetProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (AP4_Cardinal)info.dwNumberOfProcessors : 1;
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_AtomicIncrement
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_AtomicIncrement(volatile AP4_Cardinal& value)
+{
+    return (AP4_Cardinal)InterlockedIncrement((volatile LONG*)&value);
+}
+
+/*----------------------------------------------------------------------
+|   AP4_System_AtomicDecrement
++---------------------------------------------------------------------*/
+AP4_Cardinal
+AP4_System_AtomicDecrement(volatile AP4_Cardinal& value)
+{
+    return (AP4_Cardinal)InterlockedDecrement((volatile LONG*)&value);
+}
@@ -0,0 +1,228 @@
+/*****************************************************************
+|
+|    AP4 - Arena Test
+|
+|    Copyright 2002-2016 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "Arena Test - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2016 Axiomatic Systems, LLC"
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x)                                                  \
+do {                                                              \
+    if (!(x)) {                                                   \
+        fprintf(stderr, "ERROR line %d: %s\n", __LINE__, #x);     \
+        return AP4_FAILURE;                                       \
+    }                                                             \
+} while(0)
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: arenatest <input>\n"
+            "Parses <input> with and without an arena and checks that the\n"
+            "two atom trees are identical.\n");
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   SerializeTree
++---------------------------------------------------------------------*/
+static AP4_Result
+SerializeTree(AP4_AtomParent& tree, AP4_MemoryByteStream& serialized, AP4_MemoryByteStream& dump)
+{
+    AP4_PrintInspector inspector(dump);
+    for (AP4_List<AP4_Atom>::Item* item = tree.GetChildren().FirstItem();
+                                   item;
+                                   item = item->GetNext()) {
+        AP4_Atom* atom = item->GetData();
+        AP4_Result result = atom->Write(serialized);
+        if (AP4_FAILED(result)) return result;
+        atom->Inspect(inspector);
+    }
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   CompareStreams
++---------------------------------------------------------------------*/
+static bool
+CompareStreams(AP4_MemoryByteStream& a, AP4_MemoryByteStream& b)
+{
+    return a.GetDataSize() == b.GetDataSize() &&
+           AP4_CompareMemory(a.GetData(), b.GetData(), a.GetDataSize()) == 0;
+}
+
+/*----------------------------------------------------------------------
+|   CompareAtomTrees
++---------------------------------------------------------------------*/
+static AP4_Result
+CompareAtomTrees(AP4_ByteStream& input)
+{
+    AP4_MemoryByteStream* heap_serialized  = new AP4_MemoryByteStream();
+    AP4_MemoryByteStream* heap_dump        = new AP4_MemoryByteStream();
+    AP4_MemoryByteStream* arena_serialized = new AP4_MemoryByteStream();
+    AP4_MemoryByteStream* arena_dump       = new AP4_MemoryByteStream();
+
+    // parse on the heap
+    AP4_AtomParent* heap_tree = new AP4_AtomParent();
+    {
+        AP4_DefaultAtomFactory atom_factory;
+        input.Seek(0);
+        CHECK(AP4_SUCCEEDED(atom_factory.CreateAtomsFromStream(input, *heap_tree)));
+    }
+    CHECK(AP4_SUCCEEDED(SerializeTree(*heap_tree, *heap_serialized, *heap_dump)));
+
+    // parse into an arena, and let the tree keep it alive
+    AP4_Arena* arena = new AP4_Arena();
+    AP4_AtomParent* arena_tree = new AP4_AtomParent();
+    {
+        AP4_DefaultAtomFactory atom_factory;
+        atom_factory.SetArena(arena);
+        input.Seek(0);
+        CHECK(AP4_SUCCEEDED(atom_factory.CreateAtomsFromStream(input, *arena_tree)));
+    }
+    arena->Release();
+    CHECK(AP4_SUCCEEDED(SerializeTree(*arena_tree, *arena_serialized, *arena_dump)));
+
+    CHECK(heap_tree->GetChildren().ItemCount() == arena_tree->GetChildren().ItemCount());
+    CHECK(CompareStreams(*heap_serialized, *arena_serialized));
+    CHECK(CompareStreams(*heap_dump, *arena_dump));
+
+    // atoms from the arena can be deleted one at a time
+    AP4_Atom* first = arena_tree->GetChildren().FirstItem()->GetData();
+    first->Detach();
+    delete first;
+
+    delete heap_tree;
+    delete arena_tree;
+    heap_serialized->Release();
+    heap_dump->Release();
+    arena_serialized->Release();
+    arena_dump->Release();
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   CompareSamples
++---------------------------------------------------------------------*/
+static AP4_Result
+CompareSamples(AP4_ByteStream& input)
+{
+    AP4_DefaultAtomFactory heap_factory;
+    AP4_DefaultAtomFactory arena_factory;
+    AP4_Arena* arena = new AP4_Arena();
+    arena_factory.SetArena(arena);
+    arena->Release();
+
+    input.Seek(0);
+    AP4_File* heap_file = new AP4_File(input, heap_factory, true);
+    input.Seek(0);
+    AP4_File* arena_file = new AP4_File(input, arena_factory, true);
+
+    AP4_Movie* heap_movie  = heap_file->GetMovie();
+    AP4_Movie* arena_movie = arena_file->GetMovie();
+    CHECK((heap_movie == NULL) == (arena_movie == NULL));
+    if (heap_movie) {
+        CHECK(heap_movie->GetTracks().ItemCount() == arena_movie->GetTracks().ItemCount());
+        AP4_List<AP4_Track>::Item* heap_item  = heap_movie->GetTracks().FirstItem();
+        AP4_List<AP4_Track>::Item* arena_item = arena_movie->GetTracks().FirstItem();
+        for (; heap_item; heap_item = heap_item->GetNext(), arena_item = arena_item->GetNext()) {
+            AP4_Track* heap_track  = heap_item->GetData();
+            AP4_Track* arena_track = arena_item->GetData();
+            CHECK(heap_track->GetSampleCount() == arena_track->GetSampleCount());
+            for (AP4_Ordinal i=0; i<heap_track->GetSampleCount(); i++) {
+                AP4_Sample heap_sample;
+                AP4_Sample arena_sample;
+                CHECK(AP4_SUCCEEDED(heap_track->GetSample(i, heap_sample)));
+                CHECK(AP4_SUCCEEDED(arena_track->GetSample(i, arena_sample)));
+                CHECK(heap_sample.GetOffset()           == arena_sample.GetOffset());
+                CHECK(heap_sample.GetSize()             == arena_sample.GetSize());
+                CHECK(heap_sample.GetDts()              == arena_sample.GetDts());
+                CHECK(heap_sample.GetCts()              == arena_sample.GetCts());
+                CHECK(heap_sample.IsSync()              == arena_sample.IsSync());
+                CHECK(heap_sample.GetDescriptionIndex() == arena_sample.GetDescriptionIndex());
+            }
+        }
+    }
+
+    delete heap_file;
+    delete arena_file;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int argc, char** argv)
+{
+    if (argc != 2) {
+        PrintUsageAndExit();
+    }
+    const char* input_filename = argv[1];
+
+    // open the input
+    AP4_ByteStream* input = NULL;
+    AP4_Result result = AP4_FileByteStream::Create(input_filename, AP4_FileByteStream::STREAM_MODE_READ, input);
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: cannot open input file (%s)\n", input_filename);
+        return 1;
+    }
+
+    result = CompareAtomTrees(*input);
+    if (AP4_SUCCEEDED(result)) result = CompareSamples(*input);
+    input->Release();
+
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "FAILED\n");
+        return 1;
+    }
+    printf("PASSED\n");
+
+    return 0;
+}
@@ -0,0 +1,1011 @@
+/*****************************************************************
+|
+|    AP4 - Media Processing Benchmarks
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#if defined (WIN32)
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+#define BANNER "Bento4 Media Benchmarks - Version 1.0\n"\
+               "(Bento4 Version " AP4_VERSION_STRING ")\n"\
+               "(c) 2002-2017 Axiomatic Systems, LLC"
+
+const unsigned int BENCH_DEFAULT_MEDIA_DURATION = 60;   // seconds of synthetic media
+const double       BENCH_DEFAULT_MIN_TIME       = 2.0;  // seconds per benchmark
+const unsigned int BENCH_FRAGMENT_DURATION      = 2;    // seconds
+const unsigned int BENCH_VIDEO_TRACK_ID         = 1;
+const unsigned int BENCH_AUDIO_TRACK_ID         = 2;
+const unsigned int BENCH_VIDEO_TIMESCALE        = 30000;
+const unsigned int BENCH_VIDEO_FRAME_DURATION   = 1000; // 30 fps
+const unsigned int BENCH_VIDEO_GOP_SIZE         = 60;
+const unsigned int BENCH_VIDEO_WIDTH            = 1280;
+const unsigned int BENCH_VIDEO_HEIGHT           = 720;
+const unsigned int BENCH_AUDIO_SAMPLE_RATE      = 44100;
+const unsigned int BENCH_AUDIO_FRAME_DURATION   = 1024;
+const double       BENCH_SCALE_MB               = 1024.0*1024.0;
+
+const AP4_UI08 BENCH_KEY[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+const AP4_UI08 BENCH_IV[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// a 1280x720 High profile SPS and a matching PPS
+const AP4_UI08 BENCH_AVC_SPS[] = {
+    0x67, 0x64, 0x00, 0x1f, 0xac, 0xd9, 0x40, 0x50, 0x05, 0xbb, 0x01, 0x10,
+    0x00, 0x00, 0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x03, 0xc0, 0xf1, 0x83,
+    0x19, 0x60
+};
+const AP4_UI08 BENCH_AVC_PPS[] = {
+    0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0
+};
+
+// AAC LC, 44100 Hz, stereo
+const AP4_UI08 BENCH_AAC_DSI[] = {
+    0x12, 0x10
+};
+
+/*----------------------------------------------------------------------
+|   globals
++---------------------------------------------------------------------*/
+static struct _Options {
+    unsigned int media_duration;
+    double       min_time;
+    unsigned int max_iterations;
+    unsigned int thread_count;
+    const char*  output_filename;
+} Options;
+
+/*----------------------------------------------------------------------
+|   BenchmarkResult
++---------------------------------------------------------------------*/
+struct BenchmarkResult {
+    const char*  m_Name;
+    unsigned int m_Iterations;
+    double       m_Seconds;
+    double       m_Bytes;
+    double       m_Samples;
+};
+
+/*----------------------------------------------------------------------
+|   BenchmarkData
++---------------------------------------------------------------------*/
+struct BenchmarkData {
+    AP4_DataBuffer m_Mp4;            // flat (non-fragmented) movie
+    AP4_DataBuffer m_FragmentedMp4;  // same movie, fragmented
+    AP4_DataBuffer m_EncryptedMp4;   // fragmented movie, CENC encrypted
+    AP4_Cardinal   m_SampleCount;
+    AP4_UI64       m_SampleBytes;
+};
+
+#if defined(WIN32)
+/*----------------------------------------------------------------------
+|   GetTime
++---------------------------------------------------------------------*/
+static double
+GetTime()
+{
+    struct _timeb time_stamp;
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1400)
+    _ftime_s(&time_stamp);
+#else
+    _ftime(&time_stamp);
+#endif
+    return (double)time_stamp.time+((double)time_stamp.millitm)/1000.0;
+}
+#else
+/*----------------------------------------------------------------------
+|   GetTime
++---------------------------------------------------------------------*/
+static double
+GetTime()
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (double)now.tv_sec+((double)now.tv_usec)/1000000.0;
+}
+#endif
+
+/*----------------------------------------------------------------------
+|   PrintUsageAndExit
++---------------------------------------------------------------------*/
+static void
+PrintUsageAndExit()
+{
+    fprintf(stderr,
+            BANNER
+            "\n\nusage: mediabenchmarks [options] [<test-name> ...]\n"
+            "Options:\n"
+            "  --duration <seconds>: duration of the synthetic movie (default: %d)\n"
+            "  --min-time <seconds>: run each test for at least that long (default: %.1f)\n"
+            "  --iterations <n>: run each test exactly <n> times (overrides --min-time)\n"
+            "  --threads <n>: number of threads to use for encryption and parallel reads (default: 1)\n"
+            "  --output <filename>: write the JSON results to a file instead of stdout\n"
+            "\n"
+            "valid test names are (all of them are run when none is specified):\n"
+            "  parse\n"
+            "  parse-tree\n"
+            "  parse-tree-arena\n"
+            "  linear-read\n"
+            "  linear-read-fragmented\n"
+            "  parallel-read\n"
+            "  fragment\n"
+            "  cenc-encrypt\n"
+            "  cenc-decrypt\n"
+            "  ts-mux\n",
+            BENCH_DEFAULT_MEDIA_DURATION,
+            BENCH_DEFAULT_MIN_TIME);
+    exit(1);
+}
+
+/*----------------------------------------------------------------------
+|   Random
++---------------------------------------------------------------------*/
+static AP4_UI32
+Random(AP4_UI32& state)
+{
+    // simple LCG, so that the synthetic media is the same on every run
+    state = state*1664525+1013904223;
+    return state>>8;
+}
+
+/*----------------------------------------------------------------------
+|   AddSyntheticSample
++---------------------------------------------------------------------*/
+static AP4_Result
+AddSyntheticSample(AP4_SyntheticSampleTable& sample_table,
+                   AP4_MemoryByteStream&     sample_storage,
+                   AP4_UI32&                 random,
+                   AP4_Size                  size,
+                   AP4_UI32                  duration,
+                   bool                      sync,
+                   AP4_UI08                  nalu_type)
+{
+    AP4_Position position = 0;
+    sample_storage.Tell(position);
+
+    AP4_DataBuffer data(size);
+    data.SetDataSize(size);
+    AP4_UI08* payload = data.UseData();
+    for (unsigned int i=0; i<size; i++) {
+        payload[i] = (AP4_UI08)Random(random);
+    }
+    if (nalu_type) {
+        // one NAL unit, with a 4-byte length prefix
+        AP4_BytesFromUInt32BE(payload, size-4);
+        payload[4] = nalu_type;
+    }
+    AP4_Result result = sample_storage.Write(payload, size);
+    if (AP4_FAILED(result)) return result;
+
+    return sample_table.AddSample(sample_storage, position, size, duration, 0, 0, 0, sync);
+}
+
+/*----------------------------------------------------------------------
+|   CreateSyntheticMovie
++---------------------------------------------------------------------*/
+static AP4_Result
+CreateSyntheticMovie(unsigned int duration, AP4_DataBuffer& mp4)
+{
+    AP4_Result            result = AP4_SUCCESS;
+    AP4_UI32              random = 0;
+    AP4_MemoryByteStream* sample_storage = new AP4_MemoryByteStream();
+
+    // video track: 1 large sync sample followed by smaller ones for each GOP
+    AP4_SyntheticSampleTable* video_table = new AP4_SyntheticSampleTable();
+    AP4_Array<AP4_DataBuffer> sps_array;
+    AP4_Array<AP4_DataBuffer> pps_array;
+    sps_array.Append(AP4_DataBuffer(BENCH_AVC_SPS, sizeof(BENCH_AVC_SPS)));
+    pps_array.Append(AP4_DataBuffer(BENCH_AVC_PPS, sizeof(BENCH_AVC_PPS)));
+    video_table->AddSampleDescription(new AP4_AvcSampleDescription(AP4_SAMPLE_FORMAT_AVC1,
+                                                                   BENCH_VIDEO_WIDTH,
+                                                                   BENCH_VIDEO_HEIGHT,
+                                                                   24,
+                                                                   "h264",
+                                                                   BENCH_AVC_SPS[1],
+                                                                   BENCH_AVC_SPS[3],
+                                                                   BENCH_AVC_SPS[2],
+                                                                   4,
+                                                                   sps_array,
+                                                                   pps_array));
+    unsigned int video_sample_count = duration*BENCH_VIDEO_TIMESCALE/BENCH_VIDEO_FRAME_DURATION;
+    for (unsigned int i=0; AP4_SUCCEEDED(result) && i<video_sample_count; i++) {
+        bool     sync = (i%BENCH_VIDEO_GOP_SIZE) == 0;
+        AP4_Size size = sync ? 40000+Random(random)%40000 : 2000+Random(random)%12000;
+        result = AddSyntheticSample(*video_table, *sample_storage, random, size, BENCH_VIDEO_FRAME_DURATION, sync, sync?0x65:0x41);
+    }
+
+    // audio track: AAC frames of roughly 128kbps
+    AP4_SyntheticSampleTable* audio_table = new AP4_SyntheticSampleTable();
+    AP4_DataBuffer dsi(BENCH_AAC_DSI, sizeof(BENCH_AAC_DSI));
+    audio_table->AddSampleDescription(new AP4_MpegAudioSampleDescription(AP4_OTI_MPEG4_AUDIO,
+                                                                         BENCH_AUDIO_SAMPLE_RATE,
+                                                                         16,
+                                                                         2,
+                                                                         &dsi,
+                                                                         6144,
+                                                                         128000,
+                                                                         128000));
+    unsigned int audio_sample_count = duration*BENCH_AUDIO_SAMPLE_RATE/BENCH_AUDIO_FRAME_DURATION;
+    for (unsigned int i=0; AP4_SUCCEEDED(result) && i<audio_sample_count; i++) {
+        AP4_Size size = 300+Random(random)%200;
+        result = AddSyntheticSample(*audio_table, *sample_storage, random, size, BENCH_AUDIO_FRAME_DURATION, true, 0);
+    }
+
+    // create the movie (the tracks own the sample tables)
+    AP4_Movie* movie = new AP4_Movie(1000);
+    movie->AddTrack(new AP4_Track(AP4_Track::TYPE_VIDEO,
+                                  video_table,
+                                  BENCH_VIDEO_TRACK_ID,
+                                  1000,
+                                  duration*1000,
+                                  BENCH_VIDEO_TIMESCALE,
+                                  (AP4_UI64)video_sample_count*BENCH_VIDEO_FRAME_DURATION,
+                                  "und",
+                                  BENCH_VIDEO_WIDTH<<16,
+                                  BENCH_VIDEO_HEIGHT<<16));
+    movie->AddTrack(new AP4_Track(AP4_Track::TYPE_AUDIO,
+                                  audio_table,
+                                  BENCH_AUDIO_TRACK_ID,
+                                  1000,
+                                  duration*1000,
+                                  BENCH_AUDIO_SAMPLE_RATE,
+                                  (AP4_UI64)audio_sample_count*BENCH_AUDIO_FRAME_DURATION,
+                                  "und",
+                                  0, 0));
+    AP4_File file(movie);
+
+    // write the file to memory
+    if (AP4_SUCCEEDED(result)) {
+        AP4_UI32 compatible_brands[2] = {
+            AP4_FILE_BRAND_ISOM,
+            AP4_FILE_BRAND_AVC1
+        };
+        file.SetFileType(AP4_FILE_BRAND_MP42, 0, compatible_brands, 2);
+        AP4_MemoryByteStream* output = new AP4_MemoryByteStream(mp4);
+        result = AP4_FileWriter::Write(file, *output);
+        output->Release();
+    }
+
+    sample_storage->Release();
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   FragmentMovie
++---------------------------------------------------------------------*/
+static AP4_Result
+FragmentMovie(const AP4_DataBuffer& mp4, AP4_DataBuffer& fragmented_mp4)
+{
+    AP4_Result            result = AP4_SUCCESS;
+    AP4_MemoryByteStream* input  = new AP4_MemoryByteStream(mp4.GetData(), mp4.GetDataSize());
+    AP4_File*             input_file = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Movie*            input_movie = input_file->GetMovie();
+    if (input_movie == NULL) {
+        delete input_file;
+        input->Release();
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+
+    // create the output movie, with an mvex container
+    AP4_Movie*         output_movie = new AP4_Movie(1000);
+    AP4_ContainerAtom* mvex = new AP4_ContainerAtom(AP4_ATOM_TYPE_MVEX);
+    mvex->AddChild(new AP4_MehdAtom(input_movie->GetDuration()));
+    AP4_List<AP4_Track>& tracks = input_movie->GetTracks();
+    for (AP4_List<AP4_Track>::Item* item = tracks.FirstItem(); item; item = item->GetNext()) {
+        AP4_Track* track = item->GetData();
+        AP4_SyntheticSampleTable* sample_table = new AP4_SyntheticSampleTable();
+        for (unsigned int i=0; i<track->GetSampleDescriptionCount(); i++) {
+            sample_table->AddSampleDescription(track->GetSampleDescription(i), false);
+        }
+        output_movie->AddTrack(new AP4_Track(sample_table,
+                                             track->GetId(),
+                                             1000,
+                                             track->GetDuration(),
+                                             track->GetMediaTimeScale(),
+                                             0,
+                                             track));
+        mvex->AddChild(new AP4_TrexAtom(track->GetId(), 1, 0, 0, 0));
+    }
+    output_movie->GetMoovAtom()->AddChild(mvex);
+
+    // write the ftyp and moov
+    AP4_MemoryByteStream* output = new AP4_MemoryByteStream(fragmented_mp4);
+    AP4_UI32 compatible_brands[2] = {
+        AP4_FILE_BRAND_ISOM,
+        AP4_FILE_BRAND_ISO5
+    };
+    AP4_FtypAtom ftyp(AP4_FILE_BRAND_MP42, 0, compatible_brands, 2);
+    ftyp.Write(*output);
+    output_movie->GetMoovAtom()->Write(*output);
+
+    // write one fragment per track for each time slice, in time order
+    AP4_Array<AP4_Ordinal> cursors;
+    cursors.SetItemCount(tracks.ItemCount());
+    for (unsigned int i=0; i<cursors.ItemCount(); i++) {
+        cursors[i] = 0;
+    }
+    AP4_UI32       sequence_number = 1;
+    AP4_Sample     sample;
+    AP4_DataBuffer sample_data;
+    for (unsigned int slice=1; AP4_SUCCEEDED(result); slice++) {
+        bool done = true;
+        unsigned int t = 0;
+        for (AP4_List<AP4_Track>::Item* item = tracks.FirstItem(); item; item = item->GetNext(), t++) {
+            AP4_Track*  track = item->GetData();
+            AP4_Ordinal first = cursors[t];
+            AP4_UI64    end_dts = (AP4_UI64)slice*BENCH_FRAGMENT_DURATION*track->GetMediaTimeScale();
+
+            // collect the samples for this slice
+            AP4_Array<AP4_TrunAtom::Entry> trun_entries;
+            AP4_UI64                       base_dts = 0;
+            AP4_UI32                       mdat_size = AP4_ATOM_HEADER_SIZE;
+            for (; cursors[t] < track->GetSampleCount(); cursors[t]++) {
+                if (AP4_FAILED(track->GetSample(cursors[t], sample))) break;
+                if (sample.GetDts() >= end_dts) break;
+                if (cursors[t] == first) base_dts = sample.GetDts();
+                AP4_TrunAtom::Entry entry;
+                entry.sample_duration                = sample.GetDuration();
+                entry.sample_size                    = sample.GetSize();
+                entry.sample_flags                   = 0;
+                entry.sample_composition_time_offset = sample.GetCtsDelta();
+                trun_entries.Append(entry);
+                mdat_size += sample.GetSize();
+            }
+            if (cursors[t] < track->GetSampleCount()) done = false;
+            if (trun_entries.ItemCount() == 0) continue;
+
+            // setup the moof structure
+            bool is_video = track->GetType() == AP4_Track::TYPE_VIDEO;
+            AP4_ContainerAtom* moof = new AP4_ContainerAtom(AP4_ATOM_TYPE_MOOF);
+            moof->AddChild(new AP4_MfhdAtom(sequence_number++));
+            AP4_ContainerAtom* traf = new AP4_ContainerAtom(AP4_ATOM_TYPE_TRAF);
+            AP4_TfhdAtom* tfhd = new AP4_TfhdAtom(AP4_TFHD_FLAG_DEFAULT_BASE_IS_MOOF |
+                                                  (is_video?AP4_TFHD_FLAG_DEFAULT_SAMPLE_FLAGS_PRESENT:0),
+                                                  track->GetId(),
+                                                  0,
+                                                  1,
+                                                  0,
+                                                  0,
+                                                  0);
+            if (is_video) {
+                tfhd->SetDefaultSampleFlags(0x1010000); // sample_is_non_sync_sample=1, sample_depends_on=1 (not I frame)
+            }
+            traf->AddChild(tfhd);
+            traf->AddChild(new AP4_TfdtAtom(1, base_dts));
+            AP4_TrunAtom* trun = new AP4_TrunAtom(AP4_TRUN_FLAG_DATA_OFFSET_PRESENT     |
+                                                  AP4_TRUN_FLAG_SAMPLE_DURATION_PRESENT |
+                                                  AP4_TRUN_FLAG_SAMPLE_SIZE_PRESENT     |
+                                                  (is_video?AP4_TRUN_FLAG_FIRST_SAMPLE_FLAGS_PRESENT:0),
+                                                  0,
+                                                  is_video?0x2000000:0); // sample_depends_on=2 (I frame)
+            traf->AddChild(trun);
+            moof->AddChild(traf);
+            trun->SetEntries(trun_entries);
+            trun->SetDataOffset((AP4_UI32)moof->GetSize()+AP4_ATOM_HEADER_SIZE);
+
+            // write the moof and the mdat
+            result = moof->Write(*output);
+            delete moof;
+            if (AP4_FAILED(result)) break;
+            output->WriteUI32(mdat_size);
+            output->WriteUI32(AP4_ATOM_TYPE_MDAT);
+            for (AP4_Ordinal i=first; i<cursors[t]; i++) {
+                result = track->ReadSample(i, sample, sample_data);
+                if (AP4_FAILED(result)) break;
+                result = output->Write(sample_data.GetData(), sample_data.GetDataSize());
+                if (AP4_FAILED(result)) break;
+            }
+            if (AP4_FAILED(result)) break;
+        }
+        if (done) break;
+    }
+
+    // cleanup (the output movie references the input sample descriptions)
+    delete output_movie;
+    delete input_file;
+    input->Release();
+    output->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchParse
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchParse(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_MemoryByteStream* input = new AP4_MemoryByteStream(data.m_Mp4.GetData(), data.m_Mp4.GetDataSize());
+    AP4_File* file = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Result result = AP4_SUCCESS;
+    AP4_Movie* movie = file->GetMovie();
+    if (movie) {
+        bytes += (double)movie->GetMoovAtom()->GetSize();
+
+        // look up every sample, so that the sample tables are fully exercised
+        for (AP4_List<AP4_Track>::Item* item = movie->GetTracks().FirstItem(); item; item = item->GetNext()) {
+            AP4_Track* track = item->GetData();
+            AP4_Sample sample;
+            for (AP4_Ordinal i=0; i<track->GetSampleCount(); i++) {
+                result = track->GetSample(i, sample);
+                if (AP4_FAILED(result)) break;
+            }
+            samples += track->GetSampleCount();
+        }
+    } else {
+        result = AP4_ERROR_INVALID_FORMAT;
+    }
+    delete file;
+    input->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   ParseAtomTree
++---------------------------------------------------------------------*/
+static AP4_Result
+ParseAtomTree(const AP4_DataBuffer& mp4, AP4_Arena* arena, double& bytes)
+{
+    AP4_MemoryByteStream* input = new AP4_MemoryByteStream(mp4.GetData(), mp4.GetDataSize());
+    AP4_DefaultAtomFactory atom_factory;
+    atom_factory.SetArena(arena);
+    AP4_File* file = new AP4_File(*input, atom_factory, false);
+    AP4_Result result = file->GetChildren().ItemCount() ? AP4_SUCCESS : AP4_ERROR_INVALID_FORMAT;
+    bytes += (double)mp4.GetDataSize();
+    delete file;
+    input->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchParseTree
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchParseTree(BenchmarkData& data, double& bytes, double& /* samples */)
+{
+    return ParseAtomTree(data.m_FragmentedMp4, NULL, bytes);
+}
+
+/*----------------------------------------------------------------------
+|   BenchParseTreeArena
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchParseTreeArena(BenchmarkData& data, double& bytes, double& /* samples */)
+{
+    AP4_Arena* arena = new AP4_Arena();
+    AP4_Result result = ParseAtomTree(data.m_FragmentedMp4, arena, bytes);
+    arena->Release();
+    
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchLinearRead
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchLinearRead(const AP4_DataBuffer& mp4, double& bytes, double& samples)
+{
+    AP4_MemoryByteStream* input = new AP4_MemoryByteStream(mp4.GetData(), mp4.GetDataSize());
+    AP4_File* file = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Movie* movie = file->GetMovie();
+    if (movie == NULL) {
+        delete file;
+        input->Release();
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+
+    AP4_LinearReader reader(*movie, movie->HasFragments()?input:NULL);
+    for (AP4_List<AP4_Track>::Item* item = movie->GetTracks().FirstItem(); item; item = item->GetNext()) {
+        reader.EnableTrack(item->GetData()->GetId());
+    }
+    AP4_Result     result;
+    AP4_Sample     sample;
+    AP4_DataBuffer sample_data;
+    AP4_UI32       track_id = 0;
+    while (AP4_SUCCEEDED(result = reader.ReadNextSample(sample, sample_data, track_id))) {
+        bytes += sample_data.GetDataSize();
+        samples += 1;
+    }
+    if (result == AP4_ERROR_EOS) result = AP4_SUCCESS;
+
+    delete file;
+    input->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   SampleReader
++---------------------------------------------------------------------*/
+class SampleReader : public AP4_Runnable
+{
+public:
+    SampleReader() : m_Movie(NULL), m_Start(0), m_Step(1), m_Result(AP4_SUCCESS), m_Bytes(0), m_Samples(0) {}
+
+    // AP4_Runnable methods
+    void Run() {
+        AP4_Sample     sample;
+        AP4_DataBuffer sample_data;
+        for (AP4_List<AP4_Track>::Item* item = m_Movie->GetTracks().FirstItem(); item; item = item->GetNext()) {
+            AP4_Track* track = item->GetData();
+            for (AP4_Ordinal i=m_Start; i<track->GetSampleCount(); i += m_Step) {
+                m_Result = track->ReadSample(i, sample, sample_data);
+                if (AP4_FAILED(m_Result)) return;
+                m_Bytes += sample_data.GetDataSize();
+                m_Samples += 1;
+            }
+        }
+    }
+
+    // members
+    AP4_Movie*   m_Movie;
+    AP4_Ordinal  m_Start;
+    AP4_Cardinal m_Step;
+    AP4_Result   m_Result;
+    double       m_Bytes;
+    double       m_Samples;
+};
+
+/*----------------------------------------------------------------------
+|   BenchParallelRead
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchParallelRead(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_MemoryByteStream* input = new AP4_MemoryByteStream(data.m_Mp4.GetData(), data.m_Mp4.GetDataSize());
+    AP4_File* file = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Movie* movie = file->GetMovie();
+    AP4_Result result = movie ? movie->PrepareForConcurrentReads() : AP4_ERROR_INVALID_FORMAT;
+    if (AP4_SUCCEEDED(result)) {
+        // all the readers share the same movie, each one reads every n-th sample
+        unsigned int   reader_count = Options.thread_count;
+        SampleReader*  readers = new SampleReader[reader_count];
+        AP4_Thread**   threads = new AP4_Thread*[reader_count];
+        for (unsigned int i=0; i<reader_count; i++) {
+            readers[i].m_Movie = movie;
+            readers[i].m_Start = i;
+            readers[i].m_Step  = reader_count;
+            threads[i] = new AP4_Thread(readers[i]);
+            if (AP4_FAILED(threads[i]->Start())) readers[i].Run();
+        }
+        for (unsigned int i=0; i<reader_count; i++) {
+            delete threads[i]; // waits for the thread
+            if (AP4_FAILED(readers[i].m_Result)) result = readers[i].m_Result;
+            bytes   += readers[i].m_Bytes;
+            samples += readers[i].m_Samples;
+        }
+        delete[] threads;
+        delete[] readers;
+    }
+
+    delete file;
+    input->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchFragment
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchFragment(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_DataBuffer fragmented_mp4;
+    fragmented_mp4.Reserve(data.m_FragmentedMp4.GetDataSize());
+    AP4_Result result = FragmentMovie(data.m_Mp4, fragmented_mp4);
+    bytes   += (double)data.m_SampleBytes;
+    samples += data.m_SampleCount;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   ProcessMovie
++---------------------------------------------------------------------*/
+static AP4_Result
+ProcessMovie(AP4_Processor& processor, const AP4_DataBuffer& input_data, AP4_DataBuffer& output_data)
+{
+    AP4_MemoryByteStream* input  = new AP4_MemoryByteStream(input_data.GetData(), input_data.GetDataSize());
+    AP4_MemoryByteStream* output = new AP4_MemoryByteStream(output_data);
+    output_data.SetDataSize(0);
+    AP4_Result result = processor.Process(*input, *output);
+    input->Release();
+    output->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   EncryptMovie
++---------------------------------------------------------------------*/
+static AP4_Result
+EncryptMovie(const AP4_DataBuffer& fragmented_mp4, AP4_DataBuffer& encrypted_mp4)
+{
+    AP4_CencEncryptingProcessor processor(AP4_CENC_VARIANT_MPEG);
+    processor.GetKeyMap().SetKey(BENCH_VIDEO_TRACK_ID, BENCH_KEY, 16, BENCH_IV, 16);
+    processor.GetKeyMap().SetKey(BENCH_AUDIO_TRACK_ID, BENCH_KEY, 16, BENCH_IV, 16);
+    processor.SetThreadCount(Options.thread_count);
+
+    return ProcessMovie(processor, fragmented_mp4, encrypted_mp4);
+}
+
+/*----------------------------------------------------------------------
+|   BenchCencEncrypt
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchCencEncrypt(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_DataBuffer encrypted_mp4;
+    encrypted_mp4.Reserve(data.m_EncryptedMp4.GetDataSize());
+    AP4_Result result = EncryptMovie(data.m_FragmentedMp4, encrypted_mp4);
+    bytes   += (double)data.m_SampleBytes;
+    samples += data.m_SampleCount;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchCencDecrypt
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchCencDecrypt(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_ProtectionKeyMap key_map;
+    key_map.SetKey(BENCH_VIDEO_TRACK_ID, BENCH_KEY, 16);
+    key_map.SetKey(BENCH_AUDIO_TRACK_ID, BENCH_KEY, 16);
+    AP4_CencDecryptingProcessor processor(&key_map);
+
+    AP4_DataBuffer decrypted_mp4;
+    decrypted_mp4.Reserve(data.m_EncryptedMp4.GetDataSize());
+    AP4_Result result = ProcessMovie(processor, data.m_EncryptedMp4, decrypted_mp4);
+    bytes   += (double)data.m_SampleBytes;
+    samples += data.m_SampleCount;
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   BenchTsMux
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchTsMux(BenchmarkData& data, double& bytes, double& samples)
+{
+    AP4_MemoryByteStream* input = new AP4_MemoryByteStream(data.m_Mp4.GetData(), data.m_Mp4.GetDataSize());
+    AP4_File*  file  = new AP4_File(*input, AP4_DefaultAtomFactory::Instance, true);
+    AP4_Movie* movie = file->GetMovie();
+    AP4_Track* video_track = movie?movie->GetTrack(AP4_Track::TYPE_VIDEO):NULL;
+    AP4_Track* audio_track = movie?movie->GetTrack(AP4_Track::TYPE_AUDIO):NULL;
+    if (video_track == NULL || audio_track == NULL) {
+        delete file;
+        input->Release();
+        return AP4_ERROR_INVALID_FORMAT;
+    }
+
+    AP4_DataBuffer                   ts;
+    AP4_MemoryByteStream*            output = new AP4_MemoryByteStream(ts);
+    AP4_Mpeg2TsWriter                writer;
+    AP4_Mpeg2TsWriter::SampleStream* audio_stream = NULL;
+    AP4_Mpeg2TsWriter::SampleStream* video_stream = NULL;
+    ts.Reserve(data.m_Mp4.GetDataSize()+data.m_Mp4.GetDataSize()/8);
+    AP4_Result result = writer.SetAudioStream(audio_track->GetMediaTimeScale(),
+                                              AP4_MPEG2_STREAM_TYPE_ISO_IEC_13818_7,
+                                              AP4_MPEG2_TS_DEFAULT_STREAM_ID_AUDIO,
+                                              audio_stream);
+    if (AP4_SUCCEEDED(result)) {
+        result = writer.SetVideoStream(video_track->GetMediaTimeScale(),
+                                       AP4_MPEG2_STREAM_TYPE_AVC,
+                                       AP4_MPEG2_TS_DEFAULT_STREAM_ID_VIDEO,
+                                       video_stream);
+    }
+    if (AP4_SUCCEEDED(result)) {
+        writer.WritePAT(*output);
+        writer.WritePMT(*output);
+    }
+
+    // write the samples of both tracks, interleaved by timestamp
+    AP4_Ordinal    audio_index = 0;
+    AP4_Ordinal    video_index = 0;
+    AP4_Sample     sample;
+    AP4_DataBuffer sample_data;
+    while (AP4_SUCCEEDED(result)) {
+        bool audio_eos = audio_index >= audio_track->GetSampleCount();
+        bool video_eos = video_index >= video_track->GetSampleCount();
+        if (audio_eos && video_eos) break;
+
+        bool use_video = audio_eos;
+        if (!audio_eos && !video_eos) {
+            AP4_Sample audio_sample;
+            AP4_Sample video_sample;
+            audio_track->GetSample(audio_index, audio_sample);
+            video_track->GetSample(video_index, video_sample);
+            use_video = (double)video_sample.GetDts()/(double)video_track->GetMediaTimeScale() <=
+                        (double)audio_sample.GetDts()/(double)audio_track->GetMediaTimeScale();
+        }
+        if (use_video) {
+            result = video_track->ReadSample(video_index++, sample, sample_data);
+            if (AP4_FAILED(result)) break;
+            result = video_stream->WriteSample(sample,
+                                               sample_data,
+                                               video_track->GetSampleDescription(sample.GetDescriptionIndex()),
+                                               true,
+                                               *output);
+        } else {
+            result = audio_track->ReadSample(audio_index++, sample, sample_data);
+            if (AP4_FAILED(result)) break;
+            result = audio_stream->WriteSample(sample,
+                                               sample_data,
+                                               audio_track->GetSampleDescription(sample.GetDescriptionIndex()),
+                                               false,
+                                               *output);
+        }
+        bytes   += sample_data.GetDataSize();
+        samples += 1;
+    }
+
+    output->Release();
+    delete file;
+    input->Release();
+
+    return result;
+}
+
+/*----------------------------------------------------------------------
+|   RunBenchmark
++---------------------------------------------------------------------*/
+typedef AP4_Result (*BenchmarkFunction)(BenchmarkData& data, double& bytes, double& samples);
+
+static AP4_Result
+RunBenchmark(const char*       name,
+             BenchmarkFunction function,
+             BenchmarkData&    data,
+             BenchmarkResult&  bench_result)
+{
+    bench_result.m_Name       = name;
+    bench_result.m_Iterations = 0;
+    bench_result.m_Seconds    = 0.0;
+    bench_result.m_Bytes      = 0.0;
+    bench_result.m_Samples    = 0.0;
+
+    fprintf(stderr, "%s: ", name);
+    double start = GetTime();
+    double elapsed = 0.0;
+    do {
+        AP4_Result result = function(data, bench_result.m_Bytes, bench_result.m_Samples);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "FAILED (%d)\n", result);
+            return result;
+        }
+        ++bench_result.m_Iterations;
+        elapsed = GetTime()-start;
+    } while (Options.max_iterations ?
+             bench_result.m_Iterations < Options.max_iterations :
+             elapsed < Options.min_time);
+    bench_result.m_Seconds = elapsed;
+
+    fprintf(stderr, "%.2f MB/s, %.0f samples/s (%u iterations in %.3f seconds)\n",
+            bench_result.m_Bytes/BENCH_SCALE_MB/elapsed,
+            bench_result.m_Samples/elapsed,
+            bench_result.m_Iterations,
+            elapsed);
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   BenchLinearReadFlat
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchLinearReadFlat(BenchmarkData& data, double& bytes, double& samples)
+{
+    return BenchLinearRead(data.m_Mp4, bytes, samples);
+}
+
+/*----------------------------------------------------------------------
+|   BenchLinearReadFragmented
++---------------------------------------------------------------------*/
+static AP4_Result
+BenchLinearReadFragmented(BenchmarkData& data, double& bytes, double& samples)
+{
+    return BenchLinearRead(data.m_FragmentedMp4, bytes, samples);
+}
+
+/*----------------------------------------------------------------------
+|   benchmark table
++---------------------------------------------------------------------*/
+static const struct {
+    const char*       name;
+    BenchmarkFunction function;
+} Benchmarks[] = {
+    { "parse",                  BenchParse                },
+    { "parse-tree",             BenchParseTree            },
+    { "parse-tree-arena",       BenchParseTreeArena       },
+    { "linear-read",            BenchLinearReadFlat       },
+    { "linear-read-fragmented", BenchLinearReadFragmented },
+    { "parallel-read",          BenchParallelRead         },
+    { "fragment",               BenchFragment             },
+    { "cenc-encrypt",           BenchCencEncrypt          },
+    { "cenc-decrypt",           BenchCencDecrypt          },
+    { "ts-mux",                 BenchTsMux                }
+};
+const unsigned int BenchmarkCount = sizeof(Benchmarks)/sizeof(Benchmarks[0]);
+
+/*----------------------------------------------------------------------
+|   WriteJson
++---------------------------------------------------------------------*/
+static void
+WriteJson(FILE*                       out,
+          BenchmarkData&              data,
+          AP4_Array<BenchmarkResult>& results)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"bento4_version\": \"%s\",\n", AP4_VERSION_STRING);
+    fprintf(out, "  \"config\": {\n");
+    fprintf(out, "    \"media_duration\": %u,\n", Options.media_duration);
+    fprintf(out, "    \"threads\": %u,\n", Options.thread_count);
+    fprintf(out, "    \"sample_count\": %u,\n", data.m_SampleCount);
+    fprintf(out, "    \"sample_bytes\": %llu,\n", (unsigned long long)data.m_SampleBytes);
+    fprintf(out, "    \"mp4_size\": %u,\n", (unsigned int)data.m_Mp4.GetDataSize());
+    fprintf(out, "    \"fragmented_mp4_size\": %u\n", (unsigned int)data.m_FragmentedMp4.GetDataSize());
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"results\": [");
+    for (unsigned int i=0; i<results.ItemCount(); i++) {
+        const BenchmarkResult& result = results[i];
+        double seconds = result.m_Seconds > 0.0 ? result.m_Seconds : 1e-9;
+        fprintf(out, "%s\n    {\n", i?",":"");
+        fprintf(out, "      \"name\": \"%s\",\n", result.m_Name);
+        fprintf(out, "      \"iterations\": %u,\n", result.m_Iterations);
+        fprintf(out, "      \"seconds\": %.6f,\n", result.m_Seconds);
+        fprintf(out, "      \"bytes\": %.0f,\n", result.m_Bytes);
+        fprintf(out, "      \"samples\": %.0f,\n", result.m_Samples);
+        fprintf(out, "      \"mb_per_second\": %.3f,\n", result.m_Bytes/BENCH_SCALE_MB/seconds);
+        fprintf(out, "      \"samples_per_second\": %.1f,\n", result.m_Samples/seconds);
+        fprintf(out, "      \"ms_per_iteration\": %.3f\n", 1000.0*result.m_Seconds/result.m_Iterations);
+        fprintf(out, "    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int /*argc*/, char** argv)
+{
+    Options.media_duration  = BENCH_DEFAULT_MEDIA_DURATION;
+    Options.min_time        = BENCH_DEFAULT_MIN_TIME;
+    Options.max_iterations  = 0;
+    Options.thread_count    = 1;
+    Options.output_filename = NULL;
+
+    bool selected[BenchmarkCount];
+    bool any_selected = false;
+    for (unsigned int i=0; i<BenchmarkCount; i++) selected[i] = false;
+
+    while (const char* arg = *++argv) {
+        if (!strcmp(arg, "--duration")) {
+            if (*++argv == NULL) PrintUsageAndExit();
+            Options.media_duration = (unsigned int)strtoul(*argv, NULL, 10);
+            if (Options.media_duration == 0) PrintUsageAndExit();
+        } else if (!strcmp(arg, "--min-time")) {
+            if (*++argv == NULL) PrintUsageAndExit();
+            Options.min_time = strtod(*argv, NULL);
+        } else if (!strcmp(arg, "--iterations")) {
+            if (*++argv == NULL) PrintUsageAndExit();
+            Options.max_iterations = (unsigned int)strtoul(*argv, NULL, 10);
+        } else if (!strcmp(arg, "--threads")) {
+            if (*++argv == NULL) PrintUsageAndExit();
+            Options.thread_count = (unsigned int)strtoul(*argv, NULL, 10);
+            if (Options.thread_count == 0) Options.thread_count = AP4_System_GetProcessorCount();
+        } else if (!strcmp(arg, "--output")) {
+            if (*++argv == NULL) PrintUsageAndExit();
+            Options.output_filename = *argv;
+        } else if (arg[0] == '-') {
+            fprintf(stderr, "ERROR: unknown option (%s)\n", arg);
+            PrintUsageAndExit();
+        } else {
+            unsigned int i;
+            for (i=0; i<BenchmarkCount; i++) {
+                if (!strcmp(arg, Benchmarks[i].name)) break;
+            }
+            if (i == BenchmarkCount) {
+                fprintf(stderr, "ERROR: unknown test name (%s)\n", arg);
+                PrintUsageAndExit();
+            }
+            selected[i] = any_selected = true;
+        }
+    }
+    if (!any_selected) {
+        for (unsigned int i=0; i<BenchmarkCount; i++) selected[i] = true;
+    }
+
+    // generate the test media
+    BenchmarkData data;
+    fprintf(stderr, "generating %u seconds of synthetic media...\n", Options.media_duration);
+    AP4_Result result = CreateSyntheticMovie(Options.media_duration, data.m_Mp4);
+    if (AP4_SUCCEEDED(result)) {
+        result = FragmentMovie(data.m_Mp4, data.m_FragmentedMp4);
+    }
+    if (AP4_SUCCEEDED(result)) {
+        result = EncryptMovie(data.m_FragmentedMp4, data.m_EncryptedMp4);
+    }
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "ERROR: failed to generate the test media (%d)\n", result);
+        return 1;
+    }
+    {
+        double bytes = 0.0, samples = 0.0;
+        BenchLinearRead(data.m_Mp4, bytes, samples);
+        data.m_SampleBytes = (AP4_UI64)bytes;
+        data.m_SampleCount = (AP4_Cardinal)samples;
+    }
+
+    // run the benchmarks
+    AP4_Array<BenchmarkResult> results;
+    int exit_code = 0;
+    for (unsigned int i=0; i<BenchmarkCount; i++) {
+        if (!selected[i]) continue;
+        BenchmarkResult bench_result;
+        if (AP4_SUCCEEDED(RunBenchmark(Benchmarks[i].name, Benchmarks[i].function, data, bench_result))) {
+            results.Append(bench_result);
+        } else {
+            exit_code = 1;
+        }
+    }
+
+    // output the results
+    FILE* out = stdout;
+    if (Options.output_filename) {
+        out = fopen(Options.output_filename, "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: cannot open output file (%s)\n", Options.output_filename);
+            return 1;
+        }
+    }
+    WriteJson(out, data, results);
+    if (out != stdout) fclose(out);
+
+    return exit_code;
+}
@@ -0,0 +1,261 @@
+/*****************************************************************
+|
+|    AP4 - Segment Builder Test
+|
+|    Copyright 2002-2017 Axiomatic Systems, LLC
+|
+|
+|    This file is part of Bento4/AP4 (MP4 Atom Processing Library).
+|
+|    Unless you have obtained Bento4 under a difference license,
+|    this version of Bento4 is Bento4|GPL.
+|    Bento4|GPL is free software; you can redistribute it and/or modify
+|    it under the terms of the GNU General Public License as published by
+|    the Free Software Foundation; either version 2, or (at your option)
+|    any later version.
+|
+|    Bento4|GPL is distributed in the hope that it will be useful,
+|    but WITHOUT ANY WARRANTY; without even the implied warranty of
+|    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+|    GNU General Public License for more details.
+|
+|    You should have received a copy of the GNU General Public License
+|    along with Bento4|GPL; see the file COPYING.  If not, write to the
+|    Free Software Foundation, 59 Temple Place - Suite 330, Boston, MA
+|    02111-1307, USA.
+|
+ ****************************************************************/
+
+/*----------------------------------------------------------------------
+|   includes
++---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Ap4.h"
+
+/*----------------------------------------------------------------------
+|   constants
++---------------------------------------------------------------------*/
+const unsigned int SAMPLE_COUNT = 10;
+
+/*----------------------------------------------------------------------
+|   macros
++---------------------------------------------------------------------*/
+#define CHECK(x)                                                  \
+do {                                                              \
+    if (!(x)) {                                                   \
+        fprintf(stderr, "ERROR line %d: %s\n", __LINE__, #x);     \
+        return AP4_FAILURE;                                       \
+    }                                                             \
+} while(0)
+
+/*----------------------------------------------------------------------
+|   TestSegmentBuilder
++---------------------------------------------------------------------*/
+class TestSegmentBuilder : public AP4_SegmentBuilder
+{
+public:
+    TestSegmentBuilder(AP4_Track::Type track_type) :
+        AP4_SegmentBuilder(track_type, 1) {}
+
+    // AP4_SegmentBuilder methods
+    AP4_Result WriteInitSegment(AP4_ByteStream& /* stream */) {
+        return AP4_ERROR_NOT_SUPPORTED;
+    }
+};
+
+/*----------------------------------------------------------------------
+|   Chunk
++---------------------------------------------------------------------*/
+struct Chunk {
+    AP4_DataBuffer m_Data;
+    unsigned int   m_SequenceNumber;
+    AP4_UI64       m_MediaStartTime;
+    AP4_UI64       m_MediaDuration;
+    bool           m_Independent;
+};
+
+/*----------------------------------------------------------------------
+|   ChunkCollector
++---------------------------------------------------------------------*/
+class ChunkCollector : public AP4_SegmentBuilder::ChunkListener
+{
+public:
+    ~ChunkCollector() {
+        for (unsigned int i=0; i<m_Chunks.ItemCount(); i++) {
+            delete m_Chunks[i];
+        }
+    }
+
+    // AP4_SegmentBuilder::ChunkListener methods
+    AP4_Result OnChunk(const AP4_DataBuffer& chunk,
+                       unsigned int          sequence_number,
+                       AP4_UI64              media_start_time,
+                       AP4_UI64              media_duration,
+                       bool                  independent) {
+        // the chunk data is only valid during the call, keep a copy
+        Chunk* copy = new Chunk();
+        copy->m_Data.SetData(chunk.GetData(), chunk.GetDataSize());
+        copy->m_SequenceNumber = sequence_number;
+        copy->m_MediaStartTime = media_start_time;
+        copy->m_MediaDuration  = media_duration;
+        copy->m_Independent    = independent;
+        return m_Chunks.Append(copy);
+    }
+
+    // members
+    AP4_Array<Chunk*> m_Chunks;
+};
+
+/*----------------------------------------------------------------------
+|   CreateSamples
++---------------------------------------------------------------------*/
+static void
+CreateSamples(AP4_MemoryByteStream& source,
+              AP4_UI32              duration,
+              AP4_Array<AP4_Sample>& samples)
+{
+    AP4_Position offset = 0;
+    AP4_UI64     dts    = 0;
+    for (unsigned int i=0; i<SAMPLE_COUNT; i++) {
+        // each sample has its own size and its own byte pattern
+        AP4_Size size = 100+13*i;
+        for (unsigned int j=0; j<size; j++) {
+            source.WriteUI08((AP4_UI08)(i*31+j));
+        }
+        samples.Append(AP4_Sample(source, offset, size, duration, 1, dts, 0, i%6 == 0));
+        offset += size;
+        dts    += duration;
+    }
+}
+
+/*----------------------------------------------------------------------
+|   CheckChunk
++---------------------------------------------------------------------*/
+static AP4_Result
+CheckChunk(Chunk&                 chunk,
+           unsigned int           sequence_number,
+           AP4_MemoryByteStream&  source,
+           AP4_Array<AP4_Sample>& samples,
+           unsigned int           first_sample,
+           unsigned int           sample_count)
+{
+    // chunk info
+    AP4_Sample& first = samples[first_sample];
+    CHECK(chunk.m_SequenceNumber == sequence_number);
+    CHECK(chunk.m_MediaStartTime == first.GetDts());
+    CHECK(chunk.m_MediaDuration  == sample_count*first.GetDuration());
+    CHECK(chunk.m_Independent    == first.IsSync());
+
+    // the chunk is a 'moof' followed by an 'mdat'
+    AP4_MemoryByteStream* stream = new AP4_MemoryByteStream(chunk.m_Data.GetData(), chunk.m_Data.GetDataSize());
+    AP4_Atom* atom = NULL;
+    CHECK(AP4_SUCCEEDED(AP4_DefaultAtomFactory::Instance.CreateAtomFromStream(*stream, atom)));
+    stream->Release();
+    AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+    CHECK(moof && moof->GetType() == AP4_ATOM_TYPE_MOOF);
+    AP4_MfhdAtom* mfhd = AP4_DYNAMIC_CAST(AP4_MfhdAtom, moof->GetChild(AP4_ATOM_TYPE_MFHD));
+    AP4_TfdtAtom* tfdt = AP4_DYNAMIC_CAST(AP4_TfdtAtom, moof->FindChild("traf/tfdt"));
+    AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, moof->FindChild("traf/trun"));
+    CHECK(mfhd && tfdt && trun);
+    CHECK(mfhd->GetSequenceNumber() == sequence_number);
+    CHECK(tfdt->GetBaseMediaDecodeTime() == first.GetDts());
+    CHECK(trun->GetEntries().ItemCount() == sample_count);
+    AP4_Size moof_size = (AP4_Size)moof->GetSize();
+    CHECK(trun->GetDataOffset() == (AP4_SI32)(moof_size+AP4_ATOM_HEADER_SIZE));
+
+    // the 'mdat' holds exactly the bytes of the chunk's samples, in order
+    const AP4_UI08* mdat = chunk.m_Data.GetData()+moof_size;
+    AP4_Size payload_size = 0;
+    for (unsigned int i=0; i<sample_count; i++) {
+        CHECK(trun->GetEntries()[i].sample_size == samples[first_sample+i].GetSize());
+        payload_size += samples[first_sample+i].GetSize();
+    }
+    CHECK(chunk.m_Data.GetDataSize() == moof_size+AP4_ATOM_HEADER_SIZE+payload_size);
+    CHECK(AP4_BytesToUInt32BE(mdat)   == AP4_ATOM_HEADER_SIZE+payload_size);
+    CHECK(AP4_BytesToUInt32BE(mdat+4) == AP4_ATOM_TYPE_MDAT);
+    const AP4_UI08* payload = mdat+AP4_ATOM_HEADER_SIZE;
+    for (unsigned int i=0; i<sample_count; i++) {
+        AP4_Sample& sample = samples[first_sample+i];
+        CHECK(AP4_CompareMemory(payload, source.GetData()+sample.GetOffset(), sample.GetSize()) == 0);
+        payload += sample.GetSize();
+    }
+    delete moof;
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   TestChunks
++---------------------------------------------------------------------*/
+static AP4_Result
+TestChunks(AP4_Track::Type     track_type,
+           AP4_Cardinal        max_chunk_samples,
+           AP4_UI32            max_chunk_duration_ms,
+           AP4_UI32            sample_duration,
+           const unsigned int* expected_chunk_sizes,
+           unsigned int        expected_chunk_count)
+{
+    AP4_MemoryByteStream* source = new AP4_MemoryByteStream();
+    AP4_Array<AP4_Sample> samples;
+    CreateSamples(*source, sample_duration, samples);
+
+    // feed all the samples, the last chunk is only delivered when flushed
+    TestSegmentBuilder builder(track_type);
+    ChunkCollector     collector;
+    builder.SetChunkListener(&collector, max_chunk_samples, max_chunk_duration_ms);
+    for (unsigned int i=0; i<samples.ItemCount(); i++) {
+        CHECK(AP4_SUCCEEDED(builder.AddSample(samples[i])));
+    }
+    CHECK(collector.m_Chunks.ItemCount() == expected_chunk_count-1);
+    CHECK(AP4_SUCCEEDED(builder.FlushChunk()));
+    CHECK(AP4_SUCCEEDED(builder.FlushChunk())); // nothing left to deliver
+    CHECK(collector.m_Chunks.ItemCount() == expected_chunk_count);
+
+    unsigned int first_sample = 0;
+    for (unsigned int i=0; i<expected_chunk_count; i++) {
+        AP4_Result result = CheckChunk(*collector.m_Chunks[i],
+                                       i+1,
+                                       *source,
+                                       samples,
+                                       first_sample,
+                                       expected_chunk_sizes[i]);
+        if (AP4_FAILED(result)) {
+            fprintf(stderr, "chunk %d is not valid\n", i+1);
+            return result;
+        }
+        first_sample += expected_chunk_sizes[i];
+    }
+    CHECK(first_sample == SAMPLE_COUNT);
+
+    samples.Clear();
+    source->Release();
+
+    return AP4_SUCCESS;
+}
+
+/*----------------------------------------------------------------------
+|   main
++---------------------------------------------------------------------*/
+int
+main(int /*argc*/, char** /*argv*/)
+{
+    // chunks of at most 3 samples
+    const unsigned int by_count[] = {3, 3, 3, 1};
+    AP4_Result result = TestChunks(AP4_Track::TYPE_AUDIO, 3, 0, 20, by_count, 4);
+
+    // chunks of at most 100ms, with 50ms samples
+    const unsigned int by_duration[] = {2, 2, 2, 2, 2};
+    if (AP4_SUCCEEDED(result)) {
+        result = TestChunks(AP4_Track::TYPE_VIDEO, 0, 100, 50, by_duration, 5);
+    }
+
+    if (AP4_FAILED(result)) {
+        fprintf(stderr, "FAILED\n");
+        return 1;
+    }
+    printf("PASSED\n");
+
+    return 0;
+}
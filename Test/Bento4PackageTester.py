@@ -0,0 +1,130 @@
+#! /usr/bin/env python
+
+# Checks that mp4package produces the same segments as the mp4-dash.py
+# pipeline (mp4fragment, then mp4encrypt, then mp4split) for a ladder.
+#
+# usage: Bento4PackageTester.py <bin-root> <input> [<input> ...]
+
+import os
+import sys
+import json
+import shutil
+import filecmp
+import tempfile
+import subprocess
+
+KID = '000102030405060708090A0B0C0D0E0F'
+KEY = '00112233445566778899AABBCCDDEEFF'
+IV  = '0123456789ABCDEF'
+
+SEGMENT_PATTERN = 'seg-%llu.m4f'
+
+def Run(args):
+    print(' '.join(args))
+    subprocess.check_call(args)
+
+def Bento4Command(name, *args):
+    Run([os.path.join(BIN_ROOT, name)] + list(args))
+
+def GetInfo(input):
+    output = subprocess.check_output([os.path.join(BIN_ROOT, 'mp4info'), '--format', 'json', input])
+    return json.loads(output.decode('utf-8'))
+
+def PackageWithPipeline(inputs, output_dir, encrypt):
+    # same renditions as mp4package: video/<n>, and audio/<lang> for the
+    # first audio track of each language
+    video_count = 0
+    languages = []
+    for (index, input) in enumerate(inputs):
+        info = GetInfo(input)
+        fragmented = info['movie']['fragments']
+        renditions = []
+        for track in info['tracks']:
+            if not fragmented and track['media']['sample_count'] == 0:
+                continue
+            if track['type'] == 'Video':
+                video_count += 1
+                renditions.append((track['id'], os.path.join(output_dir, 'video', str(video_count))))
+            elif track['type'] == 'Audio' and track['language'] not in languages:
+                languages.append(track['language'])
+                renditions.append((track['id'], os.path.join(output_dir, 'audio', track['language'])))
+
+        source = input
+        if not fragmented:
+            fragmented_file = os.path.join(WORK_DIR, 'fragmented-%d.mp4' % index)
+            Bento4Command('mp4fragment', input, fragmented_file)
+            source = fragmented_file
+        if encrypt:
+            encrypted_file = os.path.join(WORK_DIR, 'encrypted-%d.mp4' % index)
+            args = ['--method', 'MPEG-CENC']
+            for (track_id, directory) in renditions:
+                args += ['--key', '%d:%s:%s' % (track_id, KEY, IV), '--property', '%d:KID:%s' % (track_id, KID)]
+            Bento4Command('mp4encrypt', *(args + [source, encrypted_file]))
+            source = encrypted_file
+
+        for (track_id, directory) in renditions:
+            os.makedirs(directory)
+            Bento4Command('mp4split',
+                          '--track-id', str(track_id),
+                          '--pattern-parameters', 'N',
+                          '--start-number', '1',
+                          '--init-segment', os.path.join(directory, 'init.mp4'),
+                          '--media-segment', os.path.join(directory, SEGMENT_PATTERN),
+                          source)
+
+def PackageWithMp4Package(inputs, output_dir, encrypt):
+    args = ['--threads', '0', '--output-dir', output_dir]
+    if encrypt:
+        args += ['--key', KID+':'+KEY+':'+IV]
+    Bento4Command('mp4package', *(args + inputs))
+
+def ListFiles(root):
+    files = []
+    for (directory, subdirs, names) in os.walk(root):
+        for name in names:
+            files.append(os.path.relpath(os.path.join(directory, name), root))
+    return sorted(files)
+
+def Compare(expected_dir, actual_dir):
+    expected = ListFiles(expected_dir)
+    actual   = ListFiles(actual_dir)
+    if expected != actual:
+        print('MISMATCH: file lists differ')
+        print('  only in pipeline output:   ' + str([f for f in expected if f not in actual]))
+        print('  only in mp4package output: ' + str([f for f in actual if f not in expected]))
+        return False
+    if len(expected) == 0:
+        print('MISMATCH: no segments')
+        return False
+    ok = True
+    for name in expected:
+        if not filecmp.cmp(os.path.join(expected_dir, name), os.path.join(actual_dir, name), shallow=False):
+            print('MISMATCH: ' + name)
+            ok = False
+    return ok
+
+if len(sys.argv) < 3:
+    print('usage: Bento4PackageTester.py <bin-root> <input> [<input> ...]')
+    sys.exit(1)
+
+BIN_ROOT = sys.argv[1]
+INPUTS   = sys.argv[2:]
+WORK_DIR = tempfile.mkdtemp()
+
+failures = 0
+try:
+    for encrypt in [False, True]:
+        mode = encrypt and 'encrypted' or 'clear'
+        pipeline_dir = os.path.join(WORK_DIR, 'pipeline-'+mode)
+        package_dir  = os.path.join(WORK_DIR, 'mp4package-'+mode)
+        PackageWithPipeline(INPUTS, pipeline_dir, encrypt)
+        PackageWithMp4Package(INPUTS, package_dir, encrypt)
+        if Compare(pipeline_dir, package_dir):
+            print('PASSED (' + mode + ')')
+        else:
+            print('FAILED (' + mode + ')')
+            failures += 1
+finally:
+    shutil.rmtree(WORK_DIR)
+
+sys.exit(failures and 1 or 0)